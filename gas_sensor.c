@@ -7,10 +7,23 @@
  */
 
 #include "gas_sensor.h"
+#include "gas_sensor_layout.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+/* Channel masks for decoder variants; CO2 and O2 are always decoded */
+#define CHANNEL_N2O     0x01u
+#define CHANNEL_AA      0x02u
+#define CHANNEL_ALL     (CHANNEL_N2O | CHANNEL_AA)
+
+/* Forces the per-variant copies of the frame parser to be specialized */
+#if defined(__GNUC__)
+#define ALWAYS_INLINE   inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE   inline
+#endif
+
 /* ============================================================================
  * Helper Functions - Frame Parsing Utilities
  * ============================================================================ */
@@ -71,106 +84,126 @@ static uint16_t parse_uint16_be(const uint8_t *data)
     return ((uint16_t)data[0] << 8) | data[1];
 }
 
+/**
+ * Decode a two-digit BCD byte (0x42 = 42)
+ */
+static uint16_t parse_bcd(uint8_t value)
+{
+    return (uint16_t)((value >> 4) * 10 + (value & 0x0F));
+}
+
 /* ============================================================================
  * Slow Data Parsing Functions - One per Frame ID
  * ============================================================================ */
 
+/**
+ * Parse the slow data value of one channel; channels that are not fitted
+ * are reported as invalid without being decoded
+ */
+static inline float parse_channel(uint8_t raw_value, unsigned channels, unsigned channel)
+{
+    return (channels & channel) ? parse_concentration(raw_value) : GAS_SENSOR_CONC_INVALID;
+}
+
 /**
  * Parse inspiration values (Frame ID 0x00)
- * Bytes 13-18 of frame: CO2, N2O, AA1, AA2, O2 (5 bytes) + reserved
+ * Bytes 14-19 of frame: CO2, N2O, AA1, AA2, O2 (5 bytes) + reserved
  */
-static void parse_insp_vals(const uint8_t *slow_data_bytes,
-                           gas_sensor_insp_vals_t *insp)
+static inline void parse_insp_vals(const uint8_t *slow_data_bytes,
+                                   gas_sensor_insp_vals_t *insp,
+                                   unsigned channels)
 {
-    insp->co2 = parse_concentration(slow_data_bytes[0]);
-    insp->n2o = parse_concentration(slow_data_bytes[1]);
-    insp->aa1 = parse_concentration(slow_data_bytes[2]);
-    insp->aa2 = parse_concentration(slow_data_bytes[3]);
-    insp->o2 = parse_concentration(slow_data_bytes[4]);
+    insp->co2 = parse_concentration(slow_data_bytes[GAS_SENSOR_SLOW_CO2]);
+    insp->n2o = parse_channel(slow_data_bytes[GAS_SENSOR_SLOW_N2O], channels, CHANNEL_N2O);
+    insp->aa1 = parse_channel(slow_data_bytes[GAS_SENSOR_SLOW_AA1], channels, CHANNEL_AA);
+    insp->aa2 = parse_channel(slow_data_bytes[GAS_SENSOR_SLOW_AA2], channels, CHANNEL_AA);
+    insp->o2 = parse_concentration(slow_data_bytes[GAS_SENSOR_SLOW_O2]);
 }
 
 /**
  * Parse expiration values (Frame ID 0x01)
- * Bytes 13-18 of frame: CO2, N2O, AA1, AA2, O2 (5 bytes) + reserved
+ * Bytes 14-19 of frame: CO2, N2O, AA1, AA2, O2 (5 bytes) + reserved
  */
-static void parse_exp_vals(const uint8_t *slow_data_bytes,
-                          gas_sensor_exp_vals_t *exp)
+static inline void parse_exp_vals(const uint8_t *slow_data_bytes,
+                                  gas_sensor_exp_vals_t *exp,
+                                  unsigned channels)
 {
-    exp->co2 = parse_concentration(slow_data_bytes[0]);
-    exp->n2o = parse_concentration(slow_data_bytes[1]);
-    exp->aa1 = parse_concentration(slow_data_bytes[2]);
-    exp->aa2 = parse_concentration(slow_data_bytes[3]);
-    exp->o2 = parse_concentration(slow_data_bytes[4]);
+    exp->co2 = parse_concentration(slow_data_bytes[GAS_SENSOR_SLOW_CO2]);
+    exp->n2o = parse_channel(slow_data_bytes[GAS_SENSOR_SLOW_N2O], channels, CHANNEL_N2O);
+    exp->aa1 = parse_channel(slow_data_bytes[GAS_SENSOR_SLOW_AA1], channels, CHANNEL_AA);
+    exp->aa2 = parse_channel(slow_data_bytes[GAS_SENSOR_SLOW_AA2], channels, CHANNEL_AA);
+    exp->o2 = parse_concentration(slow_data_bytes[GAS_SENSOR_SLOW_O2]);
 }
 
 /**
  * Parse momentary values (Frame ID 0x02)
- * Bytes 13-18 of frame: CO2, N2O, AA1, AA2, O2 (5 bytes) + reserved
+ * Bytes 14-19 of frame: CO2, N2O, AA1, AA2, O2 (5 bytes) + reserved
  */
-static void parse_mom_vals(const uint8_t *slow_data_bytes,
-                          gas_sensor_mom_vals_t *mom)
+static inline void parse_mom_vals(const uint8_t *slow_data_bytes,
+                                  gas_sensor_mom_vals_t *mom,
+                                  unsigned channels)
 {
-    mom->co2 = parse_concentration(slow_data_bytes[0]);
-    mom->n2o = parse_concentration(slow_data_bytes[1]);
-    mom->aa1 = parse_concentration(slow_data_bytes[2]);
-    mom->aa2 = parse_concentration(slow_data_bytes[3]);
-    mom->o2 = parse_concentration(slow_data_bytes[4]);
+    mom->co2 = parse_concentration(slow_data_bytes[GAS_SENSOR_SLOW_CO2]);
+    mom->n2o = parse_channel(slow_data_bytes[GAS_SENSOR_SLOW_N2O], channels, CHANNEL_N2O);
+    mom->aa1 = parse_channel(slow_data_bytes[GAS_SENSOR_SLOW_AA1], channels, CHANNEL_AA);
+    mom->aa2 = parse_channel(slow_data_bytes[GAS_SENSOR_SLOW_AA2], channels, CHANNEL_AA);
+    mom->o2 = parse_concentration(slow_data_bytes[GAS_SENSOR_SLOW_O2]);
 }
 
 /**
  * Parse general values (Frame ID 0x03)
- * Byte 13: Respiratory rate (0xFF = invalid)
- * Byte 14: Time since breath (0xFF = invalid)
- * Byte 15: Agent identification
- * Byte 16: Secondary agent identification
- * Bytes 17-18: Atmospheric pressure (big-endian, 0xFFFF = invalid)
+ * Byte 14: Respiratory rate (0xFF = invalid)
+ * Byte 15: Time since breath (0xFF = invalid)
+ * Byte 16: Agent identification
+ * Byte 17: Secondary agent identification
+ * Bytes 18-19: Atmospheric pressure (big-endian, 0.1 kPa, 0xFFFF = invalid)
  */
 static void parse_gen_vals(const uint8_t *slow_data_bytes,
                           gas_sensor_gen_vals_t *gen)
 {
-    gen->resp_rate = slow_data_bytes[0];
-    gen->time_since_breath = slow_data_bytes[1];
-    gen->primary_agent = (gas_agent_id_t)slow_data_bytes[2];
-    gen->secondary_agent = (gas_agent_id_t)slow_data_bytes[3];
+    gen->resp_rate = slow_data_bytes[GAS_SENSOR_SLOW_RESP_RATE];
+    gen->time_since_breath = slow_data_bytes[GAS_SENSOR_SLOW_SINCE_BREATH];
+    gen->primary_agent = (gas_agent_id_t)slow_data_bytes[GAS_SENSOR_SLOW_PRIMARY_AGENT];
+    gen->secondary_agent = (gas_agent_id_t)slow_data_bytes[GAS_SENSOR_SLOW_SECONDARY_AGENT];
     
-    uint16_t pressure_raw = parse_uint16_be(&slow_data_bytes[4]);
+    uint16_t pressure_raw = parse_uint16_be(&slow_data_bytes[GAS_SENSOR_SLOW_ATM_PRESSURE]);
     if (pressure_raw == 0xFFFF) {
         gen->atm_pressure = GAS_SENSOR_CONC_INVALID;
     } else {
-        gen->atm_pressure = (float)pressure_raw / 100.0f;  /* In kPa */
+        gen->atm_pressure = (float)pressure_raw / 10.0f;   /* 0.1 kPa units */
     }
 }
 
 /**
  * Parse sensor registers (Frame ID 0x04)
- * Byte 13: Mode
- * Byte 14: Error register
- * Byte 15: Adapter status register
- * Byte 16: Data valid register
- * Byte 17: Reserved
- * Byte 18: Reserved
+ * Byte 14: Mode (bits 2-0)
+ * Byte 15: Reserved
+ * Byte 16: Error register
+ * Byte 17: Adapter status register
+ * Byte 18: Data valid register
+ * Byte 19: Reserved
  */
 static void parse_sensor_regs(const uint8_t *slow_data_bytes,
                              gas_sensor_sensor_regs_t *regs)
 {
     /* Mode */
-    regs->mode = (gas_sensor_mode_t)slow_data_bytes[0];
+    regs->mode = (gas_sensor_mode_t)(slow_data_bytes[GAS_SENSOR_SLOW_MODE] & GAS_SENSOR_MODE_MASK);
     
-    /* Error register (byte 14) */
-    uint8_t error_byte = slow_data_bytes[1];
+    /* Error register (byte 16) */
+    uint8_t error_byte = slow_data_bytes[GAS_SENSOR_SLOW_ERROR];
     regs->error.sw_error = (error_byte & 0x01) != 0;
     regs->error.hw_error = (error_byte & 0x02) != 0;
     regs->error.motor_fail = (error_byte & 0x04) != 0;
     regs->error.uncalibrated = (error_byte & 0x08) != 0;
     
-    /* Adapter status register (byte 15) */
-    uint8_t adapter_byte = slow_data_bytes[2];
+    /* Adapter status register (byte 17) */
+    uint8_t adapter_byte = slow_data_bytes[GAS_SENSOR_SLOW_ADAPTER];
     regs->adapter.replace_adapter = (adapter_byte & 0x01) != 0;
     regs->adapter.no_adapter = (adapter_byte & 0x02) != 0;
     regs->adapter.o2_clogged = (adapter_byte & 0x04) != 0;
     
-    /* Data valid register (byte 16) */
-    uint8_t valid_byte = slow_data_bytes[3];
+    /* Data valid register (byte 18) */
+    uint8_t valid_byte = slow_data_bytes[GAS_SENSOR_SLOW_DATA_VALID];
     regs->data_valid.co2_out_of_range = (valid_byte & 0x01) != 0;
     regs->data_valid.n2o_out_of_range = (valid_byte & 0x02) != 0;
     regs->data_valid.agent_out_of_range = (valid_byte & 0x04) != 0;
@@ -182,16 +215,17 @@ static void parse_sensor_regs(const uint8_t *slow_data_bytes,
 
 /**
  * Parse configuration data (Frame ID 0x05)
- * Byte 13: Fitted options (bit flags)
- * Byte 14: Reserved
- * Bytes 15-16: Hardware revision (big-endian)
- * Bytes 17-18: Software revision (big-endian)
+ * Byte 14: Sensor config register 0 (fitted options)
+ * Byte 15: Hardware revision (BCD, 0-99)
+ * Bytes 16-17: Software revision (BCD, HI byte 0-99, LO byte 0-99)
+ * Byte 18: Sensor config register 1 (bit 0 = agent ID option)
+ * Byte 19: Communication protocol revision (BCD, 0-99)
  */
 static void parse_config_data(const uint8_t *slow_data_bytes,
                              gas_sensor_config_data_t *config)
 {
-    /* Fitted options (byte 13) */
-    uint8_t fitted_byte = slow_data_bytes[0];
+    /* Fitted options (byte 14) */
+    uint8_t fitted_byte = slow_data_bytes[GAS_SENSOR_SLOW_CONFIG0];
     config->o2_fitted = (fitted_byte & 0x01) != 0;
     config->co2_fitted = (fitted_byte & 0x02) != 0;
     config->n2o_fitted = (fitted_byte & 0x04) != 0;
@@ -201,31 +235,32 @@ static void parse_config_data(const uint8_t *slow_data_bytes,
     config->sevoflurane_fitted = (fitted_byte & 0x40) != 0;
     config->desflurane_fitted = (fitted_byte & 0x80) != 0;
     
-    /* Hardware revision (bytes 15-16) */
-    config->hw_revision = parse_uint16_be(&slow_data_bytes[2]);
+    /* Revisions (bytes 15-17) */
+    config->hw_revision = parse_bcd(slow_data_bytes[GAS_SENSOR_SLOW_HW_REV]);
+    config->sw_revision = (uint16_t)(parse_bcd(slow_data_bytes[GAS_SENSOR_SLOW_SW_REV]) * 100 +
+                                     parse_bcd(slow_data_bytes[GAS_SENSOR_SLOW_SW_REV + 1]));
     
-    /* Software revision (bytes 17-18) */
-    config->sw_revision = parse_uint16_be(&slow_data_bytes[4]);
+    /* Config register 1 (byte 18) */
+    config->id_config = (slow_data_bytes[GAS_SENSOR_SLOW_CONFIG1] & 0x01) != 0;
     
-    /* Configuration flags */
-    config->id_config = false;  /* Would need additional info to determine */
-    config->comm_protocol_rev = 0;  /* Would need additional info */
+    /* Protocol revision (byte 19) */
+    config->comm_protocol_rev = (uint8_t)parse_bcd(slow_data_bytes[GAS_SENSOR_SLOW_PROTOCOL_REV]);
 }
 
 /**
  * Parse service data (Frame ID 0x06)
- * Bytes 13-14: Serial number (big-endian)
- * Byte 15: Service status register
- * Bytes 16-18: Reserved
+ * Bytes 14-15: Serial number (big-endian)
+ * Byte 16: Service status register
+ * Bytes 17-19: Reserved
  */
 static void parse_service_data(const uint8_t *slow_data_bytes,
                               gas_sensor_service_data_t *service)
 {
-    /* Serial number (bytes 13-14) */
-    service->serial_number = parse_uint16_be(&slow_data_bytes[0]);
+    /* Serial number (bytes 14-15) */
+    service->serial_number = parse_uint16_be(&slow_data_bytes[GAS_SENSOR_SLOW_SERIAL]);
     
-    /* Service status register (byte 15) */
-    uint8_t status_byte = slow_data_bytes[2];
+    /* Service status register (byte 16) */
+    uint8_t status_byte = slow_data_bytes[GAS_SENSOR_SLOW_SERVICE_STATUS];
     service->status.zero_disabled = (status_byte & 0x01) != 0;
     service->status.zero_in_progress = (status_byte & 0x02) != 0;
     service->status.span_calibration_error = (status_byte & 0x04) != 0;
@@ -236,10 +271,14 @@ static void parse_service_data(const uint8_t *slow_data_bytes,
  * Public API Functions
  * ============================================================================ */
 
-int gas_sensor_parse_frame(const uint8_t *frame_data,
-                          gas_sensor_slow_data_t *slow_data,
-                          gas_sensor_waveform_t *waveform,
-                          gas_sensor_status_t *status)
+/**
+ * Frame parser body, specialized per channel mask
+ */
+static ALWAYS_INLINE int parse_frame_channels(const uint8_t *frame_data,
+                                              gas_sensor_slow_data_t *slow_data,
+                                              gas_sensor_waveform_t *waveform,
+                                              gas_sensor_status_t *status,
+                                              unsigned channels)
 {
     /* Parameter validation */
     if (frame_data == NULL) {
@@ -258,29 +297,27 @@ int gas_sensor_parse_frame(const uint8_t *frame_data,
     
     /* Parse waveform data (bytes 4-13: 10 bytes for 5 concentrations × 2 bytes each, big-endian) */
     if (waveform != NULL) {
-        waveform->co2 = parse_concentration_2byte(parse_uint16_be(&frame_data[4]));
-        waveform->n2o = parse_concentration_2byte(parse_uint16_be(&frame_data[6]));
-        waveform->aa1 = parse_concentration_2byte(parse_uint16_be(&frame_data[8]));
-        waveform->aa2 = parse_concentration_2byte(parse_uint16_be(&frame_data[10]));
-        waveform->o2 = parse_concentration_2byte(parse_uint16_be(&frame_data[12]));
+        waveform->co2 = parse_concentration_2byte(parse_uint16_be(&frame_data[GAS_SENSOR_OFFSET_CO2]));
+        waveform->n2o = (channels & CHANNEL_N2O)
+                        ? parse_concentration_2byte(parse_uint16_be(&frame_data[GAS_SENSOR_OFFSET_N2O]))
+                        : GAS_SENSOR_CONC_INVALID;
+        waveform->aa1 = (channels & CHANNEL_AA)
+                        ? parse_concentration_2byte(parse_uint16_be(&frame_data[GAS_SENSOR_OFFSET_AA1]))
+                        : GAS_SENSOR_CONC_INVALID;
+        waveform->aa2 = (channels & CHANNEL_AA)
+                        ? parse_concentration_2byte(parse_uint16_be(&frame_data[GAS_SENSOR_OFFSET_AA2]))
+                        : GAS_SENSOR_CONC_INVALID;
+        waveform->o2 = parse_concentration_2byte(parse_uint16_be(&frame_data[GAS_SENSOR_OFFSET_O2]));
     }
     
     /* Parse status byte (byte 3) */
     if (status != NULL) {
-        uint8_t status_byte = frame_data[3];
-        status->breath_detected = (status_byte & 0x01) != 0;
-        status->apnea = (status_byte & 0x02) != 0;
-        status->o2_low = (status_byte & 0x04) != 0;
-        status->o2_replace = (status_byte & 0x08) != 0;
-        status->check_adapter = (status_byte & 0x10) != 0;
-        status->accuracy_out_of_range = (status_byte & 0x20) != 0;
-        status->sensor_error = (status_byte & 0x40) != 0;
-        status->o2_calibration_required = (status_byte & 0x80) != 0;
+        gas_sensor_decode_status(frame_data[GAS_SENSOR_OFFSET_STS], status);
     }
     
     /* Parse slow data based on frame ID (byte 2) */
     if (slow_data != NULL) {
-        uint8_t frame_id = frame_data[2];
+        uint8_t frame_id = frame_data[GAS_SENSOR_OFFSET_ID];
         
         /* Validate frame ID */
         if (frame_id >= GAS_SENSOR_FRAME_ID_MAX) {
@@ -289,18 +326,18 @@ int gas_sensor_parse_frame(const uint8_t *frame_data,
         
         slow_data->last_frame_id = frame_id;
         
-        /* Bytes 13-18 contain slow data */
-        const uint8_t *slow_data_bytes = &frame_data[13];
+        /* Bytes 14-19 contain slow data */
+        const uint8_t *slow_data_bytes = &frame_data[GAS_SENSOR_OFFSET_SLOW];
         
         switch (frame_id) {
             case 0x00:
-                parse_insp_vals(slow_data_bytes, &slow_data->insp_vals);
+                parse_insp_vals(slow_data_bytes, &slow_data->insp_vals, channels);
                 break;
             case 0x01:
-                parse_exp_vals(slow_data_bytes, &slow_data->exp_vals);
+                parse_exp_vals(slow_data_bytes, &slow_data->exp_vals, channels);
                 break;
             case 0x02:
-                parse_mom_vals(slow_data_bytes, &slow_data->mom_vals);
+                parse_mom_vals(slow_data_bytes, &slow_data->mom_vals, channels);
                 break;
             case 0x03:
                 parse_gen_vals(slow_data_bytes, &slow_data->gen_vals);
@@ -325,6 +362,62 @@ int gas_sensor_parse_frame(const uint8_t *frame_data,
     return GAS_SENSOR_OK;
 }
 
+int gas_sensor_parse_frame(const uint8_t *frame_data,
+                          gas_sensor_slow_data_t *slow_data,
+                          gas_sensor_waveform_t *waveform,
+                          gas_sensor_status_t *status)
+{
+    return parse_frame_channels(frame_data, slow_data, waveform, status, CHANNEL_ALL);
+}
+
+/* Decoder variants for sensors lacking N2O and/or agent options */
+static int parse_frame_no_aa(const uint8_t *frame_data,
+                             gas_sensor_slow_data_t *slow_data,
+                             gas_sensor_waveform_t *waveform,
+                             gas_sensor_status_t *status)
+{
+    return parse_frame_channels(frame_data, slow_data, waveform, status, CHANNEL_N2O);
+}
+
+static int parse_frame_no_n2o(const uint8_t *frame_data,
+                              gas_sensor_slow_data_t *slow_data,
+                              gas_sensor_waveform_t *waveform,
+                              gas_sensor_status_t *status)
+{
+    return parse_frame_channels(frame_data, slow_data, waveform, status, CHANNEL_AA);
+}
+
+static int parse_frame_co2_o2(const uint8_t *frame_data,
+                              gas_sensor_slow_data_t *slow_data,
+                              gas_sensor_waveform_t *waveform,
+                              gas_sensor_status_t *status)
+{
+    return parse_frame_channels(frame_data, slow_data, waveform, status, 0);
+}
+
+gas_sensor_decoder_fn gas_sensor_select_decoder(const gas_sensor_config_data_t *config)
+{
+    static const gas_sensor_decoder_fn variants[4] = {
+        parse_frame_co2_o2,         /* Neither */
+        parse_frame_no_aa,          /* N2O only */
+        parse_frame_no_n2o,         /* Agents only */
+        gas_sensor_parse_frame      /* Both */
+    };
+    
+    if (config == NULL) {
+        return gas_sensor_parse_frame;
+    }
+    
+    /* Every protocol revision documented so far uses the same frame
+     * layout, so only the fitted options select a variant */
+    bool aa_fitted = config->halothane_fitted || config->enflurane_fitted ||
+                     config->isoflurane_fitted || config->sevoflurane_fitted ||
+                     config->desflurane_fitted;
+    unsigned channels = (config->n2o_fitted ? CHANNEL_N2O : 0) |
+                        (aa_fitted ? CHANNEL_AA : 0);
+    return variants[channels];
+}
+
 bool gas_sensor_verify_checksum(const uint8_t *frame_data)
 {
     if (frame_data == NULL) {
@@ -345,6 +438,30 @@ bool gas_sensor_verify_checksum(const uint8_t *frame_data)
     return calculated == frame_checksum;
 }
 
+uint8_t gas_sensor_compute_checksum(const uint8_t *frame_data)
+{
+    if (frame_data == NULL) {
+        return 0;
+    }
+    
+    return calculate_checksum(frame_data);
+}
+
+int gas_sensor_build_command(uint8_t command_id, uint8_t param, uint8_t *command)
+{
+    if (command == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    
+    command[0] = GAS_SENSOR_FLAG1;
+    command[1] = GAS_SENSOR_FLAG2;
+    command[2] = command_id;
+    command[3] = param;
+    command[4] = (uint8_t)(-(command_id + param));
+    
+    return GAS_SENSOR_OK;
+}
+
 void gas_sensor_init_slow_data(gas_sensor_slow_data_t *slow_data)
 {
     if (slow_data == NULL) {
@@ -380,6 +497,67 @@ float gas_sensor_parse_concentration(uint8_t raw_value)
     return parse_concentration(raw_value);
 }
 
+uint8_t gas_sensor_frame_id(const uint8_t *frame_data)
+{
+    return (frame_data != NULL) ? frame_data[GAS_SENSOR_OFFSET_ID] : GAS_SENSOR_NO_DATA;
+}
+
+uint8_t gas_sensor_frame_status(const uint8_t *frame_data)
+{
+    return (frame_data != NULL) ? frame_data[GAS_SENSOR_OFFSET_STS] : 0;
+}
+
+float gas_sensor_frame_waveform(const uint8_t *frame_data, gas_sensor_channel_t channel)
+{
+    if (frame_data == NULL || (unsigned)channel >= GAS_SENSOR_CH_COUNT) {
+        return GAS_SENSOR_CONC_INVALID;
+    }
+    
+    /* Channels are consecutive big-endian words starting at byte 4 */
+    return parse_concentration_2byte(parse_uint16_be(&frame_data[4 + 2 * channel]));
+}
+
+void gas_sensor_decode_status(uint8_t status_byte, gas_sensor_status_t *status)
+{
+    if (status == NULL) {
+        return;
+    }
+    
+    status->breath_detected = (status_byte & GAS_SENSOR_STS_BREATH) != 0;
+    status->apnea = (status_byte & GAS_SENSOR_STS_APNEA) != 0;
+    status->o2_low = (status_byte & GAS_SENSOR_STS_O2_LOW) != 0;
+    status->o2_replace = (status_byte & GAS_SENSOR_STS_O2_REPLACE) != 0;
+    status->check_adapter = (status_byte & GAS_SENSOR_STS_CHECK_ADAPTER) != 0;
+    status->accuracy_out_of_range = (status_byte & GAS_SENSOR_STS_ACCURACY) != 0;
+    status->sensor_error = (status_byte & GAS_SENSOR_STS_SENSOR_ERROR) != 0;
+    status->o2_calibration_required = (status_byte & GAS_SENSOR_STS_O2_CALIBRATION) != 0;
+}
+
+void gas_sensor_cycle_init(gas_sensor_cycle_t *cycle)
+{
+    if (cycle == NULL) {
+        return;
+    }
+    
+    memset(cycle, 0, sizeof(*cycle));
+}
+
+bool gas_sensor_cycle_update(gas_sensor_cycle_t *cycle, uint8_t frame_id)
+{
+    if (cycle == NULL || frame_id >= GAS_SENSOR_FRAME_ID_MAX) {
+        return false;
+    }
+    
+    cycle->seen |= (uint16_t)(1u << frame_id);
+    if ((cycle->seen & GAS_SENSOR_CYCLE_DATA_IDS) != GAS_SENSOR_CYCLE_DATA_IDS) {
+        return false;
+    }
+    
+    cycle->seen = 0;
+    cycle->completed++;
+    return true;
+}
+
 const char *gas_sensor_strerror(int error_code)
 {
     switch (error_code) {
@@ -391,6 +569,18 @@ const char *gas_sensor_strerror(int error_code)
             return "Checksum verification failed";
         case GAS_SENSOR_ERR_NULL_PARAM:
             return "NULL parameter provided";
+        case GAS_SENSOR_ERR_IO:
+            return "I/O error";
+        case GAS_SENSOR_ERR_MEMORY:
+            return "Memory allocation failed";
+        case GAS_SENSOR_ERR_FORMAT:
+            return "Invalid or unsupported data format";
+        case GAS_SENSOR_ERR_EOF:
+            return "End of data";
+        case GAS_SENSOR_ERR_INVALID_PARAM:
+            return "Invalid parameter value";
+        case GAS_SENSOR_ERR_NO_SPACE:
+            return "Output buffer too small";
         default:
             return "Unknown error";
     }
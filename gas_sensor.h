@@ -25,6 +25,12 @@ extern "C" {
 #define GAS_SENSOR_ERR_INVALID_FRAME    -1
 #define GAS_SENSOR_ERR_CHECKSUM         -2
 #define GAS_SENSOR_ERR_NULL_PARAM       -3
+#define GAS_SENSOR_ERR_IO               -4
+#define GAS_SENSOR_ERR_MEMORY           -5
+#define GAS_SENSOR_ERR_FORMAT           -6
+#define GAS_SENSOR_ERR_EOF              -7
+#define GAS_SENSOR_ERR_INVALID_PARAM    -8
+#define GAS_SENSOR_ERR_NO_SPACE         -9
 
 /* ============================================================================
  * Constants
@@ -37,13 +43,42 @@ extern "C" {
 
 #define GAS_SENSOR_NO_DATA              0xFF
 
+/* Host-to-sensor command frames: FLAG1 FLAG2 ID Param CHK */
+#define GAS_SENSOR_COMMAND_SIZE         5
+#define GAS_SENSOR_CMD_SET_MODE         0x00    /* Param: gas_sensor_mode_t */
+#define GAS_SENSOR_CMD_SET_APNEA        0x01    /* Param: apnea time, 20-60 s */
+#define GAS_SENSOR_CMD_SET_PID          0x02    /* Param: primary agent, 0-5 */
+#define GAS_SENSOR_CMD_SET_O2           0x04    /* Param: O2 %, 0-100 */
+
+/* SetO2 parameter telling the sensor to use its own O2 measurement */
+#define GAS_SENSOR_O2_MEASURED          255
+
 /* Special value for "no data" - represents missing measurement */
 #define GAS_SENSOR_CONC_INVALID         -1.0f
 
+/* Status summary byte (STS) bits */
+#define GAS_SENSOR_STS_BREATH           0x01
+#define GAS_SENSOR_STS_APNEA            0x02
+#define GAS_SENSOR_STS_O2_LOW           0x04
+#define GAS_SENSOR_STS_O2_REPLACE       0x08
+#define GAS_SENSOR_STS_CHECK_ADAPTER    0x10
+#define GAS_SENSOR_STS_ACCURACY         0x20
+#define GAS_SENSOR_STS_SENSOR_ERROR     0x40
+#define GAS_SENSOR_STS_O2_CALIBRATION   0x80
+
+/* STS bits that signal a condition needing attention (BREATH, ACCURACY and
+ * O2 calibration excluded) */
+#define GAS_SENSOR_STS_ALARM_MASK       (GAS_SENSOR_STS_APNEA | GAS_SENSOR_STS_O2_LOW | \
+                                         GAS_SENSOR_STS_O2_REPLACE | GAS_SENSOR_STS_CHECK_ADAPTER | \
+                                         GAS_SENSOR_STS_SENSOR_ERROR)
+
 /* ============================================================================
  * Enumerations
  * ============================================================================ */
 
+/* Mode bits of the sensor mode register (ID 0x04, byte 0) */
+#define GAS_SENSOR_MODE_MASK            0x07
+
 typedef enum {
     GAS_SENSOR_MODE_SELF_TEST = 0,
     GAS_SENSOR_MODE_SLEEP = 1,
@@ -60,6 +95,16 @@ typedef enum {
     GAS_AGENT_DESFLURANE = 5
 } gas_agent_id_t;
 
+/* Waveform channels, in frame order */
+typedef enum {
+    GAS_SENSOR_CH_CO2 = 0,
+    GAS_SENSOR_CH_N2O = 1,
+    GAS_SENSOR_CH_AA1 = 2,
+    GAS_SENSOR_CH_AA2 = 3,
+    GAS_SENSOR_CH_O2 = 4,
+    GAS_SENSOR_CH_COUNT = 5
+} gas_sensor_channel_t;
+
 /* ============================================================================
  * Fast Data Structure (Waveform Data)
  * 
@@ -179,10 +224,10 @@ typedef struct {
     bool isoflurane_fitted;         /* Isoflurane option fitted */
     bool sevoflurane_fitted;        /* Sevoflurane option fitted */
     bool desflurane_fitted;         /* Desflurane option fitted */
-    uint16_t hw_revision;           /* Hardware revision */
-    uint16_t sw_revision;           /* Software revision */
-    bool id_config;                 /* Agent ID auto-identification enabled */
-    uint8_t comm_protocol_rev;      /* Communication protocol revision */
+    uint16_t hw_revision;           /* Hardware revision, 0-99 (BCD decoded) */
+    uint16_t sw_revision;           /* Software revision, 0-9999 (BCD decoded) */
+    bool id_config;                 /* Agent ID option fitted (config register 1) */
+    uint8_t comm_protocol_rev;      /* Communication protocol revision, 0-99 (BCD decoded) */
 } gas_sensor_config_data_t;
 
 /* Service status register (ID 0x06, byte 2) */
@@ -233,6 +278,49 @@ typedef struct {
     /* Note: IDs 0x07-0x09 are reserved (no data) */
 } gas_sensor_slow_data_t;
 
+/* ============================================================================
+ * Slow Data Cycle Tracking
+ * 
+ * A cycle is complete once every data-carrying frame ID (0x00-0x06) has
+ * been received since the previous cycle. At that point slow_data is a
+ * consistent snapshot of one 500ms cycle.
+ * ============================================================================ */
+
+#define GAS_SENSOR_CYCLE_DATA_IDS       0x7F    /* Bit per frame ID 0x00-0x06 */
+
+typedef struct {
+    uint16_t seen;                  /* Bit per frame ID seen in this cycle */
+    uint32_t completed;             /* Number of completed cycles */
+} gas_sensor_cycle_t;
+
+/* ============================================================================
+ * Frame Events
+ * 
+ * Common consumer interface for decoded frames. Live sources and capture
+ * readers deliver the same event, so one handler serves both.
+ * ============================================================================ */
+
+typedef struct {
+    uint32_t sensor_id;                     /* Source sensor identifier */
+    uint64_t timestamp_us;                  /* Receive time (us since epoch) */
+    const uint8_t *frame;                   /* Raw 21-byte frame */
+    const gas_sensor_slow_data_t *slow_data;/* Persistent slow data of sensor */
+    const gas_sensor_waveform_t *waveform;  /* Waveform from this frame */
+    const gas_sensor_status_t *status;      /* Status from this frame */
+} gas_sensor_frame_event_t;
+
+/**
+ * Frame event handler
+ * 
+ * Pointers in the event are only valid for the duration of the call.
+ * 
+ * @param ctx: User context registered with the handler
+ * @param event: Decoded frame event
+ * @return: GAS_SENSOR_OK to continue, any other value stops delivery
+ */
+typedef int (*gas_sensor_frame_handler_t)(void *ctx,
+                                          const gas_sensor_frame_event_t *event);
+
 
 /* ============================================================================
  * Public API Functions
@@ -246,13 +334,13 @@ int gas_sensor_parse_frame(const uint8_t *frame_data,
  * Parse a complete 21-byte gas sensor frame
  * 
  * This is the primary API function. It takes a pre-buffered frame and extracts:
- *   - Waveform data (CO2, N2O, AA1, AA2, O2) from bytes 4-12
- *   - Slow data fields (bytes 13-18) identified by frame ID
+ *   - Waveform data (CO2, N2O, AA1, AA2, O2) from bytes 4-13
+ *   - Slow data fields (bytes 14-19) identified by frame ID
  *   - Status byte interpretation (byte 3)
  * 
  * Frame format (21 bytes):
  *   [0] 0xAA (sync), [1] 0x55 (sync), [2] Frame ID (0-9),
- *   [3] Status, [4-12] Waveform, [13-18] Slow data, [19-20] Checksum
+ *   [3] Status, [4-13] Waveform, [14-19] Slow data, [20] Checksum
  * 
  * Note: Frame synchronization (finding 0xAA 0x55) is handled by the application.
  *       This function expects a complete, properly aligned 21-byte buffer.
@@ -265,16 +353,64 @@ int gas_sensor_parse_frame(const uint8_t *frame_data,
  *          GAS_SENSOR_ERR_CHECKSUM on verification failure, GAS_SENSOR_ERR_NULL_PARAM
  */
 
+/**
+ * Frame decoder with the signature of gas_sensor_parse_frame()
+ */
+typedef int (*gas_sensor_decoder_fn)(const uint8_t *frame_data,
+                                     gas_sensor_slow_data_t *slow_data,
+                                     gas_sensor_waveform_t *waveform,
+                                     gas_sensor_status_t *status);
+
+/**
+ * Select a frame decoder specialized for one sensor variant
+ * 
+ * The returned decoder behaves like gas_sensor_parse_frame(), except that
+ * the N2O and agent (AA1/AA2) channels of waveform and Fi/Et/momentary
+ * values are reported as GAS_SENSOR_CONC_INVALID without being decoded
+ * when the configuration shows the option is not fitted. The choice is
+ * made once, so the per-frame path has no variant branches.
+ * 
+ * @param config: Configuration data reported by the sensor, or NULL
+ * @return: Decoder for the variant (gas_sensor_parse_frame for NULL or a
+ *          fully fitted sensor)
+ */
+gas_sensor_decoder_fn gas_sensor_select_decoder(const gas_sensor_config_data_t *config);
+
 /**
  * Verify frame checksum
  * 
- * Validates the two's complement checksum in bytes 19-20.
+ * Validates the two's complement checksum in byte 20.
  * 
  * @param frame_data: Pointer to 21-byte frame buffer
  * @return: true if checksum is valid, false otherwise
  */
 bool gas_sensor_verify_checksum(const uint8_t *frame_data);
 
+/**
+ * Compute frame checksum
+ * 
+ * Returns the two's complement of the sum of bytes 2-19, i.e. the value
+ * byte 20 must hold. Used when building frames (simulators, test data).
+ * 
+ * @param frame_data: Pointer to 21-byte frame buffer
+ * @return: Checksum byte
+ */
+uint8_t gas_sensor_compute_checksum(const uint8_t *frame_data);
+
+/**
+ * Build a host-to-sensor command frame
+ * 
+ * Writes FLAG1, FLAG2, the command ID, the parameter and a checksum equal
+ * to the two's complement of the sum of ID and parameter. Parameters are
+ * not range checked; the sensor ignores values outside a command's range.
+ * 
+ * @param command_id: Command (GAS_SENSOR_CMD_*)
+ * @param param: Command parameter
+ * @param command: Output buffer of GAS_SENSOR_COMMAND_SIZE bytes
+ * @return: GAS_SENSOR_OK or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_build_command(uint8_t command_id, uint8_t param, uint8_t *command);
+
 /**
  * Initialize slow data structure with default values
  * 
@@ -297,6 +433,60 @@ void gas_sensor_init_slow_data(gas_sensor_slow_data_t *slow_data);
  */
 float gas_sensor_parse_concentration(uint8_t raw_value);
 
+/* ============================================================================
+ * Decode-on-Demand Accessors
+ * 
+ * Read single fields straight from a validated 21-byte frame, for code that
+ * stores or forwards raw frames and only occasionally needs a value.
+ * ============================================================================ */
+
+/**
+ * Get the frame ID (byte 2)
+ */
+uint8_t gas_sensor_frame_id(const uint8_t *frame_data);
+
+/**
+ * Get the raw status summary byte (byte 3); test with GAS_SENSOR_STS_*
+ */
+uint8_t gas_sensor_frame_status(const uint8_t *frame_data);
+
+/**
+ * Decode one waveform channel
+ * 
+ * @param frame_data: Pointer to validated 21-byte frame
+ * @param channel: Waveform channel
+ * @return: Concentration in percent, or GAS_SENSOR_CONC_INVALID if the
+ *          sensor reported no data or channel is out of range
+ */
+float gas_sensor_frame_waveform(const uint8_t *frame_data, gas_sensor_channel_t channel);
+
+/**
+ * Interpret a status summary byte
+ * 
+ * @param status_byte: Raw STS byte
+ * @param status: Output status structure
+ */
+void gas_sensor_decode_status(uint8_t status_byte, gas_sensor_status_t *status);
+
+/* ============================================================================
+ * Slow Data Cycle Tracking
+ * ============================================================================ */
+
+/**
+ * Reset a cycle tracker
+ */
+void gas_sensor_cycle_init(gas_sensor_cycle_t *cycle);
+
+/**
+ * Record a parsed frame ID
+ * 
+ * @param cycle: Cycle tracker
+ * @param frame_id: ID of a successfully parsed frame
+ * @return: true if this frame completed a cycle (the slow data structure
+ *          now holds a full, consistent snapshot)
+ */
+bool gas_sensor_cycle_update(gas_sensor_cycle_t *cycle, uint8_t frame_id);
+
 /**
  * Get human-readable error message for error codes
  * 
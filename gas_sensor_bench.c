@@ -0,0 +1,358 @@
+/*
+ * Anesthetic Gas Sensor End-to-End Benchmark
+ *
+ * Measures the complete ingest path rather than gas_sensor_parse_frame()
+ * alone: N simulated sensors write frames into ptys at their real cadence,
+ * and a gateway thread services them with the session manager (serial
+ * read, stream sync, parse, dispatch to a consumer). Reported figures:
+ *   - delivered frames per second and frames lost
+ *   - gateway CPU time, in total and per 100 sensors
+ *   - write-to-delivery latency percentiles
+ *
+ * Each frame carries a sequence number in the unused AA2 waveform word so
+ * the consumer can match it to the time it was written.
+ *
+ * Build:
+ *   gcc -O2 -o gas_sensor_bench gas_sensor_bench.c gas_sensor.c \
+ *       gas_sensor_stream.c gas_sensor_session.c gas_sensor_sim.c \
+ *       gas_sensor_format.c gas_sensor_clock.c gas_sensor_mem.c -lpthread
+ *
+ * Usage:
+ *   gas_sensor_bench [-n sensors] [-d seconds] [-r frames_per_second]
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor.h"
+#include "gas_sensor_session.h"
+#include "gas_sensor_sim.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#define BENCH_SEQ_RING          1024        /* Write timestamps kept per sensor */
+#define BENCH_HIST_BUCKETS      100000      /* 1 us buckets up to 100 ms */
+#define BENCH_WARMUP_NS         1000000000ull
+#define BENCH_DRAIN_NS          500000000ull
+
+typedef struct bench bench_t;
+
+typedef struct {
+    bench_t *bench;
+    gas_sensor_sim_t sim;
+    int master_fd;                          /* Sensor side */
+    int slave_fd;                           /* Gateway side */
+    gas_sensor_session_t session;
+    uint16_t seq;
+    _Atomic uint64_t write_ns[BENCH_SEQ_RING];  /* Writer thread stores, reader loads */
+} bench_sensor_t;
+
+struct bench {
+    bench_sensor_t *sensors;
+    size_t count;
+    uint64_t period_ns;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    gas_sensor_session_mgr_t mgr;
+
+    atomic_bool writer_done;
+    atomic_uint_fast64_t written;
+    uint64_t delivered;
+    uint64_t measured;
+    double co2_sum;
+    uint64_t breaths;
+    uint64_t hist[BENCH_HIST_BUCKETS + 1];  /* Last bucket = overflow */
+    uint64_t max_latency_ns;
+    uint64_t gateway_cpu_ns;
+    uint64_t writer_cpu_ns;
+};
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static uint64_t clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t ns)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ull);
+    ts.tv_nsec = (long)(ns % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+static int open_pty_pair(int *master, int *slave)
+{
+    char name[64];
+
+    *master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (*master < 0) {
+        return -1;
+    }
+    if (grantpt(*master) != 0 || unlockpt(*master) != 0 ||
+        ptsname_r(*master, name, sizeof(name)) != 0 ||
+        gas_sensor_serial_open(name, slave) != GAS_SENSOR_OK) {
+        close(*master);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Latency (us) below which `fraction` of the measured frames fall
+ */
+static double percentile_us(const bench_t *b, double fraction)
+{
+    uint64_t target = (uint64_t)((double)b->measured * fraction);
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i <= BENCH_HIST_BUCKETS; i++) {
+        seen += b->hist[i];
+        if (seen > target) {
+            return (i == BENCH_HIST_BUCKETS) ? (double)b->max_latency_ns / 1000.0 : (double)i;
+        }
+    }
+    return (double)b->max_latency_ns / 1000.0;
+}
+
+/* ============================================================================
+ * Consumer
+ * ============================================================================ */
+
+static int bench_consumer(void *ctx, const gas_sensor_frame_event_t *event)
+{
+    bench_sensor_t *sensor = ctx;
+    bench_t *b = sensor->bench;
+    uint64_t now = clock_ns(CLOCK_MONOTONIC);
+
+    b->delivered++;
+
+    /* Use the decoded data like a real consumer would */
+    b->co2_sum += event->waveform->co2;
+    b->breaths += event->status->breath_detected;
+
+    uint16_t seq = (uint16_t)((event->frame[10] << 8) | event->frame[11]);
+    uint64_t written = atomic_load_explicit(&sensor->write_ns[seq % BENCH_SEQ_RING],
+                                            memory_order_relaxed);
+    if (written < b->start_ns + BENCH_WARMUP_NS || now < written) {
+        return GAS_SENSOR_OK;
+    }
+
+    uint64_t latency = now - written;
+    uint64_t bucket = latency / 1000;
+    b->hist[bucket < BENCH_HIST_BUCKETS ? bucket : BENCH_HIST_BUCKETS]++;
+    if (latency > b->max_latency_ns) {
+        b->max_latency_ns = latency;
+    }
+    b->measured++;
+    return GAS_SENSOR_OK;
+}
+
+/* ============================================================================
+ * Threads
+ * ============================================================================ */
+
+static void *writer_thread(void *arg)
+{
+    bench_t *b = arg;
+    uint64_t cpu_start = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    uint64_t end = b->start_ns + b->duration_ns;
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+
+    /* Sensors are evenly staggered across one frame period */
+    for (uint64_t tick = 0; ; tick++) {
+        uint64_t base = b->start_ns + tick * b->period_ns;
+        if (base >= end) {
+            break;
+        }
+
+        for (size_t i = 0; i < b->count; i++) {
+            bench_sensor_t *s = &b->sensors[i];
+            uint64_t due = base + b->period_ns * i / b->count;
+            if (due > clock_ns(CLOCK_MONOTONIC)) {
+                sleep_until_ns(due);
+            }
+
+            gas_sensor_sim_next_frame(&s->sim, frame);
+            uint16_t seq = s->seq++;
+            frame[10] = (uint8_t)(seq >> 8);
+            frame[11] = (uint8_t)(seq & 0xFF);
+            frame[20] = gas_sensor_compute_checksum(frame);
+
+            atomic_store_explicit(&s->write_ns[seq % BENCH_SEQ_RING], clock_ns(CLOCK_MONOTONIC),
+                                  memory_order_relaxed);
+            if (write(s->master_fd, frame, sizeof(frame)) == (ssize_t)sizeof(frame)) {
+                atomic_fetch_add(&b->written, 1);
+            }
+        }
+    }
+
+    b->writer_cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+    atomic_store(&b->writer_done, true);
+    return NULL;
+}
+
+static void *gateway_thread(void *arg)
+{
+    bench_t *b = arg;
+    uint64_t cpu_start = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    uint64_t drain_deadline = 0;
+
+    for (;;) {
+        if (atomic_load(&b->writer_done)) {
+            uint64_t now = clock_ns(CLOCK_MONOTONIC);
+            if (drain_deadline == 0) {
+                drain_deadline = now + BENCH_DRAIN_NS;
+            }
+            if (b->delivered >= atomic_load(&b->written) || now >= drain_deadline) {
+                break;
+            }
+        }
+
+        int result = gas_sensor_session_mgr_poll(b->mgr, 10);
+        if (result < 0) {
+            fprintf(stderr, "poll failed: %s\n", gas_sensor_strerror(result));
+            break;
+        }
+    }
+
+    b->gateway_cpu_ns = clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu_start;
+    return NULL;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char **argv)
+{
+    size_t count = 100;
+    double seconds = 10.0;
+    double rate = 20.0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:d:r:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                count = (size_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'd':
+                seconds = strtod(optarg, NULL);
+                break;
+            case 'r':
+                rate = strtod(optarg, NULL);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n sensors] [-d seconds] [-r frames_per_second]\n",
+                        argv[0]);
+                return (opt == 'h') ? 0 : 2;
+        }
+    }
+
+    if (count == 0 || seconds <= 0.0 || rate <= 0.0) {
+        fprintf(stderr, "sensors, duration and rate must be positive\n");
+        return 2;
+    }
+
+    /* Two descriptors per sensor */
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    bench_t *b = calloc(1, sizeof(*b));
+    bench_sensor_t *sensors = calloc(count, sizeof(*sensors));
+    if (b == NULL || sensors == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    b->sensors = sensors;
+    b->count = count;
+    b->period_ns = (uint64_t)(1e9 / rate);
+    b->duration_ns = (uint64_t)(seconds * 1e9);
+    atomic_init(&b->writer_done, false);
+    atomic_init(&b->written, 0);
+
+    if (gas_sensor_session_mgr_create(&b->mgr) != GAS_SENSOR_OK) {
+        fprintf(stderr, "cannot create session manager\n");
+        return 1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        bench_sensor_t *s = &sensors[i];
+        s->bench = b;
+        for (size_t k = 0; k < BENCH_SEQ_RING; k++) {
+            atomic_init(&s->write_ns[k], 0);
+        }
+        gas_sensor_sim_init(&s->sim, NULL);
+        s->sim.config.serial_number = (uint16_t)i;
+        s->sim.frame_count = i;             /* Desynchronize breath phases */
+
+        if (open_pty_pair(&s->master_fd, &s->slave_fd) != 0) {
+            fprintf(stderr, "cannot open pty %zu: %s\n", i, strerror(errno));
+            return 1;
+        }
+        if (gas_sensor_session_attach(b->mgr, s->slave_fd, (uint32_t)i,
+                                      bench_consumer, s, &s->session) != GAS_SENSOR_OK) {
+            fprintf(stderr, "cannot attach sensor %zu\n", i);
+            return 1;
+        }
+    }
+
+    printf("sensors: %zu, rate: %.1f frames/s each, duration: %.1f s\n",
+           count, rate, seconds);
+
+    b->start_ns = clock_ns(CLOCK_MONOTONIC);
+    pthread_t writer;
+    pthread_t gateway;
+    pthread_create(&gateway, NULL, gateway_thread, b);
+    pthread_create(&writer, NULL, writer_thread, b);
+    pthread_join(writer, NULL);
+    pthread_join(gateway, NULL);
+
+    uint64_t written = atomic_load(&b->written);
+    double gateway_cpu = (double)b->gateway_cpu_ns / 1e9;
+
+    printf("frames written:    %llu\n", (unsigned long long)written);
+    printf("frames delivered:  %llu (%.0f frames/s, %llu lost)\n",
+           (unsigned long long)b->delivered,
+           (double)b->delivered / seconds,
+           (unsigned long long)(written > b->delivered ? written - b->delivered : 0));
+    printf("gateway CPU:       %.3f s (%.2f%% of one core, %.3f%% per 100 sensors)\n",
+           gateway_cpu,
+           100.0 * gateway_cpu / seconds,
+           100.0 * gateway_cpu / seconds * 100.0 / (double)count);
+    printf("simulator CPU:     %.3f s\n", (double)b->writer_cpu_ns / 1e9);
+    printf("breaths:           %llu (mean CO2 %.2f%%)\n", (unsigned long long)b->breaths,
+           b->delivered > 0 ? b->co2_sum / (double)b->delivered : 0.0);
+    if (b->measured > 0) {
+        printf("latency (us):      p50 %.0f  p90 %.0f  p99 %.0f  p99.9 %.0f  max %.0f\n",
+               percentile_us(b, 0.50), percentile_us(b, 0.90),
+               percentile_us(b, 0.99), percentile_us(b, 0.999),
+               (double)b->max_latency_ns / 1000.0);
+    }
+
+    gas_sensor_session_mgr_destroy(b->mgr);
+    for (size_t i = 0; i < count; i++) {
+        close(sensors[i].slave_fd);
+        close(sensors[i].master_fd);
+    }
+    free(sensors);
+    free(b);
+    return 0;
+}
@@ -0,0 +1,547 @@
+/*
+ * Anesthetic Gas Sensor Breath Store - Implementation
+ *
+ * The writer maps the whole file and grows it in whole blocks with
+ * posix_fallocate() and mremap(). A record's columns and its block header
+ * are written before the committed count in the file header is advanced,
+ * so a reader opened at any time sees only complete records.
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor_breath.h"
+#include "gas_sensor_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Breath stores are mapped in host order and require a little-endian host"
+#endif
+
+#define RECORDS             GAS_SENSOR_BREATH_BLOCK_RECORDS
+#define RECORD_BYTES        (8 + 4 + 2 * GAS_SENSOR_CH_COUNT + 1 + 1)
+#define BLOCK_SIZE          (GAS_SENSOR_BREATH_BLOCK_HDR_SIZE + RECORDS * RECORD_BYTES)
+#define MIN_GROW_BLOCKS     16
+
+/* Column offsets within a block */
+#define COL_START           GAS_SENSOR_BREATH_BLOCK_HDR_SIZE
+#define COL_DURATION        (COL_START + RECORDS * 8)
+#define COL_ET              (COL_DURATION + RECORDS * 4)
+#define COL_FI              (COL_ET + RECORDS * GAS_SENSOR_CH_COUNT)
+#define COL_RESP_RATE       (COL_FI + RECORDS * GAS_SENSOR_CH_COUNT)
+#define COL_STATUS          (COL_RESP_RATE + RECORDS)
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t reserved0;
+    uint32_t sensor_id;
+    uint32_t block_records;
+    _Atomic uint64_t count;
+    uint8_t reserved1[40];
+} store_header_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t flags;
+    uint64_t first_start_us;
+    uint64_t last_start_us;
+    gas_sensor_breath_zone_t zone;
+    uint8_t reserved[16];
+} block_header_t;
+
+_Static_assert(sizeof(store_header_t) == GAS_SENSOR_BREATH_HEADER_SIZE, "store header size");
+_Static_assert(sizeof(block_header_t) == GAS_SENSOR_BREATH_BLOCK_HDR_SIZE, "block header size");
+_Static_assert(BLOCK_SIZE % 64 == 0, "blocks keep columns aligned");
+
+struct gas_sensor_breath_writer {
+    int fd;
+    uint8_t *map;
+    size_t map_size;
+    size_t capacity_blocks;
+    uint64_t count;
+    uint64_t last_start_us;
+
+    /* Breath assembly */
+    uint8_t prev_status;
+    bool in_breath;
+    gas_sensor_breath_t current;
+};
+
+struct gas_sensor_breath_reader {
+    int fd;
+    const uint8_t *map;
+    size_t map_size;
+    uint32_t sensor_id;
+    uint64_t count;
+    size_t blocks;
+};
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static uint8_t *block_at(uint8_t *map, size_t block)
+{
+    return map + GAS_SENSOR_BREATH_HEADER_SIZE + block * (size_t)BLOCK_SIZE;
+}
+
+static size_t blocks_for(uint64_t count)
+{
+    return (size_t)((count + RECORDS - 1) / RECORDS);
+}
+
+static void zone_value(gas_sensor_breath_zone_t *zone, int column, uint8_t value)
+{
+    if (value == GAS_SENSOR_NO_DATA) {
+        return;
+    }
+    if (value < zone->min[column]) {
+        zone->min[column] = value;
+    }
+    if (value > zone->max[column]) {
+        zone->max[column] = value;
+    }
+}
+
+/* Widen a block's bounds to cover one more record */
+static void zone_update(gas_sensor_breath_zone_t *zone, const gas_sensor_breath_t *breath)
+{
+    for (int ch = 0; ch < GAS_SENSOR_CH_COUNT; ch++) {
+        zone_value(zone, GAS_SENSOR_BREATH_ZONE_ET + ch, breath->et[ch]);
+        zone_value(zone, GAS_SENSOR_BREATH_ZONE_FI + ch, breath->fi[ch]);
+    }
+    zone_value(zone, GAS_SENSOR_BREATH_ZONE_RESP_RATE, breath->resp_rate);
+    zone->min[GAS_SENSOR_BREATH_ZONE_STATUS] &= breath->status;
+    zone->max[GAS_SENSOR_BREATH_ZONE_STATUS] |= breath->status;
+}
+
+static int writer_reserve(struct gas_sensor_breath_writer *w, size_t blocks)
+{
+    if (blocks <= w->capacity_blocks) {
+        return GAS_SENSOR_OK;
+    }
+
+    size_t capacity = w->capacity_blocks * 2;
+    if (capacity < blocks) {
+        capacity = blocks;
+    }
+    if (capacity < MIN_GROW_BLOCKS) {
+        capacity = MIN_GROW_BLOCKS;
+    }
+
+    size_t size = GAS_SENSOR_BREATH_HEADER_SIZE + capacity * (size_t)BLOCK_SIZE;
+    if (posix_fallocate(w->fd, 0, (off_t)size) != 0) {
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    void *map = mremap(w->map, w->map_size, size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    w->map = map;
+    w->map_size = size;
+    w->capacity_blocks = capacity;
+    return GAS_SENSOR_OK;
+}
+
+/* First index in [0, n) with start[i] >= t */
+static size_t lower_bound(const uint64_t *start, size_t n, uint64_t t)
+{
+    size_t lo = 0;
+    size_t hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (start[mid] < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Records of a block the reader may use */
+static size_t reader_block_count(gas_sensor_breath_reader_t r, size_t block)
+{
+    uint64_t remaining = r->count - (uint64_t)block * RECORDS;
+    return (remaining < RECORDS) ? (size_t)remaining : RECORDS;
+}
+
+static const uint64_t *reader_starts(gas_sensor_breath_reader_t r, size_t block)
+{
+    return (const uint64_t *)(block_at((uint8_t *)r->map, block) + COL_START);
+}
+
+/* ============================================================================
+ * Writer
+ * ============================================================================ */
+
+int gas_sensor_breath_writer_open(const char *path,
+                                  uint32_t sensor_id,
+                                  gas_sensor_breath_writer_t *writer)
+{
+    if (path == NULL || writer == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    struct gas_sensor_breath_writer *w = calloc(1, sizeof(*w));
+    if (w == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    w->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (w->fd < 0) {
+        free(w);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    struct stat st;
+    if (fstat(w->fd, &st) != 0) {
+        close(w->fd);
+        free(w);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    bool created = (st.st_size == 0);
+    if (created) {
+        if (posix_fallocate(w->fd, 0, GAS_SENSOR_BREATH_HEADER_SIZE) != 0) {
+            close(w->fd);
+            free(w);
+            return GAS_SENSOR_ERR_IO;
+        }
+        st.st_size = GAS_SENSOR_BREATH_HEADER_SIZE;
+    } else if ((size_t)st.st_size < GAS_SENSOR_BREATH_HEADER_SIZE) {
+        close(w->fd);
+        free(w);
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    w->map_size = (size_t)st.st_size;
+    w->map = mmap(NULL, w->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+    if (w->map == MAP_FAILED) {
+        close(w->fd);
+        free(w);
+        return GAS_SENSOR_ERR_IO;
+    }
+    w->capacity_blocks = (w->map_size - GAS_SENSOR_BREATH_HEADER_SIZE) / BLOCK_SIZE;
+
+    store_header_t *h = (store_header_t *)w->map;
+    if (created) {
+        memcpy(h->magic, GAS_SENSOR_BREATH_MAGIC, 4);
+        h->version = GAS_SENSOR_BREATH_VERSION;
+        h->sensor_id = sensor_id;
+        h->block_records = RECORDS;
+        atomic_store_explicit(&h->count, 0, memory_order_release);
+    } else {
+        w->count = atomic_load_explicit(&h->count, memory_order_acquire);
+        if (memcmp(h->magic, GAS_SENSOR_BREATH_MAGIC, 4) != 0 ||
+            h->version != GAS_SENSOR_BREATH_VERSION ||
+            h->sensor_id != sensor_id ||
+            h->block_records != RECORDS ||
+            blocks_for(w->count) > w->capacity_blocks) {
+            munmap(w->map, w->map_size);
+            close(w->fd);
+            free(w);
+            return GAS_SENSOR_ERR_FORMAT;
+        }
+        if (w->count > 0) {
+            const block_header_t *b =
+                (const block_header_t *)block_at(w->map, blocks_for(w->count) - 1);
+            w->last_start_us = b->last_start_us;
+        }
+    }
+
+    *writer = w;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_breath_append(gas_sensor_breath_writer_t writer,
+                             const gas_sensor_breath_t *breath)
+{
+    if (writer == NULL || breath == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (writer->count > 0 && breath->start_us < writer->last_start_us) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    size_t block = (size_t)(writer->count / RECORDS);
+    size_t slot = (size_t)(writer->count % RECORDS);
+    int result = writer_reserve(writer, block + 1);
+    if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+
+    uint8_t *b = block_at(writer->map, block);
+    ((uint64_t *)(b + COL_START))[slot] = breath->start_us;
+    ((uint32_t *)(b + COL_DURATION))[slot] = breath->duration_us;
+    for (int ch = 0; ch < GAS_SENSOR_CH_COUNT; ch++) {
+        b[COL_ET + ch * RECORDS + slot] = breath->et[ch];
+        b[COL_FI + ch * RECORDS + slot] = breath->fi[ch];
+    }
+    b[COL_RESP_RATE + slot] = breath->resp_rate;
+    b[COL_STATUS + slot] = breath->status;
+
+    block_header_t *bh = (block_header_t *)b;
+    if (slot == 0) {
+        bh->first_start_us = breath->start_us;
+        bh->flags = GAS_SENSOR_BREATH_BLOCK_ZONE_MAP;
+        memset(bh->zone.min, 0xFF, sizeof(bh->zone.min));
+        memset(bh->zone.max, 0, sizeof(bh->zone.max));
+    }
+    if (bh->flags & GAS_SENSOR_BREATH_BLOCK_ZONE_MAP) {
+        zone_update(&bh->zone, breath);
+    }
+    bh->last_start_us = breath->start_us;
+    bh->count = (uint32_t)(slot + 1);
+
+    writer->count++;
+    writer->last_start_us = breath->start_us;
+    atomic_store_explicit(&((store_header_t *)writer->map)->count, writer->count,
+                          memory_order_release);
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_breath_frame_handler(void *ctx, const gas_sensor_frame_event_t *event)
+{
+    struct gas_sensor_breath_writer *w = ctx;
+    if (w == NULL || event == NULL || event->frame == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    uint8_t status = gas_sensor_frame_status(event->frame);
+    bool breath_start = (status & GAS_SENSOR_STS_BREATH) != 0 &&
+                        (w->prev_status & GAS_SENSOR_STS_BREATH) == 0;
+    w->prev_status = status;
+
+    if (!breath_start) {
+        w->current.status |= status;
+        return GAS_SENSOR_OK;
+    }
+
+    int result = GAS_SENSOR_OK;
+    if (w->in_breath && event->timestamp_us >= w->current.start_us) {
+        gas_sensor_breath_t *b = &w->current;
+        uint64_t duration = event->timestamp_us - b->start_us;
+        b->duration_us = (duration > UINT32_MAX) ? UINT32_MAX : (uint32_t)duration;
+
+        const gas_sensor_slow_data_t *slow = event->slow_data;
+        if (slow != NULL) {
+            b->et[GAS_SENSOR_CH_CO2] = conc_to_raw(slow->exp_vals.co2);
+            b->et[GAS_SENSOR_CH_N2O] = conc_to_raw(slow->exp_vals.n2o);
+            b->et[GAS_SENSOR_CH_AA1] = conc_to_raw(slow->exp_vals.aa1);
+            b->et[GAS_SENSOR_CH_AA2] = conc_to_raw(slow->exp_vals.aa2);
+            b->et[GAS_SENSOR_CH_O2] = conc_to_raw(slow->exp_vals.o2);
+            b->fi[GAS_SENSOR_CH_CO2] = conc_to_raw(slow->insp_vals.co2);
+            b->fi[GAS_SENSOR_CH_N2O] = conc_to_raw(slow->insp_vals.n2o);
+            b->fi[GAS_SENSOR_CH_AA1] = conc_to_raw(slow->insp_vals.aa1);
+            b->fi[GAS_SENSOR_CH_AA2] = conc_to_raw(slow->insp_vals.aa2);
+            b->fi[GAS_SENSOR_CH_O2] = conc_to_raw(slow->insp_vals.o2);
+            b->resp_rate = slow->gen_vals.resp_rate;
+        } else {
+            memset(b->et, GAS_SENSOR_NO_DATA, sizeof(b->et));
+            memset(b->fi, GAS_SENSOR_NO_DATA, sizeof(b->fi));
+            b->resp_rate = GAS_SENSOR_NO_DATA;
+        }
+        result = gas_sensor_breath_append(w, b);
+    }
+
+    w->in_breath = true;
+    w->current.start_us = event->timestamp_us;
+    w->current.status = status;
+    return result;
+}
+
+uint64_t gas_sensor_breath_writer_count(gas_sensor_breath_writer_t writer)
+{
+    return (writer != NULL) ? writer->count : 0;
+}
+
+int gas_sensor_breath_writer_close(gas_sensor_breath_writer_t writer)
+{
+    if (writer == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    int result = GAS_SENSOR_OK;
+    size_t size = GAS_SENSOR_BREATH_HEADER_SIZE + blocks_for(writer->count) * (size_t)BLOCK_SIZE;
+    if (munmap(writer->map, writer->map_size) != 0 ||
+        ftruncate(writer->fd, (off_t)size) != 0) {
+        result = GAS_SENSOR_ERR_IO;
+    }
+    if (close(writer->fd) != 0) {
+        result = GAS_SENSOR_ERR_IO;
+    }
+
+    free(writer);
+    return result;
+}
+
+/* ============================================================================
+ * Reader
+ * ============================================================================ */
+
+int gas_sensor_breath_reader_open(const char *path,
+                                  gas_sensor_breath_reader_t *reader)
+{
+    if (path == NULL || reader == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    struct gas_sensor_breath_reader *r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    r->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (r->fd < 0) {
+        free(r);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    struct stat st;
+    if (fstat(r->fd, &st) != 0) {
+        close(r->fd);
+        free(r);
+        return GAS_SENSOR_ERR_IO;
+    }
+    if ((size_t)st.st_size < GAS_SENSOR_BREATH_HEADER_SIZE) {
+        close(r->fd);
+        free(r);
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    r->map_size = (size_t)st.st_size;
+    void *map = mmap(NULL, r->map_size, PROT_READ, MAP_SHARED, r->fd, 0);
+    if (map == MAP_FAILED) {
+        close(r->fd);
+        free(r);
+        return GAS_SENSOR_ERR_IO;
+    }
+    r->map = map;
+
+    store_header_t *h = map;
+    r->count = atomic_load_explicit(&h->count, memory_order_acquire);
+    r->sensor_id = h->sensor_id;
+    r->blocks = blocks_for(r->count);
+
+    if (memcmp(h->magic, GAS_SENSOR_BREATH_MAGIC, 4) != 0 ||
+        h->version != GAS_SENSOR_BREATH_VERSION ||
+        h->block_records != RECORDS ||
+        GAS_SENSOR_BREATH_HEADER_SIZE + r->blocks * (size_t)BLOCK_SIZE > r->map_size) {
+        gas_sensor_breath_reader_close(r);
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    /* Scans read the columns front to back */
+    madvise(map, r->map_size, MADV_SEQUENTIAL);
+
+    *reader = r;
+    return GAS_SENSOR_OK;
+}
+
+uint32_t gas_sensor_breath_sensor_id(gas_sensor_breath_reader_t reader)
+{
+    return (reader != NULL) ? reader->sensor_id : 0;
+}
+
+uint64_t gas_sensor_breath_count(gas_sensor_breath_reader_t reader)
+{
+    return (reader != NULL) ? reader->count : 0;
+}
+
+void gas_sensor_breath_scan_init(gas_sensor_breath_scan_t *scan,
+                                 gas_sensor_breath_reader_t reader,
+                                 uint64_t from_us,
+                                 uint64_t to_us)
+{
+    if (scan == NULL) {
+        return;
+    }
+
+    scan->reader = reader;
+    scan->from_us = from_us;
+    scan->to_us = to_us;
+    scan->block = 0;
+
+    if (reader == NULL) {
+        return;
+    }
+
+    /* First block whose last breath starts at or after from_us */
+    size_t lo = 0;
+    size_t hi = reader->blocks;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t n = reader_block_count(reader, mid);
+        if (reader_starts(reader, mid)[n - 1] < from_us) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    scan->block = lo;
+}
+
+int gas_sensor_breath_scan_next(gas_sensor_breath_scan_t *scan,
+                                gas_sensor_breath_columns_t *columns)
+{
+    if (scan == NULL || scan->reader == NULL || columns == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    gas_sensor_breath_reader_t r = scan->reader;
+
+    while (scan->block < r->blocks) {
+        size_t block = scan->block++;
+        size_t n = reader_block_count(r, block);
+        const uint64_t *start = reader_starts(r, block);
+
+        if (start[0] >= scan->to_us) {
+            break;
+        }
+
+        size_t first = (start[0] >= scan->from_us) ? 0 : lower_bound(start, n, scan->from_us);
+        size_t end = (start[n - 1] < scan->to_us) ? n : lower_bound(start, n, scan->to_us);
+        if (first == end) {
+            continue;
+        }
+
+        const uint8_t *b = block_at((uint8_t *)r->map, block);
+        const block_header_t *bh = (const block_header_t *)b;
+        columns->count = end - first;
+        columns->zone = (bh->flags & GAS_SENSOR_BREATH_BLOCK_ZONE_MAP) ? &bh->zone : NULL;
+        columns->start_us = start + first;
+        columns->duration_us = (const uint32_t *)(b + COL_DURATION) + first;
+        for (int ch = 0; ch < GAS_SENSOR_CH_COUNT; ch++) {
+            columns->et[ch] = b + COL_ET + ch * RECORDS + first;
+            columns->fi[ch] = b + COL_FI + ch * RECORDS + first;
+        }
+        columns->resp_rate = b + COL_RESP_RATE + first;
+        columns->status = b + COL_STATUS + first;
+        return GAS_SENSOR_OK;
+    }
+
+    scan->block = r->blocks;
+    return GAS_SENSOR_ERR_EOF;
+}
+
+void gas_sensor_breath_reader_close(gas_sensor_breath_reader_t reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+
+    munmap((void *)reader->map, reader->map_size);
+    close(reader->fd);
+    free(reader);
+}
@@ -0,0 +1,245 @@
+/*
+ * Anesthetic Gas Sensor Breath Store
+ *
+ * Assembles one record per breath from a sensor's frame stream and keeps
+ * the records in an append-only, memory-mapped file with a columnar
+ * layout, so analyses over long periods read only the columns they need
+ * and skip whole blocks outside the requested time range.
+ *
+ * A breath starts on a frame whose STS breath bit is set after a frame
+ * where it was clear, and ends where the next breath starts. Its record
+ * holds the start time, the duration, the Et and Fi values and the
+ * respiratory rate reported by the time it ended, and the OR of every STS
+ * byte received during it.
+ *
+ * File layout (one sensor per file, host byte order, little-endian only):
+ *   Header (64 bytes):
+ *     [0-3]   Magic "GSBR"
+ *     [4-5]   Format version
+ *     [6-7]   Reserved
+ *     [8-11]  Sensor ID
+ *     [12-15] Records per block (GAS_SENSOR_BREATH_BLOCK_RECORDS)
+ *     [16-23] Committed record count
+ *     [24-63] Reserved
+ *   Blocks (repeated):
+ *     [0-3]   Records in this block
+ *     [4-7]   Flags (GAS_SENSOR_BREATH_BLOCK_ZONE_MAP)
+ *     [8-15]  First breath start (us since epoch)
+ *     [16-23] Last breath start (us since epoch)
+ *     [24-35] Zone map minimum per column: et[5], fi[5], resp_rate, and
+ *             the AND of status
+ *     [36-47] Zone map maximum per column, with the OR of status
+ *     [48-63] Reserved
+ *     Columns, each GAS_SENSOR_BREATH_BLOCK_RECORDS entries:
+ *       start_us (u64), duration_us (u32), et[5] (u8 each), fi[5] (u8
+ *       each), resp_rate (u8), status (u8)
+ *
+ * Records are stored in start time order, so a time-range scan visits a
+ * contiguous run of blocks and, within the first and last block, a
+ * contiguous run of records.
+ *
+ * The zone map bounds the values stored in a block, GAS_SENSOR_NO_DATA
+ * excluded (a column with no value in the block has minimum 0xFF and
+ * maximum 0), so a query can skip blocks its predicates cannot match
+ * without reading their columns. Blocks started by a writer that predates
+ * zone maps have the flag clear and must be read.
+ *
+ * Linux only (mremap).
+ */
+
+#ifndef GAS_SENSOR_BREATH_H
+#define GAS_SENSOR_BREATH_H
+
+#include "gas_sensor.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_BREATH_MAGIC             "GSBR"
+#define GAS_SENSOR_BREATH_VERSION           1
+#define GAS_SENSOR_BREATH_HEADER_SIZE       64
+#define GAS_SENSOR_BREATH_BLOCK_HDR_SIZE    64
+#define GAS_SENSOR_BREATH_BLOCK_RECORDS     1024
+
+/* Block header flag: the zone map is valid */
+#define GAS_SENSOR_BREATH_BLOCK_ZONE_MAP    0x00000001u
+
+/* Zone map columns: et[5], fi[5], resp_rate, status */
+#define GAS_SENSOR_BREATH_ZONE_ET           0
+#define GAS_SENSOR_BREATH_ZONE_FI           GAS_SENSOR_CH_COUNT
+#define GAS_SENSOR_BREATH_ZONE_RESP_RATE    (2 * GAS_SENSOR_CH_COUNT)
+#define GAS_SENSOR_BREATH_ZONE_STATUS       (2 * GAS_SENSOR_CH_COUNT + 1)
+#define GAS_SENSOR_BREATH_ZONE_COLUMNS      (2 * GAS_SENSOR_CH_COUNT + 2)
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_breath_writer *gas_sensor_breath_writer_t;
+typedef struct gas_sensor_breath_reader *gas_sensor_breath_reader_t;
+
+/*
+ * One breath
+ *
+ * Concentrations are raw slow data bytes (percent * 10, GAS_SENSOR_NO_DATA
+ * if missing); gas_sensor_parse_concentration() converts them.
+ */
+typedef struct {
+    uint64_t start_us;                      /* Breath start (us since epoch) */
+    uint32_t duration_us;                   /* Until the next breath started */
+    uint8_t et[GAS_SENSOR_CH_COUNT];        /* End-tidal values, by channel */
+    uint8_t fi[GAS_SENSOR_CH_COUNT];        /* Inspired values, by channel */
+    uint8_t resp_rate;                      /* bpm, GAS_SENSOR_NO_DATA if invalid */
+    uint8_t status;                         /* OR of STS bytes during the breath */
+} gas_sensor_breath_t;
+
+/*
+ * Value bounds of one block, by zone map column
+ *
+ * For status, min is the AND and max the OR of every STS byte stored, which
+ * also bound it numerically.
+ */
+typedef struct {
+    uint8_t min[GAS_SENSOR_BREATH_ZONE_COLUMNS];
+    uint8_t max[GAS_SENSOR_BREATH_ZONE_COLUMNS];
+} gas_sensor_breath_zone_t;
+
+/* A run of consecutive records inside one block; pointers into the mapping */
+typedef struct {
+    size_t count;
+    const gas_sensor_breath_zone_t *zone;   /* Bounds of the whole block, NULL if
+                                               it has no zone map */
+    const uint64_t *start_us;
+    const uint32_t *duration_us;
+    const uint8_t *et[GAS_SENSOR_CH_COUNT];
+    const uint8_t *fi[GAS_SENSOR_CH_COUNT];
+    const uint8_t *resp_rate;
+    const uint8_t *status;
+} gas_sensor_breath_columns_t;
+
+/* Time-range scan state (caller-allocated) */
+typedef struct {
+    gas_sensor_breath_reader_t reader;
+    uint64_t from_us;                       /* Inclusive */
+    uint64_t to_us;                         /* Exclusive */
+    size_t block;                           /* Next block to visit */
+} gas_sensor_breath_scan_t;
+
+/* ============================================================================
+ * Writer
+ * ============================================================================ */
+
+/**
+ * Open a breath store for appending
+ *
+ * An existing store for the same sensor is extended; a new file is created
+ * otherwise.
+ *
+ * @param path: Store file path
+ * @param sensor_id: Sensor identifier stored in the file header
+ * @param writer: Output parameter for the writer handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO, GAS_SENSOR_ERR_FORMAT (existing
+ *          file is not a breath store for this sensor), GAS_SENSOR_ERR_MEMORY
+ *          or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_breath_writer_open(const char *path,
+                                  uint32_t sensor_id,
+                                  gas_sensor_breath_writer_t *writer);
+
+/**
+ * Append one breath record
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM if the breath starts
+ *          before the last stored one, GAS_SENSOR_ERR_IO or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_breath_append(gas_sensor_breath_writer_t writer,
+                             const gas_sensor_breath_t *breath);
+
+/**
+ * Feed one frame event to the breath assembler
+ *
+ * Matches gas_sensor_frame_handler_t, so a writer can be passed directly
+ * to gas_sensor_session_attach() as handler context. A record is appended
+ * each time a new breath starts.
+ *
+ * @param ctx: Writer handle
+ * @param event: Frame event of the writer's sensor
+ * @return: GAS_SENSOR_OK, or an error from gas_sensor_breath_append()
+ */
+int gas_sensor_breath_frame_handler(void *ctx, const gas_sensor_frame_event_t *event);
+
+/**
+ * Get the number of stored records
+ */
+uint64_t gas_sensor_breath_writer_count(gas_sensor_breath_writer_t writer);
+
+/**
+ * Close the store
+ *
+ * A breath still in progress is discarded, since its end is unknown.
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_breath_writer_close(gas_sensor_breath_writer_t writer);
+
+/* ============================================================================
+ * Reader
+ * ============================================================================ */
+
+/**
+ * Map a breath store for reading
+ *
+ * The reader sees the records committed when it was opened.
+ *
+ * @param path: Store file path
+ * @param reader: Output parameter for the reader handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO, GAS_SENSOR_ERR_FORMAT,
+ *          GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_breath_reader_open(const char *path,
+                                  gas_sensor_breath_reader_t *reader);
+
+/**
+ * Get header fields and size of an open store
+ */
+uint32_t gas_sensor_breath_sensor_id(gas_sensor_breath_reader_t reader);
+uint64_t gas_sensor_breath_count(gas_sensor_breath_reader_t reader);
+
+/**
+ * Start a scan over breaths with from_us <= start < to_us
+ */
+void gas_sensor_breath_scan_init(gas_sensor_breath_scan_t *scan,
+                                 gas_sensor_breath_reader_t reader,
+                                 uint64_t from_us,
+                                 uint64_t to_us);
+
+/**
+ * Get the next run of matching records
+ *
+ * Blocks outside the range are skipped using their start time bounds.
+ *
+ * @param scan: Scan state
+ * @param columns: Output columns; valid until the reader is closed
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_EOF when the range is exhausted,
+ *          or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_breath_scan_next(gas_sensor_breath_scan_t *scan,
+                                gas_sensor_breath_columns_t *columns);
+
+/**
+ * Unmap and close a reader
+ */
+void gas_sensor_breath_reader_close(gas_sensor_breath_reader_t reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_BREATH_H */
@@ -0,0 +1,530 @@
+/*
+ * Anesthetic Gas Sensor Capture Files - Implementation
+ *
+ * Sequential capture writer/reader and a k-way timestamp merge over
+ * several captures. See gas_sensor_capture.h for the file layout.
+ */
+
+#include "gas_sensor_capture.h"
+#include "gas_sensor_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+/* Reader buffer: holds at least one maximum-size record */
+#define CAPTURE_READ_BUF_SIZE   (2 * (GAS_SENSOR_CAPTURE_REC_HDR_SIZE + \
+                                      GAS_SENSOR_CAPTURE_MAX_PAYLOAD))
+
+struct gas_sensor_capture_writer {
+    FILE *file;
+    uint64_t offset;                /* Bytes written */
+};
+
+struct gas_sensor_capture_reader {
+    FILE *file;
+    uint32_t sensor_id;
+    uint64_t start_time_us;
+    uint8_t *buf;
+    uint64_t buf_offset;            /* File offset of buf[0] */
+    size_t pos;                     /* Start of unread data in buf */
+    size_t len;                     /* End of valid data in buf */
+    bool eof;
+};
+
+typedef struct {
+    gas_sensor_capture_reader_t reader;
+    gas_sensor_capture_record_t record;     /* Current head record */
+    gas_sensor_slow_data_t slow_data;       /* Persistent state per sensor */
+    gas_sensor_waveform_t waveform;
+    gas_sensor_status_t status;
+} merge_source_t;
+
+struct gas_sensor_capture_merge {
+    merge_source_t *sources;
+    size_t count;
+    size_t *heap;                   /* Source indices, min-heap on head record */
+    size_t heap_size;
+    size_t last_source;
+    bool pending;                   /* last_source must be advanced first */
+    uint64_t skipped;
+};
+
+/* ============================================================================
+ * Writer
+ * ============================================================================ */
+
+int gas_sensor_capture_writer_open(const char *path,
+                                   uint32_t sensor_id,
+                                   uint64_t start_time_us,
+                                   gas_sensor_capture_writer_t *writer)
+{
+    if (path == NULL || writer == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    struct gas_sensor_capture_writer *w = calloc(1, sizeof(*w));
+    if (w == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    w->file = fopen(path, "wb");
+    if (w->file == NULL) {
+        free(w);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    uint8_t header[GAS_SENSOR_CAPTURE_HEADER_SIZE] = {0};
+    memcpy(header, GAS_SENSOR_CAPTURE_MAGIC, 4);
+    put_uint16_le(&header[4], GAS_SENSOR_CAPTURE_VERSION);
+    put_uint32_le(&header[8], sensor_id);
+    put_uint64_le(&header[16], start_time_us);
+
+    if (fwrite(header, 1, sizeof(header), w->file) != sizeof(header)) {
+        fclose(w->file);
+        free(w);
+        return GAS_SENSOR_ERR_IO;
+    }
+    w->offset = sizeof(header);
+
+    *writer = w;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_capture_write(gas_sensor_capture_writer_t writer,
+                             uint8_t type,
+                             uint64_t timestamp_us,
+                             const uint8_t *payload,
+                             size_t length)
+{
+    if (writer == NULL || (payload == NULL && length > 0)) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (length > GAS_SENSOR_CAPTURE_MAX_PAYLOAD) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    uint8_t header[GAS_SENSOR_CAPTURE_REC_HDR_SIZE];
+    header[0] = type;
+    put_uint16_le(&header[1], (uint16_t)length);
+    put_uint64_le(&header[3], timestamp_us);
+
+    if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header)) {
+        return GAS_SENSOR_ERR_IO;
+    }
+    if (length > 0 && fwrite(payload, 1, length, writer->file) != length) {
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    writer->offset += sizeof(header) + length;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_capture_write_frame(gas_sensor_capture_writer_t writer,
+                                   uint64_t timestamp_us,
+                                   const uint8_t *frame_data)
+{
+    if (frame_data == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    return gas_sensor_capture_write(writer, GAS_SENSOR_REC_FRAME, timestamp_us,
+                                    frame_data, GAS_SENSOR_FRAME_SIZE);
+}
+
+int gas_sensor_capture_write_raw(gas_sensor_capture_writer_t writer,
+                                 uint64_t timestamp_us,
+                                 const uint8_t *data,
+                                 size_t length)
+{
+    return gas_sensor_capture_write(writer, GAS_SENSOR_REC_RAW, timestamp_us,
+                                    data, length);
+}
+
+uint64_t gas_sensor_capture_writer_offset(gas_sensor_capture_writer_t writer)
+{
+    return (writer != NULL) ? writer->offset : 0;
+}
+
+int gas_sensor_capture_writer_close(gas_sensor_capture_writer_t writer)
+{
+    if (writer == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    int result = (fclose(writer->file) == 0) ? GAS_SENSOR_OK : GAS_SENSOR_ERR_IO;
+    free(writer);
+    return result;
+}
+
+/* ============================================================================
+ * Reader
+ * ============================================================================ */
+
+/**
+ * Make at least `needed` unread bytes available in the buffer
+ * Returns false if the file ends first.
+ */
+static bool reader_fill(struct gas_sensor_capture_reader *r, size_t needed)
+{
+    while (r->len - r->pos < needed) {
+        if (r->eof) {
+            return false;
+        }
+
+        /* Move unread bytes to the front before reading more */
+        if (r->pos > 0) {
+            memmove(r->buf, &r->buf[r->pos], r->len - r->pos);
+            r->buf_offset += r->pos;
+            r->len -= r->pos;
+            r->pos = 0;
+        }
+
+        size_t n = fread(&r->buf[r->len], 1, CAPTURE_READ_BUF_SIZE - r->len, r->file);
+        r->len += n;
+        if (n == 0) {
+            r->eof = true;
+        }
+    }
+    return true;
+}
+
+int gas_sensor_capture_reader_open(const char *path,
+                                   gas_sensor_capture_reader_t *reader)
+{
+    if (path == NULL || reader == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    struct gas_sensor_capture_reader *r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    r->buf = malloc(CAPTURE_READ_BUF_SIZE);
+    if (r->buf == NULL) {
+        free(r);
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    r->file = fopen(path, "rb");
+    if (r->file == NULL) {
+        free(r->buf);
+        free(r);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    /* Validate header */
+    if (!reader_fill(r, GAS_SENSOR_CAPTURE_HEADER_SIZE) ||
+        memcmp(r->buf, GAS_SENSOR_CAPTURE_MAGIC, 4) != 0 ||
+        get_uint16_le(&r->buf[4]) != GAS_SENSOR_CAPTURE_VERSION) {
+        gas_sensor_capture_reader_close(r);
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    r->sensor_id = get_uint32_le(&r->buf[8]);
+    r->start_time_us = get_uint64_le(&r->buf[16]);
+    r->pos = GAS_SENSOR_CAPTURE_HEADER_SIZE;
+
+    *reader = r;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_capture_read(gas_sensor_capture_reader_t reader,
+                            gas_sensor_capture_record_t *record)
+{
+    if (reader == NULL || record == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (!reader_fill(reader, GAS_SENSOR_CAPTURE_REC_HDR_SIZE)) {
+        if (ferror(reader->file)) {
+            return GAS_SENSOR_ERR_IO;
+        }
+        /* Clean end of file only if nothing is left over */
+        return (reader->len == reader->pos) ? GAS_SENSOR_ERR_EOF : GAS_SENSOR_ERR_FORMAT;
+    }
+
+    const uint8_t *header = &reader->buf[reader->pos];
+    uint16_t length = get_uint16_le(&header[1]);
+
+    if (!reader_fill(reader, GAS_SENSOR_CAPTURE_REC_HDR_SIZE + (size_t)length)) {
+        return ferror(reader->file) ? GAS_SENSOR_ERR_IO : GAS_SENSOR_ERR_FORMAT;
+    }
+
+    /* Buffer may have moved during the fill */
+    header = &reader->buf[reader->pos];
+    record->type = header[0];
+    record->length = length;
+    record->timestamp_us = get_uint64_le(&header[3]);
+    record->payload = &header[GAS_SENSOR_CAPTURE_REC_HDR_SIZE];
+
+    reader->pos += GAS_SENSOR_CAPTURE_REC_HDR_SIZE + (size_t)length;
+    return GAS_SENSOR_OK;
+}
+
+uint64_t gas_sensor_capture_reader_offset(gas_sensor_capture_reader_t reader)
+{
+    return (reader != NULL) ? reader->buf_offset + reader->pos : 0;
+}
+
+int gas_sensor_capture_reader_seek(gas_sensor_capture_reader_t reader, uint64_t offset)
+{
+    if (reader == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (offset < GAS_SENSOR_CAPTURE_HEADER_SIZE) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    /* Stay within the buffer when possible */
+    if (offset >= reader->buf_offset && offset <= reader->buf_offset + reader->len) {
+        reader->pos = (size_t)(offset - reader->buf_offset);
+        return GAS_SENSOR_OK;
+    }
+
+    if (fseek(reader->file, (long)offset, SEEK_SET) != 0) {
+        return GAS_SENSOR_ERR_IO;
+    }
+    clearerr(reader->file);
+    reader->buf_offset = offset;
+    reader->pos = 0;
+    reader->len = 0;
+    reader->eof = false;
+    return GAS_SENSOR_OK;
+}
+
+uint32_t gas_sensor_capture_sensor_id(gas_sensor_capture_reader_t reader)
+{
+    return (reader != NULL) ? reader->sensor_id : 0;
+}
+
+uint64_t gas_sensor_capture_start_time(gas_sensor_capture_reader_t reader)
+{
+    return (reader != NULL) ? reader->start_time_us : 0;
+}
+
+void gas_sensor_capture_reader_close(gas_sensor_capture_reader_t reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+
+    if (reader->file != NULL) {
+        fclose(reader->file);
+    }
+    free(reader->buf);
+    free(reader);
+}
+
+/* ============================================================================
+ * K-way Timestamp Merge
+ * ============================================================================ */
+
+/**
+ * Heap ordering: earlier timestamp first, then lower source index
+ */
+static bool merge_less(const struct gas_sensor_capture_merge *m, size_t a, size_t b)
+{
+    uint64_t ta = m->sources[a].record.timestamp_us;
+    uint64_t tb = m->sources[b].record.timestamp_us;
+    return (ta != tb) ? (ta < tb) : (a < b);
+}
+
+static void merge_sift_down(struct gas_sensor_capture_merge *m, size_t i)
+{
+    for (;;) {
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        size_t smallest = i;
+
+        if (left < m->heap_size && merge_less(m, m->heap[left], m->heap[smallest])) {
+            smallest = left;
+        }
+        if (right < m->heap_size && merge_less(m, m->heap[right], m->heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+
+        size_t tmp = m->heap[i];
+        m->heap[i] = m->heap[smallest];
+        m->heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+/**
+ * Advance a source to its next frame record
+ * Returns GAS_SENSOR_OK, GAS_SENSOR_ERR_EOF or a read error.
+ */
+static int merge_advance(merge_source_t *src)
+{
+    int result;
+    do {
+        result = gas_sensor_capture_read(src->reader, &src->record);
+    } while (result == GAS_SENSOR_OK &&
+             (src->record.type != GAS_SENSOR_REC_FRAME ||
+              src->record.length != GAS_SENSOR_FRAME_SIZE));
+    return result;
+}
+
+/**
+ * Advance the head source after its record was consumed and restore
+ * the heap property
+ */
+static int merge_pop_head(struct gas_sensor_capture_merge *m)
+{
+    int result = merge_advance(&m->sources[m->heap[0]]);
+
+    if (result == GAS_SENSOR_ERR_EOF) {
+        m->heap[0] = m->heap[--m->heap_size];
+    } else if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+
+    if (m->heap_size > 0) {
+        merge_sift_down(m, 0);
+    }
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_capture_merge_open(const char *const *paths,
+                                  size_t count,
+                                  gas_sensor_capture_merge_t *merge)
+{
+    if (paths == NULL || merge == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    struct gas_sensor_capture_merge *m = calloc(1, sizeof(*m));
+    if (m == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    m->sources = calloc(count > 0 ? count : 1, sizeof(*m->sources));
+    m->heap = calloc(count > 0 ? count : 1, sizeof(*m->heap));
+    if (m->sources == NULL || m->heap == NULL) {
+        gas_sensor_capture_merge_close(m);
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    m->count = count;
+
+    for (size_t i = 0; i < count; i++) {
+        merge_source_t *src = &m->sources[i];
+        int result = gas_sensor_capture_reader_open(paths[i], &src->reader);
+        if (result != GAS_SENSOR_OK) {
+            gas_sensor_capture_merge_close(m);
+            return result;
+        }
+
+        gas_sensor_init_slow_data(&src->slow_data);
+
+        result = merge_advance(src);
+        if (result == GAS_SENSOR_OK) {
+            m->heap[m->heap_size++] = i;
+        } else if (result != GAS_SENSOR_ERR_EOF) {
+            gas_sensor_capture_merge_close(m);
+            return result;
+        }
+    }
+
+    /* Heapify */
+    for (size_t i = m->heap_size / 2; i-- > 0; ) {
+        merge_sift_down(m, i);
+    }
+
+    *merge = m;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_capture_merge_next(gas_sensor_capture_merge_t merge,
+                                  gas_sensor_frame_event_t *event)
+{
+    if (merge == NULL || event == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    for (;;) {
+        /* The previous event's record is only released now, so its payload
+         * stayed valid for the caller */
+        if (merge->pending) {
+            merge->pending = false;
+            int result = merge_pop_head(merge);
+            if (result != GAS_SENSOR_OK) {
+                return result;
+            }
+        }
+
+        if (merge->heap_size == 0) {
+            return GAS_SENSOR_ERR_EOF;
+        }
+
+        size_t index = merge->heap[0];
+        merge_source_t *src = &merge->sources[index];
+        merge->pending = true;
+
+        if (gas_sensor_parse_frame(src->record.payload, &src->slow_data,
+                                   &src->waveform, &src->status) != GAS_SENSOR_OK) {
+            merge->skipped++;
+            continue;
+        }
+
+        merge->last_source = index;
+        event->sensor_id = gas_sensor_capture_sensor_id(src->reader);
+        event->timestamp_us = src->record.timestamp_us;
+        event->frame = src->record.payload;
+        event->slow_data = &src->slow_data;
+        event->waveform = &src->waveform;
+        event->status = &src->status;
+        return GAS_SENSOR_OK;
+    }
+}
+
+int gas_sensor_capture_merge_run(gas_sensor_capture_merge_t merge,
+                                 gas_sensor_frame_handler_t handler,
+                                 void *ctx)
+{
+    if (merge == NULL || handler == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    gas_sensor_frame_event_t event;
+    int result;
+    while ((result = gas_sensor_capture_merge_next(merge, &event)) == GAS_SENSOR_OK) {
+        int handler_result = handler(ctx, &event);
+        if (handler_result != GAS_SENSOR_OK) {
+            return handler_result;
+        }
+    }
+
+    return (result == GAS_SENSOR_ERR_EOF) ? GAS_SENSOR_OK : result;
+}
+
+size_t gas_sensor_capture_merge_source(gas_sensor_capture_merge_t merge)
+{
+    return (merge != NULL) ? merge->last_source : 0;
+}
+
+uint64_t gas_sensor_capture_merge_skipped(gas_sensor_capture_merge_t merge)
+{
+    return (merge != NULL) ? merge->skipped : 0;
+}
+
+void gas_sensor_capture_merge_close(gas_sensor_capture_merge_t merge)
+{
+    if (merge == NULL) {
+        return;
+    }
+
+    if (merge->sources != NULL) {
+        for (size_t i = 0; i < merge->count; i++) {
+            gas_sensor_capture_reader_close(merge->sources[i].reader);
+        }
+    }
+    free(merge->sources);
+    free(merge->heap);
+    free(merge);
+}
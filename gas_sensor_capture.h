@@ -0,0 +1,268 @@
+/*
+ * Anesthetic Gas Sensor Capture Files
+ *
+ * Capture files archive timestamped sensor frames for offline replay and
+ * re-analysis. One file holds the traffic of one sensor. Readers stream
+ * records through a fixed-size buffer, so memory use does not depend on
+ * the length of a capture.
+ *
+ * File layout (all multi-byte fields little-endian):
+ *   Header (32 bytes):
+ *     [0-3]   Magic "GSCP"
+ *     [4-5]   Format version
+ *     [6-7]   Flags (reserved, 0)
+ *     [8-11]  Sensor ID
+ *     [12-15] Reserved
+ *     [16-23] Start time (us since epoch)
+ *     [24-31] Reserved
+ *   Records (repeated until end of file):
+ *     [0]     Record type (GAS_SENSOR_REC_*)
+ *     [1-2]   Payload length
+ *     [3-10]  Timestamp (us since epoch)
+ *     [11-]   Payload
+ *
+ * Readers skip record types they do not handle, so new types can be added
+ * without changing the format version. Change-log captures
+ * (gas_sensor_changelog.h) use the keyframe, frame run, index and trailer
+ * types.
+ */
+
+#ifndef GAS_SENSOR_CAPTURE_H
+#define GAS_SENSOR_CAPTURE_H
+
+#include "gas_sensor.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_CAPTURE_MAGIC        "GSCP"
+#define GAS_SENSOR_CAPTURE_VERSION      1
+#define GAS_SENSOR_CAPTURE_HEADER_SIZE  32
+#define GAS_SENSOR_CAPTURE_REC_HDR_SIZE 11
+#define GAS_SENSOR_CAPTURE_MAX_PAYLOAD  0xFFFF
+
+/* Record types */
+#define GAS_SENSOR_REC_FRAME            0x01    /* One validated 21-byte frame */
+#define GAS_SENSOR_REC_RAW              0x02    /* Serial bytes exactly as read */
+#define GAS_SENSOR_REC_KEYFRAME         0x03    /* Change-log: slow data state */
+#define GAS_SENSOR_REC_FRAME_RUN        0x04    /* Change-log: run of encoded frames */
+#define GAS_SENSOR_REC_INDEX            0x05    /* Change-log: keyframe index entries */
+#define GAS_SENSOR_REC_TRAILER          0x06    /* Change-log: index location */
+#define GAS_SENSOR_REC_CASE             0x07    /* Change-log: case entries */
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_capture_writer *gas_sensor_capture_writer_t;
+typedef struct gas_sensor_capture_reader *gas_sensor_capture_reader_t;
+typedef struct gas_sensor_capture_merge *gas_sensor_capture_merge_t;
+
+/* One record read from a capture file */
+typedef struct {
+    uint8_t type;                   /* Record type (GAS_SENSOR_REC_*) */
+    uint16_t length;                /* Payload length in bytes */
+    uint64_t timestamp_us;          /* Record timestamp (us since epoch) */
+    const uint8_t *payload;         /* Valid until the next read */
+} gas_sensor_capture_record_t;
+
+/* ============================================================================
+ * Writer
+ * ============================================================================ */
+
+/**
+ * Create a capture file for one sensor
+ *
+ * An existing file at path is truncated.
+ *
+ * @param path: Output file path
+ * @param sensor_id: Sensor identifier stored in the file header
+ * @param start_time_us: Capture start time (us since epoch)
+ * @param writer: Output parameter for the writer handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO, GAS_SENSOR_ERR_MEMORY or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_capture_writer_open(const char *path,
+                                   uint32_t sensor_id,
+                                   uint64_t start_time_us,
+                                   gas_sensor_capture_writer_t *writer);
+
+/**
+ * Append one record
+ *
+ * @param writer: Writer handle
+ * @param type: Record type (GAS_SENSOR_REC_*)
+ * @param timestamp_us: Record timestamp (us since epoch)
+ * @param payload: Payload bytes
+ * @param length: Payload length (at most GAS_SENSOR_CAPTURE_MAX_PAYLOAD)
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO, GAS_SENSOR_ERR_INVALID_PARAM
+ *          if too long, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_capture_write(gas_sensor_capture_writer_t writer,
+                             uint8_t type,
+                             uint64_t timestamp_us,
+                             const uint8_t *payload,
+                             size_t length);
+
+/**
+ * Append one 21-byte frame record
+ *
+ * Frames are expected to be validated by the caller. Timestamps should be
+ * non-decreasing; readers rely on it when merging captures.
+ */
+int gas_sensor_capture_write_frame(gas_sensor_capture_writer_t writer,
+                                   uint64_t timestamp_us,
+                                   const uint8_t *frame_data);
+
+/**
+ * Append one raw serial chunk
+ *
+ * Stores bytes exactly as returned by one serial read, including partial
+ * frames and corruption, so the stream can be replayed with its original
+ * chunking and timing.
+ */
+int gas_sensor_capture_write_raw(gas_sensor_capture_writer_t writer,
+                                 uint64_t timestamp_us,
+                                 const uint8_t *data,
+                                 size_t length);
+
+/**
+ * Get the file offset at which the next record will start
+ */
+uint64_t gas_sensor_capture_writer_offset(gas_sensor_capture_writer_t writer);
+
+/**
+ * Flush buffered records and close the file
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_capture_writer_close(gas_sensor_capture_writer_t writer);
+
+/* ============================================================================
+ * Reader
+ * ============================================================================ */
+
+/**
+ * Open a capture file for sequential reading
+ *
+ * @param path: Capture file path
+ * @param reader: Output parameter for the reader handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO, GAS_SENSOR_ERR_FORMAT (bad
+ *          header), GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_capture_reader_open(const char *path,
+                                   gas_sensor_capture_reader_t *reader);
+
+/**
+ * Read the next record
+ *
+ * @param reader: Reader handle
+ * @param record: Output record; payload points into the reader buffer
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_EOF at end of file,
+ *          GAS_SENSOR_ERR_FORMAT on a truncated record or GAS_SENSOR_ERR_IO
+ */
+int gas_sensor_capture_read(gas_sensor_capture_reader_t reader,
+                            gas_sensor_capture_record_t *record);
+
+/**
+ * Get the file offset of the next record to be read
+ */
+uint64_t gas_sensor_capture_reader_offset(gas_sensor_capture_reader_t reader);
+
+/**
+ * Continue reading at a file offset
+ *
+ * The offset must be the start of a record, as returned by
+ * gas_sensor_capture_reader_offset() or gas_sensor_capture_writer_offset().
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM if the offset lies
+ *          inside the header, GAS_SENSOR_ERR_IO or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_capture_reader_seek(gas_sensor_capture_reader_t reader, uint64_t offset);
+
+/**
+ * Get header fields of an open capture
+ */
+uint32_t gas_sensor_capture_sensor_id(gas_sensor_capture_reader_t reader);
+uint64_t gas_sensor_capture_start_time(gas_sensor_capture_reader_t reader);
+
+/**
+ * Close a reader and free its buffer
+ */
+void gas_sensor_capture_reader_close(gas_sensor_capture_reader_t reader);
+
+/* ============================================================================
+ * K-way Timestamp Merge
+ *
+ * Merges any number of captures into one globally time-ordered stream of
+ * decoded frames. Each source keeps one reader buffer and its own slow data
+ * state; sources are ordered by a binary min-heap on (timestamp, source
+ * index), so memory is O(sources) and each frame costs O(log sources).
+ * Frames that fail validation are skipped and counted. Only frame records
+ * are merged; raw chunks are skipped.
+ * ============================================================================ */
+
+/**
+ * Open a merge over several capture files
+ *
+ * @param paths: Capture file paths
+ * @param count: Number of paths
+ * @param merge: Output parameter for the merge handle
+ * @return: GAS_SENSOR_OK or the first error from opening a source
+ */
+int gas_sensor_capture_merge_open(const char *const *paths,
+                                  size_t count,
+                                  gas_sensor_capture_merge_t *merge);
+
+/**
+ * Decode the next frame in timestamp order
+ *
+ * Ties are broken by source index, so output is deterministic.
+ *
+ * @param merge: Merge handle
+ * @param event: Output event; pointers stay valid until the next call
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_EOF when all sources are drained,
+ *          or a read error from one of the sources
+ */
+int gas_sensor_capture_merge_next(gas_sensor_capture_merge_t merge,
+                                  gas_sensor_frame_event_t *event);
+
+/**
+ * Deliver all remaining frames to a handler
+ *
+ * @param merge: Merge handle
+ * @param handler: Frame handler (same interface as live delivery)
+ * @param ctx: Handler context
+ * @return: GAS_SENSOR_OK when drained, the handler's return value if it
+ *          stopped delivery, or a read error
+ */
+int gas_sensor_capture_merge_run(gas_sensor_capture_merge_t merge,
+                                 gas_sensor_frame_handler_t handler,
+                                 void *ctx);
+
+/**
+ * Get the source index of the last event returned by the merge
+ */
+size_t gas_sensor_capture_merge_source(gas_sensor_capture_merge_t merge);
+
+/**
+ * Get the number of frames skipped because they failed validation
+ */
+uint64_t gas_sensor_capture_merge_skipped(gas_sensor_capture_merge_t merge);
+
+/**
+ * Close all sources and free the merge
+ */
+void gas_sensor_capture_merge_close(gas_sensor_capture_merge_t merge);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_CAPTURE_H */
@@ -0,0 +1,256 @@
+/*
+ * Anesthetic Gas Sensor Case Segmentation - Implementation
+ *
+ * Register and agent changes are only looked at on the frames that carry
+ * them (IDs 0x04 and 0x03); breath starts and the idle timer on every
+ * frame.
+ */
+
+#include "gas_sensor_case.h"
+#include "gas_sensor_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define FRAME_ID_GEN_VALS       0x03
+#define FRAME_ID_SENSOR_REGS    0x04
+
+struct gas_sensor_segmenter {
+    gas_sensor_segmenter_config_t config;
+    gas_sensor_case_fn handler;
+    void *ctx;
+
+    /* Sensor state */
+    bool regs_seen;
+    bool agent_seen;
+    bool adapter_fitted;
+    bool measuring;
+    uint8_t agent;
+    uint8_t prev_status;
+
+    /* Case in progress */
+    bool open;
+    gas_sensor_case_t current;
+    uint64_t last_breath_us;        /* Last breath start */
+    uint64_t last_active_us;        /* Last frame with the breath bit set */
+    uint64_t co2_sum;
+    uint32_t co2_count;
+    uint64_t rr_sum;
+    uint32_t rr_count;
+
+    uint64_t cases;
+    uint64_t dropped;
+};
+
+static void case_open(struct gas_sensor_segmenter *s, uint64_t timestamp_us)
+{
+    gas_sensor_case_t *c = &s->current;
+    memset(c, 0, sizeof(*c));
+    c->start_us = timestamp_us;
+    c->agent = s->agent;
+    c->resp_rate_mean = GAS_SENSOR_NO_DATA;
+    c->et_co2_min = GAS_SENSOR_NO_DATA;
+    c->et_co2_mean = GAS_SENSOR_NO_DATA;
+    c->et_co2_max = GAS_SENSOR_NO_DATA;
+    c->et_agent_max = GAS_SENSOR_NO_DATA;
+
+    s->open = true;
+    s->last_breath_us = timestamp_us;
+    s->last_active_us = timestamp_us;
+    s->co2_sum = 0;
+    s->co2_count = 0;
+    s->rr_sum = 0;
+    s->rr_count = 0;
+}
+
+/* Take the values reported by the end of the previous breath */
+static void case_breath(struct gas_sensor_segmenter *s, const gas_sensor_slow_data_t *slow)
+{
+    gas_sensor_case_t *c = &s->current;
+    c->breaths++;
+    if (slow == NULL) {
+        return;
+    }
+
+    uint8_t co2 = conc_to_raw(slow->exp_vals.co2);
+    if (co2 != GAS_SENSOR_NO_DATA) {
+        s->co2_sum += co2;
+        s->co2_count++;
+        if (c->et_co2_min == GAS_SENSOR_NO_DATA || co2 < c->et_co2_min) {
+            c->et_co2_min = co2;
+        }
+        if (c->et_co2_max == GAS_SENSOR_NO_DATA || co2 > c->et_co2_max) {
+            c->et_co2_max = co2;
+        }
+    }
+
+    uint8_t agent = conc_to_raw(slow->exp_vals.aa1);
+    if (agent != GAS_SENSOR_NO_DATA &&
+        (c->et_agent_max == GAS_SENSOR_NO_DATA || agent > c->et_agent_max)) {
+        c->et_agent_max = agent;
+    }
+
+    uint8_t rr = slow->gen_vals.resp_rate;
+    if (rr != GAS_SENSOR_NO_DATA) {
+        s->rr_sum += rr;
+        s->rr_count++;
+    }
+}
+
+static int case_close(struct gas_sensor_segmenter *s, uint8_t reason, uint64_t end_us)
+{
+    gas_sensor_case_t *c = &s->current;
+    s->open = false;
+
+    c->end_us = (end_us > c->start_us) ? end_us : c->start_us;
+    c->end_reason = reason;
+    if (s->co2_count > 0) {
+        c->et_co2_mean = (uint8_t)((s->co2_sum + s->co2_count / 2) / s->co2_count);
+    }
+    if (s->rr_count > 0) {
+        c->resp_rate_mean = (uint8_t)((s->rr_sum + s->rr_count / 2) / s->rr_count);
+    }
+
+    if (c->end_us - c->start_us < (uint64_t)s->config.min_ms * 1000 ||
+        c->breaths < s->config.min_breaths) {
+        s->dropped++;
+        return GAS_SENSOR_OK;
+    }
+
+    s->cases++;
+    return s->handler(s->ctx, c);
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+void gas_sensor_segmenter_config_init(gas_sensor_segmenter_config_t *config)
+{
+    if (config == NULL) {
+        return;
+    }
+
+    config->idle_ms = GAS_SENSOR_CASE_DEFAULT_IDLE_MS;
+    config->min_ms = GAS_SENSOR_CASE_DEFAULT_MIN_MS;
+    config->min_breaths = GAS_SENSOR_CASE_DEFAULT_MIN_BREATHS;
+    config->split_on_agent = true;
+}
+
+int gas_sensor_segmenter_create(const gas_sensor_segmenter_config_t *config,
+                                gas_sensor_case_fn handler,
+                                void *ctx,
+                                gas_sensor_segmenter_t *segmenter)
+{
+    if (handler == NULL || segmenter == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    struct gas_sensor_segmenter *s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    if (config != NULL) {
+        s->config = *config;
+    } else {
+        gas_sensor_segmenter_config_init(&s->config);
+    }
+    s->handler = handler;
+    s->ctx = ctx;
+    s->agent = GAS_AGENT_NONE;
+
+    *segmenter = s;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_segmenter_frame_handler(void *ctx, const gas_sensor_frame_event_t *event)
+{
+    struct gas_sensor_segmenter *s = ctx;
+    if (s == NULL || event == NULL || event->frame == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    const gas_sensor_slow_data_t *slow = event->slow_data;
+    uint64_t now = event->timestamp_us;
+    uint8_t id = gas_sensor_frame_id(event->frame);
+    int result = GAS_SENSOR_OK;
+
+    if (id == FRAME_ID_SENSOR_REGS && slow != NULL) {
+        s->regs_seen = true;
+        s->adapter_fitted = !slow->sensor_regs.adapter.no_adapter;
+        s->measuring = (slow->sensor_regs.mode == GAS_SENSOR_MODE_MEASUREMENT);
+        if (s->open && !s->adapter_fitted) {
+            result = case_close(s, GAS_SENSOR_CASE_END_ADAPTER, now);
+        } else if (s->open && !s->measuring) {
+            result = case_close(s, GAS_SENSOR_CASE_END_MODE, now);
+        }
+    } else if (id == FRAME_ID_GEN_VALS && slow != NULL) {
+        uint8_t agent = (uint8_t)slow->gen_vals.primary_agent;
+        s->agent_seen = true;
+        s->agent = agent;
+        if (s->open && agent != GAS_AGENT_NONE) {
+            if (s->current.agent == GAS_AGENT_NONE) {
+                s->current.agent = agent;
+            } else if (agent != s->current.agent && s->config.split_on_agent) {
+                result = case_close(s, GAS_SENSOR_CASE_END_AGENT, now);
+            }
+        }
+    }
+
+    uint8_t status = gas_sensor_frame_status(event->frame);
+    bool breath = (status & GAS_SENSOR_STS_BREATH) != 0;
+    bool breath_start = breath && (s->prev_status & GAS_SENSOR_STS_BREATH) == 0;
+    s->prev_status = status;
+
+    if (s->open && breath) {
+        s->last_active_us = now;
+    }
+    if (s->open && result == GAS_SENSOR_OK && now > s->last_breath_us &&
+        now - s->last_breath_us >= (uint64_t)s->config.idle_ms * 1000) {
+        result = case_close(s, GAS_SENSOR_CASE_END_IDLE, s->last_active_us);
+    }
+
+    if (breath_start && !s->open &&
+        s->regs_seen && s->agent_seen && s->adapter_fitted && s->measuring) {
+        case_open(s, now);
+    }
+    if (s->open) {
+        if (breath_start) {
+            s->last_breath_us = now;
+            case_breath(s, slow);
+        }
+        s->current.status |= status;
+    }
+    return result;
+}
+
+int gas_sensor_segmenter_flush(gas_sensor_segmenter_t segmenter, uint64_t timestamp_us)
+{
+    if (segmenter == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (!segmenter->open) {
+        return GAS_SENSOR_OK;
+    }
+    return case_close(segmenter, GAS_SENSOR_CASE_END_FLUSH, timestamp_us);
+}
+
+int gas_sensor_segmenter_stats(gas_sensor_segmenter_t segmenter,
+                               gas_sensor_segmenter_stats_t *stats)
+{
+    if (segmenter == NULL || stats == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    stats->cases = segmenter->cases;
+    stats->dropped = segmenter->dropped;
+    stats->open = segmenter->open;
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_segmenter_destroy(gas_sensor_segmenter_t segmenter)
+{
+    free(segmenter);
+}
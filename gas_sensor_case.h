@@ -0,0 +1,163 @@
+/*
+ * Anesthetic Gas Sensor Case Segmentation
+ *
+ * Cuts a sensor's continuous frame stream into patient cases as it
+ * arrives. A case opens on the first breath (rising STS breath bit) seen
+ * while an adapter is fitted and the sensor is measuring, and ends at the
+ * first of:
+ *   - GAS_SENSOR_CASE_END_ADAPTER: the adapter register reports no adapter
+ *   - GAS_SENSOR_CASE_END_MODE: the sensor leaves measurement mode
+ *   - GAS_SENSOR_CASE_END_AGENT: the primary agent changes from one agent
+ *     to another (starting an agent after none is part of the same case)
+ *   - GAS_SENSOR_CASE_END_IDLE: no breath for the idle time; the case then
+ *     ends at the last frame with the breath bit set
+ *   - GAS_SENSOR_CASE_END_FLUSH: gas_sensor_segmenter_flush()
+ * Cases shorter than the minimum duration or with too few breaths are
+ * dropped as noise (a test breath, an adapter briefly refitted).
+ *
+ * Every case carries summary statistics taken at each breath start from
+ * the slow data, as the breath store does. Handing cases to
+ * gas_sensor_changelog_case_handler() stores them in the index of a
+ * change-log capture, so an archive reader can list its cases and seek
+ * straight to one (gas_sensor_changelog_seek_case()).
+ *
+ * Register and agent state are only trusted once the sensor register
+ * (ID 0x04) and general values (ID 0x03) frames have been seen, so no
+ * case opens in the first slow data cycle.
+ */
+
+#ifndef GAS_SENSOR_CASE_H
+#define GAS_SENSOR_CASE_H
+
+#include "gas_sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_CASE_DEFAULT_IDLE_MS     120000
+#define GAS_SENSOR_CASE_DEFAULT_MIN_MS      60000
+#define GAS_SENSOR_CASE_DEFAULT_MIN_BREATHS 10
+
+/* Why a case ended */
+#define GAS_SENSOR_CASE_END_IDLE            1
+#define GAS_SENSOR_CASE_END_ADAPTER         2
+#define GAS_SENSOR_CASE_END_MODE            3
+#define GAS_SENSOR_CASE_END_AGENT           4
+#define GAS_SENSOR_CASE_END_FLUSH           5
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_segmenter *gas_sensor_segmenter_t;
+
+/*
+ * One case
+ *
+ * Concentrations are raw slow data bytes (percent * 10), and every value
+ * is GAS_SENSOR_NO_DATA if no breath of the case reported it.
+ */
+typedef struct {
+    uint64_t start_us;              /* First breath (us since epoch) */
+    uint64_t end_us;                /* Last breath activity, or the cut */
+    uint32_t breaths;
+    uint8_t agent;                  /* Primary agent (gas_agent_id_t), GAS_AGENT_NONE if none */
+    uint8_t end_reason;             /* GAS_SENSOR_CASE_END_* */
+    uint8_t status;                 /* OR of every STS byte in the case */
+    uint8_t resp_rate_mean;         /* bpm */
+    uint8_t et_co2_min;
+    uint8_t et_co2_mean;
+    uint8_t et_co2_max;
+    uint8_t et_agent_max;           /* End-tidal primary agent (AA1) */
+} gas_sensor_case_t;
+
+/**
+ * Case handler
+ *
+ * @param ctx: Handler context
+ * @param c: Finished case; valid for the duration of the call
+ * @return: GAS_SENSOR_OK, or an error passed back to the frame handler
+ */
+typedef int (*gas_sensor_case_fn)(void *ctx, const gas_sensor_case_t *c);
+
+typedef struct {
+    uint32_t idle_ms;               /* Breathless time that ends a case */
+    uint32_t min_ms;                /* Shorter cases are dropped */
+    uint32_t min_breaths;           /* Cases with fewer breaths are dropped */
+    bool split_on_agent;            /* End a case when the agent changes */
+} gas_sensor_segmenter_config_t;
+
+typedef struct {
+    uint64_t cases;                 /* Cases delivered */
+    uint64_t dropped;               /* Cases too short or with too few breaths */
+    bool open;                      /* A case is in progress */
+} gas_sensor_segmenter_stats_t;
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Initialize a configuration: 2 minutes idle, cases of at least 1 minute
+ * and 10 breaths, split on agent changes
+ */
+void gas_sensor_segmenter_config_init(gas_sensor_segmenter_config_t *config);
+
+/**
+ * Create a segmenter for one sensor
+ *
+ * @param config: Configuration, or NULL for the defaults
+ * @param handler: Called for every finished case
+ * @param ctx: Handler context
+ * @param segmenter: Output parameter for the segmenter handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_segmenter_create(const gas_sensor_segmenter_config_t *config,
+                                gas_sensor_case_fn handler,
+                                void *ctx,
+                                gas_sensor_segmenter_t *segmenter);
+
+/**
+ * Feed one frame event
+ *
+ * Matches gas_sensor_frame_handler_t, so a segmenter can be passed
+ * directly to gas_sensor_session_attach() as handler context.
+ *
+ * @param ctx: Segmenter handle
+ * @param event: Frame event (frame and slow data are used)
+ * @return: GAS_SENSOR_OK, the case handler's error, or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_segmenter_frame_handler(void *ctx, const gas_sensor_frame_event_t *event);
+
+/**
+ * End the case in progress, if any, e.g. before closing a capture
+ *
+ * @param segmenter: Segmenter handle
+ * @param timestamp_us: End of the stream (us since epoch)
+ * @return: GAS_SENSOR_OK, the case handler's error, or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_segmenter_flush(gas_sensor_segmenter_t segmenter, uint64_t timestamp_us);
+
+/**
+ * Get segmenter counters
+ */
+int gas_sensor_segmenter_stats(gas_sensor_segmenter_t segmenter,
+                               gas_sensor_segmenter_stats_t *stats);
+
+/**
+ * Free a segmenter; a case in progress is discarded
+ */
+void gas_sensor_segmenter_destroy(gas_sensor_segmenter_t segmenter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_CASE_H */
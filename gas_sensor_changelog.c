@@ -0,0 +1,977 @@
+/*
+ * Anesthetic Gas Sensor Change-Log Captures - Implementation
+ *
+ * Writer and reader both keep, per frame ID, slow data bytes 14-19 of the
+ * last frame with that ID (the "window"). The writer omits them when they
+ * match the window; the reader fills them back in from its own copy,
+ * which it maintains the same way while decoding in order.
+ */
+
+#include "gas_sensor_changelog.h"
+#include "gas_sensor_layout.h"
+#include "gas_sensor_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define FRAME_IDS           GAS_SENSOR_FRAME_ID_MAX
+#define SLOW_OFFSET         GAS_SENSOR_OFFSET_SLOW
+#define SLOW_SIZE           GAS_SENSOR_SLOW_SIZE
+#define DENSE_OFFSET        3                       /* STS and waveform, bytes 3-13 */
+#define DENSE_SIZE          11
+#define VARINT_MAX          10
+#define ENTRY_MAX           (VARINT_MAX + 1 + DENSE_SIZE + SLOW_SIZE)
+#define KEYFRAME_SIZE       (3 + FRAME_IDS * SLOW_SIZE)
+#define INDEX_ENTRY_SIZE    16
+#define INDEX_PER_RECORD    (GAS_SENSOR_CAPTURE_MAX_PAYLOAD / INDEX_ENTRY_SIZE)
+#define CASE_ENTRY_SIZE     32
+#define CASE_PER_RECORD     (GAS_SENSOR_CAPTURE_MAX_PAYLOAD / CASE_ENTRY_SIZE)
+#define TRAILER_SIZE        20
+#define TRAILER_RECORD_SIZE (GAS_SENSOR_CAPTURE_REC_HDR_SIZE + TRAILER_SIZE)
+#define NO_FRAME_ID         0xFF
+
+typedef struct {
+    uint64_t timestamp_us;
+    uint64_t offset;
+} index_entry_t;
+
+struct gas_sensor_changelog_writer {
+    gas_sensor_capture_writer_t capture;
+    uint32_t sensor_id;
+    gas_sensor_mem_t mem;                   /* Ledger charged for the index, or NULL */
+    uint64_t keyframe_us;
+    bool keyed;                             /* At least one keyframe written */
+    uint64_t next_keyframe_us;
+    uint64_t last_us;                       /* Timestamp of the last frame */
+    uint16_t mask;                          /* Frame IDs with a window */
+    uint8_t last_id;
+    uint8_t window[FRAME_IDS][SLOW_SIZE];
+    uint8_t run[GAS_SENSOR_CHANGELOG_RUN_SIZE];
+    size_t run_len;
+    uint64_t run_start_us;
+    index_entry_t *index;
+    size_t index_count;
+    size_t index_capacity;
+    gas_sensor_case_t *cases;
+    size_t case_count;
+    size_t case_capacity;
+};
+
+struct gas_sensor_changelog_reader {
+    gas_sensor_capture_reader_t capture;
+    index_entry_t *index;
+    size_t index_count;
+    gas_sensor_case_t *cases;
+    size_t case_count;
+
+    /* Current frame run; points into the capture reader buffer */
+    const uint8_t *run;
+    size_t run_len;
+    size_t run_pos;
+    uint64_t run_us;                        /* Timestamp of the previous entry */
+
+    uint16_t mask;
+    uint8_t window[FRAME_IDS][SLOW_SIZE];
+
+    bool pending;                           /* frame decoded but not yet parsed */
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+    uint64_t frame_us;
+    gas_sensor_slow_data_t slow_data;
+    gas_sensor_waveform_t waveform;
+    gas_sensor_status_t status;
+};
+
+/* ============================================================================
+ * Helper Functions - Encoding
+ * ============================================================================ */
+
+static size_t put_varint(uint8_t *data, uint64_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80) {
+        data[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    data[n++] = (uint8_t)value;
+    return n;
+}
+
+/* Returns bytes consumed, or 0 if the varint is truncated or too long */
+static size_t get_varint(const uint8_t *data, size_t available, uint64_t *value)
+{
+    uint64_t v = 0;
+    for (size_t n = 0; n < available && n < VARINT_MAX; n++) {
+        v |= (uint64_t)(data[n] & 0x7F) << (7 * n);
+        if ((data[n] & 0x80) == 0) {
+            *value = v;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+/* Frame with the given ID and window; STS and waveform bytes 3-13 are zero */
+static void window_frame(uint8_t id, const uint8_t *window, uint8_t *frame)
+{
+    memset(frame, 0, GAS_SENSOR_FRAME_SIZE);
+    frame[0] = GAS_SENSOR_FLAG1;
+    frame[1] = GAS_SENSOR_FLAG2;
+    frame[2] = id;
+    memcpy(&frame[SLOW_OFFSET], window, SLOW_SIZE);
+    frame[GAS_SENSOR_FRAME_SIZE - 1] = gas_sensor_compute_checksum(frame);
+}
+
+static void encode_case(uint8_t *entry, const gas_sensor_case_t *c)
+{
+    put_uint64_le(&entry[0], c->start_us);
+    put_uint64_le(&entry[8], c->end_us);
+    put_uint32_le(&entry[16], c->breaths);
+    entry[20] = c->agent;
+    entry[21] = c->end_reason;
+    entry[22] = c->status;
+    entry[23] = c->resp_rate_mean;
+    entry[24] = c->et_co2_min;
+    entry[25] = c->et_co2_mean;
+    entry[26] = c->et_co2_max;
+    entry[27] = c->et_agent_max;
+    memset(&entry[28], 0, CASE_ENTRY_SIZE - 28);
+}
+
+static void decode_case(const uint8_t *entry, gas_sensor_case_t *c)
+{
+    c->start_us = get_uint64_le(&entry[0]);
+    c->end_us = get_uint64_le(&entry[8]);
+    c->breaths = get_uint32_le(&entry[16]);
+    c->agent = entry[20];
+    c->end_reason = entry[21];
+    c->status = entry[22];
+    c->resp_rate_mean = entry[23];
+    c->et_co2_min = entry[24];
+    c->et_co2_mean = entry[25];
+    c->et_co2_max = entry[26];
+    c->et_agent_max = entry[27];
+}
+
+/* ============================================================================
+ * Writer
+ * ============================================================================ */
+
+static int writer_flush_run(struct gas_sensor_changelog_writer *w)
+{
+    if (w->run_len == 0) {
+        return GAS_SENSOR_OK;
+    }
+
+    int result = gas_sensor_capture_write(w->capture, GAS_SENSOR_REC_FRAME_RUN,
+                                          w->run_start_us, w->run, w->run_len);
+    w->run_len = 0;
+    return result;
+}
+
+/* Over the memory budget: keep every other index entry, key half as often */
+static void writer_thin_index(struct gas_sensor_changelog_writer *w)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < w->index_count; i += 2) {
+        w->index[n++] = w->index[i];
+    }
+    w->index_count = n;
+    w->keyframe_us *= 2;
+}
+
+static int writer_keyframe(struct gas_sensor_changelog_writer *w, uint64_t timestamp_us)
+{
+    if (w->index_count == w->index_capacity) {
+        size_t capacity = w->index_capacity ? w->index_capacity * 2 : 256;
+        size_t grow = (capacity - w->index_capacity) * sizeof(*w->index);
+        if (gas_sensor_mem_charge(w->mem, w->sensor_id, GAS_SENSOR_MEM_INDEX, grow) == GAS_SENSOR_OK) {
+            index_entry_t *index = realloc(w->index, capacity * sizeof(*index));
+            if (index == NULL) {
+                gas_sensor_mem_release(w->mem, w->sensor_id, GAS_SENSOR_MEM_INDEX, grow);
+                return GAS_SENSOR_ERR_MEMORY;
+            }
+            w->index = index;
+            w->index_capacity = capacity;
+        } else {
+            writer_thin_index(w);
+        }
+    }
+
+    uint8_t payload[KEYFRAME_SIZE];
+    put_uint16_le(payload, w->mask);
+    payload[2] = w->last_id;
+    memcpy(&payload[3], w->window, sizeof(w->window));
+
+    uint64_t offset = gas_sensor_capture_writer_offset(w->capture);
+    int result = gas_sensor_capture_write(w->capture, GAS_SENSOR_REC_KEYFRAME,
+                                          timestamp_us, payload, sizeof(payload));
+    if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+
+    /* With no index at all the keyframe is only found by scanning */
+    if (w->index_count < w->index_capacity) {
+        w->index[w->index_count].timestamp_us = timestamp_us;
+        w->index[w->index_count].offset = offset;
+        w->index_count++;
+    }
+    return GAS_SENSOR_OK;
+}
+
+static int writer_index(struct gas_sensor_changelog_writer *w)
+{
+    uint64_t first = gas_sensor_capture_writer_offset(w->capture);
+    uint8_t *payload = malloc(INDEX_PER_RECORD * INDEX_ENTRY_SIZE);
+    if (payload == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    int result = GAS_SENSOR_OK;
+    for (size_t i = 0; i < w->index_count && result == GAS_SENSOR_OK; ) {
+        size_t n = 0;
+        for (; n < INDEX_PER_RECORD && i < w->index_count; n++, i++) {
+            put_uint64_le(&payload[n * INDEX_ENTRY_SIZE], w->index[i].timestamp_us);
+            put_uint64_le(&payload[n * INDEX_ENTRY_SIZE + 8], w->index[i].offset);
+        }
+        result = gas_sensor_capture_write(w->capture, GAS_SENSOR_REC_INDEX,
+                                          w->last_us, payload, n * INDEX_ENTRY_SIZE);
+    }
+    for (size_t i = 0; i < w->case_count && result == GAS_SENSOR_OK; ) {
+        size_t n = 0;
+        for (; n < CASE_PER_RECORD && i < w->case_count; n++, i++) {
+            encode_case(&payload[n * CASE_ENTRY_SIZE], &w->cases[i]);
+        }
+        result = gas_sensor_capture_write(w->capture, GAS_SENSOR_REC_CASE,
+                                          w->last_us, payload, n * CASE_ENTRY_SIZE);
+    }
+    free(payload);
+    if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+
+    uint8_t trailer[TRAILER_SIZE];
+    put_uint64_le(&trailer[0], first);
+    put_uint64_le(&trailer[8], w->index_count);
+    memcpy(&trailer[16], GAS_SENSOR_CHANGELOG_INDEX_MAGIC, 4);
+    return gas_sensor_capture_write(w->capture, GAS_SENSOR_REC_TRAILER,
+                                    w->last_us, trailer, sizeof(trailer));
+}
+
+int gas_sensor_changelog_writer_open(const char *path,
+                                     uint32_t sensor_id,
+                                     uint64_t start_time_us,
+                                     uint32_t keyframe_ms,
+                                     gas_sensor_changelog_writer_t *writer)
+{
+    if (path == NULL || writer == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    struct gas_sensor_changelog_writer *w = calloc(1, sizeof(*w));
+    if (w == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    int result = gas_sensor_capture_writer_open(path, sensor_id, start_time_us, &w->capture);
+    if (result != GAS_SENSOR_OK) {
+        free(w);
+        return result;
+    }
+
+    if (keyframe_ms == 0) {
+        keyframe_ms = GAS_SENSOR_CHANGELOG_DEFAULT_KEYFRAME_MS;
+    }
+    w->keyframe_us = (uint64_t)keyframe_ms * 1000;
+    w->last_id = NO_FRAME_ID;
+    w->sensor_id = sensor_id;
+
+    *writer = w;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_changelog_writer_set_mem(gas_sensor_changelog_writer_t writer,
+                                        gas_sensor_mem_t mem)
+{
+    if (writer == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    size_t index_bytes = writer->index_capacity * sizeof(*writer->index) +
+                         writer->case_capacity * sizeof(*writer->cases);
+    int result = gas_sensor_mem_charge(mem, writer->sensor_id, GAS_SENSOR_MEM_INDEX, index_bytes);
+    if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+    result = gas_sensor_mem_charge(mem, writer->sensor_id, GAS_SENSOR_MEM_OTHER, sizeof(*writer));
+    if (result != GAS_SENSOR_OK) {
+        gas_sensor_mem_release(mem, writer->sensor_id, GAS_SENSOR_MEM_INDEX, index_bytes);
+        return result;
+    }
+
+    gas_sensor_mem_release(writer->mem, writer->sensor_id, GAS_SENSOR_MEM_INDEX, index_bytes);
+    gas_sensor_mem_release(writer->mem, writer->sensor_id, GAS_SENSOR_MEM_OTHER, sizeof(*writer));
+    writer->mem = mem;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_changelog_write_frame(gas_sensor_changelog_writer_t writer,
+                                     uint64_t timestamp_us,
+                                     const uint8_t *frame_data)
+{
+    if (writer == NULL || frame_data == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    uint8_t id = frame_data[2];
+    if (frame_data[0] != GAS_SENSOR_FLAG1 || frame_data[1] != GAS_SENSOR_FLAG2 ||
+        id >= FRAME_IDS) {
+        return GAS_SENSOR_ERR_INVALID_FRAME;
+    }
+    if (!gas_sensor_verify_checksum(frame_data)) {
+        return GAS_SENSOR_ERR_CHECKSUM;
+    }
+    if (writer->keyed && timestamp_us < writer->last_us) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    int result;
+    if (!writer->keyed || timestamp_us >= writer->next_keyframe_us) {
+        if ((result = writer_flush_run(writer)) != GAS_SENSOR_OK ||
+            (result = writer_keyframe(writer, timestamp_us)) != GAS_SENSOR_OK) {
+            return result;
+        }
+        writer->keyed = true;
+        writer->next_keyframe_us = timestamp_us + writer->keyframe_us;
+    }
+
+    if (writer->run_len + ENTRY_MAX > sizeof(writer->run) &&
+        (result = writer_flush_run(writer)) != GAS_SENSOR_OK) {
+        return result;
+    }
+    if (writer->run_len == 0) {
+        writer->run_start_us = timestamp_us;
+        writer->last_us = timestamp_us;
+    }
+
+    uint8_t *window = writer->window[id];
+    bool changed = !(writer->mask & (1u << id)) ||
+                   memcmp(window, &frame_data[SLOW_OFFSET], SLOW_SIZE) != 0;
+
+    uint8_t *entry = &writer->run[writer->run_len];
+    size_t n = put_varint(entry, timestamp_us - writer->last_us);
+    entry[n++] = changed ? (uint8_t)(id | GAS_SENSOR_CHANGELOG_SLOW_FLAG) : id;
+    memcpy(&entry[n], &frame_data[DENSE_OFFSET], DENSE_SIZE);
+    n += DENSE_SIZE;
+    if (changed) {
+        memcpy(&entry[n], &frame_data[SLOW_OFFSET], SLOW_SIZE);
+        n += SLOW_SIZE;
+    }
+    writer->run_len += n;
+
+    memcpy(window, &frame_data[SLOW_OFFSET], SLOW_SIZE);
+    writer->mask |= (uint16_t)(1u << id);
+    writer->last_id = id;
+    writer->last_us = timestamp_us;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_changelog_frame_handler(void *ctx, const gas_sensor_frame_event_t *event)
+{
+    if (ctx == NULL || event == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    return gas_sensor_changelog_write_frame(ctx, event->timestamp_us, event->frame);
+}
+
+int gas_sensor_changelog_add_case(gas_sensor_changelog_writer_t writer,
+                                  const gas_sensor_case_t *c)
+{
+    if (writer == NULL || c == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (writer->case_count == writer->case_capacity) {
+        size_t capacity = writer->case_capacity ? writer->case_capacity * 2 : 16;
+        size_t grow = (capacity - writer->case_capacity) * sizeof(*writer->cases);
+        int result = gas_sensor_mem_charge(writer->mem, writer->sensor_id,
+                                           GAS_SENSOR_MEM_INDEX, grow);
+        if (result != GAS_SENSOR_OK) {
+            return result;
+        }
+        gas_sensor_case_t *cases = realloc(writer->cases, capacity * sizeof(*cases));
+        if (cases == NULL) {
+            gas_sensor_mem_release(writer->mem, writer->sensor_id, GAS_SENSOR_MEM_INDEX, grow);
+            return GAS_SENSOR_ERR_MEMORY;
+        }
+        writer->cases = cases;
+        writer->case_capacity = capacity;
+    }
+
+    writer->cases[writer->case_count++] = *c;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_changelog_case_handler(void *ctx, const gas_sensor_case_t *c)
+{
+    return gas_sensor_changelog_add_case(ctx, c);
+}
+
+int gas_sensor_changelog_writer_close(gas_sensor_changelog_writer_t writer)
+{
+    if (writer == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    int result = writer_flush_run(writer);
+    if (result == GAS_SENSOR_OK) {
+        result = writer_index(writer);
+    }
+
+    int close_result = gas_sensor_capture_writer_close(writer->capture);
+    gas_sensor_mem_release(writer->mem, writer->sensor_id, GAS_SENSOR_MEM_INDEX,
+                           writer->index_capacity * sizeof(*writer->index) +
+                           writer->case_capacity * sizeof(*writer->cases));
+    gas_sensor_mem_release(writer->mem, writer->sensor_id, GAS_SENSOR_MEM_OTHER, sizeof(*writer));
+    free(writer->index);
+    free(writer->cases);
+    free(writer);
+    return (result != GAS_SENSOR_OK) ? result : close_result;
+}
+
+int gas_sensor_changelog_convert(const char *src_path,
+                                 const char *dst_path,
+                                 uint32_t keyframe_ms)
+{
+    if (src_path == NULL || dst_path == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    gas_sensor_capture_reader_t reader;
+    int result = gas_sensor_capture_reader_open(src_path, &reader);
+    if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+
+    gas_sensor_changelog_writer_t writer;
+    result = gas_sensor_changelog_writer_open(dst_path,
+                                              gas_sensor_capture_sensor_id(reader),
+                                              gas_sensor_capture_start_time(reader),
+                                              keyframe_ms, &writer);
+    if (result != GAS_SENSOR_OK) {
+        gas_sensor_capture_reader_close(reader);
+        return result;
+    }
+
+    gas_sensor_segmenter_t segmenter;
+    result = gas_sensor_segmenter_create(NULL, gas_sensor_changelog_case_handler, writer,
+                                         &segmenter);
+    if (result != GAS_SENSOR_OK) {
+        gas_sensor_changelog_writer_close(writer);
+        gas_sensor_capture_reader_close(reader);
+        return result;
+    }
+
+    gas_sensor_slow_data_t slow_data;
+    gas_sensor_waveform_t waveform;
+    gas_sensor_status_t status;
+    gas_sensor_frame_event_t event = {
+        .sensor_id = gas_sensor_capture_sensor_id(reader),
+        .slow_data = &slow_data,
+        .waveform = &waveform,
+        .status = &status,
+    };
+    gas_sensor_init_slow_data(&slow_data);
+
+    gas_sensor_capture_record_t record;
+    uint64_t last_us = 0;
+    while ((result = gas_sensor_capture_read(reader, &record)) == GAS_SENSOR_OK) {
+        if (record.type != GAS_SENSOR_REC_FRAME || record.length != GAS_SENSOR_FRAME_SIZE) {
+            continue;
+        }
+        result = gas_sensor_changelog_write_frame(writer, record.timestamp_us, record.payload);
+        if (result == GAS_SENSOR_ERR_IO || result == GAS_SENSOR_ERR_MEMORY) {
+            break;
+        }
+        if (result == GAS_SENSOR_OK &&
+            gas_sensor_parse_frame(record.payload, &slow_data, &waveform, &status) ==
+                GAS_SENSOR_OK) {
+            event.timestamp_us = record.timestamp_us;
+            event.frame = record.payload;
+            last_us = record.timestamp_us;
+            result = gas_sensor_segmenter_frame_handler(segmenter, &event);
+            if (result != GAS_SENSOR_OK) {
+                break;
+            }
+        }
+    }
+    if (result == GAS_SENSOR_ERR_EOF) {
+        result = gas_sensor_segmenter_flush(segmenter, last_us);
+    }
+    gas_sensor_segmenter_destroy(segmenter);
+
+    int close_result = gas_sensor_changelog_writer_close(writer);
+    gas_sensor_capture_reader_close(reader);
+    return (result != GAS_SENSOR_OK) ? result : close_result;
+}
+
+/* ============================================================================
+ * Reader - Decoding
+ * ============================================================================ */
+
+static void reader_reset(struct gas_sensor_changelog_reader *r)
+{
+    r->run_len = 0;
+    r->run_pos = 0;
+    r->pending = false;
+    r->mask = 0;
+    gas_sensor_init_slow_data(&r->slow_data);
+}
+
+/* Remember slow data bytes 14-19 of a decoded frame */
+static void reader_update_window(struct gas_sensor_changelog_reader *r)
+{
+    uint8_t id = r->frame[2];
+    memcpy(r->window[id], &r->frame[SLOW_OFFSET], SLOW_SIZE);
+    r->mask |= (uint16_t)(1u << id);
+}
+
+/* Decode the run entry at run_pos into frame */
+static int reader_decode_entry(struct gas_sensor_changelog_reader *r)
+{
+    const uint8_t *p = &r->run[r->run_pos];
+    size_t available = r->run_len - r->run_pos;
+
+    uint64_t delta;
+    size_t n = get_varint(p, available, &delta);
+    if (n == 0 || available < n + 1 + DENSE_SIZE) {
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    uint8_t id = p[n] & (uint8_t)~GAS_SENSOR_CHANGELOG_SLOW_FLAG;
+    bool changed = (p[n] & GAS_SENSOR_CHANGELOG_SLOW_FLAG) != 0;
+    n++;
+    if (id >= FRAME_IDS ||
+        (changed && available < n + DENSE_SIZE + SLOW_SIZE) ||
+        (!changed && !(r->mask & (1u << id)))) {
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    r->frame[0] = GAS_SENSOR_FLAG1;
+    r->frame[1] = GAS_SENSOR_FLAG2;
+    r->frame[2] = id;
+    memcpy(&r->frame[DENSE_OFFSET], &p[n], DENSE_SIZE);
+    n += DENSE_SIZE;
+    if (changed) {
+        memcpy(&r->frame[SLOW_OFFSET], &p[n], SLOW_SIZE);
+        n += SLOW_SIZE;
+    } else {
+        memcpy(&r->frame[SLOW_OFFSET], r->window[id], SLOW_SIZE);
+    }
+    r->frame[GAS_SENSOR_FRAME_SIZE - 1] = gas_sensor_compute_checksum(r->frame);
+
+    r->run_us += delta;
+    r->frame_us = r->run_us;
+    r->run_pos += n;
+    reader_update_window(r);
+    return GAS_SENSOR_OK;
+}
+
+/* Decode the next frame into frame/frame_us without parsing it */
+static int reader_peek(struct gas_sensor_changelog_reader *r)
+{
+    while (!r->pending) {
+        if (r->run_pos < r->run_len) {
+            int result = reader_decode_entry(r);
+            if (result != GAS_SENSOR_OK) {
+                return result;
+            }
+            r->pending = true;
+            break;
+        }
+
+        gas_sensor_capture_record_t record;
+        int result = gas_sensor_capture_read(r->capture, &record);
+        if (result != GAS_SENSOR_OK) {
+            return result;
+        }
+
+        if (record.type == GAS_SENSOR_REC_FRAME_RUN) {
+            r->run = record.payload;
+            r->run_len = record.length;
+            r->run_pos = 0;
+            r->run_us = record.timestamp_us;
+        } else if (record.type == GAS_SENSOR_REC_FRAME &&
+                   record.length == GAS_SENSOR_FRAME_SIZE &&
+                   record.payload[0] == GAS_SENSOR_FLAG1 &&
+                   record.payload[1] == GAS_SENSOR_FLAG2 &&
+                   record.payload[2] < FRAME_IDS &&
+                   gas_sensor_verify_checksum(record.payload)) {
+            memcpy(r->frame, record.payload, GAS_SENSOR_FRAME_SIZE);
+            r->frame_us = record.timestamp_us;
+            reader_update_window(r);
+            r->pending = true;
+        }
+        /* Keyframes repeat the state already decoded; others carry no frames */
+    }
+    return GAS_SENSOR_OK;
+}
+
+static void reader_apply(struct gas_sensor_changelog_reader *r)
+{
+    gas_sensor_parse_frame(r->frame, &r->slow_data, &r->waveform, &r->status);
+    r->pending = false;
+}
+
+/* Restore windows and slow data from a keyframe payload */
+static int reader_restore(struct gas_sensor_changelog_reader *r,
+                          const gas_sensor_capture_record_t *record)
+{
+    if (record->type != GAS_SENSOR_REC_KEYFRAME || record->length != KEYFRAME_SIZE) {
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    reader_reset(r);
+    r->mask = get_uint16_le(record->payload) & ((1u << FRAME_IDS) - 1);
+    memcpy(r->window, &record->payload[3], sizeof(r->window));
+
+    /* Each frame ID's parser overwrites only its own fields, so parsing the
+     * last frame of every ID reproduces the state after the whole stream */
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+    for (uint8_t id = 0; id < FRAME_IDS; id++) {
+        if (r->mask & (1u << id)) {
+            window_frame(id, r->window[id], frame);
+            gas_sensor_parse_frame(frame, &r->slow_data, NULL, NULL);
+        }
+    }
+
+    uint8_t last_id = record->payload[2];
+    r->slow_data.last_frame_id = (last_id < FRAME_IDS) ? last_id : 0;
+    return GAS_SENSOR_OK;
+}
+
+/* ============================================================================
+ * Reader - Index
+ * ============================================================================ */
+
+static int reader_add_index(struct gas_sensor_changelog_reader *r, size_t *capacity,
+                            uint64_t timestamp_us, uint64_t offset)
+{
+    if (r->index_count == *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 256;
+        index_entry_t *index = realloc(r->index, new_capacity * sizeof(*index));
+        if (index == NULL) {
+            return GAS_SENSOR_ERR_MEMORY;
+        }
+        r->index = index;
+        *capacity = new_capacity;
+    }
+
+    r->index[r->index_count].timestamp_us = timestamp_us;
+    r->index[r->index_count].offset = offset;
+    r->index_count++;
+    return GAS_SENSOR_OK;
+}
+
+/**
+ * Read the index written on close
+ * Returns GAS_SENSOR_ERR_FORMAT if it is missing or inconsistent.
+ */
+static int reader_load_index(struct gas_sensor_changelog_reader *r, uint64_t size)
+{
+    gas_sensor_capture_record_t record;
+    if (size < GAS_SENSOR_CAPTURE_HEADER_SIZE + TRAILER_RECORD_SIZE ||
+        gas_sensor_capture_reader_seek(r->capture, size - TRAILER_RECORD_SIZE) != GAS_SENSOR_OK ||
+        gas_sensor_capture_read(r->capture, &record) != GAS_SENSOR_OK ||
+        record.type != GAS_SENSOR_REC_TRAILER || record.length != TRAILER_SIZE ||
+        memcmp(&record.payload[16], GAS_SENSOR_CHANGELOG_INDEX_MAGIC, 4) != 0) {
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    uint64_t first = get_uint64_le(&record.payload[0]);
+    uint64_t count = get_uint64_le(&record.payload[8]);
+    if (first < GAS_SENSOR_CAPTURE_HEADER_SIZE || first > size - TRAILER_RECORD_SIZE ||
+        count > size / INDEX_ENTRY_SIZE ||
+        gas_sensor_capture_reader_seek(r->capture, first) != GAS_SENSOR_OK) {
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    size_t capacity = 0;
+    while (r->index_count < count) {
+        if (gas_sensor_capture_read(r->capture, &record) != GAS_SENSOR_OK ||
+            record.type != GAS_SENSOR_REC_INDEX || record.length % INDEX_ENTRY_SIZE != 0) {
+            return GAS_SENSOR_ERR_FORMAT;
+        }
+        for (size_t i = 0; i < record.length; i += INDEX_ENTRY_SIZE) {
+            uint64_t timestamp_us = get_uint64_le(&record.payload[i]);
+            uint64_t offset = get_uint64_le(&record.payload[i + 8]);
+            if (offset < GAS_SENSOR_CAPTURE_HEADER_SIZE || offset >= first ||
+                (r->index_count > 0 &&
+                 timestamp_us < r->index[r->index_count - 1].timestamp_us)) {
+                return GAS_SENSOR_ERR_FORMAT;
+            }
+            if (reader_add_index(r, &capacity, timestamp_us, offset) != GAS_SENSOR_OK) {
+                return GAS_SENSOR_ERR_MEMORY;
+            }
+        }
+    }
+    if (r->index_count != count) {
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    /* Case records follow the index; older files have none */
+    size_t case_capacity = 0;
+    while (gas_sensor_capture_read(r->capture, &record) == GAS_SENSOR_OK &&
+           record.type == GAS_SENSOR_REC_CASE) {
+        if (record.length % CASE_ENTRY_SIZE != 0) {
+            break;
+        }
+        size_t n = record.length / CASE_ENTRY_SIZE;
+        if (r->case_count + n > case_capacity) {
+            size_t grown = case_capacity ? case_capacity * 2 : 16;
+            while (grown < r->case_count + n) {
+                grown *= 2;
+            }
+            gas_sensor_case_t *cases = realloc(r->cases, grown * sizeof(*cases));
+            if (cases == NULL) {
+                return GAS_SENSOR_ERR_MEMORY;
+            }
+            r->cases = cases;
+            case_capacity = grown;
+        }
+        for (size_t i = 0; i < n; i++) {
+            decode_case(&record.payload[i * CASE_ENTRY_SIZE], &r->cases[r->case_count++]);
+        }
+    }
+    return GAS_SENSOR_OK;
+}
+
+/* Build the index from the keyframe records of an unclosed capture */
+static int reader_scan_index(struct gas_sensor_changelog_reader *r)
+{
+    size_t capacity = 0;
+    r->index_count = 0;
+
+    int result = gas_sensor_capture_reader_seek(r->capture, GAS_SENSOR_CAPTURE_HEADER_SIZE);
+    while (result == GAS_SENSOR_OK) {
+        uint64_t offset = gas_sensor_capture_reader_offset(r->capture);
+        gas_sensor_capture_record_t record;
+        result = gas_sensor_capture_read(r->capture, &record);
+        if (result == GAS_SENSOR_OK && record.type == GAS_SENSOR_REC_KEYFRAME) {
+            result = reader_add_index(r, &capacity, record.timestamp_us, offset);
+        }
+    }
+
+    /* A writer that did not close may leave a truncated last record */
+    return (result == GAS_SENSOR_ERR_EOF || result == GAS_SENSOR_ERR_FORMAT)
+           ? GAS_SENSOR_OK : result;
+}
+
+/* ============================================================================
+ * Reader - Public Functions
+ * ============================================================================ */
+
+int gas_sensor_changelog_reader_open(const char *path,
+                                     gas_sensor_changelog_reader_t *reader)
+{
+    if (path == NULL || reader == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return GAS_SENSOR_ERR_IO;
+    }
+    long size = (fseek(file, 0, SEEK_END) == 0) ? ftell(file) : -1;
+    fclose(file);
+    if (size < 0) {
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    struct gas_sensor_changelog_reader *r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    int result = gas_sensor_capture_reader_open(path, &r->capture);
+    if (result != GAS_SENSOR_OK) {
+        free(r);
+        return result;
+    }
+
+    result = reader_load_index(r, (uint64_t)size);
+    if (result == GAS_SENSOR_ERR_FORMAT) {
+        result = reader_scan_index(r);
+    }
+    if (result == GAS_SENSOR_OK) {
+        result = gas_sensor_capture_reader_seek(r->capture, GAS_SENSOR_CAPTURE_HEADER_SIZE);
+    }
+    if (result != GAS_SENSOR_OK) {
+        gas_sensor_changelog_reader_close(r);
+        return result;
+    }
+
+    reader_reset(r);
+    *reader = r;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_changelog_next(gas_sensor_changelog_reader_t reader,
+                              gas_sensor_frame_event_t *event)
+{
+    if (reader == NULL || event == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    int result = reader_peek(reader);
+    if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+    reader_apply(reader);
+
+    event->sensor_id = gas_sensor_capture_sensor_id(reader->capture);
+    event->timestamp_us = reader->frame_us;
+    event->frame = reader->frame;
+    event->slow_data = &reader->slow_data;
+    event->waveform = &reader->waveform;
+    event->status = &reader->status;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_changelog_seek(gas_sensor_changelog_reader_t reader, uint64_t timestamp_us)
+{
+    if (reader == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    /* Last keyframe at or before the target */
+    size_t lo = 0;
+    size_t hi = reader->index_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (reader->index[mid].timestamp_us <= timestamp_us) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    int result;
+    if (lo == 0) {
+        result = gas_sensor_capture_reader_seek(reader->capture, GAS_SENSOR_CAPTURE_HEADER_SIZE);
+        reader_reset(reader);
+    } else {
+        gas_sensor_capture_record_t record;
+        result = gas_sensor_capture_reader_seek(reader->capture, reader->index[lo - 1].offset);
+        if (result == GAS_SENSOR_OK) {
+            result = gas_sensor_capture_read(reader->capture, &record);
+        }
+        if (result == GAS_SENSOR_OK) {
+            result = reader_restore(reader, &record);
+        } else if (result == GAS_SENSOR_ERR_EOF) {
+            result = GAS_SENSOR_ERR_FORMAT;
+        }
+    }
+
+    while (result == GAS_SENSOR_OK) {
+        result = reader_peek(reader);
+        if (result == GAS_SENSOR_OK) {
+            if (reader->frame_us >= timestamp_us) {
+                return GAS_SENSOR_OK;
+            }
+            reader_apply(reader);
+        }
+    }
+
+    return (result == GAS_SENSOR_ERR_EOF) ? GAS_SENSOR_OK : result;
+}
+
+int gas_sensor_changelog_state_at(gas_sensor_changelog_reader_t reader,
+                                  uint64_t timestamp_us,
+                                  gas_sensor_slow_data_t *slow_data)
+{
+    if (reader == NULL || slow_data == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    int result = gas_sensor_changelog_seek(reader, (timestamp_us < UINT64_MAX)
+                                                   ? timestamp_us + 1 : timestamp_us);
+    if (result == GAS_SENSOR_OK) {
+        *slow_data = reader->slow_data;
+    }
+    return result;
+}
+
+int gas_sensor_changelog_run(gas_sensor_changelog_reader_t reader,
+                             gas_sensor_frame_handler_t handler,
+                             void *ctx)
+{
+    if (reader == NULL || handler == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    gas_sensor_frame_event_t event;
+    int result;
+    while ((result = gas_sensor_changelog_next(reader, &event)) == GAS_SENSOR_OK) {
+        int handler_result = handler(ctx, &event);
+        if (handler_result != GAS_SENSOR_OK) {
+            return handler_result;
+        }
+    }
+
+    return (result == GAS_SENSOR_ERR_EOF) ? GAS_SENSOR_OK : result;
+}
+
+uint32_t gas_sensor_changelog_sensor_id(gas_sensor_changelog_reader_t reader)
+{
+    return (reader != NULL) ? gas_sensor_capture_sensor_id(reader->capture) : 0;
+}
+
+size_t gas_sensor_changelog_case_count(gas_sensor_changelog_reader_t reader)
+{
+    return (reader != NULL) ? reader->case_count : 0;
+}
+
+int gas_sensor_changelog_get_case(gas_sensor_changelog_reader_t reader,
+                                  size_t index,
+                                  gas_sensor_case_t *c)
+{
+    if (reader == NULL || c == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (index >= reader->case_count) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    *c = reader->cases[index];
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_changelog_seek_case(gas_sensor_changelog_reader_t reader, size_t index)
+{
+    if (reader == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (index >= reader->case_count) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    return gas_sensor_changelog_seek(reader, reader->cases[index].start_us);
+}
+
+uint64_t gas_sensor_changelog_start_time(gas_sensor_changelog_reader_t reader)
+{
+    return (reader != NULL) ? gas_sensor_capture_start_time(reader->capture) : 0;
+}
+
+void gas_sensor_changelog_reader_close(gas_sensor_changelog_reader_t reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+
+    gas_sensor_capture_reader_close(reader->capture);
+    free(reader->index);
+    free(reader->cases);
+    free(reader);
+}
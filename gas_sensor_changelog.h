@@ -0,0 +1,316 @@
+/*
+ * Anesthetic Gas Sensor Change-Log Captures
+ *
+ * A compact capture encoding for long archives. The STS byte and waveform
+ * of every frame are kept, but each frame ID's slow data payload is only
+ * stored when it differs from the last one stored for that ID; the
+ * configuration and service payloads, which almost never change, then
+ * cost nothing after the first cycle. Every frame is still reproduced
+ * byte for byte on reading, checksum included.
+ *
+ * Change-log captures are GSCP files (gas_sensor_capture.h) made of:
+ *   Keyframe records (GAS_SENSOR_REC_KEYFRAME), written every keyframe
+ *   interval before the next frame:
+ *     [0-1]   Bit per frame ID with a stored payload
+ *     [2]     ID of the last frame, 0xFF if none
+ *     [3-62]  Per frame ID 0-9: slow data bytes 14-19 of its last frame
+ *   Frame run records (GAS_SENSOR_REC_FRAME_RUN), timestamped with their
+ *   first frame; entries of:
+ *     varint  Microseconds since the previous frame (LEB128)
+ *     [0]     Frame ID, | GAS_SENSOR_CHANGELOG_SLOW_FLAG if bytes 14-19 follow
+ *     [1-11]  Frame bytes 3-13 (STS and waveform)
+ *     [12-17] Frame bytes 14-19, only if flagged
+ *   Index records (GAS_SENSOR_REC_INDEX), written on close; entries of
+ *   keyframe timestamp (u64) and file offset (u64)
+ *   Case records (GAS_SENSOR_REC_CASE), written on close after the index
+ *   when cases were added; 32-byte entries of:
+ *     [0-7]   Start (us since epoch)
+ *     [8-15]  End (us since epoch)
+ *     [16-19] Breaths
+ *     [20]    Primary agent
+ *     [21]    End reason (GAS_SENSOR_CASE_END_*)
+ *     [22]    OR of STS bytes
+ *     [23]    Mean respiratory rate
+ *     [24-26] Minimum, mean and maximum EtCO2
+ *     [27]    Maximum end-tidal primary agent
+ *     [28-31] Reserved
+ *   A trailer record (GAS_SENSOR_REC_TRAILER) ending the file:
+ *     [0-7]   Offset of the first index record
+ *     [8-15]  Number of index entries
+ *     [16-19] Magic "GSIX"
+ *
+ * Seeking to a timestamp binary-searches the index, restores the slow data
+ * state from the keyframe and decodes forward at most one keyframe
+ * interval. A capture whose writer did not close has no index; the reader
+ * then builds one by scanning the record headers once.
+ *
+ * Cases from a gas_sensor_segmenter_t (gas_sensor_case.h) can be handed
+ * to the writer as they end; the reader lists them from the index and
+ * seeks to one through the keyframe index like to any other time. Readers
+ * that predate case records stop after the index entries and never see
+ * them.
+ *
+ * The writer's index grows by one entry per keyframe, for as long as the
+ * capture runs. With a memory ledger set, index growth is charged to the
+ * sensor under GAS_SENSOR_MEM_INDEX; when a charge is refused the writer
+ * drops every other index entry and doubles the keyframe interval, so the
+ * index stops growing and seeks decode forward further instead.
+ */
+
+#ifndef GAS_SENSOR_CHANGELOG_H
+#define GAS_SENSOR_CHANGELOG_H
+
+#include "gas_sensor_capture.h"
+#include "gas_sensor_case.h"
+#include "gas_sensor_mem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_CHANGELOG_INDEX_MAGIC        "GSIX"
+#define GAS_SENSOR_CHANGELOG_DEFAULT_KEYFRAME_MS 10000
+
+/* Frame ID byte flag: the slow data payload follows */
+#define GAS_SENSOR_CHANGELOG_SLOW_FLAG          0x80
+
+/* Run payload size at which a frame run record is written */
+#define GAS_SENSOR_CHANGELOG_RUN_SIZE           4096
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_changelog_writer *gas_sensor_changelog_writer_t;
+typedef struct gas_sensor_changelog_reader *gas_sensor_changelog_reader_t;
+
+/* ============================================================================
+ * Writer
+ * ============================================================================ */
+
+/**
+ * Create a change-log capture for one sensor
+ *
+ * An existing file at path is truncated.
+ *
+ * @param path: Output file path
+ * @param sensor_id: Sensor identifier stored in the file header
+ * @param start_time_us: Capture start time (us since epoch)
+ * @param keyframe_ms: Keyframe interval, 0 for the default; bounds the
+ *                     decoding work of a seek
+ * @param writer: Output parameter for the writer handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO, GAS_SENSOR_ERR_MEMORY or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_changelog_writer_open(const char *path,
+                                     uint32_t sensor_id,
+                                     uint64_t start_time_us,
+                                     uint32_t keyframe_ms,
+                                     gas_sensor_changelog_writer_t *writer);
+
+/**
+ * Set the memory ledger of a writer
+ *
+ * The writer and its index are charged to its sensor from then on.
+ *
+ * @param writer: Writer handle
+ * @param mem: Ledger, or NULL to stop accounting
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NO_SPACE (the ledger refused
+ *          what the writer already holds) or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_changelog_writer_set_mem(gas_sensor_changelog_writer_t writer,
+                                        gas_sensor_mem_t mem);
+
+/**
+ * Append one frame
+ *
+ * The checksum is recomputed on reading, so frames must be valid.
+ *
+ * @param writer: Writer handle
+ * @param timestamp_us: Receive time (us since epoch), non-decreasing
+ * @param frame_data: 21-byte frame
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_FRAME (bad flags or ID),
+ *          GAS_SENSOR_ERR_CHECKSUM, GAS_SENSOR_ERR_INVALID_PARAM if the
+ *          timestamp goes backwards, GAS_SENSOR_ERR_IO,
+ *          GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_changelog_write_frame(gas_sensor_changelog_writer_t writer,
+                                     uint64_t timestamp_us,
+                                     const uint8_t *frame_data);
+
+/**
+ * Append one frame event
+ *
+ * Matches gas_sensor_frame_handler_t, so a writer can be passed directly
+ * to gas_sensor_session_attach() as handler context.
+ *
+ * @param ctx: Writer handle
+ * @param event: Frame event of the writer's sensor
+ * @return: As gas_sensor_changelog_write_frame()
+ */
+int gas_sensor_changelog_frame_handler(void *ctx, const gas_sensor_frame_event_t *event);
+
+/**
+ * Record a case in the index written on close
+ *
+ * Case growth is charged like the index when a memory ledger is set.
+ *
+ * @param writer: Writer handle
+ * @param c: Case, normally from a segmenter fed the same frames
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NO_SPACE (refused by the ledger),
+ *          GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_changelog_add_case(gas_sensor_changelog_writer_t writer,
+                                  const gas_sensor_case_t *c);
+
+/**
+ * Record a case
+ *
+ * Matches gas_sensor_case_fn, so a writer can be passed directly to
+ * gas_sensor_segmenter_create() as handler context.
+ *
+ * @param ctx: Writer handle
+ * @param c: Finished case
+ * @return: As gas_sensor_changelog_add_case()
+ */
+int gas_sensor_changelog_case_handler(void *ctx, const gas_sensor_case_t *c);
+
+/**
+ * Flush the pending run, write the index and close the file
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_changelog_writer_close(gas_sensor_changelog_writer_t writer);
+
+/**
+ * Re-encode the frame records of an ordinary capture
+ *
+ * Raw chunks and frames failing validation are dropped. The frames are
+ * segmented into cases with the default segmenter configuration, and the
+ * cases are recorded in the index.
+ *
+ * @param src_path: Capture to read
+ * @param dst_path: Change-log capture to create
+ * @param keyframe_ms: Keyframe interval, 0 for the default
+ * @return: GAS_SENSOR_OK, or an error from reading or writing
+ */
+int gas_sensor_changelog_convert(const char *src_path,
+                                 const char *dst_path,
+                                 uint32_t keyframe_ms);
+
+/* ============================================================================
+ * Reader
+ * ============================================================================ */
+
+/**
+ * Open a change-log capture
+ *
+ * Reads the index (or rebuilds it) and positions the reader at the first
+ * frame. Ordinary frame records in the file are decoded as well.
+ *
+ * @param path: Capture file path
+ * @param reader: Output parameter for the reader handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO, GAS_SENSOR_ERR_FORMAT,
+ *          GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_changelog_reader_open(const char *path,
+                                     gas_sensor_changelog_reader_t *reader);
+
+/**
+ * Decode the next frame
+ *
+ * @param reader: Reader handle
+ * @param event: Output event with the reconstructed frame and the slow
+ *               data state after it; pointers stay valid until the next
+ *               call
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_EOF, GAS_SENSOR_ERR_FORMAT or
+ *          GAS_SENSOR_ERR_IO
+ */
+int gas_sensor_changelog_next(gas_sensor_changelog_reader_t reader,
+                              gas_sensor_frame_event_t *event);
+
+/**
+ * Position the reader at the first frame received at or after a time
+ *
+ * The slow data state is restored to what it was just before that frame.
+ *
+ * @return: GAS_SENSOR_OK (also when no frame follows; the next read then
+ *          returns GAS_SENSOR_ERR_EOF), GAS_SENSOR_ERR_FORMAT,
+ *          GAS_SENSOR_ERR_IO or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_changelog_seek(gas_sensor_changelog_reader_t reader, uint64_t timestamp_us);
+
+/**
+ * Reconstruct the slow data state at a time
+ *
+ * Equivalent to parsing every frame received up to and including
+ * timestamp_us. Leaves the reader positioned after those frames.
+ *
+ * @param reader: Reader handle
+ * @param timestamp_us: Time of interest (us since epoch)
+ * @param slow_data: Output slow data state
+ * @return: As gas_sensor_changelog_seek()
+ */
+int gas_sensor_changelog_state_at(gas_sensor_changelog_reader_t reader,
+                                  uint64_t timestamp_us,
+                                  gas_sensor_slow_data_t *slow_data);
+
+/**
+ * Deliver all remaining frames to a handler
+ *
+ * @return: GAS_SENSOR_OK when drained, the handler's return value if it
+ *          stopped delivery, or a read error
+ */
+int gas_sensor_changelog_run(gas_sensor_changelog_reader_t reader,
+                             gas_sensor_frame_handler_t handler,
+                             void *ctx);
+
+/**
+ * Get the number of cases recorded in the index
+ */
+size_t gas_sensor_changelog_case_count(gas_sensor_changelog_reader_t reader);
+
+/**
+ * Get a recorded case
+ *
+ * @param reader: Reader handle
+ * @param index: Case number, 0 to gas_sensor_changelog_case_count() - 1,
+ *               in the order the cases ended
+ * @param c: Output case
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_changelog_get_case(gas_sensor_changelog_reader_t reader,
+                                  size_t index,
+                                  gas_sensor_case_t *c);
+
+/**
+ * Position the reader at the first frame of a recorded case
+ *
+ * Equivalent to gas_sensor_changelog_seek() to the case start; frames
+ * from then on belong to the case until the case end time.
+ *
+ * @return: As gas_sensor_changelog_seek(), or GAS_SENSOR_ERR_INVALID_PARAM
+ */
+int gas_sensor_changelog_seek_case(gas_sensor_changelog_reader_t reader, size_t index);
+
+/**
+ * Get header fields of an open capture
+ */
+uint32_t gas_sensor_changelog_sensor_id(gas_sensor_changelog_reader_t reader);
+uint64_t gas_sensor_changelog_start_time(gas_sensor_changelog_reader_t reader);
+
+/**
+ * Close a reader
+ */
+void gas_sensor_changelog_reader_close(gas_sensor_changelog_reader_t reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_CHANGELOG_H */
@@ -0,0 +1,66 @@
+/*
+ * Anesthetic Gas Sensor Clocks - Implementation
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor_clock.h"
+#include <stddef.h>
+#include <time.h>
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static uint64_t system_now_us(void *ctx)
+{
+    (void)ctx;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static uint64_t vclock_now_us(void *ctx)
+{
+    return ((const gas_sensor_vclock_t *)ctx)->now_us;
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+gas_sensor_clock_t gas_sensor_clock_system(void)
+{
+    gas_sensor_clock_t clock = { system_now_us, NULL };
+    return clock;
+}
+
+uint64_t gas_sensor_clock_now(const gas_sensor_clock_t *clock)
+{
+    if (clock == NULL || clock->now_us == NULL) {
+        return system_now_us(NULL);
+    }
+    return clock->now_us(clock->ctx);
+}
+
+void gas_sensor_vclock_init(gas_sensor_vclock_t *vclock, uint64_t start_us)
+{
+    if (vclock == NULL) {
+        return;
+    }
+
+    vclock->now_us = start_us;
+}
+
+gas_sensor_clock_t gas_sensor_vclock_clock(gas_sensor_vclock_t *vclock)
+{
+    gas_sensor_clock_t clock = { vclock_now_us, vclock };
+    return clock;
+}
+
+void gas_sensor_vclock_set(gas_sensor_vclock_t *vclock, uint64_t now_us)
+{
+    if (vclock != NULL && now_us > vclock->now_us) {
+        vclock->now_us = now_us;
+    }
+}
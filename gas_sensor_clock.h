@@ -0,0 +1,94 @@
+/*
+ * Anesthetic Gas Sensor Clocks
+ *
+ * Time-dependent components read "now" through a gas_sensor_clock_t
+ * instead of calling the operating system directly, so a test or a
+ * simulation can substitute its own time base. The system clock reads
+ * CLOCK_REALTIME; a virtual clock only moves when its owner advances it,
+ * which lets hours of simulated sensor traffic run as fast as the CPU
+ * allows and with the same timestamps on every run.
+ *
+ * Components that already take the time as a parameter (for example
+ * gas_sensor_o2feed_run() or gas_sensor_passthrough_tick()) need no
+ * clock; the caller passes gas_sensor_clock_now().
+ */
+
+#ifndef GAS_SENSOR_CLOCK_H
+#define GAS_SENSOR_CLOCK_H
+
+#include "gas_sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+/**
+ * Time source
+ *
+ * @param ctx: Clock context
+ * @return: Current time (us since epoch), never decreasing
+ */
+typedef uint64_t (*gas_sensor_clock_fn)(void *ctx);
+
+/* Clock: a time source and its context; copied by value */
+typedef struct {
+    gas_sensor_clock_fn now_us;
+    void *ctx;
+} gas_sensor_clock_t;
+
+/* Virtual clock state; allocate anywhere and gas_sensor_vclock_init() */
+typedef struct {
+    uint64_t now_us;
+} gas_sensor_vclock_t;
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Get the system clock (CLOCK_REALTIME)
+ */
+gas_sensor_clock_t gas_sensor_clock_system(void);
+
+/**
+ * Read a clock
+ *
+ * @param clock: Clock, or NULL for the system clock
+ * @return: Current time (us since epoch)
+ */
+uint64_t gas_sensor_clock_now(const gas_sensor_clock_t *clock);
+
+/**
+ * Reset a virtual clock
+ *
+ * @param vclock: Virtual clock state
+ * @param start_us: Initial time (us since epoch)
+ */
+void gas_sensor_vclock_init(gas_sensor_vclock_t *vclock, uint64_t start_us);
+
+/**
+ * Get a clock reading a virtual clock
+ *
+ * @param vclock: Virtual clock state, which must outlive every copy of
+ *                the returned clock
+ */
+gas_sensor_clock_t gas_sensor_vclock_clock(gas_sensor_vclock_t *vclock);
+
+/**
+ * Move a virtual clock forward
+ *
+ * @param vclock: Virtual clock state
+ * @param now_us: New time; earlier times are ignored so the clock never
+ *                goes backwards
+ */
+void gas_sensor_vclock_set(gas_sensor_vclock_t *vclock, uint64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_CLOCK_H */
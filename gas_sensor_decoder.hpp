@@ -0,0 +1,371 @@
+/*
+ * Anesthetic Gas Sensor Policy-Templated Decoder (C++20)
+ *
+ * gas_sensor_parse_frame() always fills the fixed C output structs, and
+ * most consumers then copy those values into their own representation.
+ * gas::decode() instead hands each decoded field group straight to a sink
+ * policy, so decoding inlines into the consumer's own data structures:
+ *
+ *     struct co2_trend {
+ *         std::vector<float> co2;
+ *         void on_waveform(float co2_pct, float, float, float, float) {
+ *             co2.push_back(co2_pct);
+ *         }
+ *     };
+ *
+ *     co2_trend t;
+ *     gas::decode(frame, t);          // unused words may be optimized away
+ *
+ * Hooks are optional and detected at compile time; a group whose hook the
+ * sink does not declare is never decoded. Available hooks, in call order:
+ *
+ *   on_waveform(co2, n2o, aa1, aa2, o2)            floats, %
+ *   on_status(sts)                                 raw STS byte
+ *   bool on_frame_id(id)                           return false to skip slow data
+ *   on_insp(co2, n2o, aa1, aa2, o2)                ID 0x00, floats, %
+ *   on_exp(co2, n2o, aa1, aa2, o2)                 ID 0x01
+ *   on_mom(co2, n2o, aa1, aa2, o2)                 ID 0x02
+ *   on_gen(resp_rate, time_since_breath,
+ *          primary_agent, secondary_agent, atm)    ID 0x03
+ *   on_sensor_regs(mode, error, adapter, valid)    ID 0x04, raw registers
+ *   on_config(fitted, hw_revision, sw_revision,
+ *             config1, protocol_rev)               ID 0x05, revisions BCD decoded
+ *   on_service(serial_number, service_status)      ID 0x06, raw register
+ *
+ * Invalid concentrations arrive as GAS_SENSOR_CONC_INVALID, exactly as in
+ * the C structs. gas::struct_sink is the sink that writes those structs;
+ * gas::parse_frame() instantiated with it produces the same output and
+ * return codes as gas_sensor_parse_frame(), which stays a plain C function
+ * so the library itself still builds with a C99 compiler. Both take every
+ * byte offset from gas_sensor_layout.h.
+ */
+
+#ifndef GAS_SENSOR_DECODER_HPP
+#define GAS_SENSOR_DECODER_HPP
+
+#include "gas_sensor.h"
+#include "gas_sensor_layout.h"
+#include <concepts>
+#include <cstdint>
+
+namespace gas {
+
+/* ============================================================================
+ * Field Conversions
+ * ============================================================================ */
+
+namespace detail {
+
+inline std::uint16_t be16(const std::uint8_t *data)
+{
+    return static_cast<std::uint16_t>((data[0] << 8) | data[1]);
+}
+
+/* Two-digit BCD byte: 0x42 = 42 */
+inline std::uint16_t bcd(std::uint8_t value)
+{
+    return static_cast<std::uint16_t>((value >> 4) * 10 + (value & 0x0F));
+}
+
+/* Slow data: percentage * 10, 0xFF = invalid */
+inline float conc1(std::uint8_t raw)
+{
+    return raw == GAS_SENSOR_NO_DATA ? GAS_SENSOR_CONC_INVALID
+                                     : static_cast<float>(raw) / 10.0f;
+}
+
+/* Waveform: percentage * 100, 0xFFFF = invalid */
+inline float conc2(const std::uint8_t *data)
+{
+    std::uint16_t raw = be16(data);
+    return raw == 0xFFFF ? GAS_SENSOR_CONC_INVALID
+                         : static_cast<float>(raw) / 100.0f;
+}
+
+/* Bytes 2-19 plus the two's complement checksum sum to zero */
+inline bool checksum_ok(const std::uint8_t *frame)
+{
+    std::uint8_t sum = 0;
+    for (int i = GAS_SENSOR_OFFSET_ID; i < GAS_SENSOR_OFFSET_CHECKSUM; i++) {
+        sum = static_cast<std::uint8_t>(sum + frame[i]);
+    }
+    return static_cast<std::uint8_t>(sum + frame[GAS_SENSOR_OFFSET_CHECKSUM]) == 0;
+}
+
+/* ============================================================================
+ * Hook Detection
+ * ============================================================================ */
+
+template <class S>
+concept has_on_waveform = requires(S &s, float v) { s.on_waveform(v, v, v, v, v); };
+
+template <class S>
+concept has_on_status = requires(S &s, std::uint8_t b) { s.on_status(b); };
+
+template <class S>
+concept has_on_frame_id = requires(S &s, std::uint8_t b) { { s.on_frame_id(b) } -> std::convertible_to<bool>; };
+
+template <class S>
+concept has_on_insp = requires(S &s, float v) { s.on_insp(v, v, v, v, v); };
+
+template <class S>
+concept has_on_exp = requires(S &s, float v) { s.on_exp(v, v, v, v, v); };
+
+template <class S>
+concept has_on_mom = requires(S &s, float v) { s.on_mom(v, v, v, v, v); };
+
+template <class S>
+concept has_on_gen = requires(S &s, std::uint8_t b, gas_agent_id_t a, float v) {
+    s.on_gen(b, b, a, a, v);
+};
+
+template <class S>
+concept has_on_sensor_regs = requires(S &s, std::uint8_t b) { s.on_sensor_regs(b, b, b, b); };
+
+template <class S>
+concept has_on_config = requires(S &s, std::uint8_t b, std::uint16_t w) { s.on_config(b, w, w, b, b); };
+
+template <class S>
+concept has_on_service = requires(S &s, std::uint8_t b, std::uint16_t w) { s.on_service(w, b); };
+
+template <class S>
+concept has_slow_hooks = has_on_insp<S> || has_on_exp<S> || has_on_mom<S> ||
+                         has_on_gen<S> || has_on_sensor_regs<S> ||
+                         has_on_config<S> || has_on_service<S>;
+
+} // namespace detail
+
+/* ============================================================================
+ * Decoder
+ * ============================================================================ */
+
+/**
+ * Validate one 21-byte frame and pass its fields to the sink
+ *
+ * The frame ID is only checked when the sink consumes slow data (and its
+ * on_frame_id(), if any, did not decline it), matching the C parser.
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NULL_PARAM,
+ *          GAS_SENSOR_ERR_INVALID_FRAME or GAS_SENSOR_ERR_CHECKSUM
+ */
+template <class Sink>
+inline int decode(const std::uint8_t *frame, Sink &sink)
+{
+    using namespace detail;
+
+    if (frame == nullptr) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (frame[0] != GAS_SENSOR_FLAG1 || frame[1] != GAS_SENSOR_FLAG2) {
+        return GAS_SENSOR_ERR_INVALID_FRAME;
+    }
+    if (!checksum_ok(frame)) {
+        return GAS_SENSOR_ERR_CHECKSUM;
+    }
+
+    if constexpr (has_on_waveform<Sink>) {
+        sink.on_waveform(conc2(&frame[GAS_SENSOR_OFFSET_CO2]), conc2(&frame[GAS_SENSOR_OFFSET_N2O]),
+                         conc2(&frame[GAS_SENSOR_OFFSET_AA1]), conc2(&frame[GAS_SENSOR_OFFSET_AA2]),
+                         conc2(&frame[GAS_SENSOR_OFFSET_O2]));
+    }
+    if constexpr (has_on_status<Sink>) {
+        sink.on_status(frame[GAS_SENSOR_OFFSET_STS]);
+    }
+
+    if constexpr (has_slow_hooks<Sink> || has_on_frame_id<Sink>) {
+        std::uint8_t id = frame[GAS_SENSOR_OFFSET_ID];
+        if constexpr (has_on_frame_id<Sink>) {
+            if (!sink.on_frame_id(id)) {
+                return GAS_SENSOR_OK;
+            }
+        }
+        if (id >= GAS_SENSOR_FRAME_ID_MAX) {
+            return GAS_SENSOR_ERR_INVALID_FRAME;
+        }
+
+        /* Slow data bytes, laid out as for gas_sensor_parse_frame() */
+        const std::uint8_t *s = &frame[GAS_SENSOR_OFFSET_SLOW];
+        switch (id) {
+            case 0x00:
+                if constexpr (has_on_insp<Sink>) {
+                    sink.on_insp(conc1(s[GAS_SENSOR_SLOW_CO2]), conc1(s[GAS_SENSOR_SLOW_N2O]),
+                                 conc1(s[GAS_SENSOR_SLOW_AA1]), conc1(s[GAS_SENSOR_SLOW_AA2]),
+                                 conc1(s[GAS_SENSOR_SLOW_O2]));
+                }
+                break;
+            case 0x01:
+                if constexpr (has_on_exp<Sink>) {
+                    sink.on_exp(conc1(s[GAS_SENSOR_SLOW_CO2]), conc1(s[GAS_SENSOR_SLOW_N2O]),
+                                 conc1(s[GAS_SENSOR_SLOW_AA1]), conc1(s[GAS_SENSOR_SLOW_AA2]),
+                                 conc1(s[GAS_SENSOR_SLOW_O2]));
+                }
+                break;
+            case 0x02:
+                if constexpr (has_on_mom<Sink>) {
+                    sink.on_mom(conc1(s[GAS_SENSOR_SLOW_CO2]), conc1(s[GAS_SENSOR_SLOW_N2O]),
+                                 conc1(s[GAS_SENSOR_SLOW_AA1]), conc1(s[GAS_SENSOR_SLOW_AA2]),
+                                 conc1(s[GAS_SENSOR_SLOW_O2]));
+                }
+                break;
+            case 0x03:
+                if constexpr (has_on_gen<Sink>) {
+                    std::uint16_t atm = be16(&s[GAS_SENSOR_SLOW_ATM_PRESSURE]);
+                    sink.on_gen(s[GAS_SENSOR_SLOW_RESP_RATE], s[GAS_SENSOR_SLOW_SINCE_BREATH],
+                                static_cast<gas_agent_id_t>(s[GAS_SENSOR_SLOW_PRIMARY_AGENT]),
+                                static_cast<gas_agent_id_t>(s[GAS_SENSOR_SLOW_SECONDARY_AGENT]),
+                                atm == 0xFFFF ? GAS_SENSOR_CONC_INVALID
+                                              : static_cast<float>(atm) / 10.0f);
+                }
+                break;
+            case 0x04:
+                if constexpr (has_on_sensor_regs<Sink>) {
+                    sink.on_sensor_regs(s[GAS_SENSOR_SLOW_MODE], s[GAS_SENSOR_SLOW_ERROR],
+                                        s[GAS_SENSOR_SLOW_ADAPTER], s[GAS_SENSOR_SLOW_DATA_VALID]);
+                }
+                break;
+            case 0x05:
+                if constexpr (has_on_config<Sink>) {
+                    sink.on_config(s[GAS_SENSOR_SLOW_CONFIG0], bcd(s[GAS_SENSOR_SLOW_HW_REV]),
+                                   static_cast<std::uint16_t>(bcd(s[GAS_SENSOR_SLOW_SW_REV]) * 100 +
+                                                              bcd(s[GAS_SENSOR_SLOW_SW_REV + 1])),
+                                   s[GAS_SENSOR_SLOW_CONFIG1],
+                                   static_cast<std::uint8_t>(bcd(s[GAS_SENSOR_SLOW_PROTOCOL_REV])));
+                }
+                break;
+            case 0x06:
+                if constexpr (has_on_service<Sink>) {
+                    sink.on_service(be16(&s[GAS_SENSOR_SLOW_SERIAL]), s[GAS_SENSOR_SLOW_SERVICE_STATUS]);
+                }
+                break;
+            default:
+                /* Reserved frame IDs - no data */
+                break;
+        }
+    }
+
+    return GAS_SENSOR_OK;
+}
+
+/* ============================================================================
+ * C Struct Sink
+ * ============================================================================ */
+
+/**
+ * Sink that fills the C output structs; any pointer may be null
+ */
+struct struct_sink {
+    gas_sensor_slow_data_t *slow_data;
+    gas_sensor_waveform_t *waveform;
+    gas_sensor_status_t *status;
+
+    void on_waveform(float co2, float n2o, float aa1, float aa2, float o2)
+    {
+        if (waveform != nullptr) {
+            *waveform = { co2, n2o, aa1, aa2, o2 };
+        }
+    }
+
+    void on_status(std::uint8_t sts)
+    {
+        if (status != nullptr) {
+            gas_sensor_decode_status(sts, status);
+        }
+    }
+
+    bool on_frame_id(std::uint8_t id)
+    {
+        if (slow_data == nullptr) {
+            return false;
+        }
+        if (id < GAS_SENSOR_FRAME_ID_MAX) {
+            slow_data->last_frame_id = id;
+        }
+        return true;
+    }
+
+    void on_insp(float co2, float n2o, float aa1, float aa2, float o2)
+    {
+        slow_data->insp_vals = { co2, n2o, aa1, aa2, o2 };
+    }
+
+    void on_exp(float co2, float n2o, float aa1, float aa2, float o2)
+    {
+        slow_data->exp_vals = { co2, n2o, aa1, aa2, o2 };
+    }
+
+    void on_mom(float co2, float n2o, float aa1, float aa2, float o2)
+    {
+        slow_data->mom_vals = { co2, n2o, aa1, aa2, o2 };
+    }
+
+    void on_gen(std::uint8_t resp_rate, std::uint8_t time_since_breath,
+                gas_agent_id_t primary, gas_agent_id_t secondary, float atm_pressure)
+    {
+        slow_data->gen_vals = { resp_rate, time_since_breath, primary, secondary, atm_pressure };
+    }
+
+    void on_sensor_regs(std::uint8_t mode, std::uint8_t error,
+                        std::uint8_t adapter, std::uint8_t valid)
+    {
+        gas_sensor_sensor_regs_t &r = slow_data->sensor_regs;
+        r.mode = static_cast<gas_sensor_mode_t>(mode & GAS_SENSOR_MODE_MASK);
+        r.error.sw_error = (error & 0x01) != 0;
+        r.error.hw_error = (error & 0x02) != 0;
+        r.error.motor_fail = (error & 0x04) != 0;
+        r.error.uncalibrated = (error & 0x08) != 0;
+        r.adapter.replace_adapter = (adapter & 0x01) != 0;
+        r.adapter.no_adapter = (adapter & 0x02) != 0;
+        r.adapter.o2_clogged = (adapter & 0x04) != 0;
+        r.data_valid.co2_out_of_range = (valid & 0x01) != 0;
+        r.data_valid.n2o_out_of_range = (valid & 0x02) != 0;
+        r.data_valid.agent_out_of_range = (valid & 0x04) != 0;
+        r.data_valid.o2_out_of_range = (valid & 0x08) != 0;
+        r.data_valid.temp_out_of_range = (valid & 0x10) != 0;
+        r.data_valid.pressure_out_of_range = (valid & 0x20) != 0;
+        r.data_valid.zero_calibration_required = (valid & 0x40) != 0;
+    }
+
+    void on_config(std::uint8_t fitted, std::uint16_t hw_revision, std::uint16_t sw_revision,
+                   std::uint8_t config1, std::uint8_t protocol_rev)
+    {
+        gas_sensor_config_data_t &c = slow_data->config_data;
+        c.o2_fitted = (fitted & 0x01) != 0;
+        c.co2_fitted = (fitted & 0x02) != 0;
+        c.n2o_fitted = (fitted & 0x04) != 0;
+        c.halothane_fitted = (fitted & 0x08) != 0;
+        c.enflurane_fitted = (fitted & 0x10) != 0;
+        c.isoflurane_fitted = (fitted & 0x20) != 0;
+        c.sevoflurane_fitted = (fitted & 0x40) != 0;
+        c.desflurane_fitted = (fitted & 0x80) != 0;
+        c.hw_revision = hw_revision;
+        c.sw_revision = sw_revision;
+        c.id_config = (config1 & 0x01) != 0;
+        c.comm_protocol_rev = protocol_rev;
+    }
+
+    void on_service(std::uint16_t serial_number, std::uint8_t service_status)
+    {
+        gas_sensor_service_data_t &s = slow_data->service_data;
+        s.serial_number = serial_number;
+        s.status.zero_disabled = (service_status & 0x01) != 0;
+        s.status.zero_in_progress = (service_status & 0x02) != 0;
+        s.status.span_calibration_error = (service_status & 0x04) != 0;
+        s.status.span_calibration_in_progress = (service_status & 0x08) != 0;
+    }
+};
+
+/**
+ * gas_sensor_parse_frame() as an instantiation of gas::decode()
+ */
+inline int parse_frame(const std::uint8_t *frame,
+                       gas_sensor_slow_data_t *slow_data,
+                       gas_sensor_waveform_t *waveform,
+                       gas_sensor_status_t *status)
+{
+    struct_sink sink{ slow_data, waveform, status };
+    return decode(frame, sink);
+}
+
+} // namespace gas
+
+#endif /* GAS_SENSOR_DECODER_HPP */
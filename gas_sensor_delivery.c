@@ -0,0 +1,464 @@
+/*
+ * Anesthetic Gas Sensor Delivery with Alarm Fast Lane - Implementation
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor_delivery.h"
+#include "gas_sensor_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#define CACHE_LINE              64
+#define SENSOR_TABLE_INITIAL    64
+
+/* ============================================================================
+ * SPSC Ring
+ * ============================================================================ */
+
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_size_t tail;        /* Written by producer */
+    _Alignas(CACHE_LINE) atomic_size_t head;        /* Written by consumer */
+    _Alignas(CACHE_LINE) size_t mask;
+    size_t elem_size;
+    uint8_t *slots;
+} ring_t;
+
+static size_t ring_slots(size_t capacity)
+{
+    size_t n = 1;
+    while (n < capacity) {
+        n <<= 1;
+    }
+    return n;
+}
+
+static int ring_init(ring_t *r, size_t capacity, size_t elem_size)
+{
+    size_t n = ring_slots(capacity);
+    r->slots = malloc(n * elem_size);
+    if (r->slots == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    r->mask = n - 1;
+    r->elem_size = elem_size;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    return GAS_SENSOR_OK;
+}
+
+static bool ring_push(ring_t *r, const void *elem)
+{
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&r->head, memory_order_acquire) > r->mask) {
+        return false;
+    }
+    memcpy(&r->slots[(tail & r->mask) * r->elem_size], elem, r->elem_size);
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+/* Pop up to max elements into out; returns the number popped */
+static size_t ring_pop(ring_t *r, void *out, size_t max)
+{
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t avail = atomic_load_explicit(&r->tail, memory_order_acquire) - head;
+    size_t n = (avail < max) ? avail : max;
+
+    for (size_t i = 0; i < n; i++) {
+        memcpy((uint8_t *)out + i * r->elem_size,
+               &r->slots[((head + i) & r->mask) * r->elem_size], r->elem_size);
+    }
+    atomic_store_explicit(&r->head, head + n, memory_order_release);
+    return n;
+}
+
+static size_t ring_count(ring_t *r)
+{
+    return atomic_load_explicit(&r->tail, memory_order_acquire) -
+           atomic_load_explicit(&r->head, memory_order_relaxed);
+}
+
+/* ============================================================================
+ * Delivery State
+ * ============================================================================ */
+
+/* Last alarm-relevant state of one sensor (producer only) */
+typedef struct {
+    uint32_t sensor_id;
+    bool used;
+    uint8_t status;                         /* Masked STS bits */
+    gas_sensor_sensor_regs_t regs;
+} sensor_state_t;
+
+struct gas_sensor_delivery {
+    gas_sensor_delivery_config_t config;
+    ring_t bulk;
+    ring_t alarm;
+    int bulk_fd;
+    int alarm_fd;
+
+    /* Producer-only state */
+    sensor_state_t *sensors;
+    size_t sensor_capacity;
+    size_t sensor_count;
+    size_t bulk_unsignaled;                 /* Frames queued since the last wakeup */
+    size_t mem_charged;                     /* Bytes charged to config.mem */
+
+    /* Written by the producer, read by stats */
+    atomic_uint_fast64_t frames;
+    atomic_uint_fast64_t bulk_dropped;
+    atomic_uint_fast64_t bulk_wakeups;
+    atomic_uint_fast64_t alarms;
+    atomic_uint_fast64_t alarm_dropped;
+};
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static uint64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static void counter_inc(atomic_uint_fast64_t *c)
+{
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+static void signal_fd(int fd)
+{
+    uint64_t one = 1;
+    ssize_t n;
+    do {
+        n = write(fd, &one, sizeof(one));
+    } while (n < 0 && errno == EINTR);
+}
+
+/**
+ * Wait for an eventfd and reset it
+ * Returns 1 if signaled, 0 on timeout, GAS_SENSOR_ERR_IO on failure.
+ */
+static int wait_fd(int fd, int timeout_ms)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+    int n = poll(&pfd, 1, timeout_ms);
+    if (n < 0) {
+        return (errno == EINTR) ? 0 : GAS_SENSOR_ERR_IO;
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    uint64_t value;
+    if (read(fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        return GAS_SENSOR_ERR_IO;
+    }
+    return 1;
+}
+
+GAS_SENSOR_ID_TABLE(sensor, sensor_state_t)
+
+/**
+ * Find or create a sensor's state; NULL if the table could not grow
+ */
+static sensor_state_t *sensor_lookup(struct gas_sensor_delivery *d, uint32_t sensor_id)
+{
+    size_t i = sensor_slot(d->sensors, d->sensor_capacity - 1, sensor_id);
+    if (d->sensors[i].used) {
+        return &d->sensors[i];
+    }
+
+    /* Keep the load factor at or below one half */
+    if ((d->sensor_count + 1) * 2 > d->sensor_capacity) {
+        size_t capacity = d->sensor_capacity * 2;
+        sensor_state_t *table = calloc(capacity, sizeof(*table));
+        if (table == NULL) {
+            return NULL;
+        }
+        for (size_t k = 0; k < d->sensor_capacity; k++) {
+            if (d->sensors[k].used) {
+                table[sensor_slot(table, capacity - 1, d->sensors[k].sensor_id)] = d->sensors[k];
+            }
+        }
+        free(d->sensors);
+        d->sensors = table;
+        gas_sensor_mem_force(d->config.mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE,
+                             (capacity - d->sensor_capacity) * sizeof(*table));
+        d->mem_charged += (capacity - d->sensor_capacity) * sizeof(*table);
+        d->sensor_capacity = capacity;
+        i = sensor_slot(table, capacity - 1, sensor_id);
+    }
+
+    d->sensors[i].used = true;
+    d->sensors[i].sensor_id = sensor_id;
+    d->sensor_count++;
+    return &d->sensors[i];
+}
+
+static bool regs_differ(const gas_sensor_sensor_regs_t *a, const gas_sensor_sensor_regs_t *b)
+{
+    return a->mode != b->mode ||
+           memcmp(&a->error, &b->error, sizeof(a->error)) != 0 ||
+           memcmp(&a->adapter, &b->adapter, sizeof(a->adapter)) != 0;
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+void gas_sensor_delivery_default_config(gas_sensor_delivery_config_t *config)
+{
+    if (config == NULL) {
+        return;
+    }
+
+    config->bulk_capacity = 4096;
+    config->bulk_batch = 256;
+    config->alarm_capacity = 256;
+    config->status_mask = GAS_SENSOR_STS_ALARM_MASK;
+    config->mem = NULL;
+}
+
+int gas_sensor_delivery_create(const gas_sensor_delivery_config_t *config,
+                               gas_sensor_delivery_t *delivery)
+{
+    if (delivery == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    gas_sensor_delivery_config_t cfg;
+    if (config != NULL) {
+        cfg = *config;
+    } else {
+        gas_sensor_delivery_default_config(&cfg);
+    }
+    if (cfg.bulk_capacity == 0 || cfg.alarm_capacity == 0 ||
+        cfg.bulk_batch == 0 || cfg.bulk_batch > cfg.bulk_capacity) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    struct gas_sensor_delivery *d = aligned_alloc(CACHE_LINE, sizeof(*d));
+    if (d == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    memset(d, 0, sizeof(*d));
+    d->config = cfg;
+    d->bulk_fd = -1;
+    d->alarm_fd = -1;
+
+    /* Alarm state is always granted; the bulk ring takes what is left */
+    d->sensor_capacity = SENSOR_TABLE_INITIAL;
+    d->mem_charged = d->sensor_capacity * sizeof(*d->sensors) +
+                     ring_slots(cfg.alarm_capacity) * sizeof(gas_sensor_alarm_t);
+    gas_sensor_mem_force(cfg.mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE, d->mem_charged);
+
+    size_t bulk = ring_slots(cfg.bulk_capacity);
+    while (gas_sensor_mem_charge(cfg.mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE,
+                                 bulk * sizeof(gas_sensor_delivery_item_t)) != GAS_SENSOR_OK) {
+        if (bulk / 2 < cfg.bulk_batch) {
+            gas_sensor_delivery_destroy(d);
+            return GAS_SENSOR_ERR_NO_SPACE;
+        }
+        bulk /= 2;
+    }
+    d->mem_charged += bulk * sizeof(gas_sensor_delivery_item_t);
+    d->config.bulk_capacity = bulk;
+
+    d->sensors = calloc(d->sensor_capacity, sizeof(*d->sensors));
+    if (d->sensors == NULL ||
+        ring_init(&d->bulk, bulk, sizeof(gas_sensor_delivery_item_t)) != GAS_SENSOR_OK ||
+        ring_init(&d->alarm, cfg.alarm_capacity, sizeof(gas_sensor_alarm_t)) != GAS_SENSOR_OK) {
+        gas_sensor_delivery_destroy(d);
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    d->bulk_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    d->alarm_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (d->bulk_fd < 0 || d->alarm_fd < 0) {
+        gas_sensor_delivery_destroy(d);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    *delivery = d;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_delivery_frame_handler(void *ctx, const gas_sensor_frame_event_t *event)
+{
+    struct gas_sensor_delivery *d = ctx;
+    if (d == NULL || event == NULL || event->frame == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    int result = GAS_SENSOR_OK;
+    gas_sensor_alarm_t alarm;
+    gas_sensor_delivery_item_t *item = &alarm.item;
+
+    item->sensor_id = event->sensor_id;
+    item->timestamp_us = event->timestamp_us;
+    memcpy(item->frame, event->frame, GAS_SENSOR_FRAME_SIZE);
+    counter_inc(&d->frames);
+
+    /* Alarm lane first: it must not wait behind anything */
+    sensor_state_t *state = sensor_lookup(d, event->sensor_id);
+    if (state != NULL) {
+        uint8_t status = event->frame[3];
+        uint8_t masked = status & d->config.status_mask;
+
+        alarm.status = status;
+        alarm.status_changed = masked ^ state->status;
+        alarm.regs_changed = false;
+        state->status = masked;
+
+        if (event->frame[2] == 0x04 && event->slow_data != NULL &&
+            regs_differ(&event->slow_data->sensor_regs, &state->regs)) {
+            state->regs = event->slow_data->sensor_regs;
+            alarm.regs_changed = true;
+        }
+        alarm.regs = state->regs;
+
+        if (alarm.status_changed != 0 || alarm.regs_changed) {
+            if (ring_push(&d->alarm, &alarm)) {
+                counter_inc(&d->alarms);
+                signal_fd(d->alarm_fd);
+            } else {
+                counter_inc(&d->alarm_dropped);
+                result = GAS_SENSOR_ERR_NO_SPACE;
+            }
+        }
+    }
+
+    /* Bulk lane: wake the consumer once per batch */
+    if (ring_push(&d->bulk, item)) {
+        if (++d->bulk_unsignaled >= d->config.bulk_batch) {
+            d->bulk_unsignaled = 0;
+            counter_inc(&d->bulk_wakeups);
+            signal_fd(d->bulk_fd);
+        }
+    } else {
+        counter_inc(&d->bulk_dropped);
+        result = GAS_SENSOR_ERR_NO_SPACE;
+    }
+    return result;
+}
+
+void gas_sensor_delivery_flush(gas_sensor_delivery_t delivery)
+{
+    if (delivery == NULL || delivery->bulk_unsignaled == 0) {
+        return;
+    }
+
+    delivery->bulk_unsignaled = 0;
+    counter_inc(&delivery->bulk_wakeups);
+    signal_fd(delivery->bulk_fd);
+}
+
+int gas_sensor_delivery_next_alarm(gas_sensor_delivery_t delivery,
+                                   gas_sensor_alarm_t *alarm,
+                                   int timeout_ms)
+{
+    if (delivery == NULL || alarm == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    uint64_t deadline = (timeout_ms > 0) ? monotonic_ms() + (uint64_t)timeout_ms : 0;
+
+    for (;;) {
+        if (ring_pop(&delivery->alarm, alarm, 1) == 1) {
+            return GAS_SENSOR_OK;
+        }
+
+        int wait = -1;
+        if (timeout_ms >= 0) {
+            uint64_t now = monotonic_ms();
+            if (timeout_ms == 0 || now >= deadline) {
+                return GAS_SENSOR_ERR_EOF;
+            }
+            wait = (int)(deadline - now);
+        }
+
+        int signaled = wait_fd(delivery->alarm_fd, wait);
+        if (signaled < 0) {
+            return signaled;
+        }
+    }
+}
+
+int gas_sensor_delivery_read_bulk(gas_sensor_delivery_t delivery,
+                                  gas_sensor_delivery_item_t *items,
+                                  size_t max,
+                                  int timeout_ms)
+{
+    if (delivery == NULL || items == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (ring_count(&delivery->bulk) < delivery->config.bulk_batch) {
+        int signaled = wait_fd(delivery->bulk_fd, timeout_ms);
+        if (signaled < 0) {
+            return signaled;
+        }
+    }
+
+    if (max > (size_t)INT32_MAX) {
+        max = (size_t)INT32_MAX;
+    }
+    return (int)ring_pop(&delivery->bulk, items, max);
+}
+
+int gas_sensor_delivery_alarm_fd(gas_sensor_delivery_t delivery)
+{
+    return (delivery != NULL) ? delivery->alarm_fd : -1;
+}
+
+int gas_sensor_delivery_bulk_fd(gas_sensor_delivery_t delivery)
+{
+    return (delivery != NULL) ? delivery->bulk_fd : -1;
+}
+
+int gas_sensor_delivery_stats(gas_sensor_delivery_t delivery,
+                              gas_sensor_delivery_stats_t *stats)
+{
+    if (delivery == NULL || stats == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    stats->frames = atomic_load_explicit(&delivery->frames, memory_order_relaxed);
+    stats->bulk_dropped = atomic_load_explicit(&delivery->bulk_dropped, memory_order_relaxed);
+    stats->bulk_wakeups = atomic_load_explicit(&delivery->bulk_wakeups, memory_order_relaxed);
+    stats->alarms = atomic_load_explicit(&delivery->alarms, memory_order_relaxed);
+    stats->alarm_dropped = atomic_load_explicit(&delivery->alarm_dropped, memory_order_relaxed);
+    stats->bulk_capacity = delivery->config.bulk_capacity;
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_delivery_destroy(gas_sensor_delivery_t delivery)
+{
+    if (delivery == NULL) {
+        return;
+    }
+
+    if (delivery->bulk_fd >= 0) {
+        close(delivery->bulk_fd);
+    }
+    if (delivery->alarm_fd >= 0) {
+        close(delivery->alarm_fd);
+    }
+    gas_sensor_mem_release(delivery->config.mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE,
+                           delivery->mem_charged);
+    free(delivery->bulk.slots);
+    free(delivery->alarm.slots);
+    free(delivery->sensors);
+    free(delivery);
+}
@@ -0,0 +1,172 @@
+/*
+ * Anesthetic Gas Sensor Delivery with Alarm Fast Lane
+ *
+ * Hands frames from the acquisition thread to consumer threads over two
+ * independent channels:
+ *
+ *   Bulk   Every frame. The bulk consumer is only woken once a batch has
+ *          accumulated (or its wait times out), so waveform traffic is
+ *          delivered in large, cheap batches.
+ *   Alarm  Only frames that changed something alarm-relevant: an STS bit
+ *          in the alarm mask, or the mode, error or adapter register of an
+ *          ID 0x04 frame. Each one wakes the alarm consumer immediately.
+ *
+ * The channels share nothing but the producer, so alarm latency does not
+ * depend on how much bulk data is queued. Both are lock-free SPSC rings:
+ * one producer thread (typically the session manager's poll thread) and
+ * one consumer thread per channel. Each channel exposes an eventfd for
+ * integration into an existing poll/epoll loop.
+ *
+ * With a memory ledger in the configuration, the rings and the alarm
+ * state are charged to it as GAS_SENSOR_MEM_QUEUE. Alarm memory is always
+ * granted; the bulk ring is halved until it fits the budget, down to one
+ * batch, so a tight budget costs bulk headroom rather than alarms.
+ *
+ * Linux only (eventfd).
+ */
+
+#ifndef GAS_SENSOR_DELIVERY_H
+#define GAS_SENSOR_DELIVERY_H
+
+#include "gas_sensor.h"
+#include "gas_sensor_mem.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_delivery *gas_sensor_delivery_t;
+
+typedef struct {
+    size_t bulk_capacity;           /* Bulk ring slots (rounded up to a power of two) */
+    size_t bulk_batch;              /* Frames that wake the bulk consumer */
+    size_t alarm_capacity;          /* Alarm ring slots */
+    uint8_t status_mask;            /* STS bits that are alarm-relevant */
+    gas_sensor_mem_t mem;           /* Ledger charged for the rings, or NULL */
+} gas_sensor_delivery_config_t;
+
+/* One delivered frame */
+typedef struct {
+    uint32_t sensor_id;
+    uint64_t timestamp_us;
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+} gas_sensor_delivery_item_t;
+
+/* One alarm-relevant change */
+typedef struct {
+    gas_sensor_delivery_item_t item;        /* Frame that carried the change */
+    uint8_t status;                         /* Current STS byte */
+    uint8_t status_changed;                 /* Alarm-mask STS bits that changed */
+    bool regs_changed;                      /* ID 0x04 mode/error/adapter changed */
+    gas_sensor_sensor_regs_t regs;          /* Latest sensor registers */
+} gas_sensor_alarm_t;
+
+typedef struct {
+    uint64_t frames;                /* Frames offered by the producer */
+    uint64_t bulk_dropped;          /* Frames lost to a full bulk ring */
+    uint64_t bulk_wakeups;          /* Bulk consumer wakeups signaled */
+    uint64_t alarms;                /* Alarm changes queued */
+    uint64_t alarm_dropped;         /* Alarm changes lost to a full alarm ring */
+    size_t bulk_capacity;           /* Bulk ring slots, after any memory budget */
+} gas_sensor_delivery_stats_t;
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Fill a configuration with defaults (4096-frame bulk ring, batches of
+ * 256, 256 alarm slots, GAS_SENSOR_STS_ALARM_MASK)
+ */
+void gas_sensor_delivery_default_config(gas_sensor_delivery_config_t *config);
+
+/**
+ * Create a delivery
+ *
+ * @param config: Configuration, or NULL for defaults
+ * @param delivery: Output parameter for the delivery handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM,
+ *          GAS_SENSOR_ERR_MEMORY, GAS_SENSOR_ERR_NO_SPACE (not even one
+ *          batch fits the memory budget), GAS_SENSOR_ERR_IO or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_delivery_create(const gas_sensor_delivery_config_t *config,
+                               gas_sensor_delivery_t *delivery);
+
+/**
+ * Producer: route one frame event
+ *
+ * Matches gas_sensor_frame_handler_t, so a delivery can be passed directly
+ * to gas_sensor_session_attach() as handler context.
+ *
+ * @param ctx: Delivery handle
+ * @param event: Frame event
+ * @return: GAS_SENSOR_OK, or GAS_SENSOR_ERR_NO_SPACE if a ring was full
+ */
+int gas_sensor_delivery_frame_handler(void *ctx, const gas_sensor_frame_event_t *event);
+
+/**
+ * Producer: wake the bulk consumer for a partial batch
+ */
+void gas_sensor_delivery_flush(gas_sensor_delivery_t delivery);
+
+/**
+ * Alarm consumer: take the next alarm change
+ *
+ * @param delivery: Delivery handle
+ * @param alarm: Output alarm
+ * @param timeout_ms: -1 waits forever, 0 polls
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_EOF on timeout, or GAS_SENSOR_ERR_IO
+ */
+int gas_sensor_delivery_next_alarm(gas_sensor_delivery_t delivery,
+                                   gas_sensor_alarm_t *alarm,
+                                   int timeout_ms);
+
+/**
+ * Bulk consumer: take up to max frames
+ *
+ * Waits until a full batch is queued, a flush was signaled, or the
+ * timeout expires, then returns whatever is available.
+ *
+ * @param delivery: Delivery handle
+ * @param items: Output array
+ * @param max: Capacity of items
+ * @param timeout_ms: -1 waits forever, 0 polls
+ * @return: Number of frames (0 on timeout), or GAS_SENSOR_ERR_IO
+ */
+int gas_sensor_delivery_read_bulk(gas_sensor_delivery_t delivery,
+                                  gas_sensor_delivery_item_t *items,
+                                  size_t max,
+                                  int timeout_ms);
+
+/**
+ * Get the eventfd that becomes readable when alarms are queued
+ */
+int gas_sensor_delivery_alarm_fd(gas_sensor_delivery_t delivery);
+
+/**
+ * Get the eventfd that becomes readable when a bulk batch is ready
+ */
+int gas_sensor_delivery_bulk_fd(gas_sensor_delivery_t delivery);
+
+/**
+ * Get delivery counters
+ */
+int gas_sensor_delivery_stats(gas_sensor_delivery_t delivery,
+                              gas_sensor_delivery_stats_t *stats);
+
+/**
+ * Free a delivery (no producer or consumer may be using it)
+ */
+void gas_sensor_delivery_destroy(gas_sensor_delivery_t delivery);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_DELIVERY_H */
@@ -0,0 +1,548 @@
+/*
+ * Anesthetic Gas Sensor Strand Executor - Implementation
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor_executor.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define STRAND_INITIAL_TASKS    16
+
+/* ============================================================================
+ * Internal Structures
+ * ============================================================================ */
+
+typedef struct {
+    gas_sensor_task_fn_t fn;                /* NULL for a frame task */
+    void *arg;
+    uint32_t sensor_id;
+    uint64_t timestamp_us;
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+} task_t;
+
+struct gas_sensor_strand {
+    struct gas_sensor_executor *ex;
+    struct gas_sensor_strand *next;         /* Run queue link while scheduled */
+    gas_sensor_frame_handler_t handler;
+    void *ctx;
+
+    gas_sensor_mem_t mem;                   /* Ledger charged at creation, or NULL */
+
+    pthread_mutex_t lock;                   /* Protects the task ring */
+    task_t *tasks;
+    size_t capacity;
+    size_t head;
+    size_t count;
+
+    atomic_bool scheduled;                  /* Queued on or running on a worker */
+    atomic_size_t pending;                  /* Posted but not yet run */
+
+    /* Only touched by the strand's own tasks */
+    gas_sensor_slow_data_t slow_data;
+    gas_sensor_waveform_t waveform;
+    gas_sensor_status_t status;
+};
+
+typedef struct {
+    struct gas_sensor_executor *ex;
+    unsigned index;
+    pthread_t thread;
+    bool running;
+
+    pthread_mutex_t lock;                   /* Protects the run queue */
+    struct gas_sensor_strand *first;
+    struct gas_sensor_strand *last;
+
+    atomic_uint_fast64_t tasks;
+    atomic_uint_fast64_t strand_runs;
+    atomic_uint_fast64_t steals;
+    atomic_uint_fast64_t sleeps;
+} worker_t;
+
+struct gas_sensor_executor {
+    worker_t *workers;
+    unsigned count;
+    atomic_uint next_worker;                /* Round-robin target for outside posts */
+    atomic_size_t queued;                   /* Strands in run queues */
+    atomic_size_t pending;                  /* Tasks posted, not yet run */
+    atomic_uint sleepers;                   /* Workers waiting on wake */
+    atomic_uint waiters;                    /* Threads waiting on drained */
+    atomic_bool stop;
+    _Atomic(gas_sensor_mem_t) mem;          /* Ledger for new strands */
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t drained;
+};
+
+static _Thread_local worker_t *current_worker;
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static void counter_inc(atomic_uint_fast64_t *c)
+{
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+static void notify_drained(struct gas_sensor_executor *ex)
+{
+    if (atomic_load(&ex->waiters) > 0) {
+        pthread_mutex_lock(&ex->lock);
+        pthread_cond_broadcast(&ex->drained);
+        pthread_mutex_unlock(&ex->lock);
+    }
+}
+
+/**
+ * Put a strand on a run queue: the posting worker's own queue when posted
+ * from the pool, otherwise the next worker round-robin
+ */
+static void schedule(struct gas_sensor_executor *ex, struct gas_sensor_strand *s)
+{
+    worker_t *w = current_worker;
+    if (w == NULL || w->ex != ex) {
+        w = &ex->workers[atomic_fetch_add_explicit(&ex->next_worker, 1,
+                                                   memory_order_relaxed) % ex->count];
+    }
+
+    atomic_fetch_add(&ex->queued, 1);
+
+    s->next = NULL;
+    pthread_mutex_lock(&w->lock);
+    if (w->last != NULL) {
+        w->last->next = s;
+    } else {
+        w->first = s;
+    }
+    w->last = s;
+    pthread_mutex_unlock(&w->lock);
+
+    if (atomic_load(&ex->sleepers) > 0) {
+        pthread_mutex_lock(&ex->lock);
+        pthread_cond_signal(&ex->wake);
+        pthread_mutex_unlock(&ex->lock);
+    }
+}
+
+static struct gas_sensor_strand *dequeue(worker_t *w)
+{
+    pthread_mutex_lock(&w->lock);
+    struct gas_sensor_strand *s = w->first;
+    if (s != NULL) {
+        w->first = s->next;
+        if (w->first == NULL) {
+            w->last = NULL;
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+    return s;
+}
+
+/**
+ * Take a runnable strand: own queue first, then steal
+ */
+static struct gas_sensor_strand *find_work(worker_t *w)
+{
+    struct gas_sensor_executor *ex = w->ex;
+    struct gas_sensor_strand *s = dequeue(w);
+
+    for (unsigned i = 1; s == NULL && i < ex->count; i++) {
+        s = dequeue(&ex->workers[(w->index + i) % ex->count]);
+        if (s != NULL) {
+            counter_inc(&w->steals);
+        }
+    }
+    if (s != NULL) {
+        atomic_fetch_sub(&ex->queued, 1);
+    }
+    return s;
+}
+
+static void run_task(worker_t *w, struct gas_sensor_strand *s, task_t *task)
+{
+    if (task->fn != NULL) {
+        task->fn(task->arg);
+    } else if (gas_sensor_parse_frame(task->frame, &s->slow_data,
+                                      &s->waveform, &s->status) == GAS_SENSOR_OK &&
+               s->handler != NULL) {
+        gas_sensor_frame_event_t event;
+        event.sensor_id = task->sensor_id;
+        event.timestamp_us = task->timestamp_us;
+        event.frame = task->frame;
+        event.slow_data = &s->slow_data;
+        event.waveform = &s->waveform;
+        event.status = &s->status;
+        s->handler(s->ctx, &event);
+    }
+    counter_inc(&w->tasks);
+}
+
+/**
+ * Run up to one batch of a strand's tasks, then release or requeue it
+ */
+static void run_strand(worker_t *w, struct gas_sensor_strand *s)
+{
+    struct gas_sensor_executor *ex = w->ex;
+    task_t task;
+
+    counter_inc(&w->strand_runs);
+
+    for (int n = 0; n < GAS_SENSOR_STRAND_BATCH; n++) {
+        pthread_mutex_lock(&s->lock);
+        if (s->count == 0) {
+            /*
+             * Release under the lock: a concurrent post either queued its
+             * task before this check or will see scheduled == false and
+             * reschedule. The strand is not touched after the unlock;
+             * gas_sensor_strand_destroy() waits for this release.
+             */
+            atomic_store(&s->scheduled, false);
+            pthread_mutex_unlock(&s->lock);
+            notify_drained(ex);
+            return;
+        }
+        task = s->tasks[s->head];
+        s->head = (s->head + 1) % s->capacity;
+        s->count--;
+        pthread_mutex_unlock(&s->lock);
+
+        run_task(w, s, &task);
+
+        /* A strand's waiter is woken by its release instead */
+        atomic_fetch_sub(&s->pending, 1);
+        if (atomic_fetch_sub(&ex->pending, 1) == 1) {
+            notify_drained(ex);
+        }
+    }
+
+    /* Batch used up: go to the back so other strands get a turn */
+    schedule(ex, s);
+}
+
+static void *worker_main(void *arg)
+{
+    worker_t *w = arg;
+    struct gas_sensor_executor *ex = w->ex;
+
+    current_worker = w;
+
+    for (;;) {
+        struct gas_sensor_strand *s = find_work(w);
+        if (s != NULL) {
+            run_strand(w, s);
+            continue;
+        }
+
+        pthread_mutex_lock(&ex->lock);
+        atomic_fetch_add(&ex->sleepers, 1);
+        while (atomic_load(&ex->queued) == 0 && !atomic_load(&ex->stop)) {
+            counter_inc(&w->sleeps);
+            pthread_cond_wait(&ex->wake, &ex->lock);
+        }
+        atomic_fetch_sub(&ex->sleepers, 1);
+        bool stop = atomic_load(&ex->stop) && atomic_load(&ex->queued) == 0;
+        pthread_mutex_unlock(&ex->lock);
+
+        if (stop) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static int strand_enqueue(struct gas_sensor_strand *s, const task_t *task)
+{
+    struct gas_sensor_executor *ex = s->ex;
+
+    /* Count first so a fast worker can never take pending below zero */
+    atomic_fetch_add(&s->pending, 1);
+    atomic_fetch_add(&ex->pending, 1);
+
+    pthread_mutex_lock(&s->lock);
+    if (s->count == GAS_SENSOR_STRAND_MAX_TASKS) {
+        pthread_mutex_unlock(&s->lock);
+        atomic_fetch_sub(&s->pending, 1);
+        atomic_fetch_sub(&ex->pending, 1);
+        notify_drained(ex);
+        return GAS_SENSOR_ERR_NO_SPACE;
+    }
+    if (s->count == s->capacity) {
+        size_t capacity = s->capacity * 2;
+        size_t grow = s->capacity * sizeof(*s->tasks);
+        int result = gas_sensor_mem_charge(s->mem, GAS_SENSOR_MEM_SHARED,
+                                           GAS_SENSOR_MEM_QUEUE, grow);
+        task_t *tasks = (result == GAS_SENSOR_OK) ? malloc(capacity * sizeof(*tasks)) : NULL;
+        if (tasks == NULL) {
+            if (result == GAS_SENSOR_OK) {
+                gas_sensor_mem_release(s->mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE, grow);
+                result = GAS_SENSOR_ERR_MEMORY;
+            }
+            pthread_mutex_unlock(&s->lock);
+            atomic_fetch_sub(&s->pending, 1);
+            atomic_fetch_sub(&ex->pending, 1);
+            notify_drained(ex);
+            return result;
+        }
+        for (size_t i = 0; i < s->count; i++) {
+            tasks[i] = s->tasks[(s->head + i) % s->capacity];
+        }
+        free(s->tasks);
+        s->tasks = tasks;
+        s->capacity = capacity;
+        s->head = 0;
+    }
+    s->tasks[(s->head + s->count) % s->capacity] = *task;
+    s->count++;
+    pthread_mutex_unlock(&s->lock);
+
+    if (!atomic_exchange(&s->scheduled, true)) {
+        schedule(ex, s);
+    }
+    return GAS_SENSOR_OK;
+}
+
+/* ============================================================================
+ * Executor
+ * ============================================================================ */
+
+int gas_sensor_executor_create(unsigned threads, gas_sensor_executor_t *executor)
+{
+    if (executor == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (threads == 0 || threads > GAS_SENSOR_EXECUTOR_MAX_THREADS) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    struct gas_sensor_executor *ex = calloc(1, sizeof(*ex));
+    if (ex == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    ex->workers = calloc(threads, sizeof(*ex->workers));
+    if (ex->workers == NULL) {
+        free(ex);
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    ex->count = threads;
+    atomic_init(&ex->next_worker, 0);
+    atomic_init(&ex->queued, 0);
+    atomic_init(&ex->pending, 0);
+    atomic_init(&ex->sleepers, 0);
+    atomic_init(&ex->waiters, 0);
+    atomic_init(&ex->stop, false);
+    atomic_init(&ex->mem, NULL);
+    pthread_mutex_init(&ex->lock, NULL);
+    pthread_cond_init(&ex->wake, NULL);
+    pthread_cond_init(&ex->drained, NULL);
+
+    for (unsigned i = 0; i < threads; i++) {
+        worker_t *w = &ex->workers[i];
+        w->ex = ex;
+        w->index = i;
+        pthread_mutex_init(&w->lock, NULL);
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        worker_t *w = &ex->workers[i];
+        if (pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+            gas_sensor_executor_destroy(ex);
+            return GAS_SENSOR_ERR_IO;
+        }
+        w->running = true;
+    }
+
+    *executor = ex;
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_executor_drain(gas_sensor_executor_t executor)
+{
+    if (executor == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&executor->lock);
+    atomic_fetch_add(&executor->waiters, 1);
+    while (atomic_load(&executor->pending) > 0) {
+        pthread_cond_wait(&executor->drained, &executor->lock);
+    }
+    atomic_fetch_sub(&executor->waiters, 1);
+    pthread_mutex_unlock(&executor->lock);
+}
+
+int gas_sensor_executor_set_mem(gas_sensor_executor_t executor, gas_sensor_mem_t mem)
+{
+    if (executor == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    atomic_store(&executor->mem, mem);
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_executor_stats(gas_sensor_executor_t executor,
+                              gas_sensor_executor_stats_t *stats)
+{
+    if (executor == NULL || stats == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    for (unsigned i = 0; i < executor->count; i++) {
+        worker_t *w = &executor->workers[i];
+        stats->tasks += atomic_load_explicit(&w->tasks, memory_order_relaxed);
+        stats->strand_runs += atomic_load_explicit(&w->strand_runs, memory_order_relaxed);
+        stats->steals += atomic_load_explicit(&w->steals, memory_order_relaxed);
+        stats->sleeps += atomic_load_explicit(&w->sleeps, memory_order_relaxed);
+    }
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_executor_destroy(gas_sensor_executor_t executor)
+{
+    if (executor == NULL) {
+        return;
+    }
+
+    gas_sensor_executor_drain(executor);
+
+    pthread_mutex_lock(&executor->lock);
+    atomic_store(&executor->stop, true);
+    pthread_cond_broadcast(&executor->wake);
+    pthread_mutex_unlock(&executor->lock);
+
+    for (unsigned i = 0; i < executor->count; i++) {
+        worker_t *w = &executor->workers[i];
+        if (w->running) {
+            pthread_join(w->thread, NULL);
+        }
+        pthread_mutex_destroy(&w->lock);
+    }
+
+    pthread_cond_destroy(&executor->drained);
+    pthread_cond_destroy(&executor->wake);
+    pthread_mutex_destroy(&executor->lock);
+    free(executor->workers);
+    free(executor);
+}
+
+/* ============================================================================
+ * Strands
+ * ============================================================================ */
+
+int gas_sensor_strand_create(gas_sensor_executor_t executor,
+                             gas_sensor_frame_handler_t handler,
+                             void *ctx,
+                             gas_sensor_strand_t *strand)
+{
+    if (executor == NULL || strand == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    gas_sensor_mem_t mem = atomic_load(&executor->mem);
+    size_t bytes = sizeof(struct gas_sensor_strand) + STRAND_INITIAL_TASKS * sizeof(task_t);
+    int result = gas_sensor_mem_charge(mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE, bytes);
+    if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+
+    struct gas_sensor_strand *s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        gas_sensor_mem_release(mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE, bytes);
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    s->tasks = malloc(STRAND_INITIAL_TASKS * sizeof(*s->tasks));
+    if (s->tasks == NULL) {
+        gas_sensor_mem_release(mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE, bytes);
+        free(s);
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    s->ex = executor;
+    s->mem = mem;
+    s->handler = handler;
+    s->ctx = ctx;
+    s->capacity = STRAND_INITIAL_TASKS;
+    pthread_mutex_init(&s->lock, NULL);
+    atomic_init(&s->scheduled, false);
+    atomic_init(&s->pending, 0);
+    gas_sensor_init_slow_data(&s->slow_data);
+
+    *strand = s;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_strand_post(gas_sensor_strand_t strand,
+                           gas_sensor_task_fn_t fn,
+                           void *arg)
+{
+    if (strand == NULL || fn == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    task_t task;
+    memset(&task, 0, sizeof(task));
+    task.fn = fn;
+    task.arg = arg;
+    return strand_enqueue(strand, &task);
+}
+
+int gas_sensor_strand_frame_handler(void *ctx, const gas_sensor_frame_event_t *event)
+{
+    struct gas_sensor_strand *s = ctx;
+    if (s == NULL || event == NULL || event->frame == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    task_t task;
+    task.fn = NULL;
+    task.arg = NULL;
+    task.sensor_id = event->sensor_id;
+    task.timestamp_us = event->timestamp_us;
+    memcpy(task.frame, event->frame, GAS_SENSOR_FRAME_SIZE);
+    return strand_enqueue(s, &task);
+}
+
+const gas_sensor_slow_data_t *gas_sensor_strand_slow_data(gas_sensor_strand_t strand)
+{
+    return (strand != NULL) ? &strand->slow_data : NULL;
+}
+
+void gas_sensor_strand_destroy(gas_sensor_strand_t strand)
+{
+    if (strand == NULL) {
+        return;
+    }
+
+    struct gas_sensor_executor *ex = strand->ex;
+
+    /*
+     * Wait until the last task ran and the worker let go of the strand.
+     * The worker clears scheduled before reading waiters, and this thread
+     * counts itself a waiter before reading scheduled, so one of the two
+     * always sees the other and the release cannot go unnoticed.
+     */
+    pthread_mutex_lock(&ex->lock);
+    atomic_fetch_add(&ex->waiters, 1);
+    while (atomic_load(&strand->pending) > 0 || atomic_load(&strand->scheduled)) {
+        pthread_cond_wait(&ex->drained, &ex->lock);
+    }
+    atomic_fetch_sub(&ex->waiters, 1);
+    pthread_mutex_unlock(&ex->lock);
+
+    /* The releasing worker may still be inside pthread_mutex_unlock() */
+    pthread_mutex_lock(&strand->lock);
+    pthread_mutex_unlock(&strand->lock);
+    pthread_mutex_destroy(&strand->lock);
+    gas_sensor_mem_release(strand->mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE,
+                           sizeof(*strand) + strand->capacity * sizeof(*strand->tasks));
+    free(strand->tasks);
+    free(strand);
+}
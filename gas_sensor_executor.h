@@ -0,0 +1,173 @@
+/*
+ * Anesthetic Gas Sensor Strand Executor
+ *
+ * Runs per-sensor work on a shared pool of threads. A strand is a serial
+ * queue: tasks posted to one strand run in posting order and never
+ * concurrently, while different strands run in parallel. Consumers can
+ * keep per-sensor state in the strand's context with no locks, without
+ * paying for a thread per sensor.
+ *
+ * A strand with queued tasks is scheduled on one worker at a time. Each
+ * worker has its own run queue; an idle worker steals runnable strands
+ * from the others, and a strand that has run a batch of tasks goes to
+ * the back of the queue so a busy sensor cannot starve the rest.
+ *
+ * gas_sensor_strand_frame_handler() matches gas_sensor_frame_handler_t:
+ * attach a session with a strand as context and every frame is copied,
+ * re-parsed on the pool against the strand's own slow data, and handed to
+ * the strand's handler in order.
+ *
+ * With a memory ledger set, each strand and its task ring are charged to
+ * it as shared GAS_SENSOR_MEM_QUEUE memory; a post that would grow the
+ * ring past a budget is refused. Without one, a strand whose tasks cannot
+ * keep up still stops at GAS_SENSOR_STRAND_MAX_TASKS.
+ *
+ * POSIX threads and C11 atomics.
+ */
+
+#ifndef GAS_SENSOR_EXECUTOR_H
+#define GAS_SENSOR_EXECUTOR_H
+
+#include "gas_sensor.h"
+#include "gas_sensor_mem.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_EXECUTOR_MAX_THREADS     256
+
+/* Tasks a strand runs before yielding its worker */
+#define GAS_SENSOR_STRAND_BATCH             32
+
+/* Tasks a strand can hold queued; further posts are refused */
+#define GAS_SENSOR_STRAND_MAX_TASKS         65536
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_executor *gas_sensor_executor_t;
+typedef struct gas_sensor_strand *gas_sensor_strand_t;
+
+/* Task function */
+typedef void (*gas_sensor_task_fn_t)(void *arg);
+
+typedef struct {
+    uint64_t tasks;                 /* Tasks executed */
+    uint64_t strand_runs;           /* Times a strand was given a worker */
+    uint64_t steals;                /* Strands taken from another worker */
+    uint64_t sleeps;                /* Times a worker went idle */
+} gas_sensor_executor_stats_t;
+
+/* ============================================================================
+ * Executor
+ * ============================================================================ */
+
+/**
+ * Create a pool
+ *
+ * @param threads: Worker threads, 1 to GAS_SENSOR_EXECUTOR_MAX_THREADS
+ * @param executor: Output parameter for the executor handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM,
+ *          GAS_SENSOR_ERR_MEMORY, GAS_SENSOR_ERR_IO or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_executor_create(unsigned threads, gas_sensor_executor_t *executor);
+
+/**
+ * Wait until every posted task has run
+ *
+ * Must not be called from a task.
+ */
+void gas_sensor_executor_drain(gas_sensor_executor_t executor);
+
+/**
+ * Set the memory ledger charged for strands created from now on
+ *
+ * Each strand is credited back to the ledger it was charged to.
+ *
+ * @param executor: Executor handle
+ * @param mem: Ledger, or NULL to stop accounting
+ * @return: GAS_SENSOR_OK or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_executor_set_mem(gas_sensor_executor_t executor, gas_sensor_mem_t mem);
+
+/**
+ * Get pool counters
+ */
+int gas_sensor_executor_stats(gas_sensor_executor_t executor,
+                              gas_sensor_executor_stats_t *stats);
+
+/**
+ * Drain, stop and join all workers, and free the pool
+ *
+ * Strands must be destroyed first.
+ */
+void gas_sensor_executor_destroy(gas_sensor_executor_t executor);
+
+/* ============================================================================
+ * Strands
+ * ============================================================================ */
+
+/**
+ * Create a strand
+ *
+ * @param executor: Pool the strand runs on
+ * @param handler: Frame handler for gas_sensor_strand_frame_handler()
+ *                 (may be NULL if only gas_sensor_strand_post() is used)
+ * @param ctx: Handler context, only ever used from this strand
+ * @param strand: Output parameter for the strand handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_MEMORY, GAS_SENSOR_ERR_NO_SPACE
+ *          (over a memory budget) or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_strand_create(gas_sensor_executor_t executor,
+                             gas_sensor_frame_handler_t handler,
+                             void *ctx,
+                             gas_sensor_strand_t *strand);
+
+/**
+ * Queue a task on a strand (any thread, including tasks)
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_MEMORY, GAS_SENSOR_ERR_NO_SPACE
+ *          (GAS_SENSOR_STRAND_MAX_TASKS already queued, or the ring could
+ *          not grow within the memory budget) or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_strand_post(gas_sensor_strand_t strand,
+                           gas_sensor_task_fn_t fn,
+                           void *arg);
+
+/**
+ * Queue a frame for the strand's handler
+ *
+ * Matches gas_sensor_frame_handler_t with the strand as context. Only the
+ * raw frame, sensor ID and timestamp are copied; the frame is parsed again
+ * on the pool into slow data owned by the strand.
+ *
+ * @return: As gas_sensor_strand_post()
+ */
+int gas_sensor_strand_frame_handler(void *ctx, const gas_sensor_frame_event_t *event);
+
+/**
+ * Get the strand's slow data
+ *
+ * Only safe from the strand's own tasks, or after the strand is idle.
+ */
+const gas_sensor_slow_data_t *gas_sensor_strand_slow_data(gas_sensor_strand_t strand);
+
+/**
+ * Wait for the strand's queued tasks, then free it
+ *
+ * No task may be posted to the strand concurrently or afterwards.
+ */
+void gas_sensor_strand_destroy(gas_sensor_strand_t strand);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_EXECUTOR_H */
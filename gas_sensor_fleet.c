@@ -0,0 +1,505 @@
+/*
+ * Anesthetic Gas Sensor Fleet Table - Implementation
+ *
+ * All columns of a table live in one allocation, each starting on its own
+ * cache line. Writers serialize on a mutex and make the sequence odd for
+ * the duration of an update; a snapshot copy is kept only if the sequence
+ * was even and unchanged across it.
+ */
+
+#include "gas_sensor_fleet.h"
+#include "gas_sensor_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define CACHE_LINE              64
+#define COLUMN_COUNT            (8 + 3 * GAS_SENSOR_CH_COUNT)
+
+/* Column storage shared by the live table and snapshots */
+typedef struct {
+    void *block;
+    uint8_t *active;
+    uint32_t *sensor_id;
+    uint64_t *timestamp_us;
+    uint8_t *status;
+    float *waveform[GAS_SENSOR_CH_COUNT];
+    float *et[GAS_SENSOR_CH_COUNT];
+    float *fi[GAS_SENSOR_CH_COUNT];
+    uint8_t *resp_rate;
+    uint8_t *primary_agent;
+    uint8_t *secondary_agent;
+    uint8_t *mode;
+} columns_t;
+
+typedef struct {
+    void **ptr;
+    size_t elem_size;
+} column_desc_t;
+
+typedef struct {
+    uint32_t sensor_id;
+    uint32_t slot;
+    bool used;
+} slot_entry_t;
+
+struct gas_sensor_fleet {
+    pthread_mutex_t lock;                   /* Serializes writers */
+    _Atomic uint64_t sequence;              /* Odd while a write is in progress */
+    atomic_size_t count;                    /* High-water mark of slots */
+    size_t capacity;
+    columns_t cols;
+
+    /* Writer-only: sensor ID -> slot, open addressing */
+    slot_entry_t *index;
+    size_t index_mask;
+
+    atomic_uint_fast64_t updates;
+    atomic_uint_fast64_t snapshots;
+    atomic_uint_fast64_t retries;
+    atomic_uint_fast64_t locked_snapshots;
+};
+
+struct gas_sensor_fleet_snapshot {
+    size_t capacity;
+    columns_t cols;
+    gas_sensor_fleet_columns_t view;
+};
+
+/* ============================================================================
+ * Helper Functions - Columns
+ * ============================================================================ */
+
+static size_t column_list(columns_t *c, column_desc_t *out)
+{
+    size_t n = 0;
+    out[n++] = (column_desc_t){ (void **)&c->active, sizeof(*c->active) };
+    out[n++] = (column_desc_t){ (void **)&c->sensor_id, sizeof(*c->sensor_id) };
+    out[n++] = (column_desc_t){ (void **)&c->timestamp_us, sizeof(*c->timestamp_us) };
+    out[n++] = (column_desc_t){ (void **)&c->status, sizeof(*c->status) };
+    for (int ch = 0; ch < GAS_SENSOR_CH_COUNT; ch++) {
+        out[n++] = (column_desc_t){ (void **)&c->waveform[ch], sizeof(float) };
+        out[n++] = (column_desc_t){ (void **)&c->et[ch], sizeof(float) };
+        out[n++] = (column_desc_t){ (void **)&c->fi[ch], sizeof(float) };
+    }
+    out[n++] = (column_desc_t){ (void **)&c->resp_rate, sizeof(*c->resp_rate) };
+    out[n++] = (column_desc_t){ (void **)&c->primary_agent, sizeof(*c->primary_agent) };
+    out[n++] = (column_desc_t){ (void **)&c->secondary_agent, sizeof(*c->secondary_agent) };
+    out[n++] = (column_desc_t){ (void **)&c->mode, sizeof(*c->mode) };
+    return n;
+}
+
+static size_t column_bytes(size_t capacity, size_t elem_size)
+{
+    return (capacity * elem_size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+}
+
+static int columns_alloc(columns_t *c, size_t capacity)
+{
+    column_desc_t desc[COLUMN_COUNT];
+    size_t n = column_list(c, desc);
+
+    size_t total = 0;
+    for (size_t i = 0; i < n; i++) {
+        total += column_bytes(capacity, desc[i].elem_size);
+    }
+
+    uint8_t *block = aligned_alloc(CACHE_LINE, total);
+    if (block == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    memset(block, 0, total);
+
+    c->block = block;
+    for (size_t i = 0; i < n; i++) {
+        *desc[i].ptr = block;
+        block += column_bytes(capacity, desc[i].elem_size);
+    }
+    return GAS_SENSOR_OK;
+}
+
+static void columns_copy(columns_t *dst, columns_t *src, size_t count)
+{
+    column_desc_t d[COLUMN_COUNT];
+    column_desc_t s[COLUMN_COUNT];
+    size_t n = column_list(dst, d);
+    column_list(src, s);
+
+    for (size_t i = 0; i < n; i++) {
+        memcpy(*d[i].ptr, *s[i].ptr, count * d[i].elem_size);
+    }
+}
+
+static void slot_reset(columns_t *c, size_t slot, uint32_t sensor_id)
+{
+    c->active[slot] = 1;
+    c->sensor_id[slot] = sensor_id;
+    c->timestamp_us[slot] = 0;
+    c->status[slot] = 0;
+    for (int ch = 0; ch < GAS_SENSOR_CH_COUNT; ch++) {
+        c->waveform[ch][slot] = GAS_SENSOR_CONC_INVALID;
+        c->et[ch][slot] = GAS_SENSOR_CONC_INVALID;
+        c->fi[ch][slot] = GAS_SENSOR_CONC_INVALID;
+    }
+    c->resp_rate[slot] = GAS_SENSOR_NO_DATA;
+    c->primary_agent[slot] = GAS_AGENT_NONE;
+    c->secondary_agent[slot] = GAS_AGENT_NONE;
+    c->mode[slot] = GAS_SENSOR_FLEET_MODE_UNKNOWN;
+}
+
+/* ============================================================================
+ * Helper Functions - Sequence and Index
+ * ============================================================================ */
+
+static void counter_inc(atomic_uint_fast64_t *c)
+{
+    atomic_fetch_add_explicit(c, 1, memory_order_relaxed);
+}
+
+static void write_begin(struct gas_sensor_fleet *f)
+{
+    uint64_t seq = atomic_load_explicit(&f->sequence, memory_order_relaxed);
+    atomic_store_explicit(&f->sequence, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void write_end(struct gas_sensor_fleet *f)
+{
+    uint64_t seq = atomic_load_explicit(&f->sequence, memory_order_relaxed);
+    atomic_store_explicit(&f->sequence, seq + 1, memory_order_release);
+}
+
+GAS_SENSOR_ID_TABLE(index, slot_entry_t)
+
+/* Find or assign a slot; caller holds the writer lock */
+static int slot_get(struct gas_sensor_fleet *f, uint32_t sensor_id, size_t *slot)
+{
+    size_t i = index_slot(f->index, f->index_mask, sensor_id);
+    if (f->index[i].used) {
+        *slot = f->index[i].slot;
+        return GAS_SENSOR_OK;
+    }
+
+    size_t count = atomic_load_explicit(&f->count, memory_order_relaxed);
+    size_t s = 0;
+    while (s < count && f->cols.active[s]) {
+        s++;
+    }
+    if (s == f->capacity) {
+        return GAS_SENSOR_ERR_NO_SPACE;
+    }
+
+    f->index[i].used = true;
+    f->index[i].sensor_id = sensor_id;
+    f->index[i].slot = (uint32_t)s;
+
+    write_begin(f);
+    slot_reset(&f->cols, s, sensor_id);
+    if (s == count) {
+        atomic_store_explicit(&f->count, count + 1, memory_order_relaxed);
+    }
+    write_end(f);
+
+    *slot = s;
+    return GAS_SENSOR_OK;
+}
+
+/* ============================================================================
+ * Fleet Table
+ * ============================================================================ */
+
+int gas_sensor_fleet_create(size_t capacity, gas_sensor_fleet_t *fleet)
+{
+    if (fleet == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (capacity == 0 || capacity > GAS_SENSOR_FLEET_MAX_SLOTS) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    struct gas_sensor_fleet *f = calloc(1, sizeof(*f));
+    if (f == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    /* Index at most half full */
+    size_t index_size = 1;
+    while (index_size < capacity * 2) {
+        index_size <<= 1;
+    }
+    f->index = calloc(index_size, sizeof(*f->index));
+    if (f->index == NULL || columns_alloc(&f->cols, capacity) != GAS_SENSOR_OK) {
+        free(f->index);
+        free(f);
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    f->index_mask = index_size - 1;
+    f->capacity = capacity;
+    atomic_init(&f->sequence, 0);
+    atomic_init(&f->count, 0);
+    atomic_init(&f->updates, 0);
+    atomic_init(&f->snapshots, 0);
+    atomic_init(&f->retries, 0);
+    atomic_init(&f->locked_snapshots, 0);
+    pthread_mutex_init(&f->lock, NULL);
+
+    *fleet = f;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_fleet_add(gas_sensor_fleet_t fleet, uint32_t sensor_id, size_t *slot)
+{
+    if (fleet == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    size_t s;
+    pthread_mutex_lock(&fleet->lock);
+    int result = slot_get(fleet, sensor_id, &s);
+    pthread_mutex_unlock(&fleet->lock);
+
+    if (result == GAS_SENSOR_OK && slot != NULL) {
+        *slot = s;
+    }
+    return result;
+}
+
+int gas_sensor_fleet_remove(gas_sensor_fleet_t fleet, uint32_t sensor_id)
+{
+    if (fleet == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    pthread_mutex_lock(&fleet->lock);
+    size_t i = index_slot(fleet->index, fleet->index_mask, sensor_id);
+    if (!fleet->index[i].used) {
+        pthread_mutex_unlock(&fleet->lock);
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    write_begin(fleet);
+    fleet->cols.active[fleet->index[i].slot] = 0;
+    write_end(fleet);
+
+    index_remove(fleet->index, fleet->index_mask, i);
+    pthread_mutex_unlock(&fleet->lock);
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_fleet_slot(gas_sensor_fleet_t fleet, uint32_t sensor_id, size_t *slot)
+{
+    if (fleet == NULL || slot == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    pthread_mutex_lock(&fleet->lock);
+    size_t i = index_slot(fleet->index, fleet->index_mask, sensor_id);
+    bool found = fleet->index[i].used;
+    if (found) {
+        *slot = fleet->index[i].slot;
+    }
+    pthread_mutex_unlock(&fleet->lock);
+
+    return found ? GAS_SENSOR_OK : GAS_SENSOR_ERR_INVALID_PARAM;
+}
+
+int gas_sensor_fleet_frame_handler(void *ctx, const gas_sensor_frame_event_t *event)
+{
+    struct gas_sensor_fleet *f = ctx;
+    if (f == NULL || event == NULL || event->frame == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    const uint8_t *frame = event->frame;
+    float wave[GAS_SENSOR_CH_COUNT];
+    if (event->waveform != NULL) {
+        wave[GAS_SENSOR_CH_CO2] = event->waveform->co2;
+        wave[GAS_SENSOR_CH_N2O] = event->waveform->n2o;
+        wave[GAS_SENSOR_CH_AA1] = event->waveform->aa1;
+        wave[GAS_SENSOR_CH_AA2] = event->waveform->aa2;
+        wave[GAS_SENSOR_CH_O2] = event->waveform->o2;
+    } else {
+        for (int ch = 0; ch < GAS_SENSOR_CH_COUNT; ch++) {
+            wave[ch] = gas_sensor_frame_waveform(frame, (gas_sensor_channel_t)ch);
+        }
+    }
+
+    pthread_mutex_lock(&f->lock);
+
+    size_t s;
+    int result = slot_get(f, event->sensor_id, &s);
+    if (result != GAS_SENSOR_OK) {
+        pthread_mutex_unlock(&f->lock);
+        return result;
+    }
+
+    columns_t *c = &f->cols;
+    const gas_sensor_slow_data_t *slow = event->slow_data;
+
+    write_begin(f);
+    c->timestamp_us[s] = event->timestamp_us;
+    c->status[s] = gas_sensor_frame_status(frame);
+    for (int ch = 0; ch < GAS_SENSOR_CH_COUNT; ch++) {
+        c->waveform[ch][s] = wave[ch];
+    }
+
+    if (slow != NULL) {
+        switch (gas_sensor_frame_id(frame)) {
+            case 0x00:
+                c->fi[GAS_SENSOR_CH_CO2][s] = slow->insp_vals.co2;
+                c->fi[GAS_SENSOR_CH_N2O][s] = slow->insp_vals.n2o;
+                c->fi[GAS_SENSOR_CH_AA1][s] = slow->insp_vals.aa1;
+                c->fi[GAS_SENSOR_CH_AA2][s] = slow->insp_vals.aa2;
+                c->fi[GAS_SENSOR_CH_O2][s] = slow->insp_vals.o2;
+                break;
+            case 0x01:
+                c->et[GAS_SENSOR_CH_CO2][s] = slow->exp_vals.co2;
+                c->et[GAS_SENSOR_CH_N2O][s] = slow->exp_vals.n2o;
+                c->et[GAS_SENSOR_CH_AA1][s] = slow->exp_vals.aa1;
+                c->et[GAS_SENSOR_CH_AA2][s] = slow->exp_vals.aa2;
+                c->et[GAS_SENSOR_CH_O2][s] = slow->exp_vals.o2;
+                break;
+            case 0x03:
+                c->resp_rate[s] = slow->gen_vals.resp_rate;
+                c->primary_agent[s] = (uint8_t)slow->gen_vals.primary_agent;
+                c->secondary_agent[s] = (uint8_t)slow->gen_vals.secondary_agent;
+                break;
+            case 0x04:
+                c->mode[s] = (uint8_t)slow->sensor_regs.mode;
+                break;
+            default:
+                break;
+        }
+    }
+    write_end(f);
+
+    pthread_mutex_unlock(&f->lock);
+    counter_inc(&f->updates);
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_fleet_stats(gas_sensor_fleet_t fleet, gas_sensor_fleet_stats_t *stats)
+{
+    if (fleet == NULL || stats == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    stats->updates = atomic_load_explicit(&fleet->updates, memory_order_relaxed);
+    stats->snapshots = atomic_load_explicit(&fleet->snapshots, memory_order_relaxed);
+    stats->retries = atomic_load_explicit(&fleet->retries, memory_order_relaxed);
+    stats->locked_snapshots = atomic_load_explicit(&fleet->locked_snapshots,
+                                                   memory_order_relaxed);
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_fleet_destroy(gas_sensor_fleet_t fleet)
+{
+    if (fleet == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&fleet->lock);
+    free(fleet->cols.block);
+    free(fleet->index);
+    free(fleet);
+}
+
+/* ============================================================================
+ * Snapshots
+ * ============================================================================ */
+
+int gas_sensor_fleet_snapshot_create(gas_sensor_fleet_t fleet,
+                                     gas_sensor_fleet_snapshot_t *snapshot)
+{
+    if (fleet == NULL || snapshot == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    struct gas_sensor_fleet_snapshot *snap = calloc(1, sizeof(*snap));
+    if (snap == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    if (columns_alloc(&snap->cols, fleet->capacity) != GAS_SENSOR_OK) {
+        free(snap);
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    snap->capacity = fleet->capacity;
+
+    columns_t *c = &snap->cols;
+    gas_sensor_fleet_columns_t *v = &snap->view;
+    v->active = c->active;
+    v->sensor_id = c->sensor_id;
+    v->timestamp_us = c->timestamp_us;
+    v->status = c->status;
+    for (int ch = 0; ch < GAS_SENSOR_CH_COUNT; ch++) {
+        v->waveform[ch] = c->waveform[ch];
+        v->et[ch] = c->et[ch];
+        v->fi[ch] = c->fi[ch];
+    }
+    v->resp_rate = c->resp_rate;
+    v->primary_agent = c->primary_agent;
+    v->secondary_agent = c->secondary_agent;
+    v->mode = c->mode;
+
+    *snapshot = snap;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_fleet_snapshot_take(gas_sensor_fleet_t fleet,
+                                   gas_sensor_fleet_snapshot_t snapshot)
+{
+    if (fleet == NULL || snapshot == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (snapshot->capacity < fleet->capacity) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    counter_inc(&fleet->snapshots);
+
+    for (int attempt = 0; attempt < GAS_SENSOR_FLEET_SNAPSHOT_RETRIES; attempt++) {
+        uint64_t before = atomic_load_explicit(&fleet->sequence, memory_order_acquire);
+        if ((before & 1) == 0) {
+            size_t count = atomic_load_explicit(&fleet->count, memory_order_relaxed);
+            columns_copy(&snapshot->cols, &fleet->cols, count);
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&fleet->sequence, memory_order_relaxed) == before) {
+                snapshot->view.count = count;
+                snapshot->view.epoch = before / 2;
+                return GAS_SENSOR_OK;
+            }
+        }
+        counter_inc(&fleet->retries);
+    }
+
+    /* Writers kept overlapping the copy: hold them off for one pass */
+    pthread_mutex_lock(&fleet->lock);
+    size_t count = atomic_load_explicit(&fleet->count, memory_order_relaxed);
+    columns_copy(&snapshot->cols, &fleet->cols, count);
+    snapshot->view.count = count;
+    snapshot->view.epoch = atomic_load_explicit(&fleet->sequence, memory_order_relaxed) / 2;
+    pthread_mutex_unlock(&fleet->lock);
+
+    counter_inc(&fleet->locked_snapshots);
+    return GAS_SENSOR_OK;
+}
+
+const gas_sensor_fleet_columns_t *gas_sensor_fleet_snapshot_columns(gas_sensor_fleet_snapshot_t snapshot)
+{
+    return (snapshot != NULL) ? &snapshot->view : NULL;
+}
+
+void gas_sensor_fleet_snapshot_destroy(gas_sensor_fleet_snapshot_t snapshot)
+{
+    if (snapshot == NULL) {
+        return;
+    }
+
+    free(snapshot->cols.block);
+    free(snapshot);
+}
@@ -0,0 +1,191 @@
+/*
+ * Anesthetic Gas Sensor Fleet Table
+ *
+ * Keeps the latest values of every sensor in one structure-of-arrays
+ * table: each field is a contiguous, cache-line aligned column indexed by
+ * slot. A dashboard that scans, sorts or filters the whole fleet walks a
+ * few dense arrays instead of chasing a pointer per session, and simple
+ * loops over a column vectorize.
+ *
+ * Writers (one or more acquisition threads) update a slot under a writer
+ * lock that also bumps a sequence counter, seqlock style. Readers copy the
+ * columns into a snapshot without taking the lock and retry if a write
+ * overlapped the copy, so every snapshot reflects one consistent epoch of
+ * the table and readers never delay acquisition.
+ *
+ * POSIX threads and C11 atomics.
+ */
+
+#ifndef GAS_SENSOR_FLEET_H
+#define GAS_SENSOR_FLEET_H
+
+#include "gas_sensor.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_FLEET_MAX_SLOTS          65536
+
+/* Lock-free copy attempts before a snapshot falls back to the writer lock */
+#define GAS_SENSOR_FLEET_SNAPSHOT_RETRIES   8
+
+/* Column values for slots with no data yet */
+#define GAS_SENSOR_FLEET_MODE_UNKNOWN       0xFF
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_fleet *gas_sensor_fleet_t;
+typedef struct gas_sensor_fleet_snapshot *gas_sensor_fleet_snapshot_t;
+
+/*
+ * Column view of a snapshot
+ *
+ * Every array has count entries, one per slot. Slots that were never used
+ * or were removed have active[slot] == 0; their other values are
+ * unspecified. Concentrations use GAS_SENSOR_CONC_INVALID for missing data.
+ */
+typedef struct {
+    size_t count;                                   /* Slots in use or freed (high-water mark) */
+    uint64_t epoch;                                 /* Table writes applied so far */
+    const uint8_t *active;                          /* 1 if the slot holds a sensor */
+    const uint32_t *sensor_id;
+    const uint64_t *timestamp_us;                   /* Receive time of the latest frame */
+    const uint8_t *status;                          /* Latest STS byte */
+    const float *waveform[GAS_SENSOR_CH_COUNT];     /* Latest waveform sample, by channel */
+    const float *et[GAS_SENSOR_CH_COUNT];           /* End-tidal (expiration) values */
+    const float *fi[GAS_SENSOR_CH_COUNT];           /* Inspired values */
+    const uint8_t *resp_rate;                       /* bpm, 0xFF = invalid */
+    const uint8_t *primary_agent;                   /* gas_agent_id_t */
+    const uint8_t *secondary_agent;                 /* gas_agent_id_t */
+    const uint8_t *mode;                            /* gas_sensor_mode_t or GAS_SENSOR_FLEET_MODE_UNKNOWN */
+} gas_sensor_fleet_columns_t;
+
+typedef struct {
+    uint64_t updates;               /* Frames applied */
+    uint64_t snapshots;             /* Snapshots taken */
+    uint64_t retries;               /* Lock-free copies discarded by a concurrent write */
+    uint64_t locked_snapshots;      /* Snapshots that fell back to the writer lock */
+} gas_sensor_fleet_stats_t;
+
+/* ============================================================================
+ * Fleet Table
+ * ============================================================================ */
+
+/**
+ * Create a fleet table
+ *
+ * @param capacity: Slots, 1 to GAS_SENSOR_FLEET_MAX_SLOTS
+ * @param fleet: Output parameter for the fleet handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM,
+ *          GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_fleet_create(size_t capacity, gas_sensor_fleet_t *fleet);
+
+/**
+ * Assign a slot to a sensor
+ *
+ * Returns the existing slot if the sensor already has one. The lowest free
+ * slot is used, so columns stay dense.
+ *
+ * @param fleet: Fleet handle
+ * @param sensor_id: Sensor identifier
+ * @param slot: Output slot index (may be NULL)
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NO_SPACE when every slot is taken,
+ *          or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_fleet_add(gas_sensor_fleet_t fleet, uint32_t sensor_id, size_t *slot);
+
+/**
+ * Release a sensor's slot
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM if the sensor has
+ *          no slot, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_fleet_remove(gas_sensor_fleet_t fleet, uint32_t sensor_id);
+
+/**
+ * Find a sensor's slot
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM if the sensor has
+ *          no slot, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_fleet_slot(gas_sensor_fleet_t fleet, uint32_t sensor_id, size_t *slot);
+
+/**
+ * Apply one frame event
+ *
+ * Matches gas_sensor_frame_handler_t, so a fleet can be passed directly to
+ * gas_sensor_session_attach() as handler context. Unknown sensors are
+ * given a slot on their first frame. Waveform, status and timestamp are
+ * written for every frame; Et, Fi, agents, respiratory rate and mode when
+ * the frame carries them.
+ *
+ * @param ctx: Fleet handle
+ * @param event: Frame event
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NO_SPACE when a new sensor finds
+ *          the table full, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_fleet_frame_handler(void *ctx, const gas_sensor_frame_event_t *event);
+
+/**
+ * Get fleet counters
+ */
+int gas_sensor_fleet_stats(gas_sensor_fleet_t fleet, gas_sensor_fleet_stats_t *stats);
+
+/**
+ * Free a fleet table (no writer may be using it; snapshots stay valid)
+ */
+void gas_sensor_fleet_destroy(gas_sensor_fleet_t fleet);
+
+/* ============================================================================
+ * Snapshots
+ * ============================================================================ */
+
+/**
+ * Allocate snapshot storage sized for a fleet
+ *
+ * @param fleet: Fleet the snapshot will be taken from
+ * @param snapshot: Output parameter for the snapshot handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_fleet_snapshot_create(gas_sensor_fleet_t fleet,
+                                     gas_sensor_fleet_snapshot_t *snapshot);
+
+/**
+ * Copy the current table into a snapshot
+ *
+ * The copy is consistent: it reflects the table between two updates, never
+ * part of one. Only the high-water mark of slots is copied.
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM if the snapshot was
+ *          created for a smaller fleet, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_fleet_snapshot_take(gas_sensor_fleet_t fleet,
+                                   gas_sensor_fleet_snapshot_t snapshot);
+
+/**
+ * Get the columns of the last snapshot taken
+ *
+ * The pointers stay valid until the snapshot is destroyed; their contents
+ * change with the next gas_sensor_fleet_snapshot_take().
+ */
+const gas_sensor_fleet_columns_t *gas_sensor_fleet_snapshot_columns(gas_sensor_fleet_snapshot_t snapshot);
+
+/**
+ * Free a snapshot
+ */
+void gas_sensor_fleet_snapshot_destroy(gas_sensor_fleet_snapshot_t snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_FLEET_H */
@@ -0,0 +1,247 @@
+/*
+ * Anesthetic Gas Sensor Frame Formats - Implementation
+ */
+
+#include "gas_sensor_format.h"
+#include <string.h>
+
+static const gas_sensor_field_t phasein_fields[] = {
+    GAS_SENSOR_PHASEIN_FIELDS
+};
+
+const gas_sensor_format_t gas_sensor_format_phasein =
+    GAS_SENSOR_PHASEIN_FORMAT("phasein", phasein_fields,
+                              sizeof(phasein_fields) / sizeof(phasein_fields[0]));
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static uint16_t load_be16(const uint8_t *data)
+{
+    return (uint16_t)((data[0] << 8) | data[1]);
+}
+
+static uint8_t bcd(uint8_t value)
+{
+    return (uint8_t)((value >> 4) * 10 + (value & 0x0F));
+}
+
+/* Frame bytes read by a field */
+static size_t field_src_size(uint8_t kind)
+{
+    return (kind == GAS_SENSOR_FIELD_CONC16 || kind == GAS_SENSOR_FIELD_U16 ||
+            kind == GAS_SENSOR_FIELD_BCD16 || kind == GAS_SENSOR_FIELD_PRESSURE16) ? 2 : 1;
+}
+
+/* Bytes written by a field, 0 for an unknown kind */
+static size_t field_dest_size(uint8_t kind)
+{
+    switch (kind) {
+        case GAS_SENSOR_FIELD_CONC8:
+        case GAS_SENSOR_FIELD_CONC16:
+        case GAS_SENSOR_FIELD_PRESSURE16:
+            return sizeof(float);
+        case GAS_SENSOR_FIELD_U8:
+        case GAS_SENSOR_FIELD_BCD8:
+            return sizeof(uint8_t);
+        case GAS_SENSOR_FIELD_U16:
+        case GAS_SENSOR_FIELD_BCD8_U16:
+        case GAS_SENSOR_FIELD_BCD16:
+            return sizeof(uint16_t);
+        case GAS_SENSOR_FIELD_ENUM8:
+            return sizeof(gas_sensor_mode_t);
+        case GAS_SENSOR_FIELD_BIT:
+            return sizeof(bool);
+        default:
+            return 0;
+    }
+}
+
+static float conc8(uint8_t raw)
+{
+    return (raw == GAS_SENSOR_NO_DATA) ? GAS_SENSOR_CONC_INVALID : (float)raw / 10.0f;
+}
+
+static float conc16(uint16_t raw)
+{
+    return (raw == 0xFFFF) ? GAS_SENSOR_CONC_INVALID : (float)raw / 100.0f;
+}
+
+static float pressure16(uint16_t raw)
+{
+    return (raw == 0xFFFF) ? GAS_SENSOR_CONC_INVALID : (float)raw / 10.0f;
+}
+
+static void decode_field(const gas_sensor_field_t *field,
+                         const uint8_t *frame_data,
+                         gas_sensor_slow_data_t *slow_data)
+{
+    const uint8_t *src = &frame_data[field->offset];
+    uint8_t *dst = (uint8_t *)slow_data + field->dest;
+
+    switch (field->kind) {
+        case GAS_SENSOR_FIELD_CONC8: {
+            float v = conc8(src[0]);
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case GAS_SENSOR_FIELD_CONC16: {
+            float v = conc16(load_be16(src));
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case GAS_SENSOR_FIELD_PRESSURE16: {
+            float v = pressure16(load_be16(src));
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case GAS_SENSOR_FIELD_U8:
+            *dst = src[0] & field->mask;
+            break;
+        case GAS_SENSOR_FIELD_U16: {
+            uint16_t v = load_be16(src);
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case GAS_SENSOR_FIELD_ENUM8: {
+            gas_sensor_mode_t v = (gas_sensor_mode_t)(src[0] & field->mask);
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case GAS_SENSOR_FIELD_BIT: {
+            bool v = (src[0] & field->mask) != 0;
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case GAS_SENSOR_FIELD_BCD8:
+            *dst = bcd(src[0]);
+            break;
+        case GAS_SENSOR_FIELD_BCD8_U16: {
+            uint16_t v = bcd(src[0]);
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        case GAS_SENSOR_FIELD_BCD16: {
+            uint16_t v = (uint16_t)(bcd(src[0]) * 100 + bcd(src[1]));
+            memcpy(dst, &v, sizeof(v));
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+int gas_sensor_format_validate(const gas_sensor_format_t *format)
+{
+    if (format == NULL || (format->fields == NULL && format->field_count > 0)) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    size_t size = format->size;
+    if (size < 4 || size > GAS_SENSOR_FORMAT_MAX_SIZE ||
+        format->id_count == 0 || format->id_count > GAS_SENSOR_FORMAT_MAX_IDS ||
+        format->id_offset >= size || format->status_offset >= size ||
+        (size_t)format->waveform_offset + GAS_SENSOR_FORMAT_WAVEFORM_SIZE > size ||
+        format->checksum > GAS_SENSOR_CHECKSUM_XOR8) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    if (format->checksum != GAS_SENSOR_CHECKSUM_NONE &&
+        (format->checksum_at >= size || format->checksum_from > format->checksum_at)) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    for (size_t i = 0; i < format->field_count; i++) {
+        const gas_sensor_field_t *f = &format->fields[i];
+        size_t dest_size = field_dest_size(f->kind);
+        if (dest_size == 0 || f->frame_id >= format->id_count ||
+            f->offset + field_src_size(f->kind) > size ||
+            f->dest + dest_size > sizeof(gas_sensor_slow_data_t) ||
+            f->dest % dest_size != 0) {
+            return GAS_SENSOR_ERR_INVALID_PARAM;
+        }
+    }
+
+    return GAS_SENSOR_OK;
+}
+
+bool gas_sensor_format_check(const gas_sensor_format_t *format, const uint8_t *frame_data)
+{
+    if (frame_data[0] != format->sync[0] || frame_data[1] != format->sync[1]) {
+        return false;
+    }
+
+    uint8_t acc = 0;
+    switch (format->checksum) {
+        case GAS_SENSOR_CHECKSUM_TWOS_COMPLEMENT:
+        case GAS_SENSOR_CHECKSUM_SUM8:
+            for (size_t i = format->checksum_from; i < format->checksum_at; i++) {
+                acc = (uint8_t)(acc + frame_data[i]);
+            }
+            break;
+        case GAS_SENSOR_CHECKSUM_XOR8:
+            for (size_t i = format->checksum_from; i < format->checksum_at; i++) {
+                acc ^= frame_data[i];
+            }
+            break;
+        default:
+            return true;
+    }
+
+    if (format->checksum == GAS_SENSOR_CHECKSUM_TWOS_COMPLEMENT) {
+        acc = (uint8_t)-acc;
+    }
+    return acc == frame_data[format->checksum_at];
+}
+
+int gas_sensor_format_decode(const gas_sensor_format_t *format,
+                             const uint8_t *frame_data,
+                             gas_sensor_slow_data_t *slow_data,
+                             gas_sensor_waveform_t *waveform,
+                             gas_sensor_status_t *status)
+{
+    if (format == NULL || frame_data == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (frame_data[0] != format->sync[0] || frame_data[1] != format->sync[1]) {
+        return GAS_SENSOR_ERR_INVALID_FRAME;
+    }
+    if (!gas_sensor_format_check(format, frame_data)) {
+        return GAS_SENSOR_ERR_CHECKSUM;
+    }
+
+    if (waveform != NULL) {
+        const uint8_t *w = &frame_data[format->waveform_offset];
+        waveform->co2 = conc16(load_be16(&w[0]));
+        waveform->n2o = conc16(load_be16(&w[2]));
+        waveform->aa1 = conc16(load_be16(&w[4]));
+        waveform->aa2 = conc16(load_be16(&w[6]));
+        waveform->o2 = conc16(load_be16(&w[8]));
+    }
+
+    if (status != NULL) {
+        gas_sensor_decode_status(frame_data[format->status_offset], status);
+    }
+
+    if (slow_data != NULL) {
+        uint8_t frame_id = frame_data[format->id_offset];
+        if (frame_id >= format->id_count) {
+            return GAS_SENSOR_ERR_INVALID_FRAME;
+        }
+
+        slow_data->last_frame_id = frame_id;
+        for (size_t i = 0; i < format->field_count; i++) {
+            if (format->fields[i].frame_id == frame_id) {
+                decode_field(&format->fields[i], frame_data, slow_data);
+            }
+        }
+    }
+
+    return GAS_SENSOR_OK;
+}
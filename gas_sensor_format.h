@@ -0,0 +1,209 @@
+/*
+ * Anesthetic Gas Sensor Frame Formats
+ *
+ * Phasein-compatible sensor models share the framing idea (sync bytes,
+ * frame ID, STS byte, five waveform words, a rotating slow data payload,
+ * checksum) but differ in details such as where a slow data field sits.
+ * A gas_sensor_format_t describes one such layout declaratively:
+ *
+ *   - sync bytes, frame size, frame ID count
+ *   - offsets of the frame ID, the STS byte and the waveform words
+ *   - checksum algorithm, the bytes it covers and where it is stored
+ *   - a field map: for each frame ID, which bytes decode how into which
+ *     member of gas_sensor_slow_data_t
+ *
+ * gas_sensor_format_phasein describes the built-in layout; every field is
+ * decoded exactly as gas_sensor_parse_frame() does. A new variant is a
+ * copy of GAS_SENSOR_PHASEIN_FIELDS with the differing entries changed.
+ *
+ * gas_sensor_format_decode() interprets a descriptor frame by frame and is
+ * meant for tools and tests. For live decoding, gas_sensor_format.hpp
+ * compiles a descriptor into a decoder with the gas_sensor_decoder_fn
+ * signature, which gas_sensor_session_set_format() installs on a session;
+ * the stream synchronizer then frames by the descriptor as well. Nothing
+ * is looked up per frame once the format is set.
+ */
+
+#ifndef GAS_SENSOR_FORMAT_H
+#define GAS_SENSOR_FORMAT_H
+
+#include "gas_sensor.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_FORMAT_MAX_SIZE      64      /* Largest frame a format may describe */
+#define GAS_SENSOR_FORMAT_MAX_IDS       16      /* Frame IDs per format (cycle bitmap) */
+#define GAS_SENSOR_FORMAT_WAVEFORM_SIZE 10      /* Five big-endian words */
+
+/* Checksum algorithms; the checksum covers bytes [checksum_from, checksum_at) */
+typedef enum {
+    GAS_SENSOR_CHECKSUM_NONE = 0,
+    GAS_SENSOR_CHECKSUM_TWOS_COMPLEMENT = 1,    /* -(sum) mod 256 (Phasein) */
+    GAS_SENSOR_CHECKSUM_SUM8 = 2,               /* sum mod 256 */
+    GAS_SENSOR_CHECKSUM_XOR8 = 3                /* XOR of the bytes */
+} gas_sensor_checksum_alg_t;
+
+/* Field encodings; each implies the type of the destination member */
+typedef enum {
+    GAS_SENSOR_FIELD_CONC8 = 0,     /* u8, value * 10, 0xFF invalid -> float */
+    GAS_SENSOR_FIELD_CONC16 = 1,    /* BE u16, value * 100, 0xFFFF invalid -> float */
+    GAS_SENSOR_FIELD_U8 = 2,        /* u8 & mask -> uint8_t */
+    GAS_SENSOR_FIELD_U16 = 3,       /* BE u16 -> uint16_t */
+    GAS_SENSOR_FIELD_ENUM8 = 4,     /* u8 & mask -> enum (gas_agent_id_t, gas_sensor_mode_t) */
+    GAS_SENSOR_FIELD_BIT = 5,       /* (u8 & mask) != 0 -> bool */
+    GAS_SENSOR_FIELD_BCD8 = 6,      /* Two BCD digits -> uint8_t */
+    GAS_SENSOR_FIELD_BCD8_U16 = 7,  /* Two BCD digits -> uint16_t */
+    GAS_SENSOR_FIELD_BCD16 = 8,     /* Four BCD digits, high byte first -> uint16_t */
+    GAS_SENSOR_FIELD_PRESSURE16 = 9 /* BE u16, kPa * 10, 0xFFFF invalid -> float */
+} gas_sensor_field_kind_t;
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+/* One slow data field */
+typedef struct {
+    uint8_t frame_id;               /* Frame ID carrying the field */
+    uint8_t offset;                 /* First frame byte */
+    uint8_t kind;                   /* gas_sensor_field_kind_t */
+    uint8_t mask;                   /* U8, ENUM8, BIT: bits of the byte used */
+    uint16_t dest;                  /* offsetof() the member in gas_sensor_slow_data_t */
+} gas_sensor_field_t;
+
+/* Frame format descriptor */
+typedef struct {
+    const char *name;
+    uint8_t sync[2];                /* First two bytes of every frame */
+    uint8_t size;                   /* Frame size in bytes */
+    uint8_t id_count;               /* Frame IDs are 0 to id_count - 1 */
+    uint8_t id_offset;              /* Frame ID byte */
+    uint8_t status_offset;          /* STS byte, decoded as in gas_sensor_decode_status() */
+    uint8_t waveform_offset;        /* CO2, N2O, AA1, AA2, O2 words (% * 100, 0xFFFF invalid) */
+    uint8_t checksum;               /* gas_sensor_checksum_alg_t */
+    uint8_t checksum_from;          /* First byte covered */
+    uint8_t checksum_at;            /* Checksum byte; covers up to the byte before */
+    const gas_sensor_field_t *fields;
+    size_t field_count;
+} gas_sensor_format_t;
+
+/* Field map entry initializer */
+#define GAS_SENSOR_FIELD(id, off, kind, mask, member) \
+    { (id), (off), (kind), (mask), (uint16_t)offsetof(gas_sensor_slow_data_t, member) }
+
+/*
+ * Field map of the built-in layout, for initializing gas_sensor_field_t
+ * arrays. Slow data is read from bytes 14-19, as by the parser.
+ */
+#define GAS_SENSOR_PHASEIN_CONC_FIELDS(id, group) \
+    GAS_SENSOR_FIELD(id, 14, GAS_SENSOR_FIELD_CONC8, 0xFF, group.co2), \
+    GAS_SENSOR_FIELD(id, 15, GAS_SENSOR_FIELD_CONC8, 0xFF, group.n2o), \
+    GAS_SENSOR_FIELD(id, 16, GAS_SENSOR_FIELD_CONC8, 0xFF, group.aa1), \
+    GAS_SENSOR_FIELD(id, 17, GAS_SENSOR_FIELD_CONC8, 0xFF, group.aa2), \
+    GAS_SENSOR_FIELD(id, 18, GAS_SENSOR_FIELD_CONC8, 0xFF, group.o2)
+
+#define GAS_SENSOR_PHASEIN_FIELDS \
+    GAS_SENSOR_PHASEIN_CONC_FIELDS(0, insp_vals), \
+    GAS_SENSOR_PHASEIN_CONC_FIELDS(1, exp_vals), \
+    GAS_SENSOR_PHASEIN_CONC_FIELDS(2, mom_vals), \
+    GAS_SENSOR_FIELD(3, 14, GAS_SENSOR_FIELD_U8, 0xFF, gen_vals.resp_rate), \
+    GAS_SENSOR_FIELD(3, 15, GAS_SENSOR_FIELD_U8, 0xFF, gen_vals.time_since_breath), \
+    GAS_SENSOR_FIELD(3, 16, GAS_SENSOR_FIELD_ENUM8, 0xFF, gen_vals.primary_agent), \
+    GAS_SENSOR_FIELD(3, 17, GAS_SENSOR_FIELD_ENUM8, 0xFF, gen_vals.secondary_agent), \
+    GAS_SENSOR_FIELD(3, 18, GAS_SENSOR_FIELD_PRESSURE16, 0xFF, gen_vals.atm_pressure), \
+    GAS_SENSOR_FIELD(4, 14, GAS_SENSOR_FIELD_ENUM8, GAS_SENSOR_MODE_MASK, sensor_regs.mode), \
+    GAS_SENSOR_FIELD(4, 16, GAS_SENSOR_FIELD_BIT, 0x01, sensor_regs.error.sw_error), \
+    GAS_SENSOR_FIELD(4, 16, GAS_SENSOR_FIELD_BIT, 0x02, sensor_regs.error.hw_error), \
+    GAS_SENSOR_FIELD(4, 16, GAS_SENSOR_FIELD_BIT, 0x04, sensor_regs.error.motor_fail), \
+    GAS_SENSOR_FIELD(4, 16, GAS_SENSOR_FIELD_BIT, 0x08, sensor_regs.error.uncalibrated), \
+    GAS_SENSOR_FIELD(4, 17, GAS_SENSOR_FIELD_BIT, 0x01, sensor_regs.adapter.replace_adapter), \
+    GAS_SENSOR_FIELD(4, 17, GAS_SENSOR_FIELD_BIT, 0x02, sensor_regs.adapter.no_adapter), \
+    GAS_SENSOR_FIELD(4, 17, GAS_SENSOR_FIELD_BIT, 0x04, sensor_regs.adapter.o2_clogged), \
+    GAS_SENSOR_FIELD(4, 18, GAS_SENSOR_FIELD_BIT, 0x01, sensor_regs.data_valid.co2_out_of_range), \
+    GAS_SENSOR_FIELD(4, 18, GAS_SENSOR_FIELD_BIT, 0x02, sensor_regs.data_valid.n2o_out_of_range), \
+    GAS_SENSOR_FIELD(4, 18, GAS_SENSOR_FIELD_BIT, 0x04, sensor_regs.data_valid.agent_out_of_range), \
+    GAS_SENSOR_FIELD(4, 18, GAS_SENSOR_FIELD_BIT, 0x08, sensor_regs.data_valid.o2_out_of_range), \
+    GAS_SENSOR_FIELD(4, 18, GAS_SENSOR_FIELD_BIT, 0x10, sensor_regs.data_valid.temp_out_of_range), \
+    GAS_SENSOR_FIELD(4, 18, GAS_SENSOR_FIELD_BIT, 0x20, sensor_regs.data_valid.pressure_out_of_range), \
+    GAS_SENSOR_FIELD(4, 18, GAS_SENSOR_FIELD_BIT, 0x40, sensor_regs.data_valid.zero_calibration_required), \
+    GAS_SENSOR_FIELD(5, 14, GAS_SENSOR_FIELD_BIT, 0x01, config_data.o2_fitted), \
+    GAS_SENSOR_FIELD(5, 14, GAS_SENSOR_FIELD_BIT, 0x02, config_data.co2_fitted), \
+    GAS_SENSOR_FIELD(5, 14, GAS_SENSOR_FIELD_BIT, 0x04, config_data.n2o_fitted), \
+    GAS_SENSOR_FIELD(5, 14, GAS_SENSOR_FIELD_BIT, 0x08, config_data.halothane_fitted), \
+    GAS_SENSOR_FIELD(5, 14, GAS_SENSOR_FIELD_BIT, 0x10, config_data.enflurane_fitted), \
+    GAS_SENSOR_FIELD(5, 14, GAS_SENSOR_FIELD_BIT, 0x20, config_data.isoflurane_fitted), \
+    GAS_SENSOR_FIELD(5, 14, GAS_SENSOR_FIELD_BIT, 0x40, config_data.sevoflurane_fitted), \
+    GAS_SENSOR_FIELD(5, 14, GAS_SENSOR_FIELD_BIT, 0x80, config_data.desflurane_fitted), \
+    GAS_SENSOR_FIELD(5, 15, GAS_SENSOR_FIELD_BCD8_U16, 0xFF, config_data.hw_revision), \
+    GAS_SENSOR_FIELD(5, 16, GAS_SENSOR_FIELD_BCD16, 0xFF, config_data.sw_revision), \
+    GAS_SENSOR_FIELD(5, 18, GAS_SENSOR_FIELD_BIT, 0x01, config_data.id_config), \
+    GAS_SENSOR_FIELD(5, 19, GAS_SENSOR_FIELD_BCD8, 0xFF, config_data.comm_protocol_rev), \
+    GAS_SENSOR_FIELD(6, 14, GAS_SENSOR_FIELD_U16, 0xFF, service_data.serial_number), \
+    GAS_SENSOR_FIELD(6, 16, GAS_SENSOR_FIELD_BIT, 0x01, service_data.status.zero_disabled), \
+    GAS_SENSOR_FIELD(6, 16, GAS_SENSOR_FIELD_BIT, 0x02, service_data.status.zero_in_progress), \
+    GAS_SENSOR_FIELD(6, 16, GAS_SENSOR_FIELD_BIT, 0x04, service_data.status.span_calibration_error), \
+    GAS_SENSOR_FIELD(6, 16, GAS_SENSOR_FIELD_BIT, 0x08, service_data.status.span_calibration_in_progress)
+
+/* Descriptor initializer for the built-in layout with a given field map */
+#define GAS_SENSOR_PHASEIN_FORMAT(name, fields, field_count) \
+    { (name), { GAS_SENSOR_FLAG1, GAS_SENSOR_FLAG2 }, GAS_SENSOR_FRAME_SIZE, \
+      GAS_SENSOR_FRAME_ID_MAX, 2, 3, 4, GAS_SENSOR_CHECKSUM_TWOS_COMPLEMENT, 2, 20, \
+      (fields), (field_count) }
+
+/* The built-in layout */
+extern const gas_sensor_format_t gas_sensor_format_phasein;
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Check a descriptor for consistency
+ *
+ * Every offset must lie inside the frame, the checksum byte outside the
+ * bytes it covers, and every field inside gas_sensor_slow_data_t.
+ *
+ * @param format: Descriptor
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_format_validate(const gas_sensor_format_t *format);
+
+/**
+ * Check the sync bytes and checksum of a frame
+ *
+ * @param format: Valid descriptor
+ * @param frame_data: format->size bytes
+ * @return: true if the frame is intact
+ */
+bool gas_sensor_format_check(const gas_sensor_format_t *format, const uint8_t *frame_data);
+
+/**
+ * Decode a frame by interpreting a descriptor
+ *
+ * Same contract as gas_sensor_parse_frame(): any output may be NULL, and
+ * fields of other frame IDs keep their values. With
+ * gas_sensor_format_phasein the outputs are identical to the parser's.
+ *
+ * @param format: Valid descriptor
+ * @param frame_data: format->size bytes
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_FRAME (sync bytes or
+ *          frame ID), GAS_SENSOR_ERR_CHECKSUM or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_format_decode(const gas_sensor_format_t *format,
+                             const uint8_t *frame_data,
+                             gas_sensor_slow_data_t *slow_data,
+                             gas_sensor_waveform_t *waveform,
+                             gas_sensor_status_t *status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_FORMAT_H */
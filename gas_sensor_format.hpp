@@ -0,0 +1,290 @@
+/*
+ * Anesthetic Gas Sensor Compiled Frame Formats (C++20)
+ *
+ * gas::format_decoder<F> turns a constexpr gas_sensor_format_t into a
+ * decoder: the descriptor is read at compile time, so sync bytes,
+ * checksum range and algorithm, and every field's offset, encoding and
+ * destination are constants in the generated code. Each frame ID gets a
+ * straight-line block of its own fields and the ID selects the block, the
+ * same shape as the hand-written parser. parse() has the
+ * gas_sensor_decoder_fn signature:
+ *
+ *     constexpr gas_sensor_field_t model_b_fields[] = {
+ *         GAS_SENSOR_PHASEIN_CONC_FIELDS(0, insp_vals),
+ *         ...
+ *         GAS_SENSOR_FIELD(6, 17, GAS_SENSOR_FIELD_U16, 0xFF, service_data.serial_number),
+ *     };
+ *     constexpr gas_sensor_format_t model_b = GAS_SENSOR_PHASEIN_FORMAT(
+ *         "model-b", model_b_fields, std::size(model_b_fields));
+ *
+ *     gas_sensor_session_set_format(session, &model_b,
+ *                                   gas::format_decoder<model_b>::parse);
+ *
+ * A descriptor that gas_sensor_format_validate() would reject fails to
+ * compile. gas::format_decoder<gas::phasein_format>::parse() produces the
+ * same outputs and return codes as gas_sensor_parse_frame().
+ */
+
+#ifndef GAS_SENSOR_FORMAT_HPP
+#define GAS_SENSOR_FORMAT_HPP
+
+#include "gas_sensor_format.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+namespace gas {
+
+/* The built-in layout as a constant expression */
+inline constexpr gas_sensor_field_t phasein_fields[] = { GAS_SENSOR_PHASEIN_FIELDS };
+inline constexpr gas_sensor_format_t phasein_format =
+    GAS_SENSOR_PHASEIN_FORMAT("phasein", phasein_fields, std::size(phasein_fields));
+
+namespace detail {
+
+/* ============================================================================
+ * Descriptor Checks
+ * ============================================================================ */
+
+constexpr std::size_t field_src_size(std::uint8_t kind)
+{
+    return (kind == GAS_SENSOR_FIELD_CONC16 || kind == GAS_SENSOR_FIELD_U16 ||
+            kind == GAS_SENSOR_FIELD_BCD16 || kind == GAS_SENSOR_FIELD_PRESSURE16) ? 2 : 1;
+}
+
+constexpr std::size_t field_dest_size(std::uint8_t kind)
+{
+    switch (kind) {
+        case GAS_SENSOR_FIELD_CONC8:
+        case GAS_SENSOR_FIELD_CONC16:
+        case GAS_SENSOR_FIELD_PRESSURE16:
+            return sizeof(float);
+        case GAS_SENSOR_FIELD_U8:
+        case GAS_SENSOR_FIELD_BCD8:
+            return sizeof(std::uint8_t);
+        case GAS_SENSOR_FIELD_U16:
+        case GAS_SENSOR_FIELD_BCD8_U16:
+        case GAS_SENSOR_FIELD_BCD16:
+            return sizeof(std::uint16_t);
+        case GAS_SENSOR_FIELD_ENUM8:
+            return sizeof(gas_sensor_mode_t);
+        case GAS_SENSOR_FIELD_BIT:
+            return sizeof(bool);
+        default:
+            return 0;
+    }
+}
+
+/* Same rules as gas_sensor_format_validate() */
+constexpr bool format_valid(const gas_sensor_format_t &f)
+{
+    if (f.fields == nullptr && f.field_count > 0) {
+        return false;
+    }
+    if (f.size < 4 || f.size > GAS_SENSOR_FORMAT_MAX_SIZE ||
+        f.id_count == 0 || f.id_count > GAS_SENSOR_FORMAT_MAX_IDS ||
+        f.id_offset >= f.size || f.status_offset >= f.size ||
+        f.waveform_offset + GAS_SENSOR_FORMAT_WAVEFORM_SIZE > f.size ||
+        f.checksum > GAS_SENSOR_CHECKSUM_XOR8) {
+        return false;
+    }
+    if (f.checksum != GAS_SENSOR_CHECKSUM_NONE &&
+        (f.checksum_at >= f.size || f.checksum_from > f.checksum_at)) {
+        return false;
+    }
+    for (std::size_t i = 0; i < f.field_count; i++) {
+        const gas_sensor_field_t &d = f.fields[i];
+        std::size_t dest_size = field_dest_size(d.kind);
+        if (dest_size == 0 || d.frame_id >= f.id_count ||
+            d.offset + field_src_size(d.kind) > f.size ||
+            d.dest + dest_size > sizeof(gas_sensor_slow_data_t) ||
+            d.dest % dest_size != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ============================================================================
+ * Field Conversions
+ * ============================================================================ */
+
+inline std::uint16_t load_be16(const std::uint8_t *data)
+{
+    return static_cast<std::uint16_t>((data[0] << 8) | data[1]);
+}
+
+inline std::uint8_t bcd8(std::uint8_t value)
+{
+    return static_cast<std::uint8_t>((value >> 4) * 10 + (value & 0x0F));
+}
+
+inline float conc8(std::uint8_t raw)
+{
+    return raw == GAS_SENSOR_NO_DATA ? GAS_SENSOR_CONC_INVALID
+                                     : static_cast<float>(raw) / 10.0f;
+}
+
+inline float conc16(const std::uint8_t *data)
+{
+    std::uint16_t raw = load_be16(data);
+    return raw == 0xFFFF ? GAS_SENSOR_CONC_INVALID
+                         : static_cast<float>(raw) / 100.0f;
+}
+
+inline float pressure16(const std::uint8_t *data)
+{
+    std::uint16_t raw = load_be16(data);
+    return raw == 0xFFFF ? GAS_SENSOR_CONC_INVALID
+                         : static_cast<float>(raw) / 10.0f;
+}
+
+/* Write a member of the slow data by offset */
+template <std::size_t Dest, class T>
+inline void store(gas_sensor_slow_data_t *slow_data, T value)
+{
+    std::memcpy(reinterpret_cast<unsigned char *>(slow_data) + Dest, &value, sizeof(value));
+}
+
+/* ============================================================================
+ * Code Generation
+ * ============================================================================ */
+
+template <const gas_sensor_format_t &F, std::size_t K>
+inline void decode_field(const std::uint8_t *frame, gas_sensor_slow_data_t *slow_data)
+{
+    constexpr gas_sensor_field_t field = F.fields[K];
+    const std::uint8_t *src = &frame[field.offset];
+
+    if constexpr (field.kind == GAS_SENSOR_FIELD_CONC8) {
+        store<field.dest>(slow_data, conc8(src[0]));
+    } else if constexpr (field.kind == GAS_SENSOR_FIELD_CONC16) {
+        store<field.dest>(slow_data, conc16(src));
+    } else if constexpr (field.kind == GAS_SENSOR_FIELD_PRESSURE16) {
+        store<field.dest>(slow_data, pressure16(src));
+    } else if constexpr (field.kind == GAS_SENSOR_FIELD_U8) {
+        store<field.dest>(slow_data, static_cast<std::uint8_t>(src[0] & field.mask));
+    } else if constexpr (field.kind == GAS_SENSOR_FIELD_U16) {
+        store<field.dest>(slow_data, load_be16(src));
+    } else if constexpr (field.kind == GAS_SENSOR_FIELD_ENUM8) {
+        store<field.dest>(slow_data, static_cast<gas_sensor_mode_t>(src[0] & field.mask));
+    } else if constexpr (field.kind == GAS_SENSOR_FIELD_BIT) {
+        store<field.dest>(slow_data, (src[0] & field.mask) != 0);
+    } else if constexpr (field.kind == GAS_SENSOR_FIELD_BCD8) {
+        store<field.dest>(slow_data, bcd8(src[0]));
+    } else if constexpr (field.kind == GAS_SENSOR_FIELD_BCD8_U16) {
+        store<field.dest>(slow_data, static_cast<std::uint16_t>(bcd8(src[0])));
+    } else {
+        store<field.dest>(slow_data, static_cast<std::uint16_t>(bcd8(src[0]) * 100 + bcd8(src[1])));
+    }
+}
+
+/* Decode the fields of frame ID `Id`; fields of other IDs generate nothing */
+template <const gas_sensor_format_t &F, std::uint8_t Id, std::size_t... K>
+inline void decode_id(const std::uint8_t *frame, gas_sensor_slow_data_t *slow_data,
+                      std::index_sequence<K...>)
+{
+    auto one = [&]<std::size_t I>() {
+        if constexpr (F.fields[I].frame_id == Id) {
+            decode_field<F, I>(frame, slow_data);
+        }
+    };
+    (one.template operator()<K>(), ...);
+}
+
+/* Select the block of the frame's ID; the compiler emits a jump table */
+template <const gas_sensor_format_t &F, std::size_t... Id>
+inline void decode_slow(std::uint8_t id, const std::uint8_t *frame,
+                        gas_sensor_slow_data_t *slow_data, std::index_sequence<Id...>)
+{
+    using fields = std::make_index_sequence<F.field_count>;
+    (void)((id == Id ? (decode_id<F, static_cast<std::uint8_t>(Id)>(frame, slow_data, fields{}),
+                        true)
+                     : false) || ...);
+}
+
+} // namespace detail
+
+/* ============================================================================
+ * Decoder
+ * ============================================================================ */
+
+template <const gas_sensor_format_t &F>
+struct format_decoder {
+    static_assert(detail::format_valid(F), "invalid gas_sensor_format_t descriptor");
+
+    /**
+     * Sync bytes and checksum, as gas_sensor_format_check()
+     */
+    static bool check(const std::uint8_t *frame)
+    {
+        if (frame[0] != F.sync[0] || frame[1] != F.sync[1]) {
+            return false;
+        }
+        if constexpr (F.checksum == GAS_SENSOR_CHECKSUM_NONE) {
+            return true;
+        } else {
+            std::uint8_t acc = 0;
+            for (std::size_t i = F.checksum_from; i < F.checksum_at; i++) {
+                if constexpr (F.checksum == GAS_SENSOR_CHECKSUM_XOR8) {
+                    acc ^= frame[i];
+                } else {
+                    acc = static_cast<std::uint8_t>(acc + frame[i]);
+                }
+            }
+            if constexpr (F.checksum == GAS_SENSOR_CHECKSUM_TWOS_COMPLEMENT) {
+                acc = static_cast<std::uint8_t>(-acc);
+            }
+            return acc == frame[F.checksum_at];
+        }
+    }
+
+    /**
+     * Decode one frame; a gas_sensor_decoder_fn, same contract as
+     * gas_sensor_format_decode()
+     */
+    static int parse(const std::uint8_t *frame,
+                     gas_sensor_slow_data_t *slow_data,
+                     gas_sensor_waveform_t *waveform,
+                     gas_sensor_status_t *status)
+    {
+        using namespace detail;
+
+        if (frame == nullptr) {
+            return GAS_SENSOR_ERR_NULL_PARAM;
+        }
+        if (frame[0] != F.sync[0] || frame[1] != F.sync[1]) {
+            return GAS_SENSOR_ERR_INVALID_FRAME;
+        }
+        if (!check(frame)) {
+            return GAS_SENSOR_ERR_CHECKSUM;
+        }
+
+        if (waveform != nullptr) {
+            const std::uint8_t *w = &frame[F.waveform_offset];
+            *waveform = { conc16(&w[0]), conc16(&w[2]), conc16(&w[4]),
+                          conc16(&w[6]), conc16(&w[8]) };
+        }
+
+        if (status != nullptr) {
+            gas_sensor_decode_status(frame[F.status_offset], status);
+        }
+
+        if (slow_data != nullptr) {
+            std::uint8_t id = frame[F.id_offset];
+            if (id >= F.id_count) {
+                return GAS_SENSOR_ERR_INVALID_FRAME;
+            }
+            slow_data->last_frame_id = id;
+            decode_slow<F>(id, frame, slow_data, std::make_index_sequence<F.id_count>{});
+        }
+
+        return GAS_SENSOR_OK;
+    }
+};
+
+} // namespace gas
+
+#endif /* GAS_SENSOR_FORMAT_HPP */
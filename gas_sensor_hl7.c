@@ -0,0 +1,370 @@
+/*
+ * Anesthetic Gas Sensor HL7 v2 Observation Messages - Implementation
+ */
+
+#include "gas_sensor_hl7.h"
+#include <string.h>
+
+/* ============================================================================
+ * Output Cursor
+ *
+ * All writers append through a bounded cursor. Running out of space sets
+ * a flag and turns further writes into no-ops, so segment builders need
+ * no per-call error checks and the message is validated once at the end.
+ * ============================================================================ */
+
+typedef struct {
+    char *pos;
+    char *end;
+    bool overflow;
+} hl7_cursor_t;
+
+static void put_char(hl7_cursor_t *c, char ch)
+{
+    if (c->pos < c->end) {
+        *c->pos++ = ch;
+    } else {
+        c->overflow = true;
+    }
+}
+
+static void put_mem(hl7_cursor_t *c, const char *s, size_t n)
+{
+    if ((size_t)(c->end - c->pos) < n) {
+        c->overflow = true;
+        c->pos = c->end;
+        return;
+    }
+    memcpy(c->pos, s, n);
+    c->pos += n;
+}
+
+static void put_str(hl7_cursor_t *c, const char *s)
+{
+    put_mem(c, s, strlen(s));
+}
+
+/**
+ * Append free text with HL7 delimiter escaping
+ * With keep_components, '^' passes through so callers can supply
+ * composite values such as point-of-care^room^bed.
+ */
+static void put_escaped(hl7_cursor_t *c, const char *s, bool keep_components)
+{
+    if (s == NULL) {
+        return;
+    }
+
+    for (; *s != '\0'; s++) {
+        const char *esc = NULL;
+        switch (*s) {
+            case '|':  esc = "\\F\\"; break;
+            case '^':  esc = keep_components ? NULL : "\\S\\"; break;
+            case '&':  esc = "\\T\\"; break;
+            case '~':  esc = "\\R\\"; break;
+            case '\\': esc = "\\E\\"; break;
+            case '\r':
+            case '\n': esc = " "; break;
+            default:   break;
+        }
+        if (esc != NULL) {
+            put_str(c, esc);
+        } else {
+            put_char(c, *s);
+        }
+    }
+}
+
+/**
+ * Append an unsigned integer, zero-padded to at least min_digits
+ */
+static void put_uint(hl7_cursor_t *c, uint64_t value, int min_digits)
+{
+    char digits[20];
+    int n = 0;
+
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    while (n < min_digits && n < (int)sizeof(digits)) {
+        digits[n++] = '0';
+    }
+    while (n > 0) {
+        put_char(c, digits[--n]);
+    }
+}
+
+/**
+ * Append a non-negative value as fixed point with the given decimals
+ */
+static void put_fixed(hl7_cursor_t *c, float value, int decimals)
+{
+    uint64_t scale = 1;
+    for (int i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+
+    uint64_t scaled = (uint64_t)(value * (float)scale + 0.5f);
+    put_uint(c, scaled / scale, 1);
+    if (decimals > 0) {
+        put_char(c, '.');
+        put_uint(c, scaled % scale, decimals);
+    }
+}
+
+/**
+ * Append a UTC timestamp as YYYYMMDDHHMMSS.SSS+0000
+ */
+static void put_timestamp(hl7_cursor_t *c, uint64_t timestamp_us)
+{
+    uint64_t secs = timestamp_us / 1000000u;
+    uint32_t millis = (uint32_t)(timestamp_us % 1000000u / 1000u);
+    uint32_t sod = (uint32_t)(secs % 86400u);
+
+    /* Days since 1970-01-01 to civil date (proleptic Gregorian) */
+    uint64_t z = secs / 86400u + 719468u;
+    uint64_t era = z / 146097u;
+    uint32_t doe = (uint32_t)(z - era * 146097u);
+    uint32_t yoe = (doe - doe / 1460u + doe / 36524u - doe / 146096u) / 365u;
+    uint32_t doy = doe - (365u * yoe + yoe / 4u - yoe / 100u);
+    uint32_t mp = (5u * doy + 2u) / 153u;
+    uint32_t day = doy - (153u * mp + 2u) / 5u + 1u;
+    uint32_t month = (mp < 10u) ? mp + 3u : mp - 9u;
+    uint64_t year = (uint64_t)yoe + era * 400u + (month <= 2u ? 1u : 0u);
+
+    put_uint(c, year, 4);
+    put_uint(c, month, 2);
+    put_uint(c, day, 2);
+    put_uint(c, sod / 3600u, 2);
+    put_uint(c, sod / 60u % 60u, 2);
+    put_uint(c, sod % 60u, 2);
+    put_char(c, '.');
+    put_uint(c, millis, 3);
+    put_str(c, "+0000");
+}
+
+/* ============================================================================
+ * Observation Codes
+ * ============================================================================ */
+
+/* Agent code suffix and display name, indexed by gas_agent_id_t */
+static const struct {
+    const char *code;
+    const char *name;
+} agent_codes[] = {
+    { NULL,  NULL },
+    { "HAL", "halothane" },
+    { "ENF", "enflurane" },
+    { "ISO", "isoflurane" },
+    { "SEV", "sevoflurane" },
+    { "DES", "desflurane" },
+};
+
+#define AGENT_CODE_COUNT  (sizeof(agent_codes) / sizeof(agent_codes[0]))
+
+/* ============================================================================
+ * Segment Writers
+ * ============================================================================ */
+
+static void put_msh(hl7_cursor_t *c,
+                    const gas_sensor_hl7_writer_t *writer,
+                    uint64_t timestamp_us)
+{
+    put_str(c, "MSH|^~\\&|");
+    put_escaped(c, writer->sending_application, true);
+    put_char(c, '|');
+    put_escaped(c, writer->sending_facility, true);
+    put_char(c, '|');
+    put_escaped(c, writer->receiving_application, true);
+    put_char(c, '|');
+    put_escaped(c, writer->receiving_facility, true);
+    put_char(c, '|');
+    put_timestamp(c, timestamp_us);
+    put_str(c, "||ORU^R01^ORU_R01|");
+    put_uint(c, writer->next_control_id, 1);
+    put_str(c, "|P|2.5.1\r");
+}
+
+/**
+ * Append one numeric OBX if the value is available
+ */
+static void put_obx(hl7_cursor_t *c,
+                    int *set_id,
+                    const char *prefix,
+                    const char *code,
+                    const char *name_prefix,
+                    const char *name,
+                    float value,
+                    int decimals,
+                    const char *units,
+                    uint64_t timestamp_us)
+{
+    if (value < 0.0f) {
+        return;
+    }
+
+    put_str(c, "OBX|");
+    put_uint(c, (uint64_t)++*set_id, 1);
+    put_str(c, "|NM|");
+    put_str(c, prefix);
+    put_str(c, code);
+    put_char(c, '^');
+    put_str(c, name_prefix);
+    put_str(c, name);
+    put_str(c, "^L||");
+    put_fixed(c, value, decimals);
+    put_char(c, '|');
+    put_str(c, units);
+    put_str(c, "|||||F|||");
+    put_timestamp(c, timestamp_us);
+    put_char(c, '\r');
+}
+
+static void put_gas_pair(hl7_cursor_t *c,
+                         int *set_id,
+                         const char *code,
+                         const char *name,
+                         float et,
+                         float fi,
+                         uint64_t ts)
+{
+    put_obx(c, set_id, "ET", code, "End-tidal ", name, et, 1, "%", ts);
+    put_obx(c, set_id, "FI", code, "Inspired ", name, fi, 1, "%", ts);
+}
+
+static void put_agent_pair(hl7_cursor_t *c,
+                           int *set_id,
+                           gas_agent_id_t agent,
+                           float et,
+                           float fi,
+                           uint64_t ts)
+{
+    if ((unsigned)agent == GAS_AGENT_NONE || (unsigned)agent >= AGENT_CODE_COUNT) {
+        return;
+    }
+    put_gas_pair(c, set_id, agent_codes[agent].code, agent_codes[agent].name, et, fi, ts);
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+void gas_sensor_hl7_writer_init(gas_sensor_hl7_writer_t *writer,
+                                const char *sending_application,
+                                const char *sending_facility,
+                                const char *receiving_application,
+                                const char *receiving_facility)
+{
+    if (writer == NULL) {
+        return;
+    }
+
+    memset(writer, 0, sizeof(*writer));
+    writer->sending_application = sending_application;
+    writer->sending_facility = sending_facility;
+    writer->receiving_application = receiving_application;
+    writer->receiving_facility = receiving_facility;
+    writer->next_control_id = 1;
+}
+
+int gas_sensor_hl7_write_oru(gas_sensor_hl7_writer_t *writer,
+                             const gas_sensor_hl7_bed_t *bed,
+                             char *buf,
+                             size_t size,
+                             size_t *length)
+{
+    if (writer == NULL || bed == NULL || bed->slow_data == NULL ||
+        buf == NULL || length == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    const gas_sensor_slow_data_t *sd = bed->slow_data;
+    uint64_t ts = bed->timestamp_us;
+    hl7_cursor_t c = { buf, buf + size, false };
+    int set_id = 0;
+
+    if (writer->mllp) {
+        put_char(&c, (char)GAS_SENSOR_HL7_MLLP_START);
+    }
+
+    put_msh(&c, writer, ts);
+
+    put_str(&c, "PID|1||");
+    put_escaped(&c, bed->patient_id, false);
+    put_char(&c, '\r');
+
+    put_str(&c, "PV1|1|I|");
+    put_escaped(&c, bed->location, true);
+    put_char(&c, '\r');
+
+    put_str(&c, "OBR|1||");
+    put_uint(&c, bed->sensor_id, 1);
+    put_str(&c, "|GASMON^Anesthetic gas monitoring^L|||");
+    put_timestamp(&c, ts);
+    put_char(&c, '\r');
+
+    put_gas_pair(&c, &set_id, "CO2", "CO2", sd->exp_vals.co2, sd->insp_vals.co2, ts);
+    put_gas_pair(&c, &set_id, "N2O", "N2O", sd->exp_vals.n2o, sd->insp_vals.n2o, ts);
+    put_gas_pair(&c, &set_id, "O2", "O2", sd->exp_vals.o2, sd->insp_vals.o2, ts);
+    put_agent_pair(&c, &set_id, sd->gen_vals.primary_agent,
+                   sd->exp_vals.aa1, sd->insp_vals.aa1, ts);
+    put_agent_pair(&c, &set_id, sd->gen_vals.secondary_agent,
+                   sd->exp_vals.aa2, sd->insp_vals.aa2, ts);
+
+    if (sd->gen_vals.resp_rate != GAS_SENSOR_NO_DATA) {
+        put_obx(&c, &set_id, "", "RR", "", "Respiratory rate",
+                (float)sd->gen_vals.resp_rate, 0, "/min", ts);
+    }
+    put_obx(&c, &set_id, "", "ATMP", "", "Ambient pressure",
+            sd->gen_vals.atm_pressure, 1, "kPa", ts);
+
+    if (writer->mllp) {
+        put_char(&c, (char)GAS_SENSOR_HL7_MLLP_END);
+        put_char(&c, (char)GAS_SENSOR_HL7_MLLP_TRAILER);
+    }
+
+    if (c.overflow) {
+        return GAS_SENSOR_ERR_NO_SPACE;
+    }
+
+    writer->next_control_id++;
+    *length = (size_t)(c.pos - buf);
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_hl7_write_batch(gas_sensor_hl7_writer_t *writer,
+                               const gas_sensor_hl7_bed_t *beds,
+                               size_t count,
+                               char *buf,
+                               size_t size,
+                               size_t *offsets,
+                               size_t *written)
+{
+    if (writer == NULL || (beds == NULL && count > 0) || buf == NULL || written == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    size_t used = 0;
+    size_t i;
+    int result = GAS_SENSOR_OK;
+
+    for (i = 0; i < count; i++) {
+        size_t length;
+        if (offsets != NULL) {
+            offsets[i] = used;
+        }
+        result = gas_sensor_hl7_write_oru(writer, &beds[i], buf + used, size - used, &length);
+        if (result != GAS_SENSOR_OK) {
+            break;
+        }
+        used += length;
+    }
+
+    if (offsets != NULL) {
+        offsets[i] = used;
+    }
+    *written = i;
+    return result;
+}
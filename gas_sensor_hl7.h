@@ -0,0 +1,125 @@
+/*
+ * Anesthetic Gas Sensor HL7 v2 Observation Messages
+ *
+ * Builds HL7 v2.5.1 ORU^R01 messages from completed slow data cycles
+ * (see gas_sensor_cycle_update()). Messages are written into caller-owned
+ * buffers with integer formatting only: no heap allocation, no printf,
+ * and no locale or time zone lookups, so charting every bed every minute
+ * costs microseconds.
+ *
+ * Each message carries MSH, PID, PV1 and OBR segments followed by one
+ * OBX per available value:
+ *   - Inspired (Fi) and end-tidal (Et) CO2, N2O and O2
+ *   - Inspired and end-tidal primary/secondary agent, coded per agent
+ *   - Respiratory rate and ambient pressure
+ * Values the sensor reported as "no data" are omitted. Observation
+ * identifiers use local codes (coding system "L").
+ */
+
+#ifndef GAS_SENSOR_HL7_H
+#define GAS_SENSOR_HL7_H
+
+#include "gas_sensor.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* MLLP framing bytes */
+#define GAS_SENSOR_HL7_MLLP_START       0x0B
+#define GAS_SENSOR_HL7_MLLP_END         0x1C
+#define GAS_SENSOR_HL7_MLLP_TRAILER     0x0D
+
+/* Buffer size that always fits one message with 64-character identifiers */
+#define GAS_SENSOR_HL7_MAX_MESSAGE      4096
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+/* Message header settings and control ID sequence */
+typedef struct {
+    const char *sending_application;    /* MSH-3 */
+    const char *sending_facility;       /* MSH-4 */
+    const char *receiving_application;  /* MSH-5 */
+    const char *receiving_facility;     /* MSH-6 */
+    bool mllp;                          /* Wrap each message in MLLP framing */
+    uint64_t next_control_id;           /* MSH-10, incremented per message */
+} gas_sensor_hl7_writer_t;
+
+/* One bed's cycle snapshot */
+typedef struct {
+    const char *patient_id;             /* PID-3 */
+    const char *location;               /* PV1-3, e.g. "OR3^^1" (components kept) */
+    uint32_t sensor_id;                 /* OBR-3 filler order number */
+    uint64_t timestamp_us;              /* Observation time (us since epoch, UTC) */
+    const gas_sensor_slow_data_t *slow_data;
+} gas_sensor_hl7_bed_t;
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Initialize a message writer
+ *
+ * Strings are referenced, not copied, and must outlive the writer.
+ * NULL strings produce empty fields.
+ */
+void gas_sensor_hl7_writer_init(gas_sensor_hl7_writer_t *writer,
+                                const char *sending_application,
+                                const char *sending_facility,
+                                const char *receiving_application,
+                                const char *receiving_facility);
+
+/**
+ * Write one ORU^R01 message
+ *
+ * @param writer: Writer (control ID is consumed only on success)
+ * @param bed: Bed snapshot
+ * @param buf: Output buffer
+ * @param size: Buffer size
+ * @param length: Output message length in bytes
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NO_SPACE or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_hl7_write_oru(gas_sensor_hl7_writer_t *writer,
+                             const gas_sensor_hl7_bed_t *bed,
+                             char *buf,
+                             size_t size,
+                             size_t *length);
+
+/**
+ * Write ORU^R01 messages for several beds back to back
+ *
+ * Stops at the first message that does not fit; the complete messages
+ * written so far remain valid and can be sent before retrying the rest.
+ *
+ * @param writer: Writer
+ * @param beds: Bed snapshots
+ * @param count: Number of beds
+ * @param buf: Output buffer
+ * @param size: Buffer size
+ * @param offsets: Optional array of count + 1 entries; offsets[i] is where
+ *                 message i starts and offsets[written] the total length
+ * @param written: Output number of complete messages
+ * @return: GAS_SENSOR_OK if all fit, GAS_SENSOR_ERR_NO_SPACE otherwise,
+ *          or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_hl7_write_batch(gas_sensor_hl7_writer_t *writer,
+                               const gas_sensor_hl7_bed_t *beds,
+                               size_t count,
+                               char *buf,
+                               size_t size,
+                               size_t *offsets,
+                               size_t *written);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_HL7_H */
@@ -0,0 +1,131 @@
+/*
+ * Anesthetic Gas Sensor Library - Internal Helpers
+ *
+ * Small helpers shared by the library's translation units: little-endian
+ * encoding of the on-disk and on-wire formats, the slow data
+ * concentration encoding, and the open-addressing sensor ID tables that
+ * several components keep per sensor. Not part of the public API.
+ */
+
+#ifndef GAS_SENSOR_INTERNAL_H
+#define GAS_SENSOR_INTERNAL_H
+
+#include "gas_sensor.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+/* ============================================================================
+ * Little-endian Encoding
+ * ============================================================================ */
+
+static inline void put_uint16_le(uint8_t *data, uint16_t value)
+{
+    data[0] = (uint8_t)(value & 0xFF);
+    data[1] = (uint8_t)(value >> 8);
+}
+
+static inline void put_uint32_le(uint8_t *data, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        data[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static inline void put_uint64_le(uint8_t *data, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) {
+        data[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static inline uint16_t get_uint16_le(const uint8_t *data)
+{
+    return (uint16_t)(data[0] | ((uint16_t)data[1] << 8));
+}
+
+static inline uint32_t get_uint32_le(const uint8_t *data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+           ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static inline uint64_t get_uint64_le(const uint8_t *data)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+/* ============================================================================
+ * Concentrations
+ * ============================================================================ */
+
+/* Inverse of the parser's slow data conversion; GAS_SENSOR_NO_DATA for
+ * missing values */
+static inline uint8_t conc_to_raw(float conc)
+{
+    if (conc < 0.0f) {
+        return GAS_SENSOR_NO_DATA;
+    }
+    long raw = lrintf(conc * 10.0f);
+    return (raw >= GAS_SENSOR_NO_DATA) ? GAS_SENSOR_NO_DATA : (uint8_t)raw;
+}
+
+/* ============================================================================
+ * Sensor ID Tables
+ * ============================================================================ */
+
+/* Home slot of a sensor ID in a power-of-two table (Fibonacci hashing) */
+static inline size_t sensor_id_home(uint32_t sensor_id, size_t mask)
+{
+    return (size_t)(sensor_id * 2654435761u) & mask;
+}
+
+/*
+ * Defines lookup and removal for a linear-probing table of entry_t, a
+ * struct with a bool member used and a uint32_t member sensor_id:
+ *
+ *   size_t name_slot(const entry_t *table, size_t mask, uint32_t sensor_id)
+ *       Slot holding sensor_id, or the free slot where it would go
+ *   void name_remove(entry_t *table, size_t mask, size_t i)
+ *       Free slot i, shifting later entries of its probe run back so
+ *       lookups need no tombstones
+ *
+ * mask is the table size minus one; the table must keep a free slot.
+ */
+#define GAS_SENSOR_ID_TABLE(name, entry_t)                                      \
+static inline size_t name##_slot(const entry_t *table, size_t mask,             \
+                                 uint32_t sensor_id)                            \
+{                                                                               \
+    size_t i = sensor_id_home(sensor_id, mask);                                 \
+    while (table[i].used && table[i].sensor_id != sensor_id) {                  \
+        i = (i + 1) & mask;                                                     \
+    }                                                                           \
+    return i;                                                                   \
+}                                                                               \
+                                                                                \
+static inline void name##_remove(entry_t *table, size_t mask, size_t i)         \
+{                                                                               \
+    size_t j = i;                                                               \
+    table[i].used = false;                                                      \
+    for (;;) {                                                                  \
+        j = (j + 1) & mask;                                                     \
+        if (!table[j].used) {                                                   \
+            return;                                                             \
+        }                                                                       \
+        /* Move j into the hole unless its home lies cyclically in (i, j] */    \
+        size_t home = sensor_id_home(table[j].sensor_id, mask);                 \
+        bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j); \
+        if (!stays) {                                                           \
+            table[i] = table[j];                                                \
+            table[j].used = false;                                              \
+            i = j;                                                              \
+        }                                                                       \
+    }                                                                           \
+}
+
+#endif /* GAS_SENSOR_INTERNAL_H */
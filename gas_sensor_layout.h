@@ -0,0 +1,67 @@
+/*
+ * Anesthetic Gas Sensor Frame Layout
+ *
+ * Byte offsets of the built-in 21-byte frame, as in
+ * doc/GAS_SENSOR_PROTOCOL.md. gas_sensor_parse_frame(), gas::decode()
+ * (gas_sensor_decoder.hpp) and the simulator all index frames through
+ * these, so the C and C++ decoders read the same bytes by construction.
+ *
+ * Slow data field offsets (GAS_SENSOR_SLOW_*) are relative to
+ * GAS_SENSOR_OFFSET_SLOW; which fields the six bytes hold depends on the
+ * frame ID.
+ */
+
+#ifndef GAS_SENSOR_LAYOUT_H
+#define GAS_SENSOR_LAYOUT_H
+
+/* ============================================================================
+ * Frame
+ * ============================================================================ */
+
+#define GAS_SENSOR_OFFSET_ID            2
+#define GAS_SENSOR_OFFSET_STS           3
+#define GAS_SENSOR_OFFSET_CO2           4       /* Waveform words, big-endian */
+#define GAS_SENSOR_OFFSET_N2O           6
+#define GAS_SENSOR_OFFSET_AA1           8
+#define GAS_SENSOR_OFFSET_AA2           10
+#define GAS_SENSOR_OFFSET_O2            12
+#define GAS_SENSOR_OFFSET_SLOW          14      /* Slow data, bytes 14-19 */
+#define GAS_SENSOR_SLOW_SIZE            6
+#define GAS_SENSOR_OFFSET_CHECKSUM      20      /* Covers bytes 2-19 */
+
+/* ============================================================================
+ * Slow Data Fields
+ * ============================================================================ */
+
+/* InspVals, ExpVals, MomVals (IDs 0x00-0x02): one byte per gas */
+#define GAS_SENSOR_SLOW_CO2             0
+#define GAS_SENSOR_SLOW_N2O             1
+#define GAS_SENSOR_SLOW_AA1             2
+#define GAS_SENSOR_SLOW_AA2             3
+#define GAS_SENSOR_SLOW_O2              4
+
+/* GenVals (ID 0x03) */
+#define GAS_SENSOR_SLOW_RESP_RATE       0
+#define GAS_SENSOR_SLOW_SINCE_BREATH    1
+#define GAS_SENSOR_SLOW_PRIMARY_AGENT   2
+#define GAS_SENSOR_SLOW_SECONDARY_AGENT 3
+#define GAS_SENSOR_SLOW_ATM_PRESSURE    4       /* Big-endian */
+
+/* SensorRegs (ID 0x04) */
+#define GAS_SENSOR_SLOW_MODE            0
+#define GAS_SENSOR_SLOW_ERROR           2
+#define GAS_SENSOR_SLOW_ADAPTER         3
+#define GAS_SENSOR_SLOW_DATA_VALID      4
+
+/* ConfigData (ID 0x05) */
+#define GAS_SENSOR_SLOW_CONFIG0         0       /* Fitted options */
+#define GAS_SENSOR_SLOW_HW_REV          1       /* BCD */
+#define GAS_SENSOR_SLOW_SW_REV          2       /* BCD, HI then LO */
+#define GAS_SENSOR_SLOW_CONFIG1         4
+#define GAS_SENSOR_SLOW_PROTOCOL_REV    5       /* BCD */
+
+/* ServiceData (ID 0x06) */
+#define GAS_SENSOR_SLOW_SERIAL          0       /* Big-endian */
+#define GAS_SENSOR_SLOW_SERVICE_STATUS  2
+
+#endif /* GAS_SENSOR_LAYOUT_H */
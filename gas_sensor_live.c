@@ -0,0 +1,404 @@
+/*
+ * Anesthetic Gas Sensor Live Captures - Implementation
+ *
+ * The writer owns the only writable mapping. Records are staged past the
+ * committed length and published with a release store of the new length
+ * followed by a sequence increment and FUTEX_WAKE. Readers load the
+ * sequence before the length, so a commit that lands between the check
+ * and FUTEX_WAIT changes the futex word and the wait returns at once.
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor_live.h"
+#include "gas_sensor_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Live captures store atomic header fields in host order and require a little-endian host"
+#endif
+
+/* GSCP header as seen through the mapping */
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    _Atomic uint16_t flags;
+    uint32_t sensor_id;
+    _Atomic uint32_t sequence;
+    uint64_t start_time_us;
+    _Atomic uint64_t committed;
+} live_header_t;
+
+_Static_assert(sizeof(live_header_t) == GAS_SENSOR_CAPTURE_HEADER_SIZE,
+               "live header must overlay the capture header");
+_Static_assert(offsetof(live_header_t, flags) == 6 &&
+               offsetof(live_header_t, sequence) == 12 &&
+               offsetof(live_header_t, committed) == 24,
+               "live header field offsets");
+
+struct gas_sensor_live_writer {
+    int fd;
+    uint8_t *map;
+    size_t map_size;
+    live_header_t *header;
+    uint64_t committed;             /* Last published length */
+    uint64_t staged;                /* Length including unpublished records */
+    uint64_t capacity;
+};
+
+struct gas_sensor_live_reader {
+    int fd;
+    const uint8_t *map;
+    size_t map_size;
+    live_header_t *header;
+    uint64_t pos;                   /* Record offset after the header */
+};
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+/* Shared (not process-private) futex: readers live in other processes */
+static void futex_wait(_Atomic uint32_t *word, uint32_t expected, const struct timespec *timeout)
+{
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAIT, expected, timeout, NULL, 0);
+}
+
+static void futex_wake_all(_Atomic uint32_t *word)
+{
+    syscall(SYS_futex, (uint32_t *)word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static int64_t monotonic_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ============================================================================
+ * Writer
+ * ============================================================================ */
+
+int gas_sensor_live_writer_open(const char *path,
+                                uint32_t sensor_id,
+                                uint64_t start_time_us,
+                                size_t capacity,
+                                gas_sensor_live_writer_t *writer)
+{
+    if (path == NULL || writer == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (capacity == 0) {
+        capacity = GAS_SENSOR_LIVE_DEFAULT_CAPACITY;
+    }
+
+    struct gas_sensor_live_writer *w = calloc(1, sizeof(*w));
+    if (w == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    w->capacity = capacity;
+    w->map_size = GAS_SENSOR_CAPTURE_HEADER_SIZE + capacity;
+
+    w->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (w->fd < 0) {
+        free(w);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    /* Reserve the blocks now so a full disk cannot fault a store later */
+    if (posix_fallocate(w->fd, 0, (off_t)w->map_size) != 0) {
+        close(w->fd);
+        free(w);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    w->map = mmap(NULL, w->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+    if (w->map == MAP_FAILED) {
+        close(w->fd);
+        free(w);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    w->header = (live_header_t *)w->map;
+    w->header->version = GAS_SENSOR_CAPTURE_VERSION;
+    w->header->sensor_id = sensor_id;
+    w->header->start_time_us = start_time_us;
+    atomic_store_explicit(&w->header->sequence, 0, memory_order_relaxed);
+    atomic_store_explicit(&w->header->committed, 0, memory_order_relaxed);
+    atomic_store_explicit(&w->header->flags, GAS_SENSOR_LIVE_FLAG_ACTIVE,
+                          memory_order_relaxed);
+
+    /* Magic last: a reader that sees it sees a complete header */
+    atomic_thread_fence(memory_order_release);
+    memcpy(w->header->magic, GAS_SENSOR_CAPTURE_MAGIC, 4);
+
+    *writer = w;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_live_append(gas_sensor_live_writer_t writer,
+                           uint8_t type,
+                           uint64_t timestamp_us,
+                           const uint8_t *payload,
+                           size_t length)
+{
+    if (writer == NULL || (payload == NULL && length > 0)) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (length > GAS_SENSOR_CAPTURE_MAX_PAYLOAD) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    size_t total = GAS_SENSOR_CAPTURE_REC_HDR_SIZE + length;
+    if (writer->capacity - writer->staged < total) {
+        return GAS_SENSOR_ERR_NO_SPACE;
+    }
+
+    uint8_t *rec = writer->map + GAS_SENSOR_CAPTURE_HEADER_SIZE + writer->staged;
+    rec[0] = type;
+    put_uint16_le(&rec[1], (uint16_t)length);
+    put_uint64_le(&rec[3], timestamp_us);
+    if (length > 0) {
+        memcpy(&rec[GAS_SENSOR_CAPTURE_REC_HDR_SIZE], payload, length);
+    }
+
+    writer->staged += total;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_live_append_frame(gas_sensor_live_writer_t writer,
+                                 uint64_t timestamp_us,
+                                 const uint8_t *frame_data)
+{
+    if (frame_data == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    return gas_sensor_live_append(writer, GAS_SENSOR_REC_FRAME, timestamp_us,
+                                  frame_data, GAS_SENSOR_FRAME_SIZE);
+}
+
+void gas_sensor_live_commit(gas_sensor_live_writer_t writer)
+{
+    if (writer == NULL || writer->staged == writer->committed) {
+        return;
+    }
+
+    writer->committed = writer->staged;
+    atomic_store_explicit(&writer->header->committed, writer->committed,
+                          memory_order_release);
+    atomic_fetch_add_explicit(&writer->header->sequence, 1, memory_order_release);
+    futex_wake_all(&writer->header->sequence);
+}
+
+int gas_sensor_live_frame_handler(void *ctx, const gas_sensor_frame_event_t *event)
+{
+    gas_sensor_live_writer_t w = ctx;
+    if (w == NULL || event == NULL || event->frame == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    int result = gas_sensor_live_append_frame(w, event->timestamp_us, event->frame);
+    if (result == GAS_SENSOR_OK) {
+        gas_sensor_live_commit(w);
+    }
+    return result;
+}
+
+uint64_t gas_sensor_live_writer_committed(gas_sensor_live_writer_t writer)
+{
+    return (writer != NULL) ? writer->committed : 0;
+}
+
+int gas_sensor_live_writer_close(gas_sensor_live_writer_t writer)
+{
+    if (writer == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    gas_sensor_live_commit(writer);
+
+    /* Flags are cleared after the final length, so a reader that sees the
+     * capture inactive also sees every record */
+    atomic_store_explicit(&writer->header->flags, 0, memory_order_release);
+    atomic_fetch_add_explicit(&writer->header->sequence, 1, memory_order_release);
+    futex_wake_all(&writer->header->sequence);
+
+    int result = GAS_SENSOR_OK;
+    if (munmap(writer->map, writer->map_size) != 0 ||
+        ftruncate(writer->fd, (off_t)(GAS_SENSOR_CAPTURE_HEADER_SIZE + writer->committed)) != 0) {
+        result = GAS_SENSOR_ERR_IO;
+    }
+    if (close(writer->fd) != 0) {
+        result = GAS_SENSOR_ERR_IO;
+    }
+
+    free(writer);
+    return result;
+}
+
+/* ============================================================================
+ * Reader
+ * ============================================================================ */
+
+int gas_sensor_live_reader_open(const char *path,
+                                gas_sensor_live_reader_t *reader)
+{
+    if (path == NULL || reader == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    struct gas_sensor_live_reader *r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    r->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (r->fd < 0) {
+        free(r);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    struct stat st;
+    if (fstat(r->fd, &st) != 0) {
+        close(r->fd);
+        free(r);
+        return GAS_SENSOR_ERR_IO;
+    }
+    if ((size_t)st.st_size < GAS_SENSOR_CAPTURE_HEADER_SIZE) {
+        close(r->fd);
+        free(r);
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    r->map_size = (size_t)st.st_size;
+    void *map = mmap(NULL, r->map_size, PROT_READ, MAP_SHARED, r->fd, 0);
+    if (map == MAP_FAILED) {
+        close(r->fd);
+        free(r);
+        return GAS_SENSOR_ERR_IO;
+    }
+    r->map = map;
+    r->header = map;
+
+    if (memcmp(r->header->magic, GAS_SENSOR_CAPTURE_MAGIC, 4) != 0 ||
+        r->header->version != GAS_SENSOR_CAPTURE_VERSION) {
+        gas_sensor_live_reader_close(r);
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    *reader = r;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_live_next(gas_sensor_live_reader_t reader,
+                         gas_sensor_capture_record_t *record,
+                         int timeout_ms)
+{
+    if (reader == NULL || record == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    live_header_t *h = reader->header;
+    int64_t deadline = (timeout_ms > 0) ? monotonic_ms() + timeout_ms : 0;
+
+    for (;;) {
+        /* Sequence before flags before length; see the file comment */
+        uint32_t seq = atomic_load_explicit(&h->sequence, memory_order_acquire);
+        uint16_t flags = atomic_load_explicit(&h->flags, memory_order_acquire);
+        uint64_t committed = atomic_load_explicit(&h->committed, memory_order_acquire);
+
+        if (committed > reader->map_size - GAS_SENSOR_CAPTURE_HEADER_SIZE) {
+            return GAS_SENSOR_ERR_FORMAT;
+        }
+
+        if (reader->pos < committed) {
+            if (committed - reader->pos < GAS_SENSOR_CAPTURE_REC_HDR_SIZE) {
+                return GAS_SENSOR_ERR_FORMAT;
+            }
+            const uint8_t *rec = reader->map + GAS_SENSOR_CAPTURE_HEADER_SIZE + reader->pos;
+            uint16_t length = get_uint16_le(&rec[1]);
+            if (committed - reader->pos - GAS_SENSOR_CAPTURE_REC_HDR_SIZE < length) {
+                return GAS_SENSOR_ERR_FORMAT;
+            }
+
+            record->type = rec[0];
+            record->length = length;
+            record->timestamp_us = get_uint64_le(&rec[3]);
+            record->payload = &rec[GAS_SENSOR_CAPTURE_REC_HDR_SIZE];
+            reader->pos += GAS_SENSOR_CAPTURE_REC_HDR_SIZE + (uint64_t)length;
+            return GAS_SENSOR_OK;
+        }
+
+        if ((flags & GAS_SENSOR_LIVE_FLAG_ACTIVE) == 0) {
+            return GAS_SENSOR_ERR_EOF;
+        }
+
+        if (timeout_ms == 0) {
+            return GAS_SENSOR_LIVE_TIMEOUT;
+        }
+
+        if (timeout_ms < 0) {
+            futex_wait(&h->sequence, seq, NULL);
+        } else {
+            int64_t remaining = deadline - monotonic_ms();
+            if (remaining <= 0) {
+                return GAS_SENSOR_LIVE_TIMEOUT;
+            }
+            struct timespec ts = {
+                .tv_sec = remaining / 1000,
+                .tv_nsec = (remaining % 1000) * 1000000
+            };
+            futex_wait(&h->sequence, seq, &ts);
+        }
+    }
+}
+
+void gas_sensor_live_seek_end(gas_sensor_live_reader_t reader)
+{
+    if (reader != NULL) {
+        uint64_t committed = atomic_load_explicit(&reader->header->committed,
+                                                  memory_order_acquire);
+        if (committed <= reader->map_size - GAS_SENSOR_CAPTURE_HEADER_SIZE) {
+            reader->pos = committed;
+        }
+    }
+}
+
+uint32_t gas_sensor_live_sensor_id(gas_sensor_live_reader_t reader)
+{
+    return (reader != NULL) ? reader->header->sensor_id : 0;
+}
+
+uint64_t gas_sensor_live_start_time(gas_sensor_live_reader_t reader)
+{
+    return (reader != NULL) ? reader->header->start_time_us : 0;
+}
+
+void gas_sensor_live_reader_close(gas_sensor_live_reader_t reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+
+    munmap((void *)reader->map, reader->map_size);
+    close(reader->fd);
+    free(reader);
+}
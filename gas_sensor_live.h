@@ -0,0 +1,196 @@
+/*
+ * Anesthetic Gas Sensor Live Captures
+ *
+ * A live capture is a capture file (see gas_sensor_capture.h) that other
+ * processes can follow while it is being recorded. The recorder writes
+ * records into a shared memory mapping of a preallocated file and then
+ * publishes the committed length in the file header. Any number of readers
+ * map the same file read-only, wait on the header with a futex, and are
+ * handed records that point straight into the mapping: nothing is copied
+ * and a commit wakes every waiting reader with one system call.
+ *
+ * The live header reuses reserved fields of the GSCP header:
+ *   [6-7]   Flags: GAS_SENSOR_LIVE_FLAG_ACTIVE while recording
+ *   [12-15] Commit sequence (futex word, incremented on every commit)
+ *   [24-31] Committed record bytes following the header
+ * These three fields are accessed atomically in host byte order, so live
+ * capture is limited to little-endian hosts. On close the file is
+ * truncated to the committed length and becomes an ordinary capture that
+ * gas_sensor_capture_reader_open() and the merge can read.
+ *
+ * Linux only (shared mappings and futexes).
+ */
+
+#ifndef GAS_SENSOR_LIVE_H
+#define GAS_SENSOR_LIVE_H
+
+#include "gas_sensor.h"
+#include "gas_sensor_capture.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_LIVE_FLAG_ACTIVE         0x0001
+
+/* Default record capacity: 2^21 32-byte frame records, 29 hours at 20 frames/s */
+#define GAS_SENSOR_LIVE_DEFAULT_CAPACITY    (64u * 1024u * 1024u)
+
+/* gas_sensor_live_next() return value when the wait timed out */
+#define GAS_SENSOR_LIVE_TIMEOUT             1
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_live_writer *gas_sensor_live_writer_t;
+typedef struct gas_sensor_live_reader *gas_sensor_live_reader_t;
+
+/* ============================================================================
+ * Writer
+ * ============================================================================ */
+
+/**
+ * Create a live capture for one sensor
+ *
+ * The file is preallocated to hold capacity bytes of records; appends
+ * beyond that fail with GAS_SENSOR_ERR_NO_SPACE. An existing file at path
+ * is truncated.
+ *
+ * @param path: Output file path
+ * @param sensor_id: Sensor identifier stored in the file header
+ * @param start_time_us: Capture start time (us since epoch)
+ * @param capacity: Record bytes, or 0 for GAS_SENSOR_LIVE_DEFAULT_CAPACITY
+ * @param writer: Output parameter for the writer handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO, GAS_SENSOR_ERR_MEMORY or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_live_writer_open(const char *path,
+                                uint32_t sensor_id,
+                                uint64_t start_time_us,
+                                size_t capacity,
+                                gas_sensor_live_writer_t *writer);
+
+/**
+ * Stage one record
+ *
+ * The record is written into the mapping but stays invisible to readers
+ * until the next gas_sensor_live_commit(), so several records can be
+ * published with one wakeup.
+ *
+ * @param writer: Writer handle
+ * @param type: Record type (GAS_SENSOR_REC_*)
+ * @param timestamp_us: Record timestamp (us since epoch)
+ * @param payload: Payload bytes
+ * @param length: Payload length (at most GAS_SENSOR_CAPTURE_MAX_PAYLOAD)
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NO_SPACE when the file is full,
+ *          GAS_SENSOR_ERR_INVALID_PARAM if too long, or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_live_append(gas_sensor_live_writer_t writer,
+                           uint8_t type,
+                           uint64_t timestamp_us,
+                           const uint8_t *payload,
+                           size_t length);
+
+/**
+ * Stage one 21-byte frame record
+ */
+int gas_sensor_live_append_frame(gas_sensor_live_writer_t writer,
+                                 uint64_t timestamp_us,
+                                 const uint8_t *frame_data);
+
+/**
+ * Publish all staged records and wake waiting readers
+ *
+ * Does nothing if no record was staged since the last commit.
+ */
+void gas_sensor_live_commit(gas_sensor_live_writer_t writer);
+
+/**
+ * Record and publish one frame event
+ *
+ * Matches gas_sensor_frame_handler_t, so a live writer can be passed
+ * directly to gas_sensor_session_attach() as handler context.
+ *
+ * @param ctx: Writer handle
+ * @param event: Frame event
+ * @return: GAS_SENSOR_OK or GAS_SENSOR_ERR_NO_SPACE when the file is full
+ */
+int gas_sensor_live_frame_handler(void *ctx, const gas_sensor_frame_event_t *event);
+
+/**
+ * Get the number of committed record bytes
+ */
+uint64_t gas_sensor_live_writer_committed(gas_sensor_live_writer_t writer);
+
+/**
+ * Commit, mark the capture finished, truncate the file to its committed
+ * length and close it
+ *
+ * Readers drain the remaining records and then get GAS_SENSOR_ERR_EOF.
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_live_writer_close(gas_sensor_live_writer_t writer);
+
+/* ============================================================================
+ * Reader
+ * ============================================================================ */
+
+/**
+ * Open a live capture for following
+ *
+ * Works on captures that are still being recorded and on finished ones.
+ * Reading starts at the first record.
+ *
+ * @param path: Capture file path
+ * @param reader: Output parameter for the reader handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO, GAS_SENSOR_ERR_FORMAT (bad
+ *          header), GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_live_reader_open(const char *path,
+                                gas_sensor_live_reader_t *reader);
+
+/**
+ * Take the next committed record, waiting for one if necessary
+ *
+ * @param reader: Reader handle
+ * @param record: Output record; payload points into the shared mapping and
+ *                stays valid until the reader is closed
+ * @param timeout_ms: -1 waits forever, 0 polls
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_LIVE_TIMEOUT, GAS_SENSOR_ERR_EOF once
+ *          the recorder closed and every record was read,
+ *          GAS_SENSOR_ERR_FORMAT on a corrupt record or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_live_next(gas_sensor_live_reader_t reader,
+                         gas_sensor_capture_record_t *record,
+                         int timeout_ms);
+
+/**
+ * Skip to the current end, so only records committed from now on are read
+ */
+void gas_sensor_live_seek_end(gas_sensor_live_reader_t reader);
+
+/**
+ * Get header fields of an open live capture
+ */
+uint32_t gas_sensor_live_sensor_id(gas_sensor_live_reader_t reader);
+uint64_t gas_sensor_live_start_time(gas_sensor_live_reader_t reader);
+
+/**
+ * Unmap and close a reader
+ */
+void gas_sensor_live_reader_close(gas_sensor_live_reader_t reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_LIVE_H */
@@ -0,0 +1,465 @@
+/*
+ * Anesthetic Gas Sensor Memory Accounting - Implementation
+ *
+ * Ledger totals and budgets are atomics so that the shared pressure and
+ * usage queries stay lock-free; they are only written under the lock.
+ * Per-sensor usage lives in an open-addressing table keyed by sensor ID,
+ * sized for twice the capacity; an entry is removed when its usage drops
+ * to zero.
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor_mem.h"
+#include "gas_sensor_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+typedef struct {
+    uint32_t sensor_id;
+    bool used;
+    gas_sensor_mem_usage_t usage;
+} sensor_t;
+
+typedef struct {
+    gas_sensor_mem_reclaim_fn reclaim;
+    void *ctx;
+} reclaimer_t;
+
+struct gas_sensor_mem {
+    pthread_mutex_t lock;
+
+    /* Budgets and totals, written under the lock */
+    atomic_size_t budget_total;
+    atomic_size_t budget_subsystem[GAS_SENSOR_MEM_SUBSYSTEMS];
+    atomic_size_t budget_sensor;
+    atomic_uint soft_percent;
+    atomic_size_t total;
+    atomic_size_t subsystem[GAS_SENSOR_MEM_SUBSYSTEMS];
+    atomic_size_t peak;
+
+    sensor_t *sensors;
+    size_t mask;
+    size_t capacity;
+    reclaimer_t reclaimers[GAS_SENSOR_MEM_SUBSYSTEMS][GAS_SENSOR_MEM_MAX_RECLAIMERS];
+    size_t reclaimer_count[GAS_SENSOR_MEM_SUBSYSTEMS];
+    gas_sensor_mem_stats_t stats;
+};
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static size_t load(const atomic_size_t *v)
+{
+    return atomic_load_explicit(v, memory_order_relaxed);
+}
+
+static void store(atomic_size_t *v, size_t value)
+{
+    atomic_store_explicit(v, value, memory_order_relaxed);
+}
+
+GAS_SENSOR_ID_TABLE(sensor, sensor_t)
+
+/* Entry of a sensor, created if there is room; caller holds the lock */
+static sensor_t *sensor_entry(struct gas_sensor_mem *m, uint32_t sensor_id, bool create)
+{
+    size_t i = sensor_slot(m->sensors, m->mask, sensor_id);
+    if (m->sensors[i].used) {
+        return &m->sensors[i];
+    }
+    if (!create || m->stats.sensors >= m->capacity) {
+        return NULL;
+    }
+
+    memset(&m->sensors[i], 0, sizeof(m->sensors[i]));
+    m->sensors[i].used = true;
+    m->sensors[i].sensor_id = sensor_id;
+    m->stats.sensors++;
+    return &m->sensors[i];
+}
+
+/* Bytes over budget after adding bytes to used, 0 if it fits */
+static size_t excess(size_t used, size_t bytes, size_t budget)
+{
+    if (budget == 0 || used + bytes <= budget) {
+        return 0;
+    }
+    return used + bytes - budget;
+}
+
+static int level(size_t used, size_t budget, unsigned soft_percent)
+{
+    if (budget == 0) {
+        return GAS_SENSOR_MEM_NORMAL;
+    }
+    if (used >= budget) {
+        return GAS_SENSOR_MEM_HARD;
+    }
+    return ((uint64_t)used * 100 >= (uint64_t)budget * soft_percent)
+           ? GAS_SENSOR_MEM_SOFT : GAS_SENSOR_MEM_NORMAL;
+}
+
+/* Add a charge; caller holds the lock */
+static void add(struct gas_sensor_mem *m, sensor_t *s,
+                gas_sensor_mem_subsystem_t subsystem, size_t bytes)
+{
+    size_t total = load(&m->total) + bytes;
+    store(&m->total, total);
+    store(&m->subsystem[subsystem], load(&m->subsystem[subsystem]) + bytes);
+    if (total > load(&m->peak)) {
+        store(&m->peak, total);
+    }
+
+    if (s != NULL) {
+        s->usage.total += bytes;
+        s->usage.subsystem[subsystem] += bytes;
+        if (s->usage.total > s->usage.peak) {
+            s->usage.peak = s->usage.total;
+        }
+    }
+}
+
+static int check_config(const gas_sensor_mem_config_t *config)
+{
+    return (config->soft_percent == 0 || config->soft_percent > 100 || config->capacity == 0)
+           ? GAS_SENSOR_ERR_INVALID_PARAM : GAS_SENSOR_OK;
+}
+
+static void apply_budgets(struct gas_sensor_mem *m, const gas_sensor_mem_config_t *config)
+{
+    store(&m->budget_total, config->total);
+    for (int k = 0; k < GAS_SENSOR_MEM_SUBSYSTEMS; k++) {
+        store(&m->budget_subsystem[k], config->subsystem[k]);
+    }
+    store(&m->budget_sensor, config->per_sensor);
+    atomic_store_explicit(&m->soft_percent, config->soft_percent, memory_order_relaxed);
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+void gas_sensor_mem_config_init(gas_sensor_mem_config_t *config)
+{
+    if (config == NULL) {
+        return;
+    }
+
+    memset(config, 0, sizeof(*config));
+    config->soft_percent = GAS_SENSOR_MEM_DEFAULT_SOFT_PERCENT;
+    config->capacity = GAS_SENSOR_MEM_DEFAULT_CAPACITY;
+}
+
+int gas_sensor_mem_create(const gas_sensor_mem_config_t *config, gas_sensor_mem_t *mem)
+{
+    if (mem == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    gas_sensor_mem_config_t cfg;
+    if (config != NULL) {
+        cfg = *config;
+    } else {
+        gas_sensor_mem_config_init(&cfg);
+    }
+    if (check_config(&cfg) != GAS_SENSOR_OK) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    struct gas_sensor_mem *m = calloc(1, sizeof(*m));
+    if (m == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    size_t slots = 2;
+    while (slots < cfg.capacity * 2) {
+        slots <<= 1;
+    }
+    m->sensors = calloc(slots, sizeof(*m->sensors));
+    if (m->sensors == NULL) {
+        free(m);
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    m->mask = slots - 1;
+    m->capacity = cfg.capacity;
+
+    atomic_init(&m->total, 0);
+    atomic_init(&m->peak, 0);
+    for (int k = 0; k < GAS_SENSOR_MEM_SUBSYSTEMS; k++) {
+        atomic_init(&m->subsystem[k], 0);
+    }
+    apply_budgets(m, &cfg);
+    pthread_mutex_init(&m->lock, NULL);
+
+    *mem = m;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_mem_set_budgets(gas_sensor_mem_t mem, const gas_sensor_mem_config_t *config)
+{
+    if (mem == NULL || config == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (check_config(config) != GAS_SENSOR_OK) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    /* The sensor table is sized at creation */
+    pthread_mutex_lock(&mem->lock);
+    apply_budgets(mem, config);
+    pthread_mutex_unlock(&mem->lock);
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_mem_register(gas_sensor_mem_t mem,
+                            gas_sensor_mem_subsystem_t subsystem,
+                            gas_sensor_mem_reclaim_fn reclaim,
+                            void *ctx)
+{
+    if (mem == NULL || reclaim == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if ((unsigned)subsystem >= GAS_SENSOR_MEM_SUBSYSTEMS) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    int result = GAS_SENSOR_OK;
+    pthread_mutex_lock(&mem->lock);
+    size_t n = mem->reclaimer_count[subsystem];
+    if (n < GAS_SENSOR_MEM_MAX_RECLAIMERS) {
+        mem->reclaimers[subsystem][n].reclaim = reclaim;
+        mem->reclaimers[subsystem][n].ctx = ctx;
+        mem->reclaimer_count[subsystem] = n + 1;
+    } else {
+        result = GAS_SENSOR_ERR_NO_SPACE;
+    }
+    pthread_mutex_unlock(&mem->lock);
+    return result;
+}
+
+int gas_sensor_mem_charge(gas_sensor_mem_t mem,
+                          uint32_t sensor_id,
+                          gas_sensor_mem_subsystem_t subsystem,
+                          size_t bytes)
+{
+    if (mem == NULL) {
+        return GAS_SENSOR_OK;
+    }
+    if ((unsigned)subsystem >= GAS_SENSOR_MEM_SUBSYSTEMS) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    for (int attempt = 0; ; attempt++) {
+        pthread_mutex_lock(&mem->lock);
+
+        sensor_t *s = NULL;
+        size_t sensor_over = 0;
+        if (sensor_id != GAS_SENSOR_MEM_SHARED) {
+            s = sensor_entry(mem, sensor_id, false);
+            if (s == NULL && mem->stats.sensors >= mem->capacity) {
+                mem->stats.refusals++;
+                pthread_mutex_unlock(&mem->lock);
+                return GAS_SENSOR_ERR_NO_SPACE;
+            }
+            sensor_over = excess(s != NULL ? s->usage.total : 0, bytes, load(&mem->budget_sensor));
+        }
+
+        size_t shared_over = excess(load(&mem->total), bytes, load(&mem->budget_total));
+        size_t subsystem_over = excess(load(&mem->subsystem[subsystem]), bytes,
+                                       load(&mem->budget_subsystem[subsystem]));
+        if (subsystem_over > shared_over) {
+            shared_over = subsystem_over;
+        }
+
+        if (sensor_over == 0 && shared_over == 0) {
+            if (s == NULL && sensor_id != GAS_SENSOR_MEM_SHARED) {
+                s = sensor_entry(mem, sensor_id, true);
+            }
+            add(mem, s, subsystem, bytes);
+            mem->stats.charges++;
+            pthread_mutex_unlock(&mem->lock);
+            return GAS_SENSOR_OK;
+        }
+
+        size_t n = mem->reclaimer_count[subsystem];
+        if (attempt > 0 || n == 0) {
+            mem->stats.refusals++;
+            pthread_mutex_unlock(&mem->lock);
+            return GAS_SENSOR_ERR_NO_SPACE;
+        }
+
+        /* Reclaim from the sensor itself before reclaiming from everyone */
+        reclaimer_t reclaimers[GAS_SENSOR_MEM_MAX_RECLAIMERS];
+        memcpy(reclaimers, mem->reclaimers[subsystem], n * sizeof(reclaimers[0]));
+        pthread_mutex_unlock(&mem->lock);
+
+        uint64_t calls = 0;
+        uint64_t freed = 0;
+        size_t got = 0;
+        for (size_t k = 0; k < n && got < sensor_over; k++, calls++) {
+            got += reclaimers[k].reclaim(reclaimers[k].ctx, sensor_id, sensor_over - got);
+        }
+        freed += got;
+        got = 0;
+        for (size_t k = 0; k < n && got < shared_over; k++, calls++) {
+            got += reclaimers[k].reclaim(reclaimers[k].ctx, GAS_SENSOR_MEM_SHARED,
+                                         shared_over - got);
+        }
+        freed += got;
+
+        pthread_mutex_lock(&mem->lock);
+        mem->stats.reclaim_calls += calls;
+        mem->stats.reclaimed += freed;
+        pthread_mutex_unlock(&mem->lock);
+    }
+}
+
+void gas_sensor_mem_force(gas_sensor_mem_t mem,
+                          uint32_t sensor_id,
+                          gas_sensor_mem_subsystem_t subsystem,
+                          size_t bytes)
+{
+    if (mem == NULL || (unsigned)subsystem >= GAS_SENSOR_MEM_SUBSYSTEMS) {
+        return;
+    }
+
+    pthread_mutex_lock(&mem->lock);
+    sensor_t *s = (sensor_id != GAS_SENSOR_MEM_SHARED) ? sensor_entry(mem, sensor_id, true) : NULL;
+    add(mem, s, subsystem, bytes);
+    mem->stats.charges++;
+    pthread_mutex_unlock(&mem->lock);
+}
+
+void gas_sensor_mem_release(gas_sensor_mem_t mem,
+                            uint32_t sensor_id,
+                            gas_sensor_mem_subsystem_t subsystem,
+                            size_t bytes)
+{
+    if (mem == NULL || (unsigned)subsystem >= GAS_SENSOR_MEM_SUBSYSTEMS) {
+        return;
+    }
+
+    pthread_mutex_lock(&mem->lock);
+
+    size_t total = load(&mem->total);
+    size_t used = load(&mem->subsystem[subsystem]);
+    store(&mem->total, total - (bytes < total ? bytes : total));
+    store(&mem->subsystem[subsystem], used - (bytes < used ? bytes : used));
+
+    if (sensor_id != GAS_SENSOR_MEM_SHARED) {
+        size_t i = sensor_slot(mem->sensors, mem->mask, sensor_id);
+        sensor_t *s = &mem->sensors[i];
+        if (s->used) {
+            size_t n = s->usage.subsystem[subsystem];
+            n = (bytes < n) ? bytes : n;
+            s->usage.subsystem[subsystem] -= n;
+            s->usage.total -= n;
+            if (s->usage.total == 0) {
+                sensor_remove(mem->sensors, mem->mask, i);
+                mem->stats.sensors--;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&mem->lock);
+}
+
+int gas_sensor_mem_pressure(gas_sensor_mem_t mem,
+                            uint32_t sensor_id,
+                            gas_sensor_mem_subsystem_t subsystem)
+{
+    if (mem == NULL || (unsigned)subsystem >= GAS_SENSOR_MEM_SUBSYSTEMS) {
+        return GAS_SENSOR_MEM_NORMAL;
+    }
+
+    unsigned soft = atomic_load_explicit(&mem->soft_percent, memory_order_relaxed);
+    int result = level(load(&mem->total), load(&mem->budget_total), soft);
+    int sub = level(load(&mem->subsystem[subsystem]), load(&mem->budget_subsystem[subsystem]), soft);
+    if (sub > result) {
+        result = sub;
+    }
+
+    size_t budget = load(&mem->budget_sensor);
+    if (sensor_id != GAS_SENSOR_MEM_SHARED && budget != 0 && result != GAS_SENSOR_MEM_HARD) {
+        pthread_mutex_lock(&mem->lock);
+        sensor_t *s = sensor_entry(mem, sensor_id, false);
+        int own = level(s != NULL ? s->usage.total : 0, budget, soft);
+        pthread_mutex_unlock(&mem->lock);
+        if (own > result) {
+            result = own;
+        }
+    }
+    return result;
+}
+
+int gas_sensor_mem_usage(gas_sensor_mem_t mem, uint32_t sensor_id, gas_sensor_mem_usage_t *usage)
+{
+    if (mem == NULL || usage == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (sensor_id == GAS_SENSOR_MEM_SHARED) {
+        usage->total = load(&mem->total);
+        for (int k = 0; k < GAS_SENSOR_MEM_SUBSYSTEMS; k++) {
+            usage->subsystem[k] = load(&mem->subsystem[k]);
+        }
+        usage->peak = load(&mem->peak);
+        return GAS_SENSOR_OK;
+    }
+
+    pthread_mutex_lock(&mem->lock);
+    sensor_t *s = sensor_entry(mem, sensor_id, false);
+    if (s != NULL) {
+        *usage = s->usage;
+    } else {
+        memset(usage, 0, sizeof(*usage));
+    }
+    pthread_mutex_unlock(&mem->lock);
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_mem_foreach(gas_sensor_mem_t mem,
+                           void (*visit)(void *ctx, uint32_t sensor_id,
+                                         const gas_sensor_mem_usage_t *usage),
+                           void *ctx)
+{
+    if (mem == NULL || visit == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    pthread_mutex_lock(&mem->lock);
+    for (size_t i = 0; i <= mem->mask; i++) {
+        if (mem->sensors[i].used) {
+            visit(ctx, mem->sensors[i].sensor_id, &mem->sensors[i].usage);
+        }
+    }
+    pthread_mutex_unlock(&mem->lock);
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_mem_stats(gas_sensor_mem_t mem, gas_sensor_mem_stats_t *stats)
+{
+    if (mem == NULL || stats == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    pthread_mutex_lock(&mem->lock);
+    *stats = mem->stats;
+    pthread_mutex_unlock(&mem->lock);
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_mem_destroy(gas_sensor_mem_t mem)
+{
+    if (mem == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&mem->lock);
+    free(mem->sensors);
+    free(mem);
+}
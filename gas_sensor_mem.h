@@ -0,0 +1,253 @@
+/*
+ * Anesthetic Gas Sensor Memory Accounting
+ *
+ * Keeps a ledger of the memory each sensor and each subsystem holds, and
+ * enforces budgets on it. Components charge the ledger before they grow
+ * and credit it when they shrink; the allocation itself stays with the
+ * component. A charge that would exceed a budget is refused, and the
+ * component degrades instead of failing: a change-log writer keeps a
+ * coarser seek index, a delivery runs with a shorter bulk ring, a session
+ * manager refuses to attach one more sensor, a pipeline starts with
+ * shorter queues, an uplink drops waveform messages early, and a strand
+ * refuses a post.
+ *
+ * Not charged: the WebSocket server's payload pool and client buffers,
+ * the fleet and rank tables, the change-log reader's case records, and
+ * the breath store and live ring. The last two are file-backed mappings
+ * that live in the page cache, not on the heap; bound them by file size.
+ *
+ * Three kinds of budget apply to every charge, each optional:
+ *   - total: everything charged to the ledger
+ *   - subsystem: everything charged to one gas_sensor_mem_subsystem_t
+ *   - per sensor: everything charged to one sensor ID
+ * Memory not attributable to one sensor (shared queues, read buffers) is
+ * charged to GAS_SENSOR_MEM_SHARED and only counts against the total and
+ * subsystem budgets.
+ *
+ * Before refusing, the ledger calls the reclaimers registered for the
+ * subsystem, which may free memory of lower value (old history, finer
+ * rollups) and credit it back. Each budget also has a soft limit, by
+ * default at 80%, that gas_sensor_mem_pressure() reports so components
+ * can coarsen early instead of at the hard limit.
+ *
+ * Totals are atomic counters, so gas_sensor_mem_pressure() and
+ * gas_sensor_mem_usage() for totals take no lock; per-sensor queries and
+ * charges take the ledger mutex.
+ */
+
+#ifndef GAS_SENSOR_MEM_H
+#define GAS_SENSOR_MEM_H
+
+#include "gas_sensor.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Sensor ID for memory not attributed to one sensor */
+#define GAS_SENSOR_MEM_SHARED               0xFFFFFFFFu
+
+#define GAS_SENSOR_MEM_DEFAULT_CAPACITY     1024    /* Sensors tracked */
+#define GAS_SENSOR_MEM_DEFAULT_SOFT_PERCENT 80
+#define GAS_SENSOR_MEM_MAX_RECLAIMERS       16
+
+/* Accounted subsystems */
+typedef enum {
+    GAS_SENSOR_MEM_SESSION = 0,     /* Session state, stream and decoder buffers */
+    GAS_SENSOR_MEM_RING = 1,        /* Rings and history buffers */
+    GAS_SENSOR_MEM_INDEX = 2,       /* Seek indexes */
+    GAS_SENSOR_MEM_QUEUE = 3,       /* Delivery, pipeline, uplink and strand queues */
+    GAS_SENSOR_MEM_OTHER = 4,
+    GAS_SENSOR_MEM_SUBSYSTEMS = 5
+} gas_sensor_mem_subsystem_t;
+
+/* Pressure levels */
+#define GAS_SENSOR_MEM_NORMAL               0
+#define GAS_SENSOR_MEM_SOFT                 1   /* Past a soft limit: coarsen */
+#define GAS_SENSOR_MEM_HARD                 2   /* At a budget: charges are refused */
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_mem *gas_sensor_mem_t;
+
+/* Budgets in bytes; 0 = unlimited */
+typedef struct {
+    size_t total;
+    size_t subsystem[GAS_SENSOR_MEM_SUBSYSTEMS];
+    size_t per_sensor;
+    unsigned soft_percent;          /* Soft limit, percent of each budget */
+    size_t capacity;                /* Maximum sensors with memory charged */
+} gas_sensor_mem_config_t;
+
+/* Usage of one sensor, or of the whole ledger */
+typedef struct {
+    size_t total;
+    size_t subsystem[GAS_SENSOR_MEM_SUBSYSTEMS];
+    size_t peak;                    /* Highest total seen */
+} gas_sensor_mem_usage_t;
+
+typedef struct {
+    uint64_t charges;               /* Charges granted */
+    uint64_t refusals;              /* Charges refused */
+    uint64_t reclaim_calls;         /* Reclaimer invocations */
+    uint64_t reclaimed;             /* Bytes reclaimers reported freed */
+    size_t sensors;                 /* Sensors with memory charged */
+} gas_sensor_mem_stats_t;
+
+/**
+ * Reclaimer
+ *
+ * Called without the ledger lock held, so it credits what it frees with
+ * gas_sensor_mem_release() as usual.
+ *
+ * @param ctx: Reclaimer context
+ * @param sensor_id: Sensor over its budget, or GAS_SENSOR_MEM_SHARED when
+ *                   a total or subsystem budget is exceeded (free from
+ *                   any sensor)
+ * @param wanted: Bytes needed
+ * @return: Bytes freed
+ */
+typedef size_t (*gas_sensor_mem_reclaim_fn)(void *ctx, uint32_t sensor_id, size_t wanted);
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Initialize a configuration: no budgets, soft limit at 80%, 1024 sensors
+ */
+void gas_sensor_mem_config_init(gas_sensor_mem_config_t *config);
+
+/**
+ * Create a ledger
+ *
+ * @param config: Budgets, or NULL for the defaults
+ * @param mem: Output parameter for the ledger handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM,
+ *          GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_mem_create(const gas_sensor_mem_config_t *config, gas_sensor_mem_t *mem);
+
+/**
+ * Change the budgets of a ledger
+ *
+ * Usage above a lowered budget is not reclaimed; further charges are
+ * refused until it drops below.
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_mem_set_budgets(gas_sensor_mem_t mem, const gas_sensor_mem_config_t *config);
+
+/**
+ * Register a reclaimer for a subsystem
+ *
+ * Reclaimers are called in registration order until enough is freed.
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NO_SPACE,
+ *          GAS_SENSOR_ERR_INVALID_PARAM or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_mem_register(gas_sensor_mem_t mem,
+                            gas_sensor_mem_subsystem_t subsystem,
+                            gas_sensor_mem_reclaim_fn reclaim,
+                            void *ctx);
+
+/**
+ * Charge memory about to be allocated
+ *
+ * All or nothing: if a budget would be exceeded after reclaiming, nothing
+ * is charged.
+ *
+ * @param mem: Ledger, or NULL (always granted)
+ * @param sensor_id: Owning sensor, or GAS_SENSOR_MEM_SHARED
+ * @param subsystem: Subsystem
+ * @param bytes: Size
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NO_SPACE (over a budget, or the
+ *          sensor table is full) or GAS_SENSOR_ERR_INVALID_PARAM
+ */
+int gas_sensor_mem_charge(gas_sensor_mem_t mem,
+                          uint32_t sensor_id,
+                          gas_sensor_mem_subsystem_t subsystem,
+                          size_t bytes);
+
+/**
+ * Charge memory that must not be refused
+ *
+ * For allocations a component cannot do without, such as alarm state:
+ * the charge is counted even over a budget, so later charges see the
+ * pressure. The sensor is still tracked only if the table has room.
+ *
+ * @param mem: Ledger, or NULL (no-op)
+ */
+void gas_sensor_mem_force(gas_sensor_mem_t mem,
+                          uint32_t sensor_id,
+                          gas_sensor_mem_subsystem_t subsystem,
+                          size_t bytes);
+
+/**
+ * Credit memory that was freed
+ *
+ * @param mem: Ledger, or NULL (no-op)
+ */
+void gas_sensor_mem_release(gas_sensor_mem_t mem,
+                            uint32_t sensor_id,
+                            gas_sensor_mem_subsystem_t subsystem,
+                            size_t bytes);
+
+/**
+ * Get the pressure on the budgets a charge would be checked against
+ *
+ * Lock-free for GAS_SENSOR_MEM_SHARED.
+ *
+ * @param mem: Ledger, or NULL (GAS_SENSOR_MEM_NORMAL)
+ * @return: GAS_SENSOR_MEM_NORMAL, GAS_SENSOR_MEM_SOFT or GAS_SENSOR_MEM_HARD
+ */
+int gas_sensor_mem_pressure(gas_sensor_mem_t mem,
+                            uint32_t sensor_id,
+                            gas_sensor_mem_subsystem_t subsystem);
+
+/**
+ * Get memory usage
+ *
+ * @param mem: Ledger
+ * @param sensor_id: Sensor, or GAS_SENSOR_MEM_SHARED for the whole ledger
+ * @param usage: Output usage (zero for a sensor with nothing charged)
+ * @return: GAS_SENSOR_OK or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_mem_usage(gas_sensor_mem_t mem, uint32_t sensor_id, gas_sensor_mem_usage_t *usage);
+
+/**
+ * Visit the usage of every sensor with memory charged
+ *
+ * Called with the ledger lock held; the visitor must not call back into
+ * the ledger.
+ *
+ * @return: GAS_SENSOR_OK or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_mem_foreach(gas_sensor_mem_t mem,
+                           void (*visit)(void *ctx, uint32_t sensor_id,
+                                         const gas_sensor_mem_usage_t *usage),
+                           void *ctx);
+
+/**
+ * Get ledger counters
+ */
+int gas_sensor_mem_stats(gas_sensor_mem_t mem, gas_sensor_mem_stats_t *stats);
+
+/**
+ * Free a ledger; components charging it must be gone
+ */
+void gas_sensor_mem_destroy(gas_sensor_mem_t mem);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_MEM_H */
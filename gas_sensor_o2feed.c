@@ -0,0 +1,325 @@
+/*
+ * Anesthetic Gas Sensor O2 Compensation Feeder - Implementation
+ *
+ * Bound sensors live directly in an open-addressing table keyed by sensor
+ * ID; a pass walks the whole table, which is small (twice the capacity).
+ */
+
+#include "gas_sensor_o2feed.h"
+#include "gas_sensor_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+typedef struct {
+    uint32_t sensor_id;
+    bool used;
+    int fd;
+    bool config_known;              /* Configuration data frame seen */
+    bool o2_fitted;
+    bool sent;                      /* last_value is in effect on the sensor */
+    uint8_t last_value;             /* Last SetO2 parameter written */
+    bool pending;                   /* Source differs from last_value by less than the tolerance */
+    uint64_t pending_since_us;
+    uint64_t last_sent_us;
+} sensor_t;
+
+struct gas_sensor_o2feed {
+    pthread_mutex_t lock;
+    gas_sensor_o2feed_config_t config;
+    gas_sensor_o2_source_fn source;
+    void *source_ctx;
+    sensor_t *sensors;
+    size_t mask;
+    size_t bound;
+    uint64_t next_pass_us;
+    gas_sensor_o2feed_stats_t stats;
+};
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+GAS_SENSOR_ID_TABLE(sensor, sensor_t)
+
+static bool sensor_fed(const sensor_t *s)
+{
+    return s->used && s->config_known && !s->o2_fitted;
+}
+
+/* Decide whether a sensor needs a SetO2 now; caller holds the lock */
+static bool sensor_due(struct gas_sensor_o2feed *f, sensor_t *s,
+                       float o2, uint8_t target, uint64_t now_us)
+{
+    if (!s->sent || fabsf(o2 - (float)s->last_value) >= f->config.tolerance) {
+        return true;
+    }
+
+    if (f->config.refresh_ms != 0 &&
+        now_us - s->last_sent_us >= (uint64_t)f->config.refresh_ms * 1000) {
+        return true;
+    }
+
+    if (target == s->last_value) {
+        s->pending = false;
+        return false;
+    }
+
+    if (!s->pending) {
+        s->pending = true;
+        s->pending_since_us = now_us;
+    }
+    return f->config.max_lag_ms != 0 &&
+           now_us - s->pending_since_us >= (uint64_t)f->config.max_lag_ms * 1000;
+}
+
+static bool send_o2(sensor_t *s, uint8_t value)
+{
+    uint8_t command[GAS_SENSOR_COMMAND_SIZE];
+    gas_sensor_build_command(GAS_SENSOR_CMD_SET_O2, value, command);
+
+    ssize_t n;
+    do {
+        n = write(s->fd, command, sizeof(command));
+    } while (n < 0 && errno == EINTR);
+
+    /* A partial command is discarded by the sensor's checksum check */
+    return n == (ssize_t)sizeof(command);
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+void gas_sensor_o2feed_config_init(gas_sensor_o2feed_config_t *config)
+{
+    if (config == NULL) {
+        return;
+    }
+
+    config->capacity = GAS_SENSOR_O2FEED_DEFAULT_CAPACITY;
+    config->batch_ms = GAS_SENSOR_O2FEED_DEFAULT_BATCH_MS;
+    config->tolerance = GAS_SENSOR_O2FEED_DEFAULT_TOLERANCE;
+    config->max_lag_ms = GAS_SENSOR_O2FEED_DEFAULT_MAX_LAG_MS;
+    config->refresh_ms = GAS_SENSOR_O2FEED_DEFAULT_REFRESH_MS;
+}
+
+int gas_sensor_o2feed_create(const gas_sensor_o2feed_config_t *config,
+                             gas_sensor_o2_source_fn source,
+                             void *ctx,
+                             gas_sensor_o2feed_t *feeder)
+{
+    if (source == NULL || feeder == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    gas_sensor_o2feed_config_t cfg;
+    if (config != NULL) {
+        cfg = *config;
+    } else {
+        gas_sensor_o2feed_config_init(&cfg);
+    }
+
+    if (cfg.capacity == 0 || cfg.capacity > (SIZE_MAX / 4) / sizeof(sensor_t) ||
+        cfg.batch_ms == 0 || !(cfg.tolerance > 0.0f)) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    struct gas_sensor_o2feed *f = calloc(1, sizeof(*f));
+    if (f == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    /* Table at most half full */
+    size_t size = 1;
+    while (size < cfg.capacity * 2) {
+        size <<= 1;
+    }
+
+    f->sensors = calloc(size, sizeof(*f->sensors));
+    if (f->sensors == NULL) {
+        free(f);
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    f->mask = size - 1;
+    f->config = cfg;
+    f->source = source;
+    f->source_ctx = ctx;
+    pthread_mutex_init(&f->lock, NULL);
+
+    *feeder = f;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_o2feed_add(gas_sensor_o2feed_t feeder, uint32_t sensor_id, int fd)
+{
+    if (feeder == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (fd < 0) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    int ret = GAS_SENSOR_OK;
+    pthread_mutex_lock(&feeder->lock);
+
+    size_t i = sensor_slot(feeder->sensors, feeder->mask, sensor_id);
+    sensor_t *s = &feeder->sensors[i];
+    if (s->used) {
+        s->fd = fd;
+        s->sent = false;
+    } else if (feeder->bound == feeder->config.capacity) {
+        ret = GAS_SENSOR_ERR_NO_SPACE;
+    } else {
+        memset(s, 0, sizeof(*s));
+        s->used = true;
+        s->sensor_id = sensor_id;
+        s->fd = fd;
+        feeder->bound++;
+    }
+
+    pthread_mutex_unlock(&feeder->lock);
+    return ret;
+}
+
+int gas_sensor_o2feed_remove(gas_sensor_o2feed_t feeder, uint32_t sensor_id)
+{
+    if (feeder == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    int ret = GAS_SENSOR_OK;
+    pthread_mutex_lock(&feeder->lock);
+
+    size_t i = sensor_slot(feeder->sensors, feeder->mask, sensor_id);
+    if (feeder->sensors[i].used) {
+        sensor_remove(feeder->sensors, feeder->mask, i);
+        feeder->bound--;
+    } else {
+        ret = GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    pthread_mutex_unlock(&feeder->lock);
+    return ret;
+}
+
+int gas_sensor_o2feed_frame_handler(void *ctx, const gas_sensor_frame_event_t *event)
+{
+    struct gas_sensor_o2feed *f = ctx;
+    if (f == NULL || event == NULL || event->frame == NULL || event->slow_data == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    uint8_t id = gas_sensor_frame_id(event->frame);
+    if (id != 0x04 && id != 0x05) {
+        return GAS_SENSOR_OK;
+    }
+
+    pthread_mutex_lock(&f->lock);
+
+    sensor_t *s = &f->sensors[sensor_slot(f->sensors, f->mask, event->sensor_id)];
+    if (s->used) {
+        if (id == 0x05) {
+            s->config_known = true;
+            s->o2_fitted = event->slow_data->config_data.o2_fitted;
+        } else if (event->slow_data->sensor_regs.mode == GAS_SENSOR_MODE_SELF_TEST) {
+            /* Restarted sensors fall back to their default O2 value */
+            s->sent = false;
+        }
+    }
+
+    pthread_mutex_unlock(&f->lock);
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_o2feed_run(gas_sensor_o2feed_t feeder, uint64_t now_us)
+{
+    if (feeder == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    pthread_mutex_lock(&feeder->lock);
+
+    if (now_us < feeder->next_pass_us) {
+        pthread_mutex_unlock(&feeder->lock);
+        return 0;
+    }
+    feeder->next_pass_us = now_us + (uint64_t)feeder->config.batch_ms * 1000;
+    feeder->stats.passes++;
+
+    int sent = 0;
+    for (size_t i = 0; i <= feeder->mask; i++) {
+        sensor_t *s = &feeder->sensors[i];
+        if (!sensor_fed(s)) {
+            continue;
+        }
+
+        float o2;
+        if (feeder->source(feeder->source_ctx, s->sensor_id, &o2) != GAS_SENSOR_OK ||
+            isnan(o2)) {
+            feeder->stats.source_errors++;
+            continue;
+        }
+
+        if (o2 < 0.0f) {
+            o2 = 0.0f;
+        } else if (o2 > 100.0f) {
+            o2 = 100.0f;
+        }
+        uint8_t target = (uint8_t)lrintf(o2);
+
+        if (!sensor_due(feeder, s, o2, target, now_us)) {
+            continue;
+        }
+
+        if (send_o2(s, target)) {
+            s->sent = true;
+            s->last_value = target;
+            s->last_sent_us = now_us;
+            s->pending = false;
+            feeder->stats.commands++;
+            sent++;
+        } else {
+            feeder->stats.write_errors++;
+        }
+    }
+
+    pthread_mutex_unlock(&feeder->lock);
+    return sent;
+}
+
+int gas_sensor_o2feed_stats(gas_sensor_o2feed_t feeder, gas_sensor_o2feed_stats_t *stats)
+{
+    if (feeder == NULL || stats == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    pthread_mutex_lock(&feeder->lock);
+    *stats = feeder->stats;
+    stats->bound = feeder->bound;
+    stats->fed = 0;
+    for (size_t i = 0; i <= feeder->mask; i++) {
+        if (sensor_fed(&feeder->sensors[i])) {
+            stats->fed++;
+        }
+    }
+    pthread_mutex_unlock(&feeder->lock);
+
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_o2feed_destroy(gas_sensor_o2feed_t feeder)
+{
+    if (feeder == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&feeder->lock);
+    free(feeder->sensors);
+    free(feeder);
+}
@@ -0,0 +1,173 @@
+/*
+ * Anesthetic Gas Sensor O2 Compensation Feeder
+ *
+ * A sensor without the O2 option cannot measure O2 itself, but needs the
+ * inspired O2 level to compensate its CO2 reading. The host supplies it
+ * with the SetO2 command. The feeder binds one external O2 source (for
+ * example the ventilator's FiO2 setting) to every sensor that lacks the
+ * O2 option and keeps each of them up to date.
+ *
+ * Sensors are bound with their serial descriptor; whether the O2 option
+ * is fitted is learned from the configuration data frames (ID 0x05), so
+ * sensors with the option are never sent anything. Once per batch
+ * interval gas_sensor_o2feed_run() reads the source for every bound
+ * sensor and sends SetO2 where:
+ *   - no value has been sent yet, or the sensor restarted (self-test),
+ *   - the value moved by at least the tolerance from the one last sent,
+ *   - a smaller change has been pending for max_lag_ms, or
+ *   - refresh_ms passed since the last command (keeps sensors that reset
+ *     without being noticed in sync).
+ * The compensation lag is therefore at most one batch interval for
+ * significant changes and max_lag_ms plus one batch interval for any
+ * change.
+ *
+ * Commands are written with non-blocking writes; a command that does not
+ * fit is retried on the next pass. A mutex makes it safe to feed frames
+ * and run passes from different threads.
+ */
+
+#ifndef GAS_SENSOR_O2FEED_H
+#define GAS_SENSOR_O2FEED_H
+
+#include "gas_sensor.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_O2FEED_DEFAULT_CAPACITY      256
+#define GAS_SENSOR_O2FEED_DEFAULT_BATCH_MS      1000
+#define GAS_SENSOR_O2FEED_DEFAULT_TOLERANCE     2.0f
+#define GAS_SENSOR_O2FEED_DEFAULT_MAX_LAG_MS    10000
+#define GAS_SENSOR_O2FEED_DEFAULT_REFRESH_MS    60000
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_o2feed *gas_sensor_o2feed_t;
+
+/**
+ * O2 source
+ *
+ * Called once per bound sensor and pass, with the feeder lock held; it
+ * must not call back into the feeder. A source reading one shared value
+ * simply ignores sensor_id.
+ *
+ * @param ctx: Source context
+ * @param sensor_id: Sensor the value is for
+ * @param o2_percent: Output inspired O2 (%)
+ * @return: GAS_SENSOR_OK, or any other value if no value is available
+ *          (the sensor keeps its last value)
+ */
+typedef int (*gas_sensor_o2_source_fn)(void *ctx, uint32_t sensor_id, float *o2_percent);
+
+typedef struct {
+    size_t capacity;                /* Maximum bound sensors */
+    uint32_t batch_ms;              /* Interval between passes */
+    float tolerance;                /* Change (%) sent at the next pass */
+    uint32_t max_lag_ms;            /* Age at which smaller changes are sent, 0 = never */
+    uint32_t refresh_ms;            /* Resend unchanged values after this, 0 = never */
+} gas_sensor_o2feed_config_t;
+
+typedef struct {
+    uint64_t passes;                /* Passes run */
+    uint64_t commands;              /* SetO2 commands written */
+    uint64_t write_errors;          /* Commands not written (retried) */
+    uint64_t source_errors;         /* Source calls without a value */
+    size_t bound;                   /* Sensors bound */
+    size_t fed;                     /* Bound sensors known to lack the O2 option */
+} gas_sensor_o2feed_stats_t;
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Initialize a configuration with the defaults
+ */
+void gas_sensor_o2feed_config_init(gas_sensor_o2feed_config_t *config);
+
+/**
+ * Create a feeder
+ *
+ * @param config: Configuration, or NULL for the defaults
+ * @param source: O2 source
+ * @param ctx: Source context
+ * @param feeder: Output parameter for the feeder handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM,
+ *          GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_o2feed_create(const gas_sensor_o2feed_config_t *config,
+                             gas_sensor_o2_source_fn source,
+                             void *ctx,
+                             gas_sensor_o2feed_t *feeder);
+
+/**
+ * Bind a sensor
+ *
+ * Nothing is sent until a configuration data frame shows that the sensor
+ * lacks the O2 option. Binding a sensor again replaces its descriptor.
+ *
+ * @param feeder: Feeder handle
+ * @param sensor_id: Sensor identifier, as in its frame events
+ * @param fd: Serial descriptor commands are written to (stays owned by
+ *            the caller)
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NO_SPACE, GAS_SENSOR_ERR_INVALID_PARAM
+ *          or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_o2feed_add(gas_sensor_o2feed_t feeder, uint32_t sensor_id, int fd);
+
+/**
+ * Unbind a sensor
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM if the sensor is
+ *          not bound, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_o2feed_remove(gas_sensor_o2feed_t feeder, uint32_t sensor_id);
+
+/**
+ * Feed one frame event
+ *
+ * Matches gas_sensor_frame_handler_t, so a feeder can be passed directly
+ * to gas_sensor_session_attach() as handler context. Frames of unbound
+ * sensors are ignored.
+ *
+ * @param ctx: Feeder handle
+ * @param event: Frame event
+ * @return: GAS_SENSOR_OK or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_o2feed_frame_handler(void *ctx, const gas_sensor_frame_event_t *event);
+
+/**
+ * Run a pass if one is due
+ *
+ * Cheap when no pass is due, so it can be called on every iteration of
+ * the poll loop (with a poll timeout of at most the batch interval).
+ *
+ * @param feeder: Feeder handle
+ * @param now_us: Current time (us, any monotonic origin)
+ * @return: Number of commands written (>= 0), or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_o2feed_run(gas_sensor_o2feed_t feeder, uint64_t now_us);
+
+/**
+ * Get feeder counters
+ */
+int gas_sensor_o2feed_stats(gas_sensor_o2feed_t feeder, gas_sensor_o2feed_stats_t *stats);
+
+/**
+ * Free a feeder (descriptors are not closed)
+ */
+void gas_sensor_o2feed_destroy(gas_sensor_o2feed_t feeder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_O2FEED_H */
@@ -0,0 +1,210 @@
+/*
+ * Anesthetic Gas Sensor Raw Passthrough - Implementation
+ */
+
+#include "gas_sensor_passthrough.h"
+#include "gas_sensor_internal.h"
+#include <string.h>
+
+/* Largest timestamp offset an entry can hold */
+#define BATCH_MAX_OFFSET_US     0xFFFFFFFFull
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+/**
+ * Append one validated frame to the pending batch, flushing first if the
+ * batch is full, too old, or cannot represent the timestamp
+ */
+static int passthrough_append(gas_sensor_passthrough_t *pt,
+                              const uint8_t *frame_data,
+                              uint8_t flags)
+{
+    uint64_t ts = pt->rx_timestamp_us;
+
+    if (pt->count > 0 &&
+        (pt->count >= pt->max_frames ||
+         ts < pt->base_us ||
+         ts - pt->base_us > BATCH_MAX_OFFSET_US ||
+         (pt->max_age_us > 0 && ts - pt->base_us >= pt->max_age_us))) {
+        int result = gas_sensor_passthrough_flush(pt);
+        if (result != GAS_SENSOR_OK) {
+            return result;
+        }
+    }
+
+    if (pt->count == 0) {
+        pt->base_us = ts;
+    }
+
+    uint8_t *entry = &pt->batch[GAS_SENSOR_BATCH_HEADER_SIZE +
+                                pt->count * GAS_SENSOR_BATCH_ENTRY_SIZE];
+    put_uint32_le(entry, (uint32_t)(ts - pt->base_us));
+    entry[4] = flags;
+    memcpy(&entry[5], frame_data, GAS_SENSOR_FRAME_SIZE);
+    pt->count++;
+    pt->stats.frames++;
+
+    if (pt->count >= pt->max_frames) {
+        return gas_sensor_passthrough_flush(pt);
+    }
+    return GAS_SENSOR_OK;
+}
+
+/**
+ * Stream handler: check the ID sequence and forward the raw frame
+ */
+static int passthrough_on_frame(void *ctx, const uint8_t *frame_data)
+{
+    gas_sensor_passthrough_t *pt = ctx;
+    uint8_t frame_id = frame_data[2];
+
+    if (frame_id >= GAS_SENSOR_FRAME_ID_MAX) {
+        pt->stats.invalid_ids++;
+        return GAS_SENSOR_OK;
+    }
+
+    uint8_t flags = 0;
+    if (pt->have_id && frame_id != pt->next_id) {
+        flags |= GAS_SENSOR_BATCH_F_SEQ_GAP;
+        pt->stats.sequence_gaps++;
+    }
+    pt->next_id = (uint8_t)((frame_id + 1) % GAS_SENSOR_FRAME_ID_MAX);
+    pt->have_id = true;
+
+    int result = passthrough_append(pt, frame_data, flags);
+    if (result != GAS_SENSOR_OK && pt->result == GAS_SENSOR_OK) {
+        pt->result = result;
+    }
+    return GAS_SENSOR_OK;
+}
+
+/* ============================================================================
+ * Edge Side
+ * ============================================================================ */
+
+int gas_sensor_passthrough_init(gas_sensor_passthrough_t *pt,
+                                uint32_t sensor_id,
+                                size_t max_frames,
+                                uint64_t max_age_us,
+                                gas_sensor_batch_handler_t handler,
+                                void *ctx)
+{
+    if (pt == NULL || handler == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (max_frames == 0 || max_frames > GAS_SENSOR_BATCH_MAX_FRAMES) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    memset(pt, 0, sizeof(*pt));
+    pt->sensor_id = sensor_id;
+    pt->max_frames = max_frames;
+    pt->max_age_us = max_age_us;
+    pt->handler = handler;
+    pt->ctx = ctx;
+    gas_sensor_stream_init(&pt->stream);
+
+    /* Constant header fields are written once */
+    memcpy(pt->batch, GAS_SENSOR_BATCH_MAGIC, 4);
+    pt->batch[4] = GAS_SENSOR_BATCH_VERSION;
+    put_uint32_le(&pt->batch[8], sensor_id);
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_passthrough_feed(gas_sensor_passthrough_t *pt,
+                                const uint8_t *data,
+                                size_t length,
+                                uint64_t timestamp_us)
+{
+    if (pt == NULL || (data == NULL && length > 0)) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    pt->rx_timestamp_us = timestamp_us;
+    pt->result = GAS_SENSOR_OK;
+    gas_sensor_stream_feed(&pt->stream, data, length, passthrough_on_frame, pt);
+    return pt->result;
+}
+
+int gas_sensor_passthrough_tick(gas_sensor_passthrough_t *pt, uint64_t now_us)
+{
+    if (pt == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (pt->count > 0 && pt->max_age_us > 0 &&
+        now_us >= pt->base_us && now_us - pt->base_us >= pt->max_age_us) {
+        return gas_sensor_passthrough_flush(pt);
+    }
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_passthrough_flush(gas_sensor_passthrough_t *pt)
+{
+    if (pt == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (pt->count == 0) {
+        return GAS_SENSOR_OK;
+    }
+
+    put_uint16_le(&pt->batch[6], (uint16_t)pt->count);
+    put_uint64_le(&pt->batch[12], pt->base_us);
+
+    size_t length = GAS_SENSOR_BATCH_HEADER_SIZE + pt->count * GAS_SENSOR_BATCH_ENTRY_SIZE;
+    pt->count = 0;
+    pt->stats.batches++;
+    return pt->handler(pt->ctx, pt->batch, length);
+}
+
+/* ============================================================================
+ * Receiving Side
+ * ============================================================================ */
+
+int gas_sensor_batch_open(gas_sensor_batch_reader_t *reader,
+                          const uint8_t *batch,
+                          size_t length)
+{
+    if (reader == NULL || batch == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (length < GAS_SENSOR_BATCH_HEADER_SIZE ||
+        memcmp(batch, GAS_SENSOR_BATCH_MAGIC, 4) != 0 ||
+        batch[4] != GAS_SENSOR_BATCH_VERSION) {
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    size_t count = get_uint16_le(&batch[6]);
+    if (length < GAS_SENSOR_BATCH_HEADER_SIZE + count * GAS_SENSOR_BATCH_ENTRY_SIZE) {
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    reader->data = batch;
+    reader->count = count;
+    reader->index = 0;
+    reader->sensor_id = get_uint32_le(&batch[8]);
+    reader->base_us = get_uint64_le(&batch[12]);
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_batch_next(gas_sensor_batch_reader_t *reader,
+                          gas_sensor_batch_entry_t *entry)
+{
+    if (reader == NULL || entry == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (reader->index >= reader->count) {
+        return GAS_SENSOR_ERR_EOF;
+    }
+
+    const uint8_t *e = &reader->data[GAS_SENSOR_BATCH_HEADER_SIZE +
+                                     reader->index * GAS_SENSOR_BATCH_ENTRY_SIZE];
+    entry->timestamp_us = reader->base_us + get_uint32_le(e);
+    entry->flags = e[4];
+    entry->frame = &e[5];
+    reader->index++;
+    return GAS_SENSOR_OK;
+}
@@ -0,0 +1,191 @@
+/*
+ * Anesthetic Gas Sensor Raw Passthrough
+ *
+ * Edge forwarding without decoding: incoming bytes are synchronized and
+ * checksum-verified, the frame ID sequence is checked, and the untouched
+ * 21-byte frames are packed with their receive timestamps into batches for
+ * the uplink. No concentration is converted to float on the edge. The
+ * receiving side iterates batches with gas_sensor_batch_next() and decodes
+ * only what it needs, using the decode-on-demand accessors in gas_sensor.h
+ * or gas_sensor_parse_frame() for full state.
+ *
+ * Batch layout (multi-byte fields little-endian):
+ *   Header (20 bytes):
+ *     [0-3]   Magic "GSPB"
+ *     [4]     Format version
+ *     [5]     Reserved (0)
+ *     [6-7]   Entry count
+ *     [8-11]  Sensor ID
+ *     [12-19] Base timestamp (us since epoch)
+ *   Entries (26 bytes each):
+ *     [0-3]   Timestamp offset from base (us)
+ *     [4]     Entry flags (GAS_SENSOR_BATCH_F_*)
+ *     [5-25]  Raw frame
+ */
+
+#ifndef GAS_SENSOR_PASSTHROUGH_H
+#define GAS_SENSOR_PASSTHROUGH_H
+
+#include "gas_sensor.h"
+#include "gas_sensor_stream.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_BATCH_MAGIC          "GSPB"
+#define GAS_SENSOR_BATCH_VERSION        1
+#define GAS_SENSOR_BATCH_HEADER_SIZE    20
+#define GAS_SENSOR_BATCH_ENTRY_SIZE     (5 + GAS_SENSOR_FRAME_SIZE)
+#define GAS_SENSOR_BATCH_MAX_FRAMES     64
+#define GAS_SENSOR_BATCH_MAX_SIZE       (GAS_SENSOR_BATCH_HEADER_SIZE + \
+                                         GAS_SENSOR_BATCH_MAX_FRAMES * GAS_SENSOR_BATCH_ENTRY_SIZE)
+
+/* Entry flags */
+#define GAS_SENSOR_BATCH_F_SEQ_GAP      0x01    /* Frame ID did not follow the previous one */
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+/**
+ * Batch handler, called when a batch is complete
+ *
+ * @param ctx: User context
+ * @param batch: Encoded batch (valid during the call only)
+ * @param length: Batch size in bytes
+ * @return: GAS_SENSOR_OK, or an error that is returned to the feeder
+ */
+typedef int (*gas_sensor_batch_handler_t)(void *ctx, const uint8_t *batch, size_t length);
+
+/* Passthrough counters */
+typedef struct {
+    uint64_t frames;                /* Frames forwarded */
+    uint64_t batches;               /* Batches emitted */
+    uint64_t sequence_gaps;         /* Frames flagged GAS_SENSOR_BATCH_F_SEQ_GAP */
+    uint64_t invalid_ids;           /* Frames dropped for an ID outside 0-9 */
+} gas_sensor_passthrough_stats_t;
+
+/* Edge passthrough state; allocate anywhere and initialize */
+typedef struct {
+    uint32_t sensor_id;
+    size_t max_frames;              /* Frames per batch */
+    uint64_t max_age_us;            /* Oldest entry age that forces a flush */
+    gas_sensor_batch_handler_t handler;
+    void *ctx;
+
+    gas_sensor_stream_t stream;
+    uint64_t rx_timestamp_us;       /* Timestamp of bytes being fed */
+    uint8_t next_id;                /* Expected frame ID */
+    bool have_id;                   /* next_id is meaningful */
+    int result;                     /* First handler error during a feed */
+
+    uint8_t batch[GAS_SENSOR_BATCH_MAX_SIZE];
+    size_t count;                   /* Entries in batch */
+    uint64_t base_us;               /* Timestamp of the first entry */
+    gas_sensor_passthrough_stats_t stats;
+} gas_sensor_passthrough_t;
+
+/* Receive-side batch iterator */
+typedef struct {
+    const uint8_t *data;
+    size_t count;
+    size_t index;
+    uint32_t sensor_id;
+    uint64_t base_us;
+} gas_sensor_batch_reader_t;
+
+/* One forwarded frame */
+typedef struct {
+    uint64_t timestamp_us;          /* Receive time at the edge */
+    uint8_t flags;                  /* GAS_SENSOR_BATCH_F_* */
+    const uint8_t *frame;           /* Raw 21-byte frame inside the batch */
+} gas_sensor_batch_entry_t;
+
+/* ============================================================================
+ * Edge Side
+ * ============================================================================ */
+
+/**
+ * Initialize passthrough state
+ *
+ * @param pt: State to initialize
+ * @param sensor_id: Sensor identifier written into each batch
+ * @param max_frames: Frames per batch, 1 to GAS_SENSOR_BATCH_MAX_FRAMES
+ * @param max_age_us: Flush once the oldest pending frame is this old
+ *                    (0 = only flush on a full batch)
+ * @param handler: Receives every completed batch
+ * @param ctx: Handler context
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_passthrough_init(gas_sensor_passthrough_t *pt,
+                                uint32_t sensor_id,
+                                size_t max_frames,
+                                uint64_t max_age_us,
+                                gas_sensor_batch_handler_t handler,
+                                void *ctx);
+
+/**
+ * Feed received serial bytes
+ *
+ * @param pt: Passthrough state
+ * @param data: Received bytes
+ * @param length: Number of bytes
+ * @param timestamp_us: Receive time (us since epoch)
+ * @return: GAS_SENSOR_OK, the first handler error, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_passthrough_feed(gas_sensor_passthrough_t *pt,
+                                const uint8_t *data,
+                                size_t length,
+                                uint64_t timestamp_us);
+
+/**
+ * Flush the pending batch if its oldest frame reached max_age_us
+ *
+ * Call periodically so a quiet sensor's last frames are not held back.
+ */
+int gas_sensor_passthrough_tick(gas_sensor_passthrough_t *pt, uint64_t now_us);
+
+/**
+ * Emit the pending batch, if any
+ */
+int gas_sensor_passthrough_flush(gas_sensor_passthrough_t *pt);
+
+/* ============================================================================
+ * Receiving Side
+ * ============================================================================ */
+
+/**
+ * Validate a batch header and prepare to iterate its entries
+ *
+ * @param reader: Iterator to initialize
+ * @param batch: Encoded batch
+ * @param length: Batch size in bytes
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_FORMAT or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_batch_open(gas_sensor_batch_reader_t *reader,
+                          const uint8_t *batch,
+                          size_t length);
+
+/**
+ * Get the next forwarded frame
+ *
+ * No decoding is done; use the gas_sensor_frame_*() accessors or
+ * gas_sensor_parse_frame() on entry->frame as needed.
+ *
+ * @return: GAS_SENSOR_OK, or GAS_SENSOR_ERR_EOF after the last entry
+ */
+int gas_sensor_batch_next(gas_sensor_batch_reader_t *reader,
+                          gas_sensor_batch_entry_t *entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_PASSTHROUGH_H */
@@ -0,0 +1,558 @@
+/*
+ * Anesthetic Gas Sensor Parallel Pipeline - Implementation
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor_pipeline.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#define CACHE_LINE              64
+
+/* Items a worker takes from one input queue before looking at the next */
+#define WORKER_BATCH            64
+
+/* Backoff thresholds for idle workers and blocked producers */
+#define BACKOFF_SPINS           64
+#define BACKOFF_YIELDS          128
+#define BACKOFF_SLEEP_NS        50000
+
+/* ============================================================================
+ * Bounded SPSC Queue
+ *
+ * Producer and consumer indices live on separate cache lines, each side
+ * caching the other's index so the shared line is only read when the
+ * cached value says the queue looks full (or empty).
+ * ============================================================================ */
+
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_size_t tail;       /* Written by producer */
+    size_t cached_head;
+    _Alignas(CACHE_LINE) atomic_size_t head;       /* Written by consumer */
+    size_t cached_tail;
+    _Alignas(CACHE_LINE) size_t mask;
+    gas_sensor_pipeline_item_t *slots;
+} spsc_queue_t;
+
+static bool queue_push(spsc_queue_t *q, const gas_sensor_pipeline_item_t *item)
+{
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    if (tail - q->cached_head > q->mask) {
+        q->cached_head = atomic_load_explicit(&q->head, memory_order_acquire);
+        if (tail - q->cached_head > q->mask) {
+            return false;
+        }
+    }
+    q->slots[tail & q->mask] = *item;
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static bool queue_pop(spsc_queue_t *q, gas_sensor_pipeline_item_t *item)
+{
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if (head == q->cached_tail) {
+        q->cached_tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if (head == q->cached_tail) {
+            return false;
+        }
+    }
+    *item = q->slots[head & q->mask];
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return true;
+}
+
+static bool queue_empty(spsc_queue_t *q)
+{
+    return atomic_load_explicit(&q->head, memory_order_relaxed) ==
+           atomic_load_explicit(&q->tail, memory_order_acquire);
+}
+
+/* ============================================================================
+ * Pipeline State
+ * ============================================================================ */
+
+struct stage;
+
+typedef struct {
+    struct gas_sensor_pipeline *pipeline;
+    struct stage *stage;
+    unsigned index;
+    pthread_t thread;
+    bool running;
+
+    /* Published by the worker with relaxed stores, read by stats */
+    _Alignas(CACHE_LINE) atomic_uint_fast64_t items;
+    atomic_uint_fast64_t dropped;
+    atomic_uint_fast64_t stalls;
+    atomic_uint_fast64_t busy_ns;
+} worker_t;
+
+struct stage {
+    const char *name;
+    unsigned workers;
+    gas_sensor_stage_fn_t fn;
+    void *ctx;
+    size_t index;
+    unsigned upstream;                      /* Producers feeding each worker */
+    spsc_queue_t *queues;                   /* [upstream][workers] */
+    worker_t *worker;
+    atomic_uint finished;                   /* Workers that have exited */
+};
+
+struct gas_sensor_pipeline {
+    size_t capacity;
+    gas_sensor_mem_t mem;                   /* Ledger, or NULL */
+    size_t mem_charged;                     /* Queue slot bytes charged */
+    struct stage stages[GAS_SENSOR_PIPELINE_MAX_STAGES];
+    size_t count;
+    bool started;
+    bool joined;
+    atomic_bool input_closed;
+    atomic_bool abort;
+    atomic_int error;
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void backoff(unsigned *idle)
+{
+    unsigned n = (*idle)++;
+    if (n < BACKOFF_SPINS) {
+        return;
+    }
+    if (n < BACKOFF_YIELDS) {
+        sched_yield();
+        return;
+    }
+    struct timespec ts = { 0, BACKOFF_SLEEP_NS };
+    nanosleep(&ts, NULL);
+}
+
+static void pipeline_fail(struct gas_sensor_pipeline *pl, int error)
+{
+    int expected = GAS_SENSOR_OK;
+    atomic_compare_exchange_strong(&pl->error, &expected, error);
+    atomic_store(&pl->abort, true);
+}
+
+/**
+ * Queue an item for the worker of `next` that owns its sensor
+ * Returns false if the pipeline aborted while waiting for space.
+ */
+static bool forward(struct gas_sensor_pipeline *pl,
+                    struct stage *next,
+                    unsigned from,
+                    const gas_sensor_pipeline_item_t *item,
+                    uint64_t *stalls)
+{
+    spsc_queue_t *q = &next->queues[(size_t)from * next->workers +
+                                    item->sensor_id % next->workers];
+    if (queue_push(q, item)) {
+        return true;
+    }
+
+    (*stalls)++;
+    unsigned idle = 0;
+    while (!queue_push(q, item)) {
+        if (atomic_load_explicit(&pl->abort, memory_order_relaxed)) {
+            return false;
+        }
+        backoff(&idle);
+    }
+    return true;
+}
+
+static bool upstream_done(struct gas_sensor_pipeline *pl, struct stage *st)
+{
+    if (st->index == 0) {
+        return atomic_load_explicit(&pl->input_closed, memory_order_acquire);
+    }
+    return atomic_load_explicit(&pl->stages[st->index - 1].finished,
+                                memory_order_acquire) == st->upstream;
+}
+
+static void *worker_main(void *arg)
+{
+    worker_t *w = arg;
+    struct stage *st = w->stage;
+    struct gas_sensor_pipeline *pl = w->pipeline;
+    struct stage *next = (st->index + 1 < pl->count) ? &pl->stages[st->index + 1] : NULL;
+    uint64_t items = 0, dropped = 0, stalls = 0, busy_ns = 0;
+    gas_sensor_pipeline_item_t item;
+    unsigned idle = 0;
+
+    while (!atomic_load_explicit(&pl->abort, memory_order_relaxed)) {
+        bool got = false;
+
+        for (unsigned u = 0; u < st->upstream; u++) {
+            spsc_queue_t *q = &st->queues[(size_t)u * st->workers + w->index];
+
+            for (int n = 0; n < WORKER_BATCH && queue_pop(q, &item); n++) {
+                got = true;
+
+                uint64_t t0 = monotonic_ns();
+                int result = st->fn(st->ctx, w->index, &item);
+                busy_ns += monotonic_ns() - t0;
+                items++;
+
+                if (result < 0) {
+                    pipeline_fail(pl, result);
+                    goto out;
+                }
+                if (result == GAS_SENSOR_PIPELINE_DROP) {
+                    dropped++;
+                } else if (next != NULL && !forward(pl, next, w->index, &item, &stalls)) {
+                    goto out;
+                }
+            }
+
+            atomic_store_explicit(&w->items, items, memory_order_relaxed);
+            atomic_store_explicit(&w->dropped, dropped, memory_order_relaxed);
+            atomic_store_explicit(&w->stalls, stalls, memory_order_relaxed);
+            atomic_store_explicit(&w->busy_ns, busy_ns, memory_order_relaxed);
+        }
+
+        if (got) {
+            idle = 0;
+            continue;
+        }
+
+        /* Upstream state must be read before the emptiness check */
+        if (upstream_done(pl, st)) {
+            bool empty = true;
+            for (unsigned u = 0; u < st->upstream && empty; u++) {
+                empty = queue_empty(&st->queues[(size_t)u * st->workers + w->index]);
+            }
+            if (empty) {
+                break;
+            }
+        }
+        backoff(&idle);
+    }
+
+out:
+    atomic_store_explicit(&w->items, items, memory_order_relaxed);
+    atomic_store_explicit(&w->dropped, dropped, memory_order_relaxed);
+    atomic_store_explicit(&w->stalls, stalls, memory_order_relaxed);
+    atomic_store_explicit(&w->busy_ns, busy_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&st->finished, 1, memory_order_release);
+    return NULL;
+}
+
+static void pipeline_join(struct gas_sensor_pipeline *pl)
+{
+    for (size_t s = 0; s < pl->count; s++) {
+        struct stage *st = &pl->stages[s];
+        for (unsigned i = 0; st->worker != NULL && i < st->workers; i++) {
+            if (st->worker[i].running) {
+                pthread_join(st->worker[i].thread, NULL);
+                st->worker[i].running = false;
+            }
+        }
+    }
+    pl->joined = true;
+    pl->end_ns = monotonic_ns();
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+int gas_sensor_pipeline_create(size_t queue_capacity, gas_sensor_pipeline_t *pipeline)
+{
+    if (pipeline == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (queue_capacity == 0 || queue_capacity > ((size_t)1 << 24)) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    struct gas_sensor_pipeline *pl = calloc(1, sizeof(*pl));
+    if (pl == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    pl->capacity = 1;
+    while (pl->capacity < queue_capacity) {
+        pl->capacity <<= 1;
+    }
+    atomic_init(&pl->input_closed, false);
+    atomic_init(&pl->abort, false);
+    atomic_init(&pl->error, GAS_SENSOR_OK);
+
+    *pipeline = pl;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_pipeline_add_stage(gas_sensor_pipeline_t pipeline,
+                                  const char *name,
+                                  unsigned workers,
+                                  gas_sensor_stage_fn_t fn,
+                                  void *ctx)
+{
+    if (pipeline == NULL || fn == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (pipeline->started || pipeline->count >= GAS_SENSOR_PIPELINE_MAX_STAGES ||
+        workers == 0 || workers > GAS_SENSOR_PIPELINE_MAX_WORKERS) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    struct stage *st = &pipeline->stages[pipeline->count];
+    memset(st, 0, sizeof(*st));
+    st->name = name;
+    st->workers = workers;
+    st->fn = fn;
+    st->ctx = ctx;
+    st->index = pipeline->count;
+    st->upstream = (pipeline->count == 0) ? 1 : pipeline->stages[pipeline->count - 1].workers;
+    atomic_init(&st->finished, 0);
+    pipeline->count++;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_pipeline_set_mem(gas_sensor_pipeline_t pipeline, gas_sensor_mem_t mem)
+{
+    if (pipeline == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (pipeline->started || pipeline->mem_charged != 0) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    pipeline->mem = mem;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_pipeline_start(gas_sensor_pipeline_t pipeline)
+{
+    if (pipeline == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (pipeline->started || pipeline->count == 0) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    /* Shrink the queues until their slots fit the memory budget */
+    size_t queues = 0;
+    for (size_t s = 0; s < pipeline->count; s++) {
+        queues += (size_t)pipeline->stages[s].upstream * pipeline->stages[s].workers;
+    }
+    if (pipeline->mem_charged == 0) {
+        for (;;) {
+            size_t bytes = queues * pipeline->capacity * sizeof(gas_sensor_pipeline_item_t);
+            if (gas_sensor_mem_charge(pipeline->mem, GAS_SENSOR_MEM_SHARED,
+                                      GAS_SENSOR_MEM_QUEUE, bytes) == GAS_SENSOR_OK) {
+                pipeline->mem_charged = bytes;
+                break;
+            }
+            if (pipeline->capacity == 1) {
+                return GAS_SENSOR_ERR_NO_SPACE;
+            }
+            pipeline->capacity >>= 1;
+        }
+    }
+
+    /* Allocate everything before the first thread starts */
+    for (size_t s = 0; s < pipeline->count; s++) {
+        struct stage *st = &pipeline->stages[s];
+        size_t nq = (size_t)st->upstream * st->workers;
+
+        st->queues = aligned_alloc(CACHE_LINE, nq * sizeof(spsc_queue_t));
+        if (st->queues == NULL) {
+            return GAS_SENSOR_ERR_MEMORY;
+        }
+        memset(st->queues, 0, nq * sizeof(spsc_queue_t));
+
+        st->worker = aligned_alloc(CACHE_LINE, st->workers * sizeof(worker_t));
+        if (st->worker == NULL) {
+            return GAS_SENSOR_ERR_MEMORY;
+        }
+        memset(st->worker, 0, st->workers * sizeof(worker_t));
+
+        for (size_t i = 0; i < nq; i++) {
+            spsc_queue_t *q = &st->queues[i];
+            atomic_init(&q->head, 0);
+            atomic_init(&q->tail, 0);
+            q->mask = pipeline->capacity - 1;
+            q->slots = malloc(pipeline->capacity * sizeof(gas_sensor_pipeline_item_t));
+            if (q->slots == NULL) {
+                return GAS_SENSOR_ERR_MEMORY;
+            }
+        }
+        for (unsigned i = 0; i < st->workers; i++) {
+            st->worker[i].pipeline = pipeline;
+            st->worker[i].stage = st;
+            st->worker[i].index = i;
+        }
+    }
+
+    pipeline->started = true;
+    pipeline->start_ns = monotonic_ns();
+
+    for (size_t s = 0; s < pipeline->count; s++) {
+        struct stage *st = &pipeline->stages[s];
+        for (unsigned i = 0; i < st->workers; i++) {
+            if (pthread_create(&st->worker[i].thread, NULL, worker_main, &st->worker[i]) != 0) {
+                pipeline_fail(pipeline, GAS_SENSOR_ERR_IO);
+                atomic_store(&pipeline->input_closed, true);
+                pipeline_join(pipeline);
+                return GAS_SENSOR_ERR_IO;
+            }
+            st->worker[i].running = true;
+        }
+    }
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_pipeline_push(gas_sensor_pipeline_t pipeline,
+                             const gas_sensor_pipeline_item_t *item)
+{
+    if (pipeline == NULL || item == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (!pipeline->started || pipeline->joined) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    uint64_t stalls = 0;
+    if (!forward(pipeline, &pipeline->stages[0], 0, item, &stalls)) {
+        return atomic_load(&pipeline->error);
+    }
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_pipeline_push_merge(gas_sensor_pipeline_t pipeline,
+                                   gas_sensor_capture_merge_t merge)
+{
+    if (pipeline == NULL || merge == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    gas_sensor_frame_event_t event;
+    gas_sensor_pipeline_item_t item;
+    memset(&item, 0, sizeof(item));
+
+    for (;;) {
+        int result = gas_sensor_capture_merge_next(merge, &event);
+        if (result == GAS_SENSOR_ERR_EOF) {
+            return GAS_SENSOR_OK;
+        }
+        if (result != GAS_SENSOR_OK) {
+            return result;
+        }
+
+        item.sensor_id = event.sensor_id;
+        item.timestamp_us = event.timestamp_us;
+        memcpy(item.frame, event.frame, GAS_SENSOR_FRAME_SIZE);
+
+        result = gas_sensor_pipeline_push(pipeline, &item);
+        if (result != GAS_SENSOR_OK) {
+            return result;
+        }
+    }
+}
+
+int gas_sensor_pipeline_finish(gas_sensor_pipeline_t pipeline)
+{
+    if (pipeline == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (!pipeline->started) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    if (!pipeline->joined) {
+        atomic_store_explicit(&pipeline->input_closed, true, memory_order_release);
+        pipeline_join(pipeline);
+    }
+    return atomic_load(&pipeline->error);
+}
+
+int gas_sensor_pipeline_stage_stats(gas_sensor_pipeline_t pipeline,
+                                    size_t stage,
+                                    gas_sensor_stage_stats_t *stats)
+{
+    if (pipeline == NULL || stats == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (stage >= pipeline->count) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    struct stage *st = &pipeline->stages[stage];
+    memset(stats, 0, sizeof(*stats));
+    stats->name = st->name;
+    stats->workers = st->workers;
+
+    if (!pipeline->started) {
+        return GAS_SENSOR_OK;
+    }
+
+    for (unsigned i = 0; i < st->workers; i++) {
+        worker_t *w = &st->worker[i];
+        stats->items += atomic_load_explicit(&w->items, memory_order_relaxed);
+        stats->dropped += atomic_load_explicit(&w->dropped, memory_order_relaxed);
+        stats->stalls += atomic_load_explicit(&w->stalls, memory_order_relaxed);
+        stats->busy_ns += atomic_load_explicit(&w->busy_ns, memory_order_relaxed);
+    }
+
+    uint64_t end = pipeline->joined ? pipeline->end_ns : monotonic_ns();
+    if (end > pipeline->start_ns) {
+        stats->items_per_sec = (double)stats->items * 1e9 / (double)(end - pipeline->start_ns);
+    }
+    return GAS_SENSOR_OK;
+}
+
+size_t gas_sensor_pipeline_queue_capacity(gas_sensor_pipeline_t pipeline)
+{
+    return (pipeline != NULL) ? pipeline->capacity : 0;
+}
+
+size_t gas_sensor_pipeline_stage_count(gas_sensor_pipeline_t pipeline)
+{
+    return (pipeline != NULL) ? pipeline->count : 0;
+}
+
+void gas_sensor_pipeline_destroy(gas_sensor_pipeline_t pipeline)
+{
+    if (pipeline == NULL) {
+        return;
+    }
+
+    if (pipeline->started && !pipeline->joined) {
+        atomic_store(&pipeline->abort, true);
+        pipeline_join(pipeline);
+    }
+
+    for (size_t s = 0; s < pipeline->count; s++) {
+        struct stage *st = &pipeline->stages[s];
+        if (st->queues != NULL) {
+            for (size_t i = 0; i < (size_t)st->upstream * st->workers; i++) {
+                free(st->queues[i].slots);
+            }
+        }
+        free(st->queues);
+        free(st->worker);
+    }
+    gas_sensor_mem_release(pipeline->mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE,
+                           pipeline->mem_charged);
+    free(pipeline);
+}
@@ -0,0 +1,192 @@
+/*
+ * Anesthetic Gas Sensor Parallel Pipeline
+ *
+ * Multi-stage processing for offline re-analysis (decode, filter, breath
+ * segmentation, feature extraction, storage) that uses every core:
+ *
+ *   producer --> stage 0 (N0 workers) --> stage 1 (N1 workers) --> ...
+ *
+ * Each stage is partitioned by sensor: an item for sensor S is always
+ * handled by worker S % N of that stage. Every (upstream worker,
+ * downstream worker) pair is connected by its own bounded single-producer
+ * single-consumer ring, so queues are lock-free and items of one sensor
+ * keep their order through the whole pipeline. Stage state for a sensor is
+ * touched by exactly one thread and needs no locking.
+ *
+ * A full queue blocks its producer (back-pressure); an idle worker backs
+ * off from spinning to yielding to short sleeps. Every stage reports items,
+ * drops, time spent in the stage function and throughput.
+ *
+ * With a memory ledger set, the queue slots are charged to it as shared
+ * GAS_SENSOR_MEM_QUEUE memory at start; the queue capacity is halved until
+ * the charge fits the budget.
+ *
+ * POSIX threads and C11 atomics.
+ */
+
+#ifndef GAS_SENSOR_PIPELINE_H
+#define GAS_SENSOR_PIPELINE_H
+
+#include "gas_sensor.h"
+#include "gas_sensor_capture.h"
+#include "gas_sensor_mem.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_PIPELINE_MAX_STAGES      16
+#define GAS_SENSOR_PIPELINE_MAX_WORKERS     64
+
+/* Stage function result: consume the item without passing it on */
+#define GAS_SENSOR_PIPELINE_DROP            1
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_pipeline *gas_sensor_pipeline_t;
+
+/* Unit of work, copied by value between stages */
+typedef struct {
+    uint32_t sensor_id;
+    uint64_t timestamp_us;
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+    uint64_t tag;                   /* Free for stages (flags, features, ...) */
+    void *data;                     /* Free for stages; ownership is theirs */
+} gas_sensor_pipeline_item_t;
+
+/**
+ * Stage function
+ *
+ * @param ctx: Stage context
+ * @param worker: Worker index within the stage (0 to workers - 1); all
+ *                items of one sensor see the same index
+ * @param item: Item to process; may be modified before it moves on
+ * @return: GAS_SENSOR_OK to pass the item on, GAS_SENSOR_PIPELINE_DROP to
+ *          consume it, or a negative error code to abort the pipeline
+ */
+typedef int (*gas_sensor_stage_fn_t)(void *ctx,
+                                     unsigned worker,
+                                     gas_sensor_pipeline_item_t *item);
+
+/* Per-stage counters */
+typedef struct {
+    const char *name;
+    unsigned workers;
+    uint64_t items;                 /* Items processed */
+    uint64_t dropped;               /* Items consumed with GAS_SENSOR_PIPELINE_DROP */
+    uint64_t stalls;                /* Waits on a full downstream queue */
+    uint64_t busy_ns;               /* Time in the stage function, all workers */
+    double items_per_sec;           /* Items over pipeline wall time */
+} gas_sensor_stage_stats_t;
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Create an empty pipeline
+ *
+ * @param queue_capacity: Items per queue, rounded up to a power of two
+ * @param pipeline: Output parameter for the pipeline handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM,
+ *          GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_pipeline_create(size_t queue_capacity, gas_sensor_pipeline_t *pipeline);
+
+/**
+ * Append a stage (before gas_sensor_pipeline_start())
+ *
+ * @param pipeline: Pipeline handle
+ * @param name: Stage name for statistics (referenced, not copied)
+ * @param workers: Worker threads, 1 to GAS_SENSOR_PIPELINE_MAX_WORKERS
+ * @param fn: Stage function
+ * @param ctx: Stage context
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_pipeline_add_stage(gas_sensor_pipeline_t pipeline,
+                                  const char *name,
+                                  unsigned workers,
+                                  gas_sensor_stage_fn_t fn,
+                                  void *ctx);
+
+/**
+ * Set the memory ledger charged for the queues (before start)
+ *
+ * @param pipeline: Pipeline handle
+ * @param mem: Ledger, or NULL to stop accounting
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM (already started)
+ *          or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_pipeline_set_mem(gas_sensor_pipeline_t pipeline, gas_sensor_mem_t mem);
+
+/**
+ * Allocate queues and start all worker threads
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM (no stages or
+ *          already started), GAS_SENSOR_ERR_NO_SPACE (not even one-item
+ *          queues fit the memory budget), GAS_SENSOR_ERR_MEMORY or
+ *          GAS_SENSOR_ERR_IO
+ */
+int gas_sensor_pipeline_start(gas_sensor_pipeline_t pipeline);
+
+/**
+ * Submit one item (single producer thread)
+ *
+ * Blocks while the first stage's queue is full.
+ *
+ * @return: GAS_SENSOR_OK, or the error that aborted the pipeline
+ */
+int gas_sensor_pipeline_push(gas_sensor_pipeline_t pipeline,
+                             const gas_sensor_pipeline_item_t *item);
+
+/**
+ * Submit every remaining frame of a capture merge, in timestamp order
+ *
+ * @return: GAS_SENSOR_OK when the merge is drained, a read error, or the
+ *          error that aborted the pipeline
+ */
+int gas_sensor_pipeline_push_merge(gas_sensor_pipeline_t pipeline,
+                                   gas_sensor_capture_merge_t merge);
+
+/**
+ * Close the input, let every stage drain, and join all workers
+ *
+ * @return: GAS_SENSOR_OK, or the first error returned by a stage function
+ */
+int gas_sensor_pipeline_finish(gas_sensor_pipeline_t pipeline);
+
+/**
+ * Get a stage's counters (may be called while running)
+ */
+int gas_sensor_pipeline_stage_stats(gas_sensor_pipeline_t pipeline,
+                                    size_t stage,
+                                    gas_sensor_stage_stats_t *stats);
+
+/**
+ * Get the items per queue (after start, reduced to fit the memory budget)
+ */
+size_t gas_sensor_pipeline_queue_capacity(gas_sensor_pipeline_t pipeline);
+
+/**
+ * Get the number of stages
+ */
+size_t gas_sensor_pipeline_stage_count(gas_sensor_pipeline_t pipeline);
+
+/**
+ * Stop workers if still running and free the pipeline
+ */
+void gas_sensor_pipeline_destroy(gas_sensor_pipeline_t pipeline);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_PIPELINE_H */
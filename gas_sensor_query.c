@@ -0,0 +1,938 @@
+/*
+ * Anesthetic Gas Sensor Archive Queries - Implementation
+ *
+ * Each worker owns its batch buffers and a partial result, appended in
+ * scan order: rows of one file arrive in time order, so a group is almost
+ * always the last row appended and is updated in place. Partials are
+ * concatenated, sorted by key and combined once every file is done.
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor_query.h"
+#include "gas_sensor_breath.h"
+#include "gas_sensor_changelog.h"
+#include "gas_sensor_executor.h"
+#include "gas_sensor_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdatomic.h>
+#include <ctype.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define BATCH               GAS_SENSOR_BREATH_BLOCK_RECORDS
+#define VALUES              GAS_SENSOR_QCOL_VALUES
+#define MIN_ROWS            64
+#define TOKEN_SIZE          32
+
+/* Scan outcome of one file besides the error codes */
+#define FILE_SKIPPED        1
+
+#define SECOND_US           1000000ull
+
+/* Value columns 0-11 are laid out like the breath zone map */
+_Static_assert((int)GAS_SENSOR_QCOL_FI_CO2 == GAS_SENSOR_BREATH_ZONE_FI &&
+               (int)GAS_SENSOR_QCOL_RESP_RATE == GAS_SENSOR_BREATH_ZONE_RESP_RATE &&
+               (int)GAS_SENSOR_QCOL_STATUS == GAS_SENSOR_BREATH_ZONE_STATUS,
+               "query columns match zone map columns");
+
+/* Rows of one batch; columns point into a breath mapping or a worker buffer */
+typedef struct {
+    size_t count;
+    const uint64_t *time;
+    const uint8_t *col[VALUES];
+} batch_t;
+
+typedef struct {
+    const gas_sensor_query_t *query;
+    const char *const *paths;
+    size_t count;
+    atomic_size_t next;             /* Next file to scan */
+} run_t;
+
+typedef struct {
+    run_t *run;
+    gas_sensor_strand_t strand;
+    int error;
+
+    /* Partial result */
+    gas_sensor_query_row_t *rows;
+    size_t count;
+    size_t capacity;
+    gas_sensor_query_stats_t stats;
+
+    /* Batch buffers */
+    uint64_t time[BATCH];
+    uint8_t col[VALUES][BATCH];
+    uint8_t sel[BATCH];
+} worker_t;
+
+static const char *const column_names[] = {
+    "et_co2", "et_n2o", "et_aa1", "et_aa2", "et_o2",
+    "fi_co2", "fi_n2o", "fi_aa1", "fi_aa2", "fi_o2",
+    "resp_rate", "status", "agent", "sensor"
+};
+
+static const char *const agent_names[] = {
+    "none", "hal", "enf", "iso", "sev", "des"
+};
+
+static const char *const status_names[] = {
+    "breath", "apnea", "o2_low", "o2_replace",
+    "check_adapter", "accuracy", "sensor_error", "o2_calibration"
+};
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+/* Whether GAS_SENSOR_NO_DATA marks a missing value in a column */
+static bool col_nullable(gas_sensor_query_col_t column)
+{
+    return column != GAS_SENSOR_QCOL_STATUS && column != GAS_SENSOR_QCOL_SENSOR;
+}
+
+/* Evaluate a predicate on one value */
+static bool pred_match(const gas_sensor_query_pred_t *p, uint32_t value)
+{
+    if (col_nullable(p->column) && value == GAS_SENSOR_NO_DATA) {
+        return false;
+    }
+    switch (p->op) {
+        case GAS_SENSOR_QOP_EQ: return value == p->value;
+        case GAS_SENSOR_QOP_NE: return value != p->value;
+        case GAS_SENSOR_QOP_LT: return value < p->value;
+        case GAS_SENSOR_QOP_LE: return value <= p->value;
+        case GAS_SENSOR_QOP_GT: return value > p->value;
+        case GAS_SENSOR_QOP_GE: return value >= p->value;
+        case GAS_SENSOR_QOP_HAS: return (value & p->value) != 0;
+    }
+    return false;
+}
+
+/* Whether a file with this sensor can hold matching rows */
+static bool file_match(const gas_sensor_query_t *q, uint32_t sensor_id, bool has_agent)
+{
+    for (size_t i = 0; i < q->predicate_count; i++) {
+        const gas_sensor_query_pred_t *p = &q->predicates[i];
+        if (p->column == GAS_SENSOR_QCOL_SENSOR && !pred_match(p, sensor_id)) {
+            return false;
+        }
+        if (p->column == GAS_SENSOR_QCOL_AGENT && !has_agent) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Whether a block with these bounds can hold matching rows */
+static bool zone_match(const gas_sensor_query_t *q, const gas_sensor_breath_zone_t *zone)
+{
+    for (size_t i = 0; i < q->predicate_count; i++) {
+        const gas_sensor_query_pred_t *p = &q->predicates[i];
+        if (p->column >= GAS_SENSOR_BREATH_ZONE_COLUMNS) {
+            continue;
+        }
+
+        uint32_t min = zone->min[p->column];
+        uint32_t max = zone->max[p->column];
+        if (min > max) {
+            return false;               /* No value in the block */
+        }
+
+        bool match = true;
+        switch (p->op) {
+            case GAS_SENSOR_QOP_EQ: match = (min <= p->value && p->value <= max); break;
+            case GAS_SENSOR_QOP_NE: match = !(min == max && min == p->value); break;
+            case GAS_SENSOR_QOP_LT: match = (min < p->value); break;
+            case GAS_SENSOR_QOP_LE: match = (min <= p->value); break;
+            case GAS_SENSOR_QOP_GT: match = (max > p->value); break;
+            case GAS_SENSOR_QOP_GE: match = (max >= p->value); break;
+            case GAS_SENSOR_QOP_HAS: match = ((max & p->value) != 0); break;
+        }
+        if (!match) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int rows_append(worker_t *w, uint64_t key)
+{
+    if (w->count == w->capacity) {
+        size_t capacity = (w->capacity > 0) ? w->capacity * 2 : MIN_ROWS;
+        gas_sensor_query_row_t *rows = realloc(w->rows, capacity * sizeof(*rows));
+        if (rows == NULL) {
+            return GAS_SENSOR_ERR_MEMORY;
+        }
+        w->rows = rows;
+        w->capacity = capacity;
+    }
+
+    gas_sensor_query_row_t *row = &w->rows[w->count++];
+    row->key = key;
+    row->count = 0;
+    row->sum = 0;
+    row->min = 0xFF;
+    row->max = 0;
+    return GAS_SENSOR_OK;
+}
+
+static void row_combine(gas_sensor_query_row_t *row, const gas_sensor_query_row_t *other)
+{
+    row->count += other->count;
+    row->sum += other->sum;
+    if (other->min < row->min) {
+        row->min = other->min;
+    }
+    if (other->max > row->max) {
+        row->max = other->max;
+    }
+}
+
+static int row_compare(const void *a, const void *b)
+{
+    uint64_t ka = ((const gas_sensor_query_row_t *)a)->key;
+    uint64_t kb = ((const gas_sensor_query_row_t *)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+/* ============================================================================
+ * Kernels
+ *
+ * Byte loops without branches, which compilers vectorize. A selection
+ * byte is 1 for a row still selected and 0 otherwise; "all" is 1 for the
+ * status column, where 0xFF is a value rather than a missing one.
+ * ============================================================================ */
+
+static void filter(const gas_sensor_query_pred_t *p, const uint8_t *c, size_t n, uint8_t *sel)
+{
+    const uint8_t v = (uint8_t)p->value;
+    const uint8_t all = col_nullable(p->column) ? 0 : 1;
+
+    switch (p->op) {
+        case GAS_SENSOR_QOP_EQ:
+            for (size_t i = 0; i < n; i++) {
+                sel[i] &= (uint8_t)(c[i] == v);
+            }
+            break;
+        case GAS_SENSOR_QOP_NE:
+            for (size_t i = 0; i < n; i++) {
+                sel[i] &= (uint8_t)(c[i] != v) & ((uint8_t)(c[i] != GAS_SENSOR_NO_DATA) | all);
+            }
+            break;
+        case GAS_SENSOR_QOP_LT:
+            for (size_t i = 0; i < n; i++) {
+                sel[i] &= (uint8_t)(c[i] < v);
+            }
+            break;
+        case GAS_SENSOR_QOP_LE:
+            for (size_t i = 0; i < n; i++) {
+                sel[i] &= (uint8_t)(c[i] <= v);
+            }
+            break;
+        case GAS_SENSOR_QOP_GT:
+            for (size_t i = 0; i < n; i++) {
+                sel[i] &= (uint8_t)(c[i] > v) & ((uint8_t)(c[i] != GAS_SENSOR_NO_DATA) | all);
+            }
+            break;
+        case GAS_SENSOR_QOP_GE:
+            for (size_t i = 0; i < n; i++) {
+                sel[i] &= (uint8_t)(c[i] >= v) & ((uint8_t)(c[i] != GAS_SENSOR_NO_DATA) | all);
+            }
+            break;
+        case GAS_SENSOR_QOP_HAS:
+            for (size_t i = 0; i < n; i++) {
+                sel[i] &= (uint8_t)((c[i] & v) != 0);
+            }
+            break;
+    }
+}
+
+/* Fold the selected values of rows [lo, hi) into the group of key */
+static int fold(worker_t *w, const uint8_t *c, uint8_t all, size_t lo, size_t hi, uint64_t key)
+{
+    const uint8_t *sel = w->sel;
+    uint64_t sum = 0;
+    uint32_t count = 0;
+    uint8_t min = 0xFF;
+    uint8_t max = 0;
+
+    for (size_t i = lo; i < hi; i++) {
+        uint8_t m = sel[i] & ((uint8_t)(c[i] != GAS_SENSOR_NO_DATA) | all);
+        uint8_t v = c[i] & (uint8_t)-m;             /* Value, or 0 */
+        uint8_t v_min = v | (uint8_t)(m - 1);       /* Value, or 0xFF */
+        sum += v;
+        count += m;
+        min = (v_min < min) ? v_min : min;
+        max = (v > max) ? v : max;
+    }
+
+    if (count == 0) {
+        return GAS_SENSOR_OK;
+    }
+    if (w->count == 0 || w->rows[w->count - 1].key != key) {
+        int result = rows_append(w, key);
+        if (result != GAS_SENSOR_OK) {
+            return result;
+        }
+    }
+
+    gas_sensor_query_row_t part = { key, count, sum, min, max };
+    row_combine(&w->rows[w->count - 1], &part);
+    return GAS_SENSOR_OK;
+}
+
+static int process_batch(worker_t *w, const batch_t *b, uint32_t sensor_id)
+{
+    const gas_sensor_query_t *q = w->run->query;
+    size_t n = b->count;
+
+    memset(w->sel, 1, n);
+    for (size_t i = 0; i < q->predicate_count; i++) {
+        const gas_sensor_query_pred_t *p = &q->predicates[i];
+        if (p->column < VALUES) {
+            filter(p, b->col[p->column], n, w->sel);
+        }
+    }
+
+    uint64_t matched = 0;
+    for (size_t i = 0; i < n; i++) {
+        matched += w->sel[i];
+    }
+    w->stats.rows_scanned += n;
+    w->stats.rows_matched += matched;
+    if (matched == 0) {
+        return GAS_SENSOR_OK;
+    }
+
+    const uint8_t *c = b->col[q->column];
+    const uint8_t all = col_nullable(q->column) ? 0 : 1;
+
+    switch (q->group) {
+        case GAS_SENSOR_QUERY_GROUP_NONE:
+            return fold(w, c, all, 0, n, 0);
+        case GAS_SENSOR_QUERY_GROUP_SENSOR:
+            return fold(w, c, all, 0, n, sensor_id);
+        case GAS_SENSOR_QUERY_GROUP_TIME:
+            break;
+    }
+
+    /* Runs of rows in the same bucket */
+    size_t i = 0;
+    while (i < n) {
+        uint64_t key = b->time[i] - b->time[i] % q->bucket_us;
+        size_t j = i + 1;
+        while (j < n && b->time[j] - key < q->bucket_us) {
+            j++;
+        }
+        int result = fold(w, c, all, i, j, key);
+        if (result != GAS_SENSOR_OK) {
+            return result;
+        }
+        i = j;
+    }
+    return GAS_SENSOR_OK;
+}
+
+/* ============================================================================
+ * Sources
+ * ============================================================================ */
+
+static int scan_breath(worker_t *w, const char *path)
+{
+    const gas_sensor_query_t *q = w->run->query;
+    gas_sensor_breath_reader_t reader;
+    int result = gas_sensor_breath_reader_open(path, &reader);
+    if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+
+    uint32_t sensor_id = gas_sensor_breath_sensor_id(reader);
+    if (!file_match(q, sensor_id, false)) {
+        gas_sensor_breath_reader_close(reader);
+        return FILE_SKIPPED;
+    }
+
+    /* Breath stores hold no agent */
+    memset(w->col[GAS_SENSOR_QCOL_AGENT], GAS_SENSOR_NO_DATA, BATCH);
+
+    gas_sensor_breath_scan_t scan;
+    gas_sensor_breath_columns_t columns;
+    gas_sensor_breath_scan_init(&scan, reader, q->from_us, q->to_us);
+
+    while ((result = gas_sensor_breath_scan_next(&scan, &columns)) == GAS_SENSOR_OK) {
+        w->stats.blocks++;
+        if (columns.zone != NULL && !zone_match(q, columns.zone)) {
+            w->stats.blocks_skipped++;
+            continue;
+        }
+
+        batch_t b;
+        b.count = columns.count;
+        b.time = columns.start_us;
+        for (int ch = 0; ch < GAS_SENSOR_CH_COUNT; ch++) {
+            b.col[GAS_SENSOR_QCOL_ET_CO2 + ch] = columns.et[ch];
+            b.col[GAS_SENSOR_QCOL_FI_CO2 + ch] = columns.fi[ch];
+        }
+        b.col[GAS_SENSOR_QCOL_RESP_RATE] = columns.resp_rate;
+        b.col[GAS_SENSOR_QCOL_STATUS] = columns.status;
+        b.col[GAS_SENSOR_QCOL_AGENT] = w->col[GAS_SENSOR_QCOL_AGENT];
+
+        result = process_batch(w, &b, sensor_id);
+        if (result != GAS_SENSOR_OK) {
+            break;
+        }
+    }
+
+    gas_sensor_breath_reader_close(reader);
+    return (result == GAS_SENSOR_ERR_EOF) ? GAS_SENSOR_OK : result;
+}
+
+/* Decode one row from the slow data after a completed cycle */
+static void capture_row(worker_t *w, size_t i, const gas_sensor_slow_data_t *slow)
+{
+    const float et[GAS_SENSOR_CH_COUNT] = {
+        slow->exp_vals.co2, slow->exp_vals.n2o, slow->exp_vals.aa1,
+        slow->exp_vals.aa2, slow->exp_vals.o2
+    };
+    const float fi[GAS_SENSOR_CH_COUNT] = {
+        slow->insp_vals.co2, slow->insp_vals.n2o, slow->insp_vals.aa1,
+        slow->insp_vals.aa2, slow->insp_vals.o2
+    };
+
+    for (int ch = 0; ch < GAS_SENSOR_CH_COUNT; ch++) {
+        w->col[GAS_SENSOR_QCOL_ET_CO2 + ch][i] = conc_to_raw(et[ch]);
+        w->col[GAS_SENSOR_QCOL_FI_CO2 + ch][i] = conc_to_raw(fi[ch]);
+    }
+    w->col[GAS_SENSOR_QCOL_RESP_RATE][i] = slow->gen_vals.resp_rate;
+    w->col[GAS_SENSOR_QCOL_AGENT][i] = (uint8_t)slow->gen_vals.primary_agent;
+}
+
+static int scan_capture(worker_t *w, const char *path)
+{
+    const gas_sensor_query_t *q = w->run->query;
+    gas_sensor_changelog_reader_t reader;
+    int result = gas_sensor_changelog_reader_open(path, &reader);
+    if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+
+    uint32_t sensor_id = gas_sensor_changelog_sensor_id(reader);
+    if (!file_match(q, sensor_id, true)) {
+        gas_sensor_changelog_reader_close(reader);
+        return FILE_SKIPPED;
+    }
+    if (q->from_us > 0) {
+        result = gas_sensor_changelog_seek(reader, q->from_us);
+    }
+
+    batch_t b;
+    b.time = w->time;
+    for (int c = 0; c < VALUES; c++) {
+        b.col[c] = w->col[c];
+    }
+
+    gas_sensor_cycle_t cycle;
+    gas_sensor_cycle_init(&cycle);
+    gas_sensor_frame_event_t event;
+    uint8_t status = 0;
+    size_t n = 0;
+
+    while (result == GAS_SENSOR_OK &&
+           (result = gas_sensor_changelog_next(reader, &event)) == GAS_SENSOR_OK) {
+        if (event.timestamp_us >= q->to_us) {
+            break;
+        }
+        w->stats.frames++;
+
+        status |= gas_sensor_frame_status(event.frame);
+        if (!gas_sensor_cycle_update(&cycle, gas_sensor_frame_id(event.frame))) {
+            continue;
+        }
+
+        w->time[n] = event.timestamp_us;
+        w->col[GAS_SENSOR_QCOL_STATUS][n] = status;
+        capture_row(w, n, event.slow_data);
+        status = 0;
+
+        if (++n == BATCH) {
+            b.count = n;
+            result = process_batch(w, &b, sensor_id);
+            n = 0;
+        }
+    }
+    if (result == GAS_SENSOR_ERR_EOF) {
+        result = GAS_SENSOR_OK;
+    }
+    if (result == GAS_SENSOR_OK && n > 0) {
+        b.count = n;
+        result = process_batch(w, &b, sensor_id);
+    }
+
+    gas_sensor_changelog_reader_close(reader);
+    return result;
+}
+
+static int scan_file(worker_t *w, const char *path)
+{
+    char magic[4];
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return GAS_SENSOR_ERR_IO;
+    }
+    ssize_t got = read(fd, magic, sizeof(magic));
+    close(fd);
+
+    if (got == (ssize_t)sizeof(magic) && memcmp(magic, GAS_SENSOR_BREATH_MAGIC, 4) == 0) {
+        return scan_breath(w, path);
+    }
+    return scan_capture(w, path);
+}
+
+static void worker_task(void *arg)
+{
+    worker_t *w = arg;
+    run_t *run = w->run;
+
+    for (;;) {
+        size_t i = atomic_fetch_add_explicit(&run->next, 1, memory_order_relaxed);
+        if (i >= run->count) {
+            break;
+        }
+
+        int result = scan_file(w, run->paths[i]);
+        if (result == FILE_SKIPPED) {
+            w->stats.files_skipped++;
+        } else if (result == GAS_SENSOR_ERR_MEMORY) {
+            w->error = result;
+        } else if (result != GAS_SENSOR_OK) {
+            w->stats.files_failed++;
+        }
+    }
+}
+
+/* ============================================================================
+ * Parser
+ * ============================================================================ */
+
+typedef struct {
+    const char *text;
+    const char *p;
+    const char *token_start;
+    char token[TOKEN_SIZE];
+} parser_t;
+
+/* Read a word or an operator; false at the end or on an overlong token */
+static bool next_token(parser_t *ps)
+{
+    while (isspace((unsigned char)*ps->p)) {
+        ps->p++;
+    }
+    ps->token_start = ps->p;
+
+    size_t len = 0;
+    if (*ps->p != '\0' && strchr("=!<>", *ps->p) != NULL) {
+        while (*ps->p != '\0' && strchr("=!<>", *ps->p) != NULL && len < TOKEN_SIZE - 1) {
+            ps->token[len++] = *ps->p++;
+        }
+    } else {
+        while (isalnum((unsigned char)*ps->p) || *ps->p == '_' || *ps->p == '.') {
+            if (len == TOKEN_SIZE - 1) {
+                return false;
+            }
+            ps->token[len++] = (char)tolower((unsigned char)*ps->p++);
+        }
+    }
+    ps->token[len] = '\0';
+    return len > 0;
+}
+
+static bool parse_uint(const char *s, uint64_t max, uint64_t *value)
+{
+    char *end;
+    if (!isdigit((unsigned char)*s)) {
+        return false;
+    }
+    unsigned long long v = strtoull(s, &end, 10);
+    if (*end != '\0' || v > max) {
+        return false;
+    }
+    *value = v;
+    return true;
+}
+
+static bool lookup(const char *const *names, size_t count, const char *s, uint64_t *index)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(names[i], s) == 0) {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_column(const char *s, gas_sensor_query_col_t *column)
+{
+    uint64_t i;
+    if (!lookup(column_names, sizeof(column_names) / sizeof(column_names[0]), s, &i)) {
+        return false;
+    }
+    *column = (gas_sensor_query_col_t)i;
+    return true;
+}
+
+static bool parse_value(gas_sensor_query_col_t column, const char *s, uint32_t *value)
+{
+    uint64_t v;
+
+    switch (column) {
+        case GAS_SENSOR_QCOL_RESP_RATE:
+            if (!parse_uint(s, GAS_SENSOR_NO_DATA - 1, &v)) {
+                return false;
+            }
+            break;
+        case GAS_SENSOR_QCOL_STATUS:
+            if (lookup(status_names, 8, s, &v)) {
+                v = 1ull << v;
+            } else if (!parse_uint(s, 0xFF, &v)) {
+                return false;
+            }
+            break;
+        case GAS_SENSOR_QCOL_AGENT:
+            if (!lookup(agent_names, 6, s, &v) && !parse_uint(s, GAS_SENSOR_NO_DATA - 1, &v)) {
+                return false;
+            }
+            break;
+        case GAS_SENSOR_QCOL_SENSOR:
+            if (!parse_uint(s, UINT32_MAX, &v)) {
+                return false;
+            }
+            break;
+        default: {
+            /* Concentration in percent */
+            char *end;
+            double pct = strtod(s, &end);
+            if (end == s || *end != '\0' || !(pct >= 0.0) || pct * 10.0 > GAS_SENSOR_NO_DATA - 1) {
+                return false;
+            }
+            v = (uint64_t)lround(pct * 10.0);
+            break;
+        }
+    }
+
+    *value = (uint32_t)v;
+    return true;
+}
+
+static bool parse_op(const char *s, gas_sensor_query_op_t *op)
+{
+    static const char *const ops[] = { "=", "!=", "<", "<=", ">", ">=", "has" };
+    uint64_t i;
+    if (strcmp(s, "==") == 0) {
+        *op = GAS_SENSOR_QOP_EQ;
+        return true;
+    }
+    if (!lookup(ops, sizeof(ops) / sizeof(ops[0]), s, &i)) {
+        return false;
+    }
+    *op = (gas_sensor_query_op_t)i;
+    return true;
+}
+
+static bool parse_group(const char *s, gas_sensor_query_t *q)
+{
+    static const struct { const char *name; uint64_t us; } units[] = {
+        { "minute", 60 * SECOND_US }, { "hour", 3600 * SECOND_US }, { "day", 86400 * SECOND_US }
+    };
+
+    if (strcmp(s, "sensor") == 0) {
+        q->group = GAS_SENSOR_QUERY_GROUP_SENSOR;
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+        if (strcmp(s, units[i].name) == 0) {
+            q->group = GAS_SENSOR_QUERY_GROUP_TIME;
+            q->bucket_us = units[i].us;
+            return true;
+        }
+    }
+
+    /* <n>s, <n>m or <n>h */
+    char *end;
+    unsigned long long n = strtoull(s, &end, 10);
+    uint64_t unit = (strcmp(end, "s") == 0) ? SECOND_US :
+                    (strcmp(end, "m") == 0) ? 60 * SECOND_US :
+                    (strcmp(end, "h") == 0) ? 3600 * SECOND_US : 0;
+    if (end == s || unit == 0 || n == 0 || n > UINT64_MAX / unit) {
+        return false;
+    }
+    q->group = GAS_SENSOR_QUERY_GROUP_TIME;
+    q->bucket_us = n * unit;
+    return true;
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+void gas_sensor_query_init(gas_sensor_query_t *query, gas_sensor_query_col_t column)
+{
+    if (query == NULL) {
+        return;
+    }
+
+    memset(query, 0, sizeof(*query));
+    query->column = column;
+    query->group = GAS_SENSOR_QUERY_GROUP_NONE;
+    query->to_us = UINT64_MAX;
+}
+
+int gas_sensor_query_where(gas_sensor_query_t *query,
+                           gas_sensor_query_col_t column,
+                           gas_sensor_query_op_t op,
+                           uint32_t value)
+{
+    if (query == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if ((unsigned)column > GAS_SENSOR_QCOL_SENSOR || (unsigned)op > GAS_SENSOR_QOP_HAS) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+    if (op == GAS_SENSOR_QOP_HAS && column != GAS_SENSOR_QCOL_STATUS) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+    if (column == GAS_SENSOR_QCOL_STATUS ? value > 0xFF :
+        column != GAS_SENSOR_QCOL_SENSOR && value >= GAS_SENSOR_NO_DATA) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+    if (query->predicate_count == GAS_SENSOR_QUERY_MAX_PREDICATES) {
+        return GAS_SENSOR_ERR_NO_SPACE;
+    }
+
+    gas_sensor_query_pred_t *p = &query->predicates[query->predicate_count++];
+    p->column = column;
+    p->op = op;
+    p->value = value;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_query_parse(const char *text, gas_sensor_query_t *query, size_t *error_offset)
+{
+    if (text == NULL || query == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    parser_t ps = { text, text, text, { 0 } };
+    gas_sensor_query_col_t column;
+    int result = GAS_SENSOR_ERR_FORMAT;
+
+    if (!next_token(&ps) || !parse_column(ps.token, &column) || column >= VALUES) {
+        goto fail;
+    }
+    gas_sensor_query_init(query, column);
+
+    bool more = next_token(&ps);
+    while (more) {
+        if (strcmp(ps.token, "by") == 0) {
+            if (!next_token(&ps) || !parse_group(ps.token, query)) {
+                goto fail;
+            }
+        } else if (strcmp(ps.token, "where") == 0) {
+            do {
+                gas_sensor_query_op_t op;
+                uint32_t value;
+                if (!next_token(&ps) || !parse_column(ps.token, &column) ||
+                    !next_token(&ps) || !parse_op(ps.token, &op) ||
+                    !next_token(&ps) || !parse_value(column, ps.token, &value)) {
+                    goto fail;
+                }
+                int added = gas_sensor_query_where(query, column, op, value);
+                if (added != GAS_SENSOR_OK) {
+                    if (added == GAS_SENSOR_ERR_NO_SPACE) {
+                        result = added;
+                    }
+                    goto fail;
+                }
+                more = next_token(&ps);
+            } while (more && strcmp(ps.token, "and") == 0);
+            continue;
+        } else if (strcmp(ps.token, "from") == 0 || strcmp(ps.token, "to") == 0) {
+            uint64_t *bound = (ps.token[0] == 'f') ? &query->from_us : &query->to_us;
+            if (!next_token(&ps) || !parse_uint(ps.token, UINT64_MAX, bound)) {
+                goto fail;
+            }
+        } else {
+            goto fail;
+        }
+        more = next_token(&ps);
+    }
+
+    /* Anything left is not a token */
+    if (*ps.p == '\0') {
+        return GAS_SENSOR_OK;
+    }
+
+fail:
+    if (error_offset != NULL) {
+        *error_offset = (size_t)(ps.token_start - text);
+    }
+    return result;
+}
+
+int gas_sensor_query_run(const gas_sensor_query_t *query,
+                         const char *const *paths,
+                         size_t count,
+                         unsigned threads,
+                         gas_sensor_query_result_t *result)
+{
+    if (query == NULL || result == NULL || (paths == NULL && count > 0)) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    memset(result, 0, sizeof(*result));
+    if ((unsigned)query->column >= VALUES ||
+        query->predicate_count > GAS_SENSOR_QUERY_MAX_PREDICATES ||
+        (unsigned)query->group > GAS_SENSOR_QUERY_GROUP_TIME ||
+        (query->group == GAS_SENSOR_QUERY_GROUP_TIME && query->bucket_us == 0)) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    result->stats.files = count;
+    if (count == 0) {
+        return GAS_SENSOR_OK;
+    }
+
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? (unsigned)cpus : 1;
+    }
+    if (threads > count) {
+        threads = (unsigned)count;
+    }
+    if (threads > GAS_SENSOR_EXECUTOR_MAX_THREADS) {
+        threads = GAS_SENSOR_EXECUTOR_MAX_THREADS;
+    }
+
+    run_t run;
+    run.query = query;
+    run.paths = paths;
+    run.count = count;
+    atomic_init(&run.next, 0);
+
+    worker_t *workers = calloc(threads, sizeof(*workers));
+    if (workers == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    gas_sensor_executor_t executor;
+    int status = gas_sensor_executor_create(threads, &executor);
+    if (status != GAS_SENSOR_OK) {
+        free(workers);
+        return status;
+    }
+
+    unsigned started = 0;
+    for (; started < threads; started++) {
+        worker_t *w = &workers[started];
+        w->run = &run;
+        status = gas_sensor_strand_create(executor, NULL, NULL, &w->strand);
+        if (status != GAS_SENSOR_OK) {
+            break;
+        }
+        status = gas_sensor_strand_post(w->strand, worker_task, w);
+        if (status != GAS_SENSOR_OK) {
+            gas_sensor_strand_destroy(w->strand);
+            break;
+        }
+    }
+    for (unsigned i = 0; i < started; i++) {
+        gas_sensor_strand_destroy(workers[i].strand);
+    }
+    gas_sensor_executor_destroy(executor);
+
+    /* Files are taken from a shared cursor, so one worker is enough */
+    if (started == 0) {
+        free(workers);
+        return status;
+    }
+
+    size_t total = 0;
+    status = GAS_SENSOR_OK;
+    for (unsigned i = 0; i < started; i++) {
+        const worker_t *w = &workers[i];
+        total += w->count;
+        if (w->error != GAS_SENSOR_OK) {
+            status = w->error;
+        }
+        result->stats.files_skipped += w->stats.files_skipped;
+        result->stats.files_failed += w->stats.files_failed;
+        result->stats.blocks += w->stats.blocks;
+        result->stats.blocks_skipped += w->stats.blocks_skipped;
+        result->stats.frames += w->stats.frames;
+        result->stats.rows_scanned += w->stats.rows_scanned;
+        result->stats.rows_matched += w->stats.rows_matched;
+    }
+
+    gas_sensor_query_row_t *rows = NULL;
+    if (status == GAS_SENSOR_OK && total > 0) {
+        rows = malloc(total * sizeof(*rows));
+        if (rows == NULL) {
+            status = GAS_SENSOR_ERR_MEMORY;
+        }
+    }
+    if (rows != NULL) {
+        size_t n = 0;
+        for (unsigned i = 0; i < started; i++) {
+            memcpy(rows + n, workers[i].rows, workers[i].count * sizeof(*rows));
+            n += workers[i].count;
+        }
+        qsort(rows, n, sizeof(*rows), row_compare);
+
+        size_t out = 0;
+        for (size_t i = 1; i < n; i++) {
+            if (rows[i].key == rows[out].key) {
+                row_combine(&rows[out], &rows[i]);
+            } else {
+                rows[++out] = rows[i];
+            }
+        }
+        result->rows = rows;
+        result->count = out + 1;
+    }
+
+    for (unsigned i = 0; i < threads; i++) {
+        free(workers[i].rows);
+    }
+    free(workers);
+    return status;
+}
+
+void gas_sensor_query_result_free(gas_sensor_query_result_t *result)
+{
+    if (result == NULL) {
+        return;
+    }
+
+    free(result->rows);
+    result->rows = NULL;
+    result->count = 0;
+}
+
+double gas_sensor_query_scale(gas_sensor_query_col_t column)
+{
+    return (column <= GAS_SENSOR_QCOL_FI_O2) ? 0.1 : 1.0;
+}
+
+const char *gas_sensor_query_column_name(gas_sensor_query_col_t column)
+{
+    if ((unsigned)column > GAS_SENSOR_QCOL_SENSOR) {
+        return "unknown";
+    }
+    return column_names[column];
+}
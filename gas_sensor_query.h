@@ -0,0 +1,234 @@
+/*
+ * Anesthetic Gas Sensor Archive Queries
+ *
+ * Answers aggregate questions over capture files and breath stores
+ * without a custom program, for example "mean EtCO2 per hour for
+ * sevoflurane cases with a respiratory rate above 20":
+ *
+ *     et_co2 by hour where agent = sev and resp_rate > 20
+ *
+ * Every source is seen as a table of rows with the same columns, all
+ * single bytes in the units of the slow data (concentrations in tenths of
+ * a percent, GAS_SENSOR_NO_DATA for missing values):
+ *   - breath stores (gas_sensor_breath.h): one row per breath
+ *   - captures and change-log captures: one row per completed slow data
+ *     cycle (gas_sensor_cycle_update()), about two per second, with the
+ *     slow data after the cycle and the OR of its STS bytes
+ * Breath stores hold no agent IDs, so their agent column is always
+ * missing and a predicate on it excludes them.
+ *
+ * Execution is columnar and vectorized. Rows are handled in batches of
+ * GAS_SENSOR_BREATH_BLOCK_RECORDS: each predicate narrows a byte-per-row
+ * selection over one column in a branch-free loop, and the aggregate then
+ * folds the selected values of runs of rows with the same group key.
+ * Breath blocks are used in place from the mapping; capture frames are
+ * decoded into the same column layout.
+ *
+ * Predicates are pushed down as far as the source allows before anything
+ * is decoded:
+ *   - sensor predicates against the file header, skipping whole files
+ *   - the time range against the breath store block bounds and the
+ *     change-log keyframe index (gas_sensor_changelog_seek())
+ *   - value predicates against breath block zone maps, skipping blocks
+ *     whose bounds cannot match
+ *
+ * Files are scanned in parallel on a gas_sensor_executor_t, one strand per
+ * worker taking the next file when it finishes one; per-worker partial
+ * aggregates are merged at the end, so the result does not depend on the
+ * number of threads.
+ *
+ * Comparisons with a missing value are false, including
+ * GAS_SENSOR_QOP_NE; the status column has no missing value.
+ *
+ * Linux only, like the breath store it reads.
+ */
+
+#ifndef GAS_SENSOR_QUERY_H
+#define GAS_SENSOR_QUERY_H
+
+#include "gas_sensor.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_QUERY_MAX_PREDICATES     8
+
+/* Columns */
+typedef enum {
+    GAS_SENSOR_QCOL_ET_CO2 = 0,     /* End-tidal, tenths of % */
+    GAS_SENSOR_QCOL_ET_N2O = 1,
+    GAS_SENSOR_QCOL_ET_AA1 = 2,
+    GAS_SENSOR_QCOL_ET_AA2 = 3,
+    GAS_SENSOR_QCOL_ET_O2 = 4,
+    GAS_SENSOR_QCOL_FI_CO2 = 5,     /* Inspired, tenths of % */
+    GAS_SENSOR_QCOL_FI_N2O = 6,
+    GAS_SENSOR_QCOL_FI_AA1 = 7,
+    GAS_SENSOR_QCOL_FI_AA2 = 8,
+    GAS_SENSOR_QCOL_FI_O2 = 9,
+    GAS_SENSOR_QCOL_RESP_RATE = 10, /* bpm */
+    GAS_SENSOR_QCOL_STATUS = 11,    /* OR of STS bytes */
+    GAS_SENSOR_QCOL_AGENT = 12,     /* Primary agent (gas_agent_id_t) */
+    GAS_SENSOR_QCOL_VALUES = 13,    /* Columns above are row values */
+    GAS_SENSOR_QCOL_SENSOR = 13     /* Sensor ID, predicates only */
+} gas_sensor_query_col_t;
+
+/* Predicate operators */
+typedef enum {
+    GAS_SENSOR_QOP_EQ = 0,
+    GAS_SENSOR_QOP_NE = 1,
+    GAS_SENSOR_QOP_LT = 2,
+    GAS_SENSOR_QOP_LE = 3,
+    GAS_SENSOR_QOP_GT = 4,
+    GAS_SENSOR_QOP_GE = 5,
+    GAS_SENSOR_QOP_HAS = 6          /* Any bit of the value set (status only) */
+} gas_sensor_query_op_t;
+
+/* Grouping */
+typedef enum {
+    GAS_SENSOR_QUERY_GROUP_NONE = 0,    /* One row */
+    GAS_SENSOR_QUERY_GROUP_SENSOR = 1,  /* Row per sensor ID */
+    GAS_SENSOR_QUERY_GROUP_TIME = 2     /* Row per time bucket */
+} gas_sensor_query_group_t;
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct {
+    gas_sensor_query_col_t column;
+    gas_sensor_query_op_t op;
+    uint32_t value;                 /* In column units */
+} gas_sensor_query_pred_t;
+
+/* A query; predicates are ANDed */
+typedef struct {
+    gas_sensor_query_col_t column;  /* Column aggregated */
+    gas_sensor_query_group_t group;
+    uint64_t bucket_us;             /* Bucket width for GAS_SENSOR_QUERY_GROUP_TIME */
+    uint64_t from_us;               /* Inclusive */
+    uint64_t to_us;                 /* Exclusive */
+    size_t predicate_count;
+    gas_sensor_query_pred_t predicates[GAS_SENSOR_QUERY_MAX_PREDICATES];
+} gas_sensor_query_t;
+
+/* One aggregate, over the selected rows whose value is not missing */
+typedef struct {
+    uint64_t key;                   /* Bucket start (us since epoch), sensor ID, or 0 */
+    uint64_t count;
+    uint64_t sum;                   /* In column units */
+    uint8_t min;
+    uint8_t max;
+} gas_sensor_query_row_t;
+
+typedef struct {
+    uint64_t files;                 /* Files given */
+    uint64_t files_skipped;         /* Excluded by sensor or agent predicates */
+    uint64_t files_failed;          /* Not readable as a capture or breath store */
+    uint64_t blocks;                /* Breath blocks in the time range */
+    uint64_t blocks_skipped;        /* Excluded by zone maps */
+    uint64_t frames;                /* Capture frames decoded */
+    uint64_t rows_scanned;
+    uint64_t rows_matched;          /* Selected, missing values included */
+} gas_sensor_query_stats_t;
+
+typedef struct {
+    gas_sensor_query_row_t *rows;   /* Ordered by key */
+    size_t count;
+    gas_sensor_query_stats_t stats;
+} gas_sensor_query_result_t;
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Initialize a query aggregating one column over all time, ungrouped
+ */
+void gas_sensor_query_init(gas_sensor_query_t *query, gas_sensor_query_col_t column);
+
+/**
+ * Add a predicate
+ *
+ * @param query: Query
+ * @param column: Any column, including GAS_SENSOR_QCOL_SENSOR
+ * @param op: Operator; GAS_SENSOR_QOP_HAS only applies to the status column
+ * @param value: Value in column units; below GAS_SENSOR_NO_DATA for columns
+ *               that can be missing
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NO_SPACE,
+ *          GAS_SENSOR_ERR_INVALID_PARAM or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_query_where(gas_sensor_query_t *query,
+                           gas_sensor_query_col_t column,
+                           gas_sensor_query_op_t op,
+                           uint32_t value);
+
+/**
+ * Parse a query from text
+ *
+ *   <column> [by hour|minute|day|sensor|<n>s|<n>m|<n>h]
+ *            [where <column> <op> <value> [and ...]]
+ *            [from <us>] [to <us>]
+ *
+ * Columns are et_co2 ... et_o2, fi_co2 ... fi_o2, resp_rate, status, agent
+ * and sensor; operators = != < <= > >= and has. Concentrations are given
+ * in percent ("et_co2 > 4.5"), agents by name (hal, enf, iso, sev, des,
+ * none) or ID, status bits by name (breath, apnea, o2_low, o2_replace,
+ * check_adapter, accuracy, sensor_error, o2_calibration) or value.
+ *
+ * @param text: Query text
+ * @param query: Output query
+ * @param error_offset: Output offset of the first unparsed character on
+ *                      error (may be NULL)
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_FORMAT, GAS_SENSOR_ERR_NO_SPACE
+ *          or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_query_parse(const char *text, gas_sensor_query_t *query, size_t *error_offset);
+
+/**
+ * Run a query over files
+ *
+ * Each file may be a capture, a change-log capture or a breath store.
+ * Files that cannot be read are counted in stats.files_failed and
+ * otherwise ignored.
+ *
+ * @param query: Query
+ * @param paths: File paths
+ * @param count: Number of paths
+ * @param threads: Worker threads, 0 = one per CPU (never more than files)
+ * @param result: Output result; free with gas_sensor_query_result_free()
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM, GAS_SENSOR_ERR_MEMORY,
+ *          GAS_SENSOR_ERR_IO or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_query_run(const gas_sensor_query_t *query,
+                         const char *const *paths,
+                         size_t count,
+                         unsigned threads,
+                         gas_sensor_query_result_t *result);
+
+/**
+ * Free the rows of a result
+ */
+void gas_sensor_query_result_free(gas_sensor_query_result_t *result);
+
+/**
+ * Get the factor converting a column's units to display units (0.1 for
+ * concentrations, giving percent; 1 otherwise)
+ */
+double gas_sensor_query_scale(gas_sensor_query_col_t column);
+
+/**
+ * Get a column's name as used by gas_sensor_query_parse()
+ */
+const char *gas_sensor_query_column_name(gas_sensor_query_col_t column);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_QUERY_H */
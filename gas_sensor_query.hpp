@@ -0,0 +1,152 @@
+/*
+ * Anesthetic Gas Sensor Archive Queries (C++20)
+ *
+ * A thin wrapper over gas_sensor_query.h that builds queries fluently and
+ * owns the result rows:
+ *
+ *     gas::query q(GAS_SENSOR_QCOL_ET_CO2);
+ *     q.by(std::chrono::hours(1))
+ *      .where(GAS_SENSOR_QCOL_AGENT, GAS_SENSOR_QOP_EQ, GAS_AGENT_SEVOFLURANE)
+ *      .where(GAS_SENSOR_QCOL_RESP_RATE, GAS_SENSOR_QOP_GT, 20);
+ *
+ *     gas::query_result r;
+ *     if (q.run(paths, r) == GAS_SENSOR_OK) {
+ *         for (const gas_sensor_query_row_t &row : r.rows()) {
+ *             use(row.key, q.mean(row));
+ *         }
+ *     }
+ *
+ * Like the rest of the library it reports errors as GAS_SENSOR_* codes;
+ * the first failed where() is kept and returned by run().
+ */
+
+#ifndef GAS_SENSOR_QUERY_HPP
+#define GAS_SENSOR_QUERY_HPP
+
+#include "gas_sensor_query.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+namespace gas {
+
+/* ============================================================================
+ * Result
+ * ============================================================================ */
+
+class query_result {
+public:
+    query_result() = default;
+    query_result(const query_result &) = delete;
+    query_result &operator=(const query_result &) = delete;
+
+    query_result(query_result &&other) noexcept : result_(std::exchange(other.result_, {})) {}
+
+    query_result &operator=(query_result &&other) noexcept
+    {
+        if (this != &other) {
+            gas_sensor_query_result_free(&result_);
+            result_ = std::exchange(other.result_, {});
+        }
+        return *this;
+    }
+
+    ~query_result() { gas_sensor_query_result_free(&result_); }
+
+    std::span<const gas_sensor_query_row_t> rows() const
+    {
+        return { result_.rows, result_.count };
+    }
+
+    const gas_sensor_query_stats_t &stats() const { return result_.stats; }
+
+    gas_sensor_query_result_t *get() { return &result_; }
+
+private:
+    gas_sensor_query_result_t result_{};
+};
+
+/* ============================================================================
+ * Query
+ * ============================================================================ */
+
+class query {
+public:
+    explicit query(gas_sensor_query_col_t column) { gas_sensor_query_init(&query_, column); }
+
+    /* Parse gas_sensor_query_parse() text; on error out is left unchanged */
+    static int parse(const char *text, query &out, std::size_t *error_offset = nullptr)
+    {
+        gas_sensor_query_t parsed;
+        int result = gas_sensor_query_parse(text, &parsed, error_offset);
+        if (result == GAS_SENSOR_OK) {
+            out.query_ = parsed;
+            out.status_ = GAS_SENSOR_OK;
+        }
+        return result;
+    }
+
+    query &where(gas_sensor_query_col_t column, gas_sensor_query_op_t op, std::uint32_t value)
+    {
+        int result = gas_sensor_query_where(&query_, column, op, value);
+        if (status_ == GAS_SENSOR_OK) {
+            status_ = result;
+        }
+        return *this;
+    }
+
+    /* Group by time buckets */
+    template <class Rep, class Period>
+    query &by(std::chrono::duration<Rep, Period> bucket)
+    {
+        query_.group = GAS_SENSOR_QUERY_GROUP_TIME;
+        query_.bucket_us = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(bucket).count());
+        return *this;
+    }
+
+    query &by_sensor()
+    {
+        query_.group = GAS_SENSOR_QUERY_GROUP_SENSOR;
+        return *this;
+    }
+
+    /* Rows in [from_us, to_us) */
+    query &between(std::uint64_t from_us, std::uint64_t to_us)
+    {
+        query_.from_us = from_us;
+        query_.to_us = to_us;
+        return *this;
+    }
+
+    int run(std::span<const char *const> paths, query_result &out, unsigned threads = 0) const
+    {
+        if (status_ != GAS_SENSOR_OK) {
+            return status_;
+        }
+        out = query_result();
+        return gas_sensor_query_run(&query_, paths.data(), paths.size(), threads, out.get());
+    }
+
+    /* Mean of a row in display units (percent for concentrations) */
+    double mean(const gas_sensor_query_row_t &row) const
+    {
+        if (row.count == 0) {
+            return 0.0;
+        }
+        return static_cast<double>(row.sum) / static_cast<double>(row.count) *
+               gas_sensor_query_scale(query_.column);
+    }
+
+    const gas_sensor_query_t &get() const { return query_; }
+
+private:
+    gas_sensor_query_t query_;
+    int status_ = GAS_SENSOR_OK;
+};
+
+} // namespace gas
+
+#endif /* GAS_SENSOR_QUERY_HPP */
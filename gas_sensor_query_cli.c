@@ -0,0 +1,123 @@
+/*
+ * Anesthetic Gas Sensor Archive Query Tool
+ *
+ * Runs one gas_sensor_query_parse() query over capture files and breath
+ * stores and prints a row per group: key, number of values, mean, minimum
+ * and maximum in display units (percent for concentrations).
+ *
+ * Build:
+ *   gcc -O2 -o gas_sensor_query gas_sensor_query_cli.c gas_sensor_query.c \
+ *       gas_sensor_breath.c gas_sensor_changelog.c gas_sensor_case.c \
+ *       gas_sensor_capture.c gas_sensor_executor.c gas_sensor_mem.c \
+ *       gas_sensor.c -lpthread -lm
+ *
+ * Usage:
+ *   gas_sensor_query [-j threads] [-v] "<query>" file...
+ *
+ * Example:
+ *   gas_sensor_query "et_co2 by hour where agent = sev and resp_rate > 20" \
+ *       archive/bed3-*.cap
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor.h"
+#include "gas_sensor_query.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+static void print_key(const gas_sensor_query_t *query, uint64_t key)
+{
+    switch (query->group) {
+        case GAS_SENSOR_QUERY_GROUP_NONE:
+            printf("%-20s", "all");
+            break;
+        case GAS_SENSOR_QUERY_GROUP_SENSOR:
+            printf("%-20llu", (unsigned long long)key);
+            break;
+        case GAS_SENSOR_QUERY_GROUP_TIME: {
+            time_t t = (time_t)(key / 1000000);
+            struct tm tm;
+            char buf[32];
+            gmtime_r(&t, &tm);
+            strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+            printf("%-20s", buf);
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned threads = 0;
+    bool verbose = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:vh")) != -1) {
+        switch (opt) {
+            case 'j':
+                threads = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-j threads] [-v] \"<query>\" file...\n", argv[0]);
+                return (opt == 'h') ? 0 : 2;
+        }
+    }
+
+    if (argc - optind < 2) {
+        fprintf(stderr, "usage: %s [-j threads] [-v] \"<query>\" file...\n", argv[0]);
+        return 2;
+    }
+
+    const char *text = argv[optind];
+    gas_sensor_query_t query;
+    size_t offset = 0;
+    int result = gas_sensor_query_parse(text, &query, &offset);
+    if (result != GAS_SENSOR_OK) {
+        fprintf(stderr, "query error at offset %zu: %s\n  %s\n  %*s^\n",
+                offset, gas_sensor_strerror(result), text, (int)offset, "");
+        return 2;
+    }
+
+    gas_sensor_query_result_t res;
+    result = gas_sensor_query_run(&query, (const char *const *)&argv[optind + 1],
+                                  (size_t)(argc - optind - 1), threads, &res);
+    if (result != GAS_SENSOR_OK) {
+        fprintf(stderr, "query failed: %s\n", gas_sensor_strerror(result));
+        return 1;
+    }
+
+    double scale = gas_sensor_query_scale(query.column);
+    printf("%-20s %10s %10s %10s %10s\n", "key", "count", "mean", "min", "max");
+    for (size_t i = 0; i < res.count; i++) {
+        const gas_sensor_query_row_t *row = &res.rows[i];
+        print_key(&query, row->key);
+        printf(" %10llu %10.2f %10.1f %10.1f\n",
+               (unsigned long long)row->count,
+               (double)row->sum / (double)row->count * scale,
+               row->min * scale, row->max * scale);
+    }
+
+    const gas_sensor_query_stats_t *s = &res.stats;
+    if (s->files_failed > 0) {
+        fprintf(stderr, "%llu of %llu files could not be read\n",
+                (unsigned long long)s->files_failed, (unsigned long long)s->files);
+    }
+    if (verbose) {
+        fprintf(stderr,
+                "files %llu (skipped %llu, failed %llu), blocks %llu (skipped %llu), "
+                "frames %llu, rows %llu (matched %llu)\n",
+                (unsigned long long)s->files, (unsigned long long)s->files_skipped,
+                (unsigned long long)s->files_failed, (unsigned long long)s->blocks,
+                (unsigned long long)s->blocks_skipped, (unsigned long long)s->frames,
+                (unsigned long long)s->rows_scanned, (unsigned long long)s->rows_matched);
+    }
+
+    gas_sensor_query_result_free(&res);
+    return 0;
+}
@@ -0,0 +1,320 @@
+/*
+ * Anesthetic Gas Sensor Range Adaptors (C++20)
+ *
+ * Lazy views over raw serial bytes, so analytics code can write
+ *
+ *     for (const gas::frame &f : bytes | gas::frames | gas::valid) { ... }
+ *
+ * instead of hand-rolling sync search and buffering. Every adaptor works
+ * on any input range of bytes (a std::span over a capture, an
+ * istreambuf_iterator pair, a generator) and holds at most one 21-byte
+ * frame of state; nothing is materialized and nothing is allocated.
+ *
+ *   gas::frames    Sync to AA 55 and yield gas::frame candidates. Sync
+ *                  behaves like gas_sensor_stream_feed(): after a good
+ *                  frame the search continues behind it, after a bad one
+ *                  it resumes one byte past the rejected FLAG1. Corrupt
+ *                  candidates are still yielded (frame::valid() is false)
+ *                  so they can be counted.
+ *   gas::valid     Keep frames whose checksum verifies
+ *   gas::waveform  Project each frame onto gas_sensor_waveform_t
+ *   gas::slow      Fold frames into slow data; yields the running
+ *                  gas_sensor_slow_data_t after every frame
+ *   gas::cycles    Like slow, but yields only when a full 500ms slow data
+ *                  cycle (IDs 0x00-0x06) has completed
+ *
+ * gas::slow and gas::cycles are input-only views that keep the slow data
+ * inside the view (like std::ranges::istream_view), so their references
+ * stay valid until the iterator is incremented.
+ */
+
+#ifndef GAS_SENSOR_RANGES_HPP
+#define GAS_SENSOR_RANGES_HPP
+
+#include "gas_sensor.h"
+#include "gas_sensor_decoder.hpp"
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <ranges>
+#include <utility>
+
+namespace gas {
+
+/* ============================================================================
+ * Frame Value
+ * ============================================================================ */
+
+/**
+ * One synchronized 21-byte frame candidate
+ */
+class frame {
+public:
+    frame() = default;
+
+    const std::uint8_t *data() const { return bytes_.data(); }
+    static constexpr std::size_t size() { return GAS_SENSOR_FRAME_SIZE; }
+    std::uint8_t operator[](std::size_t i) const { return bytes_[i]; }
+
+    bool valid() const { return valid_; }
+    std::uint8_t id() const { return bytes_[2]; }
+    std::uint8_t status() const { return bytes_[3]; }
+
+    float waveform(gas_sensor_channel_t channel) const
+    {
+        return gas_sensor_frame_waveform(bytes_.data(), channel);
+    }
+
+    gas_sensor_waveform_t waveform() const
+    {
+        gas_sensor_waveform_t w{ GAS_SENSOR_CONC_INVALID, GAS_SENSOR_CONC_INVALID,
+                                 GAS_SENSOR_CONC_INVALID, GAS_SENSOR_CONC_INVALID,
+                                 GAS_SENSOR_CONC_INVALID };
+        gas::parse_frame(bytes_.data(), nullptr, &w, nullptr);
+        return w;
+    }
+
+private:
+    template <class, class> friend class frames_iterator;
+
+    std::array<std::uint8_t, GAS_SENSOR_FRAME_SIZE> bytes_{};
+    bool valid_ = false;
+};
+
+/* ============================================================================
+ * Frame Synchronization View
+ * ============================================================================ */
+
+template <class It, class End>
+class frames_iterator {
+public:
+    using iterator_concept = std::input_iterator_tag;
+    using value_type = frame;
+    using difference_type = std::ptrdiff_t;
+
+    frames_iterator() = default;
+
+    frames_iterator(It cur, End end)
+        : cur_(std::move(cur)), end_(std::move(end))
+    {
+        next();
+    }
+
+    const frame &operator*() const { return frame_; }
+    const frame *operator->() const { return &frame_; }
+
+    frames_iterator &operator++()
+    {
+        if (frame_.valid_) {
+            len_ = 0;
+        } else {
+            /* Resume one byte past the rejected FLAG1 */
+            std::memmove(buf_.data(), buf_.data() + 1, GAS_SENSOR_FRAME_SIZE - 1);
+            len_ = GAS_SENSOR_FRAME_SIZE - 1;
+            realign();
+        }
+        next();
+        return *this;
+    }
+
+    void operator++(int) { ++*this; }
+
+    friend bool operator==(const frames_iterator &it, std::default_sentinel_t)
+    {
+        return it.done_;
+    }
+
+private:
+    /* Drop bytes until the buffer starts with a possible AA 55 prefix */
+    void realign()
+    {
+        std::size_t p = 0;
+        while (p < len_ && !(buf_[p] == GAS_SENSOR_FLAG1 &&
+                             (p + 1 == len_ || buf_[p + 1] == GAS_SENSOR_FLAG2))) {
+            p++;
+        }
+        if (p > 0) {
+            std::memmove(buf_.data(), buf_.data() + p, len_ - p);
+            len_ -= p;
+        }
+    }
+
+    /* Pull bytes until a full candidate is buffered */
+    void next()
+    {
+        while (len_ < GAS_SENSOR_FRAME_SIZE) {
+            if (cur_ == end_) {
+                done_ = true;
+                return;
+            }
+            buf_[len_++] = static_cast<std::uint8_t>(*cur_);
+            ++cur_;
+            if (len_ <= 2) {
+                realign();
+            }
+        }
+        frame_.bytes_ = buf_;
+        frame_.valid_ = gas_sensor_verify_checksum(buf_.data());
+    }
+
+    It cur_{};
+    End end_{};
+    std::array<std::uint8_t, GAS_SENSOR_FRAME_SIZE> buf_{};
+    std::size_t len_ = 0;
+    frame frame_{};
+    bool done_ = false;
+};
+
+template <std::ranges::input_range V>
+    requires std::ranges::view<V> &&
+             std::convertible_to<std::ranges::range_reference_t<V>, std::uint8_t>
+class frames_view : public std::ranges::view_interface<frames_view<V>> {
+public:
+    frames_view() = default;
+    explicit frames_view(V base) : base_(std::move(base)) {}
+
+    auto begin()
+    {
+        return frames_iterator<std::ranges::iterator_t<V>, std::ranges::sentinel_t<V>>(
+            std::ranges::begin(base_), std::ranges::end(base_));
+    }
+
+    std::default_sentinel_t end() const { return {}; }
+
+    V base() const { return base_; }
+
+private:
+    V base_ = V();
+};
+
+/* ============================================================================
+ * Slow Data Views
+ * ============================================================================ */
+
+template <std::ranges::input_range V, bool Cycles>
+    requires std::ranges::view<V> &&
+             std::convertible_to<std::ranges::range_reference_t<V>, const frame &>
+class slow_view : public std::ranges::view_interface<slow_view<V, Cycles>> {
+public:
+    class iterator {
+    public:
+        using iterator_concept = std::input_iterator_tag;
+        using value_type = gas_sensor_slow_data_t;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(slow_view *parent)
+            : parent_(parent), cur_(std::ranges::begin(parent->base_))
+        {
+            next();
+        }
+
+        iterator(iterator &&) = default;
+        iterator &operator=(iterator &&) = default;
+
+        const gas_sensor_slow_data_t &operator*() const { return parent_->slow_data_; }
+        const gas_sensor_slow_data_t *operator->() const { return &parent_->slow_data_; }
+
+        iterator &operator++()
+        {
+            ++cur_;
+            next();
+            return *this;
+        }
+
+        void operator++(int) { ++*this; }
+
+        friend bool operator==(const iterator &it, std::default_sentinel_t)
+        {
+            return it.at_end();
+        }
+
+    private:
+        bool at_end() const
+        {
+            return cur_ == std::ranges::end(parent_->base_);
+        }
+
+        /* Apply frames until one is worth yielding */
+        void next()
+        {
+            for (; cur_ != std::ranges::end(parent_->base_); ++cur_) {
+                const frame &f = *cur_;
+                if (gas::parse_frame(f.data(), &parent_->slow_data_, nullptr, nullptr) != GAS_SENSOR_OK) {
+                    continue;
+                }
+                if (!Cycles || gas_sensor_cycle_update(&parent_->cycle_, f.id())) {
+                    return;
+                }
+            }
+        }
+
+        slow_view *parent_ = nullptr;
+        std::ranges::iterator_t<V> cur_{};
+    };
+
+    slow_view() = default;
+    explicit slow_view(V base) : base_(std::move(base))
+    {
+        gas_sensor_init_slow_data(&slow_data_);
+        gas_sensor_cycle_init(&cycle_);
+    }
+
+    iterator begin() { return iterator(this); }
+    std::default_sentinel_t end() const { return {}; }
+
+private:
+    V base_ = V();
+    gas_sensor_slow_data_t slow_data_{};
+    gas_sensor_cycle_t cycle_{};
+};
+
+/* ============================================================================
+ * Adaptor Objects
+ * ============================================================================ */
+
+namespace detail {
+
+/* Pipeable adaptor: both `r | a` and `a(r)` */
+template <class F>
+struct range_adaptor {
+    F fn;
+
+    template <std::ranges::viewable_range R>
+    constexpr auto operator()(R &&r) const
+    {
+        return fn(std::views::all(std::forward<R>(r)));
+    }
+
+    template <std::ranges::viewable_range R>
+    friend constexpr auto operator|(R &&r, const range_adaptor &a)
+    {
+        return a(std::forward<R>(r));
+    }
+};
+
+template <class F>
+range_adaptor(F) -> range_adaptor<F>;
+
+} // namespace detail
+
+inline constexpr detail::range_adaptor frames{
+    []<class V>(V v) { return frames_view<V>(std::move(v)); }
+};
+
+inline constexpr auto valid = std::views::filter([](const frame &f) { return f.valid(); });
+
+inline constexpr auto waveform = std::views::transform([](const frame &f) { return f.waveform(); });
+
+inline constexpr detail::range_adaptor slow{
+    []<class V>(V v) { return slow_view<V, false>(std::move(v)); }
+};
+
+inline constexpr detail::range_adaptor cycles{
+    []<class V>(V v) { return slow_view<V, true>(std::move(v)); }
+};
+
+} // namespace gas
+
+#endif /* GAS_SENSOR_RANGES_HPP */
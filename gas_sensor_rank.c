@@ -0,0 +1,444 @@
+/*
+ * Anesthetic Gas Sensor Fleet Ranking - Implementation
+ *
+ * Each metric has 255 buckets (raw values 0x00-0xFE), each an intrusive
+ * doubly linked list of sensors threaded through the sensor records, and
+ * a 256-bit map of non-empty buckets. Queries find the next non-empty
+ * bucket with one bit scan per 64 buckets.
+ */
+
+#include "gas_sensor_rank.h"
+#include "gas_sensor_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#define BUCKETS         256
+#define NIL             UINT32_MAX
+
+typedef struct {
+    uint32_t sensor_id;
+    bool used;
+    gas_sensor_cycle_t cycle;
+    uint8_t value[GAS_SENSOR_METRIC_COUNT];         /* Raw value, GAS_SENSOR_NO_DATA if unindexed */
+    uint32_t prev[GAS_SENSOR_METRIC_COUNT];
+    uint32_t next[GAS_SENSOR_METRIC_COUNT];
+} sensor_t;
+
+typedef struct {
+    uint32_t head[BUCKETS];
+    uint32_t size[BUCKETS];
+    uint64_t occupied[BUCKETS / 64];
+} metric_index_t;
+
+typedef struct {
+    uint32_t sensor_id;
+    uint32_t record;
+    bool used;
+} index_entry_t;
+
+struct gas_sensor_rank {
+    pthread_mutex_t lock;
+    sensor_t *sensors;
+    size_t capacity;
+    uint32_t *free_records;                 /* Stack of unused sensor records */
+    size_t free_count;
+    index_entry_t *index;                   /* Sensor ID -> record, open addressing */
+    size_t index_mask;
+    metric_index_t metrics[GAS_SENSOR_METRIC_COUNT];
+};
+
+/* ============================================================================
+ * Helper Functions - Values
+ * ============================================================================ */
+
+/* Raw value units per reported unit: tenths of a percent, or whole bpm */
+static float metric_scale(gas_sensor_metric_t metric)
+{
+    return (metric == GAS_SENSOR_METRIC_RESP_RATE) ? 1.0f : 10.0f;
+}
+
+static float raw_to_value(gas_sensor_metric_t metric, uint8_t raw)
+{
+    return (float)raw / metric_scale(metric);
+}
+
+static void slow_data_values(const gas_sensor_slow_data_t *slow,
+                             uint8_t value[GAS_SENSOR_METRIC_COUNT])
+{
+    value[GAS_SENSOR_METRIC_ET_CO2] = conc_to_raw(slow->exp_vals.co2);
+    value[GAS_SENSOR_METRIC_ET_N2O] = conc_to_raw(slow->exp_vals.n2o);
+    value[GAS_SENSOR_METRIC_ET_AA1] = conc_to_raw(slow->exp_vals.aa1);
+    value[GAS_SENSOR_METRIC_ET_AA2] = conc_to_raw(slow->exp_vals.aa2);
+    value[GAS_SENSOR_METRIC_ET_O2] = conc_to_raw(slow->exp_vals.o2);
+    value[GAS_SENSOR_METRIC_FI_CO2] = conc_to_raw(slow->insp_vals.co2);
+    value[GAS_SENSOR_METRIC_FI_N2O] = conc_to_raw(slow->insp_vals.n2o);
+    value[GAS_SENSOR_METRIC_FI_AA1] = conc_to_raw(slow->insp_vals.aa1);
+    value[GAS_SENSOR_METRIC_FI_AA2] = conc_to_raw(slow->insp_vals.aa2);
+    value[GAS_SENSOR_METRIC_FI_O2] = conc_to_raw(slow->insp_vals.o2);
+    value[GAS_SENSOR_METRIC_RESP_RATE] = slow->gen_vals.resp_rate;
+}
+
+/* ============================================================================
+ * Helper Functions - Buckets
+ * ============================================================================ */
+
+static void bucket_insert(struct gas_sensor_rank *r, int metric, uint32_t rec, uint8_t raw)
+{
+    metric_index_t *m = &r->metrics[metric];
+    sensor_t *s = &r->sensors[rec];
+
+    s->prev[metric] = NIL;
+    s->next[metric] = m->head[raw];
+    if (m->head[raw] != NIL) {
+        r->sensors[m->head[raw]].prev[metric] = rec;
+    }
+    m->head[raw] = rec;
+    m->size[raw]++;
+    m->occupied[raw / 64] |= 1ull << (raw % 64);
+    s->value[metric] = raw;
+}
+
+static void bucket_remove(struct gas_sensor_rank *r, int metric, uint32_t rec)
+{
+    metric_index_t *m = &r->metrics[metric];
+    sensor_t *s = &r->sensors[rec];
+    uint8_t raw = s->value[metric];
+
+    if (raw == GAS_SENSOR_NO_DATA) {
+        return;
+    }
+
+    if (s->prev[metric] != NIL) {
+        r->sensors[s->prev[metric]].next[metric] = s->next[metric];
+    } else {
+        m->head[raw] = s->next[metric];
+    }
+    if (s->next[metric] != NIL) {
+        r->sensors[s->next[metric]].prev[metric] = s->prev[metric];
+    }
+
+    if (--m->size[raw] == 0) {
+        m->occupied[raw / 64] &= ~(1ull << (raw % 64));
+    }
+    s->value[metric] = GAS_SENSOR_NO_DATA;
+}
+
+/* Highest non-empty bucket <= b, or -1 */
+static int bucket_at_or_below(const metric_index_t *m, int b)
+{
+    while (b >= 0) {
+        uint64_t word = m->occupied[b / 64] & (~0ull >> (63 - b % 64));
+        if (word != 0) {
+            return (b / 64) * 64 + 63 - __builtin_clzll(word);
+        }
+        b = (b / 64) * 64 - 1;
+    }
+    return -1;
+}
+
+/* Lowest non-empty bucket >= b, or -1 */
+static int bucket_at_or_above(const metric_index_t *m, int b)
+{
+    while (b < BUCKETS) {
+        uint64_t word = m->occupied[b / 64] & (~0ull << (b % 64));
+        if (word != 0) {
+            return (b / 64) * 64 + __builtin_ctzll(word);
+        }
+        b = (b / 64 + 1) * 64;
+    }
+    return -1;
+}
+
+/**
+ * Emit buckets from first outwards (downwards if descending) into out
+ * Returns the number of entries written.
+ */
+static size_t collect(const struct gas_sensor_rank *r, int metric, int first,
+                      bool descending, gas_sensor_rank_entry_t *out, size_t max)
+{
+    const metric_index_t *m = &r->metrics[metric];
+    size_t n = 0;
+    int b = descending ? bucket_at_or_below(m, first) : bucket_at_or_above(m, first);
+
+    while (b >= 0 && n < max) {
+        float value = raw_to_value((gas_sensor_metric_t)metric, (uint8_t)b);
+        for (uint32_t rec = m->head[b]; rec != NIL && n < max; rec = r->sensors[rec].next[metric]) {
+            out[n].sensor_id = r->sensors[rec].sensor_id;
+            out[n].value = value;
+            n++;
+        }
+        b = descending ? bucket_at_or_below(m, b - 1) : bucket_at_or_above(m, b + 1);
+    }
+    return n;
+}
+
+/* ============================================================================
+ * Helper Functions - Sensor Index
+ * ============================================================================ */
+
+GAS_SENSOR_ID_TABLE(index, index_entry_t)
+
+/* Find or create a sensor record; caller holds the lock */
+static int sensor_get(struct gas_sensor_rank *r, uint32_t sensor_id, uint32_t *record)
+{
+    size_t i = index_slot(r->index, r->index_mask, sensor_id);
+    if (r->index[i].used) {
+        *record = r->index[i].record;
+        return GAS_SENSOR_OK;
+    }
+
+    if (r->free_count == 0) {
+        return GAS_SENSOR_ERR_NO_SPACE;
+    }
+
+    uint32_t rec = r->free_records[--r->free_count];
+    sensor_t *s = &r->sensors[rec];
+    s->used = true;
+    s->sensor_id = sensor_id;
+    gas_sensor_cycle_init(&s->cycle);
+    memset(s->value, GAS_SENSOR_NO_DATA, sizeof(s->value));
+
+    r->index[i].used = true;
+    r->index[i].sensor_id = sensor_id;
+    r->index[i].record = rec;
+
+    *record = rec;
+    return GAS_SENSOR_OK;
+}
+
+static void sensor_reindex(struct gas_sensor_rank *r, uint32_t rec,
+                           const gas_sensor_slow_data_t *slow)
+{
+    uint8_t value[GAS_SENSOR_METRIC_COUNT];
+    slow_data_values(slow, value);
+
+    for (int metric = 0; metric < GAS_SENSOR_METRIC_COUNT; metric++) {
+        if (r->sensors[rec].value[metric] == value[metric]) {
+            continue;
+        }
+        bucket_remove(r, metric, rec);
+        if (value[metric] != GAS_SENSOR_NO_DATA) {
+            bucket_insert(r, metric, rec, value[metric]);
+        }
+    }
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+int gas_sensor_rank_create(size_t capacity, gas_sensor_rank_t *rank)
+{
+    if (rank == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (capacity == 0 || capacity > GAS_SENSOR_RANK_MAX_SENSORS) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    struct gas_sensor_rank *r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    /* Index at most half full */
+    size_t index_size = 1;
+    while (index_size < capacity * 2) {
+        index_size <<= 1;
+    }
+
+    r->sensors = calloc(capacity, sizeof(*r->sensors));
+    r->free_records = malloc(capacity * sizeof(*r->free_records));
+    r->index = calloc(index_size, sizeof(*r->index));
+    if (r->sensors == NULL || r->free_records == NULL || r->index == NULL) {
+        free(r->sensors);
+        free(r->free_records);
+        free(r->index);
+        free(r);
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    r->capacity = capacity;
+    r->index_mask = index_size - 1;
+
+    /* Hand out low records first */
+    for (size_t i = 0; i < capacity; i++) {
+        r->free_records[i] = (uint32_t)(capacity - 1 - i);
+    }
+    r->free_count = capacity;
+
+    for (int metric = 0; metric < GAS_SENSOR_METRIC_COUNT; metric++) {
+        for (int b = 0; b < BUCKETS; b++) {
+            r->metrics[metric].head[b] = NIL;
+        }
+    }
+
+    pthread_mutex_init(&r->lock, NULL);
+
+    *rank = r;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_rank_frame_handler(void *ctx, const gas_sensor_frame_event_t *event)
+{
+    struct gas_sensor_rank *r = ctx;
+    if (r == NULL || event == NULL || event->frame == NULL || event->slow_data == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    pthread_mutex_lock(&r->lock);
+
+    uint32_t rec;
+    int result = sensor_get(r, event->sensor_id, &rec);
+    if (result == GAS_SENSOR_OK &&
+        gas_sensor_cycle_update(&r->sensors[rec].cycle, gas_sensor_frame_id(event->frame))) {
+        sensor_reindex(r, rec, event->slow_data);
+    }
+
+    pthread_mutex_unlock(&r->lock);
+    return result;
+}
+
+int gas_sensor_rank_update(gas_sensor_rank_t rank,
+                           uint32_t sensor_id,
+                           const gas_sensor_slow_data_t *slow_data)
+{
+    if (rank == NULL || slow_data == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    pthread_mutex_lock(&rank->lock);
+
+    uint32_t rec;
+    int result = sensor_get(rank, sensor_id, &rec);
+    if (result == GAS_SENSOR_OK) {
+        sensor_reindex(rank, rec, slow_data);
+    }
+
+    pthread_mutex_unlock(&rank->lock);
+    return result;
+}
+
+int gas_sensor_rank_remove(gas_sensor_rank_t rank, uint32_t sensor_id)
+{
+    if (rank == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    pthread_mutex_lock(&rank->lock);
+
+    size_t i = index_slot(rank->index, rank->index_mask, sensor_id);
+    if (!rank->index[i].used) {
+        pthread_mutex_unlock(&rank->lock);
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    uint32_t rec = rank->index[i].record;
+    for (int metric = 0; metric < GAS_SENSOR_METRIC_COUNT; metric++) {
+        bucket_remove(rank, metric, rec);
+    }
+    rank->sensors[rec].used = false;
+    rank->free_records[rank->free_count++] = rec;
+    index_remove(rank->index, rank->index_mask, i);
+
+    pthread_mutex_unlock(&rank->lock);
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_rank_top(gas_sensor_rank_t rank,
+                        gas_sensor_metric_t metric,
+                        gas_sensor_rank_order_t order,
+                        size_t k,
+                        gas_sensor_rank_entry_t *out)
+{
+    if (rank == NULL || (out == NULL && k > 0)) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if ((unsigned)metric >= GAS_SENSOR_METRIC_COUNT || k > INT32_MAX) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    bool descending = (order == GAS_SENSOR_RANK_HIGHEST);
+
+    pthread_mutex_lock(&rank->lock);
+    size_t n = collect(rank, metric, descending ? BUCKETS - 1 : 0, descending, out, k);
+    pthread_mutex_unlock(&rank->lock);
+
+    return (int)n;
+}
+
+int gas_sensor_rank_threshold(gas_sensor_rank_t rank,
+                              gas_sensor_metric_t metric,
+                              gas_sensor_rank_cmp_t cmp,
+                              float threshold,
+                              gas_sensor_rank_entry_t *out,
+                              size_t max,
+                              size_t *total)
+{
+    if (rank == NULL || (out == NULL && max > 0)) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if ((unsigned)metric >= GAS_SENSOR_METRIC_COUNT || max > INT32_MAX || isnan(threshold)) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    /* Nearest raw value on the matching side, using the parser's conversion
+     * so a value equal to the threshold never matches */
+    int first;
+    float scaled = threshold * metric_scale(metric);
+    if (cmp == GAS_SENSOR_RANK_ABOVE) {
+        first = (scaled < 0.0f) ? 0 : (scaled >= BUCKETS) ? BUCKETS : (int)scaled;
+        while (first < BUCKETS && raw_to_value(metric, (uint8_t)first) <= threshold) {
+            first++;
+        }
+    } else {
+        first = (scaled < 0.0f) ? -1 : (scaled >= BUCKETS) ? BUCKETS - 1 : (int)scaled + 1;
+        while (first >= 0 && (first >= BUCKETS ||
+                              raw_to_value(metric, (uint8_t)first) >= threshold)) {
+            first--;
+        }
+    }
+
+    size_t n = 0;
+    size_t matches = 0;
+
+    pthread_mutex_lock(&rank->lock);
+    if (first >= 0 && first < BUCKETS) {
+        bool descending = (cmp == GAS_SENSOR_RANK_BELOW);
+        n = collect(rank, metric, first, descending, out, max);
+
+        if (total != NULL) {
+            const metric_index_t *m = &rank->metrics[metric];
+            int lo = descending ? 0 : first;
+            int hi = descending ? first : BUCKETS - 1;
+            for (int b = bucket_at_or_above(m, lo); b >= 0 && b <= hi;
+                 b = bucket_at_or_above(m, b + 1)) {
+                matches += m->size[b];
+            }
+        }
+    }
+    pthread_mutex_unlock(&rank->lock);
+
+    if (total != NULL) {
+        *total = matches;
+    }
+    return (int)n;
+}
+
+void gas_sensor_rank_destroy(gas_sensor_rank_t rank)
+{
+    if (rank == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&rank->lock);
+    free(rank->sensors);
+    free(rank->free_records);
+    free(rank->index);
+    free(rank);
+}
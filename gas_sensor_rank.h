@@ -0,0 +1,176 @@
+/*
+ * Anesthetic Gas Sensor Fleet Ranking
+ *
+ * Answers "the 10 beds with the highest EtCO2" or "every bed with FiO2
+ * below 25%" without scanning every session. Slow data values are single
+ * bytes (tenths of a percent, or bpm for the respiratory rate), so each
+ * metric keeps one bucket per possible value plus a bitmap of non-empty
+ * buckets. Moving a sensor between buckets is O(1); a top-K query walks
+ * the non-empty buckets from the top and costs O(K), and a threshold
+ * query costs O(matches).
+ *
+ * Sensors are re-indexed once per completed slow data cycle (every
+ * 500 ms), when all values of the cycle are consistent. Missing values
+ * (0xFF) leave the sensor out of that metric until a valid value arrives.
+ *
+ * A mutex serializes updates and queries; both are short.
+ */
+
+#ifndef GAS_SENSOR_RANK_H
+#define GAS_SENSOR_RANK_H
+
+#include "gas_sensor.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_RANK_MAX_SENSORS     65536
+
+/* ============================================================================
+ * Enumerations
+ * ============================================================================ */
+
+typedef enum {
+    GAS_SENSOR_METRIC_ET_CO2 = 0,
+    GAS_SENSOR_METRIC_ET_N2O,
+    GAS_SENSOR_METRIC_ET_AA1,
+    GAS_SENSOR_METRIC_ET_AA2,
+    GAS_SENSOR_METRIC_ET_O2,
+    GAS_SENSOR_METRIC_FI_CO2,
+    GAS_SENSOR_METRIC_FI_N2O,
+    GAS_SENSOR_METRIC_FI_AA1,
+    GAS_SENSOR_METRIC_FI_AA2,
+    GAS_SENSOR_METRIC_FI_O2,
+    GAS_SENSOR_METRIC_RESP_RATE,
+    GAS_SENSOR_METRIC_COUNT
+} gas_sensor_metric_t;
+
+typedef enum {
+    GAS_SENSOR_RANK_HIGHEST = 0,        /* Top-K: largest values first */
+    GAS_SENSOR_RANK_LOWEST = 1          /* Top-K: smallest values first */
+} gas_sensor_rank_order_t;
+
+typedef enum {
+    GAS_SENSOR_RANK_ABOVE = 0,          /* Threshold: value > threshold */
+    GAS_SENSOR_RANK_BELOW = 1           /* Threshold: value < threshold */
+} gas_sensor_rank_cmp_t;
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_rank *gas_sensor_rank_t;
+
+/* One query result */
+typedef struct {
+    uint32_t sensor_id;
+    float value;                        /* Percent, or bpm for GAS_SENSOR_METRIC_RESP_RATE */
+} gas_sensor_rank_entry_t;
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Create a ranking index
+ *
+ * @param capacity: Sensors, 1 to GAS_SENSOR_RANK_MAX_SENSORS
+ * @param rank: Output parameter for the index handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM,
+ *          GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_rank_create(size_t capacity, gas_sensor_rank_t *rank);
+
+/**
+ * Feed one frame event
+ *
+ * Matches gas_sensor_frame_handler_t, so an index can be passed directly
+ * to gas_sensor_session_attach() as handler context. Tracks each sensor's
+ * slow data cycle and re-indexes the sensor when a cycle completes.
+ *
+ * @param ctx: Index handle
+ * @param event: Frame event
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NO_SPACE when a new sensor finds
+ *          the index full, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_rank_frame_handler(void *ctx, const gas_sensor_frame_event_t *event);
+
+/**
+ * Re-index one sensor from a complete slow data snapshot
+ *
+ * For callers that track cycles themselves.
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NO_SPACE or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_rank_update(gas_sensor_rank_t rank,
+                           uint32_t sensor_id,
+                           const gas_sensor_slow_data_t *slow_data);
+
+/**
+ * Drop a sensor from every metric
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM if the sensor is
+ *          not indexed, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_rank_remove(gas_sensor_rank_t rank, uint32_t sensor_id);
+
+/**
+ * Get the K sensors with the highest or lowest values of a metric
+ *
+ * Sensors with equal values are returned in no particular order.
+ *
+ * @param rank: Index handle
+ * @param metric: Metric to rank by
+ * @param order: GAS_SENSOR_RANK_HIGHEST or GAS_SENSOR_RANK_LOWEST
+ * @param k: Maximum number of results
+ * @param out: Output array of at least k entries, best first
+ * @return: Number of entries written, or GAS_SENSOR_ERR_INVALID_PARAM /
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_rank_top(gas_sensor_rank_t rank,
+                        gas_sensor_metric_t metric,
+                        gas_sensor_rank_order_t order,
+                        size_t k,
+                        gas_sensor_rank_entry_t *out);
+
+/**
+ * Get the sensors whose value is strictly above or below a threshold
+ *
+ * Results are ordered from the threshold outwards. If more than max
+ * sensors match, the max closest to the threshold are returned and total
+ * reports the full count.
+ *
+ * @param rank: Index handle
+ * @param metric: Metric to test
+ * @param cmp: GAS_SENSOR_RANK_ABOVE or GAS_SENSOR_RANK_BELOW
+ * @param threshold: Percent, or bpm for GAS_SENSOR_METRIC_RESP_RATE
+ * @param out: Output array of at least max entries
+ * @param max: Capacity of out
+ * @param total: Output number of matching sensors (may be NULL)
+ * @return: Number of entries written, or GAS_SENSOR_ERR_INVALID_PARAM /
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_rank_threshold(gas_sensor_rank_t rank,
+                              gas_sensor_metric_t metric,
+                              gas_sensor_rank_cmp_t cmp,
+                              float threshold,
+                              gas_sensor_rank_entry_t *out,
+                              size_t max,
+                              size_t *total);
+
+/**
+ * Free an index
+ */
+void gas_sensor_rank_destroy(gas_sensor_rank_t rank);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_RANK_H */
@@ -0,0 +1,558 @@
+/*
+ * Anesthetic Gas Sensor Capture Replay - Implementation
+ *
+ * Single-threaded scheduler writing capture records into ptys at their
+ * original (optionally scaled) timing. See gas_sensor_replay.h.
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor_replay.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REPLAY_INITIAL_CAPACITY 16
+
+typedef struct {
+    gas_sensor_capture_reader_t reader;
+    gas_sensor_capture_record_t record;     /* Record being written */
+    size_t written;                         /* Bytes of record already written */
+    uint64_t first_ts;                      /* Timestamp of the first record */
+    uint64_t due_ns;                        /* Scheduled time since run start */
+    int fd;
+    int slave_fd;                           /* Held open for pty replays, else -1 */
+    bool owns_fd;
+    gas_sensor_replay_stats_t stats;
+} replay_t;
+
+struct gas_sensor_replayer {
+    double speed;
+    replay_t *replays;
+    size_t count;
+    size_t capacity;
+    size_t *heap;                           /* Scheduled replays, min-heap on due */
+    size_t heap_size;
+    size_t *blocked;                        /* Replays waiting for POLLOUT */
+    size_t blocked_count;
+    struct pollfd *pollfds;                 /* Blocked ports, then wake_fd */
+    atomic_bool stop;
+    int wake_fd;                            /* eventfd signaled by stop() */
+};
+
+/* Result of trying to write the current record */
+typedef enum {
+    WRITE_DONE,
+    WRITE_BLOCKED,
+    WRITE_ERROR
+} write_result_t;
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static struct timespec ns_to_timespec(uint64_t ns)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ull);
+    ts.tv_nsec = (long)(ns % 1000000000ull);
+    return ts;
+}
+
+/* Clear the eventfd stop() signals so it no longer reads as ready */
+static int wake_reset(struct gas_sensor_replayer *rp)
+{
+    uint64_t value;
+    if (read(rp->wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        return GAS_SENSOR_ERR_IO;
+    }
+    return GAS_SENSOR_OK;
+}
+
+/**
+ * Read the next replayable record of a replay
+ * Returns GAS_SENSOR_OK, GAS_SENSOR_ERR_EOF or a read error.
+ */
+static int replay_next_record(replay_t *r)
+{
+    int result;
+    do {
+        result = gas_sensor_capture_read(r->reader, &r->record);
+    } while (result == GAS_SENSOR_OK &&
+             r->record.type != GAS_SENSOR_REC_RAW &&
+             r->record.type != GAS_SENSOR_REC_FRAME);
+    r->written = 0;
+    return result;
+}
+
+/**
+ * Compute when the current record is due, relative to run start
+ */
+static void replay_schedule(const struct gas_sensor_replayer *rp, replay_t *r)
+{
+    if (rp->speed <= 0.0) {
+        /* Unthrottled: order by records written so replays take turns */
+        r->due_ns = r->stats.records;
+        return;
+    }
+
+    uint64_t offset_us = (r->record.timestamp_us > r->first_ts) ?
+                         r->record.timestamp_us - r->first_ts : 0;
+    r->due_ns = (uint64_t)((double)offset_us * 1000.0 / rp->speed);
+}
+
+/**
+ * Write as much of the current record as the port accepts
+ */
+static write_result_t replay_write(replay_t *r)
+{
+    while (r->written < r->record.length) {
+        ssize_t n = write(r->fd, &r->record.payload[r->written],
+                          r->record.length - r->written);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return WRITE_BLOCKED;
+            }
+            r->stats.error = GAS_SENSOR_ERR_IO;
+            return WRITE_ERROR;
+        }
+        r->written += (size_t)n;
+        r->stats.bytes += (uint64_t)n;
+    }
+
+    r->stats.records++;
+    return WRITE_DONE;
+}
+
+/* ============================================================================
+ * Scheduling Heap
+ * ============================================================================ */
+
+static bool heap_less(const struct gas_sensor_replayer *rp, size_t a, size_t b)
+{
+    uint64_t da = rp->replays[a].due_ns;
+    uint64_t db = rp->replays[b].due_ns;
+    return (da != db) ? (da < db) : (a < b);
+}
+
+static void heap_push(struct gas_sensor_replayer *rp, size_t index)
+{
+    size_t i = rp->heap_size++;
+    rp->heap[i] = index;
+
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!heap_less(rp, rp->heap[i], rp->heap[parent])) {
+            break;
+        }
+        size_t tmp = rp->heap[i];
+        rp->heap[i] = rp->heap[parent];
+        rp->heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+static size_t heap_pop(struct gas_sensor_replayer *rp)
+{
+    size_t top = rp->heap[0];
+    rp->heap[0] = rp->heap[--rp->heap_size];
+
+    size_t i = 0;
+    for (;;) {
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        size_t smallest = i;
+
+        if (left < rp->heap_size && heap_less(rp, rp->heap[left], rp->heap[smallest])) {
+            smallest = left;
+        }
+        if (right < rp->heap_size && heap_less(rp, rp->heap[right], rp->heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+
+        size_t tmp = rp->heap[i];
+        rp->heap[i] = rp->heap[smallest];
+        rp->heap[smallest] = tmp;
+        i = smallest;
+    }
+    return top;
+}
+
+/**
+ * Finish a record: schedule the next one or mark the replay finished
+ */
+static void replay_complete_record(struct gas_sensor_replayer *rp, size_t index)
+{
+    replay_t *r = &rp->replays[index];
+    int result = replay_next_record(r);
+
+    if (result == GAS_SENSOR_OK) {
+        replay_schedule(rp, r);
+        heap_push(rp, index);
+    } else {
+        r->stats.finished = (result == GAS_SENSOR_ERR_EOF);
+        if (result != GAS_SENSOR_ERR_EOF) {
+            r->stats.error = result;
+        }
+    }
+}
+
+/**
+ * Attempt a write and route the replay to the heap, the blocked list or
+ * neither (finished/failed)
+ */
+static void replay_service(struct gas_sensor_replayer *rp, size_t index)
+{
+    switch (replay_write(&rp->replays[index])) {
+        case WRITE_DONE:
+            replay_complete_record(rp, index);
+            break;
+        case WRITE_BLOCKED:
+            rp->blocked[rp->blocked_count++] = index;
+            break;
+        case WRITE_ERROR:
+            break;
+    }
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+int gas_sensor_replayer_create(double speed, gas_sensor_replayer_t *replayer)
+{
+    if (replayer == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    struct gas_sensor_replayer *rp = calloc(1, sizeof(*rp));
+    if (rp == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    rp->speed = speed;
+    atomic_init(&rp->stop, false);
+    rp->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (rp->wake_fd < 0) {
+        free(rp);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    *replayer = rp;
+    return GAS_SENSOR_OK;
+}
+
+/**
+ * Grow per-replay arrays to hold one more replay
+ */
+static int replayer_reserve(struct gas_sensor_replayer *rp)
+{
+    if (rp->count < rp->capacity) {
+        return GAS_SENSOR_OK;
+    }
+
+    size_t capacity = (rp->capacity == 0) ? REPLAY_INITIAL_CAPACITY : rp->capacity * 2;
+
+    replay_t *replays = realloc(rp->replays, capacity * sizeof(*replays));
+    if (replays == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    rp->replays = replays;
+
+    size_t *heap = realloc(rp->heap, capacity * sizeof(*heap));
+    if (heap == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    rp->heap = heap;
+
+    size_t *blocked = realloc(rp->blocked, capacity * sizeof(*blocked));
+    if (blocked == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    rp->blocked = blocked;
+
+    struct pollfd *pollfds = realloc(rp->pollfds, (capacity + 1) * sizeof(*pollfds));
+    if (pollfds == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    rp->pollfds = pollfds;
+
+    rp->capacity = capacity;
+    return GAS_SENSOR_OK;
+}
+
+/**
+ * Register a replay writing into fd; takes ownership of slave_fd
+ */
+static int replayer_add(struct gas_sensor_replayer *rp,
+                        const char *capture_path,
+                        int fd,
+                        int slave_fd,
+                        bool owns_fd,
+                        size_t *index)
+{
+    int result = replayer_reserve(rp);
+    if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+
+    replay_t *r = &rp->replays[rp->count];
+    memset(r, 0, sizeof(*r));
+
+    result = gas_sensor_capture_reader_open(capture_path, &r->reader);
+    if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        gas_sensor_capture_reader_close(r->reader);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    r->fd = fd;
+    r->slave_fd = slave_fd;
+    r->owns_fd = owns_fd;
+
+    result = replay_next_record(r);
+    if (result == GAS_SENSOR_OK) {
+        r->first_ts = r->record.timestamp_us;
+    } else if (result == GAS_SENSOR_ERR_EOF) {
+        r->stats.finished = true;
+    } else {
+        gas_sensor_capture_reader_close(r->reader);
+        return result;
+    }
+
+    if (index != NULL) {
+        *index = rp->count;
+    }
+    rp->count++;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_replay_add(gas_sensor_replayer_t replayer,
+                          const char *capture_path,
+                          char *port_name,
+                          size_t port_name_size,
+                          size_t *index)
+{
+    if (replayer == NULL || capture_path == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0) {
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    char slave_name[GAS_SENSOR_REPLAY_PORT_NAME_MAX];
+    if (grantpt(master) != 0 || unlockpt(master) != 0 ||
+        ptsname_r(master, slave_name, sizeof(slave_name)) != 0) {
+        close(master);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    int slave = open(slave_name, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        close(master);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    /* Raw 9600 8N1, matching the sensor's serial setup */
+    struct termios tio;
+    if (tcgetattr(slave, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, B9600);
+        cfsetospeed(&tio, B9600);
+        tcsetattr(slave, TCSANOW, &tio);
+    }
+
+    int result = replayer_add(replayer, capture_path, master, slave, true, index);
+    if (result != GAS_SENSOR_OK) {
+        close(slave);
+        close(master);
+        return result;
+    }
+
+    if (port_name != NULL && port_name_size > 0) {
+        snprintf(port_name, port_name_size, "%s", slave_name);
+    }
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_replay_add_fd(gas_sensor_replayer_t replayer,
+                             const char *capture_path,
+                             int fd,
+                             size_t *index)
+{
+    if (replayer == NULL || capture_path == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    return replayer_add(replayer, capture_path, fd, -1, false, index);
+}
+
+int gas_sensor_replayer_run(gas_sensor_replayer_t replayer)
+{
+    if (replayer == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    struct gas_sensor_replayer *rp = replayer;
+    rp->heap_size = 0;
+    rp->blocked_count = 0;
+
+    /* A stop() that landed after the previous run returned */
+    if (wake_reset(rp) != GAS_SENSOR_OK) {
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    for (size_t i = 0; i < rp->count; i++) {
+        replay_t *r = &rp->replays[i];
+        if (!r->stats.finished && r->stats.error == GAS_SENSOR_OK) {
+            replay_schedule(rp, r);
+            heap_push(rp, i);
+        }
+    }
+
+    uint64_t start = monotonic_ns();
+
+    while (!atomic_load(&rp->stop) && (rp->heap_size > 0 || rp->blocked_count > 0)) {
+        uint64_t now = monotonic_ns() - start;
+
+        /* Write every record that is due */
+        while (rp->heap_size > 0 && rp->replays[rp->heap[0]].due_ns <= now) {
+            size_t index = heap_pop(rp);
+            replay_t *r = &rp->replays[index];
+
+            if (rp->speed > 0.0 && now - r->due_ns > r->stats.max_lateness_us * 1000) {
+                r->stats.max_lateness_us = (now - r->due_ns) / 1000;
+            }
+            replay_service(rp, index);
+        }
+
+        if (rp->heap_size == 0 && rp->blocked_count == 0) {
+            break;
+        }
+
+        /* Wait for blocked ports to drain, a stop, or the next due record */
+        for (size_t i = 0; i < rp->blocked_count; i++) {
+            rp->pollfds[i].fd = rp->replays[rp->blocked[i]].fd;
+            rp->pollfds[i].events = POLLOUT;
+            rp->pollfds[i].revents = 0;
+        }
+        rp->pollfds[rp->blocked_count].fd = rp->wake_fd;
+        rp->pollfds[rp->blocked_count].events = POLLIN;
+        rp->pollfds[rp->blocked_count].revents = 0;
+
+        struct timespec timeout;
+        struct timespec *timeout_ptr = NULL;
+        if (rp->heap_size > 0) {
+            uint64_t due = rp->replays[rp->heap[0]].due_ns;
+            now = monotonic_ns() - start;
+            timeout = ns_to_timespec(due > now ? due - now : 0);
+            timeout_ptr = &timeout;
+        }
+
+        int ready = ppoll(rp->pollfds, rp->blocked_count + 1, timeout_ptr, NULL);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return GAS_SENSOR_ERR_IO;
+        }
+        if (rp->pollfds[rp->blocked_count].revents != 0 && wake_reset(rp) != GAS_SENSOR_OK) {
+            return GAS_SENSOR_ERR_IO;
+        }
+
+        /* Retry ready ports; still-blocked ones are compacted in place */
+        size_t count = rp->blocked_count;
+        rp->blocked_count = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (rp->pollfds[i].revents != 0) {
+                replay_service(rp, rp->blocked[i]);
+            } else {
+                rp->blocked[rp->blocked_count++] = rp->blocked[i];
+            }
+        }
+    }
+
+    atomic_store(&rp->stop, false);
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_replayer_stop(gas_sensor_replayer_t replayer)
+{
+    if (replayer != NULL) {
+        atomic_store(&replayer->stop, true);
+
+        /* Wake a run() waiting for the next record or a blocked port */
+        uint64_t one = 1;
+        ssize_t n;
+        do {
+            n = write(replayer->wake_fd, &one, sizeof(one));
+        } while (n < 0 && errno == EINTR);
+    }
+}
+
+int gas_sensor_replay_stats(gas_sensor_replayer_t replayer,
+                            size_t index,
+                            gas_sensor_replay_stats_t *stats)
+{
+    if (replayer == NULL || stats == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (index >= replayer->count) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    *stats = replayer->replays[index].stats;
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_replayer_destroy(gas_sensor_replayer_t replayer)
+{
+    if (replayer == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < replayer->count; i++) {
+        replay_t *r = &replayer->replays[i];
+        gas_sensor_capture_reader_close(r->reader);
+        if (r->owns_fd) {
+            close(r->fd);
+        }
+        if (r->slave_fd >= 0) {
+            close(r->slave_fd);
+        }
+    }
+
+    free(replayer->replays);
+    free(replayer->heap);
+    free(replayer->blocked);
+    free(replayer->pollfds);
+    close(replayer->wake_fd);
+    free(replayer);
+}
@@ -0,0 +1,135 @@
+/*
+ * Anesthetic Gas Sensor Capture Replay
+ *
+ * Replays archived serial traffic into virtual serial ports (ptys) so the
+ * complete gateway can be exercised with field data. Every capture record
+ * is written with a single write() at its original offset from the start
+ * of the capture, scaled by a speed factor. Raw chunks keep their original
+ * boundaries and any corruption they contained.
+ *
+ * One replayer drives any number of replays from a single thread: replays
+ * are kept in a min-heap ordered by their next due time, and ports that are
+ * not being drained by the reader are waited on with poll() instead of
+ * stalling the others. Each replay uses three file descriptors (capture,
+ * pty master and a held-open pty slave), which bounds the number of
+ * simultaneous replays by RLIMIT_NOFILE.
+ *
+ * Linux only (posix_openpt, ppoll, eventfd).
+ */
+
+#ifndef GAS_SENSOR_REPLAY_H
+#define GAS_SENSOR_REPLAY_H
+
+#include "gas_sensor_capture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Speed factor that writes records back-to-back without timing */
+#define GAS_SENSOR_REPLAY_UNTHROTTLED   0.0
+
+#define GAS_SENSOR_REPLAY_PORT_NAME_MAX 64
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_replayer *gas_sensor_replayer_t;
+
+/* Per-replay statistics */
+typedef struct {
+    uint64_t records;               /* Records written */
+    uint64_t bytes;                 /* Bytes written */
+    uint64_t max_lateness_us;       /* Worst delay behind schedule */
+    bool finished;                  /* All records written */
+    int error;                      /* First error, GAS_SENSOR_OK if none */
+} gas_sensor_replay_stats_t;
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Create a replayer
+ *
+ * @param speed: Time scale; 1.0 = real time, 10.0 = ten times faster,
+ *               GAS_SENSOR_REPLAY_UNTHROTTLED = as fast as the port drains
+ * @param replayer: Output parameter for the replayer handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_replayer_create(double speed, gas_sensor_replayer_t *replayer);
+
+/**
+ * Add a capture to replay into a new pty
+ *
+ * The slave side is configured raw at 9600 8N1 and kept open by the
+ * replayer so its settings survive the gateway opening and closing it.
+ *
+ * @param replayer: Replayer handle
+ * @param capture_path: Capture file with raw and/or frame records
+ * @param port_name: Output buffer for the slave device path (may be NULL)
+ * @param port_name_size: Size of port_name
+ * @param index: Output replay index for gas_sensor_replay_stats() (may be NULL)
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO, GAS_SENSOR_ERR_FORMAT,
+ *          GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_replay_add(gas_sensor_replayer_t replayer,
+                          const char *capture_path,
+                          char *port_name,
+                          size_t port_name_size,
+                          size_t *index);
+
+/**
+ * Add a capture to replay into an existing file descriptor
+ *
+ * The descriptor is switched to non-blocking mode and is not closed by
+ * the replayer. Useful for pipes and sockets; callers writing to pipes
+ * should ignore SIGPIPE.
+ */
+int gas_sensor_replay_add_fd(gas_sensor_replayer_t replayer,
+                             const char *capture_path,
+                             int fd,
+                             size_t *index);
+
+/**
+ * Run all replays to completion
+ *
+ * Blocks the calling thread. Timing starts when this function is called.
+ * Returns early after gas_sensor_replayer_stop().
+ *
+ * @return: GAS_SENSOR_OK, or GAS_SENSOR_ERR_IO if waiting fails
+ */
+int gas_sensor_replayer_run(gas_sensor_replayer_t replayer);
+
+/**
+ * Ask a running replayer to return (safe to call from another thread)
+ *
+ * A run() waiting for the next record or a blocked port wakes at once.
+ */
+void gas_sensor_replayer_stop(gas_sensor_replayer_t replayer);
+
+/**
+ * Get statistics of one replay
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM for an unknown
+ *          index, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_replay_stats(gas_sensor_replayer_t replayer,
+                            size_t index,
+                            gas_sensor_replay_stats_t *stats);
+
+/**
+ * Close all ports and captures and free the replayer
+ */
+void gas_sensor_replayer_destroy(gas_sensor_replayer_t replayer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_REPLAY_H */
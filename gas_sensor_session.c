@@ -0,0 +1,652 @@
+/*
+ * Anesthetic Gas Sensor Session Manager - Implementation
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor_session.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+struct gas_sensor_session {
+    struct gas_sensor_session_mgr *mgr;
+    struct gas_sensor_session *prev;        /* Manager's session list */
+    struct gas_sensor_session *next;
+    int fd;
+    uint32_t sensor_id;
+    gas_sensor_frame_handler_t handler;
+    void *ctx;
+    gas_sensor_stream_t stream;
+    gas_sensor_decoder_fn decode;           /* Specialized for the sensor's options */
+    const gas_sensor_format_t *format;      /* Frame format, NULL = built-in */
+    gas_sensor_slow_data_t slow_data;
+    gas_sensor_waveform_t waveform;
+    gas_sensor_status_t status;
+    uint64_t rx_timestamp_us;               /* Timestamp of bytes being fed */
+    int dispatched;                         /* Frames dispatched by current feed */
+    uint8_t alarm_status;                   /* Alarm STS bits of the last frame */
+    unsigned idle_holdoff;                  /* Frames before the session may idle again */
+    gas_sensor_session_stats_t stats;
+};
+
+struct gas_sensor_session_mgr {
+    int epoll_fd;
+    int timer_fd;                           /* Idle servicing timer (epoll data NULL) */
+    unsigned idle_interval_ms;
+    gas_sensor_clock_t clock;               /* Receive timestamps */
+    bool virtual_timer;                     /* Idle timer follows the clock, not timer_fd */
+    uint64_t idle_due_us;                   /* Next virtual idle tick, 0 = disarmed */
+    gas_sensor_mem_t mem;                   /* Ledger charged for sessions, or NULL */
+    size_t idle_count;
+    struct gas_sensor_session *sessions;
+    struct epoll_event events[GAS_SENSOR_SESSION_MAX_EVENTS];
+    uint8_t read_buf[GAS_SENSOR_SESSION_READ_SIZE];
+};
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+/* Frames a session stays active after an alarm-relevant change (1 s) */
+#define IDLE_HOLDOFF_FRAMES     20
+
+/**
+ * Arm the idle timer to fire every interval_ms, or disarm it with 0
+ */
+static int timer_arm(struct gas_sensor_session_mgr *mgr, unsigned interval_ms)
+{
+    if (mgr->virtual_timer) {
+        mgr->idle_due_us = (interval_ms != 0)
+                           ? gas_sensor_clock_now(&mgr->clock) + (uint64_t)interval_ms * 1000
+                           : 0;
+        return GAS_SENSOR_OK;
+    }
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_interval.tv_sec = interval_ms / 1000;
+    its.it_interval.tv_nsec = (long)(interval_ms % 1000) * 1000000L;
+    its.it_value = its.it_interval;
+    return (timerfd_settime(mgr->timer_fd, 0, &its, NULL) == 0) ? GAS_SENSOR_OK : GAS_SENSOR_ERR_IO;
+}
+
+/**
+ * Whether a format frames like the built-in one
+ *
+ * Frame events carry no format, so handlers read the ID, STS and waveform
+ * bytes and check frames at the built-in offsets; only the slow data
+ * field map may differ.
+ */
+static bool format_builtin_framing(const gas_sensor_format_t *format)
+{
+    const gas_sensor_format_t *phasein = &gas_sensor_format_phasein;
+    return format->sync[0] == phasein->sync[0] &&
+           format->sync[1] == phasein->sync[1] &&
+           format->size == phasein->size &&
+           format->id_count == phasein->id_count &&
+           format->id_offset == phasein->id_offset &&
+           format->status_offset == phasein->status_offset &&
+           format->waveform_offset == phasein->waveform_offset &&
+           format->checksum == phasein->checksum &&
+           format->checksum_from == phasein->checksum_from &&
+           format->checksum_at == phasein->checksum_at;
+}
+
+static bool regs_idle(const gas_sensor_sensor_regs_t *regs)
+{
+    return regs->mode == GAS_SENSOR_MODE_SLEEP ||
+           regs->mode == GAS_SENSOR_MODE_SELF_TEST ||
+           regs->adapter.no_adapter;
+}
+
+/**
+ * Move a session between epoll-driven and timer-driven servicing
+ */
+static void session_set_idle(struct gas_sensor_session *s, bool idle)
+{
+    struct gas_sensor_session_mgr *mgr = s->mgr;
+
+    /* With no events requested the descriptor still reports hangup */
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = idle ? 0 : EPOLLIN;
+    ev.data.ptr = s;
+    if (epoll_ctl(mgr->epoll_fd, EPOLL_CTL_MOD, s->fd, &ev) != 0) {
+        return;
+    }
+
+    s->stats.idle = idle;
+    if (idle) {
+        s->stats.idle_entries++;
+        if (mgr->idle_count++ == 0) {
+            timer_arm(mgr, mgr->idle_interval_ms);
+        }
+    } else if (--mgr->idle_count == 0) {
+        timer_arm(mgr, 0);
+    }
+}
+
+/**
+ * Follow the sensor's mode and adapter state
+ *
+ * Register changes are only seen on ID 0x04 frames; the STS byte of every
+ * frame can wake an idle session. After an alarm-relevant change the
+ * session stays at full cadence until the STS bits have been stable for
+ * IDLE_HOLDOFF_FRAMES, so a sleeping sensor with a flapping condition is
+ * not left on the slow timer.
+ */
+static void session_schedule(struct gas_sensor_session *s, const uint8_t *frame_data)
+{
+    uint8_t alarm = gas_sensor_frame_status(frame_data) & GAS_SENSOR_STS_ALARM_MASK;
+    bool alarm_changed = (alarm != s->alarm_status);
+    s->alarm_status = alarm;
+
+    if (s->fd < 0 || s->stats.hangup || s->mgr->idle_interval_ms == 0) {
+        return;
+    }
+
+    bool regs_frame = (gas_sensor_frame_id(frame_data) == 0x04);
+
+    if (alarm_changed) {
+        s->idle_holdoff = IDLE_HOLDOFF_FRAMES;
+    } else if (s->idle_holdoff > 0) {
+        s->idle_holdoff--;
+    }
+
+    if (s->stats.idle) {
+        if (alarm_changed || (regs_frame && !regs_idle(&s->slow_data.sensor_regs))) {
+            session_set_idle(s, false);
+        }
+    } else if (regs_frame && s->idle_holdoff == 0 && regs_idle(&s->slow_data.sensor_regs)) {
+        session_set_idle(s, true);
+    }
+}
+
+/**
+ * Parse one synchronized frame and dispatch it
+ */
+static int session_on_frame(void *ctx, const uint8_t *frame_data)
+{
+    struct gas_sensor_session *s = ctx;
+
+    if (s->decode(frame_data, &s->slow_data, &s->waveform, &s->status) != GAS_SENSOR_OK) {
+        s->stats.parse_errors++;
+        return GAS_SENSOR_OK;
+    }
+
+    /* Configuration data arrives every 500 ms; reselecting is a few tests.
+     * A session with its own format keeps the decoder it was given. */
+    if (s->format == NULL && gas_sensor_frame_id(frame_data) == 0x05) {
+        s->decode = gas_sensor_select_decoder(&s->slow_data.config_data);
+    }
+
+    s->dispatched++;
+    if (s->handler != NULL) {
+        gas_sensor_frame_event_t event;
+        event.sensor_id = s->sensor_id;
+        event.timestamp_us = s->rx_timestamp_us;
+        event.frame = frame_data;
+        event.slow_data = &s->slow_data;
+        event.waveform = &s->waveform;
+        event.status = &s->status;
+
+        /* Handler errors are noted; delivery continues */
+        if (s->handler(s->ctx, &event) != GAS_SENSOR_OK) {
+            s->stats.handler_errors++;
+        }
+    }
+
+    session_schedule(s, frame_data);
+    return GAS_SENSOR_OK;
+}
+
+/**
+ * Stop watching a session's descriptor after hangup or read failure
+ */
+static void session_hangup(struct gas_sensor_session *s)
+{
+    if (s->stats.idle) {
+        session_set_idle(s, false);
+    }
+    s->stats.hangup = true;
+    if (s->fd >= 0) {
+        epoll_ctl(s->mgr->epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+    }
+}
+
+/**
+ * Drain a ready descriptor
+ * Returns the number of frames dispatched.
+ */
+static int session_service(struct gas_sensor_session *s)
+{
+    struct gas_sensor_session_mgr *mgr = s->mgr;
+    int frames = 0;
+
+    for (;;) {
+        ssize_t n = read(s->fd, mgr->read_buf, sizeof(mgr->read_buf));
+        if (n > 0) {
+            s->stats.reads++;
+            s->stats.bytes += (uint64_t)n;
+            frames += gas_sensor_session_feed(s, mgr->read_buf, (size_t)n,
+                                              gas_sensor_clock_now(&mgr->clock));
+            if ((size_t)n < sizeof(mgr->read_buf)) {
+                break;                      /* Short read: queue is drained */
+            }
+            continue;
+        }
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+
+        /* End of file, or EIO from a pty whose other side closed */
+        session_hangup(s);
+        break;
+    }
+    return frames;
+}
+
+/**
+ * Check the idle timer: timer_fd after it polled ready, or the virtual
+ * deadline against the clock
+ */
+static bool mgr_idle_due(struct gas_sensor_session_mgr *mgr, bool timer_ready)
+{
+    if (!mgr->virtual_timer) {
+        uint64_t expirations;
+        return timer_ready && read(mgr->timer_fd, &expirations, sizeof(expirations)) > 0;
+    }
+
+    if (mgr->idle_due_us == 0) {
+        return false;
+    }
+
+    uint64_t now = gas_sensor_clock_now(&mgr->clock);
+    if (now < mgr->idle_due_us) {
+        return false;
+    }
+
+    /* Missed ticks coalesce into one, as timerfd expirations do */
+    uint64_t interval_us = (uint64_t)mgr->idle_interval_ms * 1000;
+    mgr->idle_due_us += ((now - mgr->idle_due_us) / interval_us + 1) * interval_us;
+    return true;
+}
+
+/**
+ * Timer tick: drain every idle session in one pass
+ * Returns the number of frames dispatched.
+ */
+static int mgr_service_idle(struct gas_sensor_session_mgr *mgr)
+{
+    int frames = 0;
+    struct gas_sensor_session *s = mgr->sessions;
+    while (s != NULL) {
+        struct gas_sensor_session *next = s->next;
+        if (s->stats.idle) {
+            s->stats.idle_services++;
+            frames += session_service(s);
+        }
+        s = next;
+    }
+    return frames;
+}
+
+/* ============================================================================
+ * Serial Port Helper
+ * ============================================================================ */
+
+int gas_sensor_serial_open(const char *port, int *fd)
+{
+    if (port == NULL || fd == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    int f = open(port, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (f < 0) {
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    struct termios tio;
+    if (tcgetattr(f, &tio) != 0) {
+        close(f);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(tcflag_t)(CSTOPB | PARENB);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, B9600);
+    cfsetospeed(&tio, B9600);
+
+    if (tcsetattr(f, TCSANOW, &tio) != 0) {
+        close(f);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    *fd = f;
+    return GAS_SENSOR_OK;
+}
+
+/* ============================================================================
+ * Session Manager
+ * ============================================================================ */
+
+int gas_sensor_session_mgr_create(gas_sensor_session_mgr_t *mgr)
+{
+    if (mgr == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    struct gas_sensor_session_mgr *m = calloc(1, sizeof(*m));
+    if (m == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    m->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m->epoll_fd < 0) {
+        free(m);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    m->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m->timer_fd < 0) {
+        close(m->epoll_fd);
+        free(m);
+        return GAS_SENSOR_ERR_IO;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(m->epoll_fd, EPOLL_CTL_ADD, m->timer_fd, &ev) != 0) {
+        close(m->timer_fd);
+        close(m->epoll_fd);
+        free(m);
+        return GAS_SENSOR_ERR_IO;
+    }
+    m->idle_interval_ms = GAS_SENSOR_SESSION_IDLE_INTERVAL_MS;
+    m->clock = gas_sensor_clock_system();
+
+    *mgr = m;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_session_mgr_set_idle_interval(gas_sensor_session_mgr_t mgr,
+                                             unsigned interval_ms)
+{
+    if (mgr == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (interval_ms > GAS_SENSOR_SESSION_MAX_IDLE_INTERVAL_MS) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    mgr->idle_interval_ms = interval_ms;
+    if (interval_ms == 0) {
+        for (struct gas_sensor_session *s = mgr->sessions; s != NULL; s = s->next) {
+            if (s->stats.idle) {
+                session_set_idle(s, false);
+            }
+        }
+        return GAS_SENSOR_OK;
+    }
+
+    return (mgr->idle_count > 0) ? timer_arm(mgr, interval_ms) : GAS_SENSOR_OK;
+}
+
+int gas_sensor_session_mgr_set_clock(gas_sensor_session_mgr_t mgr,
+                                     const gas_sensor_clock_t *clock)
+{
+    if (mgr == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (clock != NULL && clock->now_us == NULL) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    /* Move a running idle timer over to the new time base */
+    bool armed = (mgr->idle_count > 0);
+    if (armed) {
+        timer_arm(mgr, 0);
+    }
+
+    mgr->clock = (clock != NULL) ? *clock : gas_sensor_clock_system();
+    mgr->virtual_timer = (clock != NULL);
+
+    return armed ? timer_arm(mgr, mgr->idle_interval_ms) : GAS_SENSOR_OK;
+}
+
+int gas_sensor_session_mgr_set_mem(gas_sensor_session_mgr_t mgr, gas_sensor_mem_t mem)
+{
+    if (mgr == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (mgr->sessions != NULL) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    int result = gas_sensor_mem_charge(mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_SESSION,
+                                       sizeof(*mgr));
+    if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+    gas_sensor_mem_release(mgr->mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_SESSION, sizeof(*mgr));
+    mgr->mem = mem;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_session_attach(gas_sensor_session_mgr_t mgr,
+                              int fd,
+                              uint32_t sensor_id,
+                              gas_sensor_frame_handler_t handler,
+                              void *ctx,
+                              gas_sensor_session_t *session)
+{
+    if (mgr == NULL || session == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    int result = gas_sensor_mem_charge(mgr->mem, sensor_id, GAS_SENSOR_MEM_SESSION,
+                                       sizeof(struct gas_sensor_session));
+    if (result != GAS_SENSOR_OK) {
+        return result;
+    }
+
+    struct gas_sensor_session *s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        gas_sensor_mem_release(mgr->mem, sensor_id, GAS_SENSOR_MEM_SESSION, sizeof(*s));
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    s->mgr = mgr;
+    s->fd = fd;
+    s->sensor_id = sensor_id;
+    s->handler = handler;
+    s->ctx = ctx;
+    gas_sensor_stream_init(&s->stream);
+    s->decode = gas_sensor_parse_frame;
+    gas_sensor_init_slow_data(&s->slow_data);
+
+    if (fd >= 0) {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+            free(s);
+            gas_sensor_mem_release(mgr->mem, sensor_id, GAS_SENSOR_MEM_SESSION, sizeof(*s));
+            return GAS_SENSOR_ERR_IO;
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = s;
+        if (epoll_ctl(mgr->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            free(s);
+            gas_sensor_mem_release(mgr->mem, sensor_id, GAS_SENSOR_MEM_SESSION, sizeof(*s));
+            return GAS_SENSOR_ERR_IO;
+        }
+    }
+
+    s->next = mgr->sessions;
+    if (mgr->sessions != NULL) {
+        mgr->sessions->prev = s;
+    }
+    mgr->sessions = s;
+
+    *session = s;
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_session_detach(gas_sensor_session_t session)
+{
+    if (session == NULL) {
+        return;
+    }
+
+    struct gas_sensor_session_mgr *mgr = session->mgr;
+    if (session->stats.idle && --mgr->idle_count == 0) {
+        timer_arm(mgr, 0);
+    }
+    if (session->fd >= 0 && !session->stats.hangup) {
+        epoll_ctl(mgr->epoll_fd, EPOLL_CTL_DEL, session->fd, NULL);
+    }
+
+    if (session->prev != NULL) {
+        session->prev->next = session->next;
+    } else {
+        mgr->sessions = session->next;
+    }
+    if (session->next != NULL) {
+        session->next->prev = session->prev;
+    }
+
+    gas_sensor_mem_release(mgr->mem, session->sensor_id, GAS_SENSOR_MEM_SESSION, sizeof(*session));
+    free(session);
+}
+
+int gas_sensor_session_mgr_poll(gas_sensor_session_mgr_t mgr, int timeout_ms)
+{
+    if (mgr == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    int ready = epoll_wait(mgr->epoll_fd, mgr->events,
+                           GAS_SENSOR_SESSION_MAX_EVENTS, timeout_ms);
+    if (ready < 0) {
+        return (errno == EINTR) ? 0 : GAS_SENSOR_ERR_IO;
+    }
+
+    /* Active sessions first; idle ones wait for the end of the round */
+    int frames = 0;
+    bool idle_tick = false;
+    for (int i = 0; i < ready; i++) {
+        if (mgr->events[i].data.ptr == NULL) {
+            idle_tick = true;
+        } else {
+            frames += session_service(mgr->events[i].data.ptr);
+        }
+    }
+    if (mgr_idle_due(mgr, idle_tick)) {
+        frames += mgr_service_idle(mgr);
+    }
+    return frames;
+}
+
+int gas_sensor_session_feed(gas_sensor_session_t session,
+                            const uint8_t *data,
+                            size_t length,
+                            uint64_t timestamp_us)
+{
+    if (session == NULL || (data == NULL && length > 0)) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    session->rx_timestamp_us = timestamp_us;
+    session->dispatched = 0;
+    gas_sensor_stream_feed_format(&session->stream, session->format, data, length,
+                                  session_on_frame, session);
+    return session->dispatched;
+}
+
+int gas_sensor_session_set_format(gas_sensor_session_t session,
+                                  const gas_sensor_format_t *format,
+                                  gas_sensor_decoder_fn decoder)
+{
+    if (session == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (format != NULL) {
+        if (decoder == NULL) {
+            return GAS_SENSOR_ERR_NULL_PARAM;
+        }
+        int ret = gas_sensor_format_validate(format);
+        if (ret != GAS_SENSOR_OK) {
+            return ret;
+        }
+        if (!format_builtin_framing(format)) {
+            return GAS_SENSOR_ERR_INVALID_PARAM;
+        }
+    }
+
+    /* Buffered bytes were framed by the old format */
+    gas_sensor_stream_stats_t stats = session->stream.stats;
+    gas_sensor_stream_init(&session->stream);
+    session->stream.stats = stats;
+
+    session->format = format;
+    session->decode = (format != NULL) ? decoder : gas_sensor_parse_frame;
+    return GAS_SENSOR_OK;
+}
+
+uint32_t gas_sensor_session_sensor_id(gas_sensor_session_t session)
+{
+    return (session != NULL) ? session->sensor_id : 0;
+}
+
+const gas_sensor_slow_data_t *gas_sensor_session_slow_data(gas_sensor_session_t session)
+{
+    return (session != NULL) ? &session->slow_data : NULL;
+}
+
+int gas_sensor_session_stats(gas_sensor_session_t session,
+                             gas_sensor_session_stats_t *stats)
+{
+    if (session == NULL || stats == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    *stats = session->stats;
+    stats->stream = session->stream.stats;
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_session_mgr_destroy(gas_sensor_session_mgr_t mgr)
+{
+    if (mgr == NULL) {
+        return;
+    }
+
+    while (mgr->sessions != NULL) {
+        gas_sensor_session_detach(mgr->sessions);
+    }
+    gas_sensor_mem_release(mgr->mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_SESSION, sizeof(*mgr));
+    close(mgr->timer_fd);
+    close(mgr->epoll_fd);
+    free(mgr);
+}
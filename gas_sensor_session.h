@@ -0,0 +1,250 @@
+/*
+ * Anesthetic Gas Sensor Session Manager
+ *
+ * Services many sensors from one thread: each session owns a serial file
+ * descriptor, a stream synchronizer and the sensor's persistent slow data.
+ * gas_sensor_session_mgr_poll() waits on all descriptors with epoll, reads
+ * whatever arrived, synchronizes and parses it, and dispatches one
+ * gas_sensor_frame_event_t per frame to the session's handler.
+ *
+ * Frames are parsed with the full decoder until the sensor reports its
+ * configuration (ID 0x05, within the first cycle); from then on with the
+ * decoder gas_sensor_select_decoder() returns for its fitted options.
+ * Sensor variants with another frame layout are given their format
+ * descriptor and decoder with gas_sensor_session_set_format().
+ *
+ * Sensors that report sleep or self-test mode, or no adapter, are idle:
+ * their descriptors leave the epoll set and are drained together on a
+ * timer instead, after the active sessions of the same wakeup. A change
+ * of an alarm-relevant STS bit, or registers that no longer read idle,
+ * return the session to full-cadence servicing.
+ *
+ * Receive timestamps and the idle timer follow the system clock, or a
+ * clock injected with gas_sensor_session_mgr_set_clock() for simulation.
+ *
+ * With a memory ledger set, each session (its state, stream carry buffer
+ * and slow data) is charged to its sensor under GAS_SENSOR_MEM_SESSION
+ * and the manager's own buffers to GAS_SENSOR_MEM_SHARED; an attach the
+ * budgets do not allow fails with GAS_SENSOR_ERR_NO_SPACE.
+ *
+ * Linux only (epoll).
+ */
+
+#ifndef GAS_SENSOR_SESSION_H
+#define GAS_SENSOR_SESSION_H
+
+#include "gas_sensor.h"
+#include "gas_sensor_stream.h"
+#include "gas_sensor_clock.h"
+#include "gas_sensor_mem.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_SESSION_READ_SIZE    4096    /* Bytes per read() call */
+#define GAS_SENSOR_SESSION_MAX_EVENTS   256     /* Ready sessions per poll */
+
+/* Idle session servicing interval. The maximum keeps the bytes queued
+ * between reads (9600 baud) well inside the kernel's serial buffer. */
+#define GAS_SENSOR_SESSION_IDLE_INTERVAL_MS     250
+#define GAS_SENSOR_SESSION_MAX_IDLE_INTERVAL_MS 2000
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_session_mgr *gas_sensor_session_mgr_t;
+typedef struct gas_sensor_session *gas_sensor_session_t;
+
+/* Per-session counters */
+typedef struct {
+    gas_sensor_stream_stats_t stream;   /* Sync and checksum counters */
+    uint64_t reads;                     /* read() calls returning data */
+    uint64_t bytes;                     /* Bytes received */
+    uint64_t parse_errors;              /* Frames rejected by the parser */
+    uint64_t handler_errors;            /* Handler returned non-zero */
+    uint64_t idle_entries;              /* Times the session became idle */
+    uint64_t idle_services;             /* Timer-driven reads while idle */
+    bool idle;                          /* Serviced on the idle timer */
+    bool hangup;                        /* Port closed or failed */
+} gas_sensor_session_stats_t;
+
+/* ============================================================================
+ * Serial Port Helper
+ * ============================================================================ */
+
+/**
+ * Open a serial port for sensor input
+ *
+ * Configures raw 9600 baud 8N1 with non-blocking reads.
+ *
+ * @param port: Device path, e.g. "/dev/ttyUSB0"
+ * @param fd: Output file descriptor (caller closes it)
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_serial_open(const char *port, int *fd);
+
+/* ============================================================================
+ * Session Manager
+ * ============================================================================ */
+
+/**
+ * Create a session manager
+ *
+ * Idle sessions are serviced every GAS_SENSOR_SESSION_IDLE_INTERVAL_MS.
+ *
+ * @param mgr: Output parameter for the manager handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO or GAS_SENSOR_ERR_MEMORY
+ */
+int gas_sensor_session_mgr_create(gas_sensor_session_mgr_t *mgr);
+
+/**
+ * Set the idle session servicing interval
+ *
+ * @param mgr: Manager handle
+ * @param interval_ms: 1 to GAS_SENSOR_SESSION_MAX_IDLE_INTERVAL_MS, or 0 to
+ *                     service every session at full cadence
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM, GAS_SENSOR_ERR_IO
+ *          or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_session_mgr_set_idle_interval(gas_sensor_session_mgr_t mgr,
+                                             unsigned interval_ms);
+
+/**
+ * Set the clock of a session manager
+ *
+ * Reads serviced by gas_sensor_session_mgr_poll() are timestamped with
+ * the clock, and the idle timer runs on it: each poll services the idle
+ * sessions if an idle interval of clock time has passed. With a virtual
+ * clock, poll with a timeout of 0 after advancing it; a blocking poll
+ * would not wake for the idle timer.
+ *
+ * @param mgr: Manager handle
+ * @param clock: Clock (copied), or NULL for the system clock and a
+ *               kernel timer
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM, GAS_SENSOR_ERR_IO
+ *          or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_session_mgr_set_clock(gas_sensor_session_mgr_t mgr,
+                                     const gas_sensor_clock_t *clock);
+
+/**
+ * Set the memory ledger of a session manager
+ *
+ * Only while no session is attached, so every session is charged to the
+ * ledger it is released from.
+ *
+ * @param mgr: Manager handle
+ * @param mem: Ledger, or NULL to stop accounting
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM (sessions are
+ *          attached), GAS_SENSOR_ERR_NO_SPACE or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_session_mgr_set_mem(gas_sensor_session_mgr_t mgr, gas_sensor_mem_t mem);
+
+/**
+ * Attach a sensor
+ *
+ * The descriptor is switched to non-blocking mode. It stays owned by the
+ * caller and must remain open until the session is detached.
+ *
+ * @param mgr: Manager handle
+ * @param fd: Serial descriptor, or -1 for a session fed only through
+ *            gas_sensor_session_feed()
+ * @param sensor_id: Identifier reported in frame events
+ * @param handler: Frame handler (may be NULL)
+ * @param ctx: Handler context
+ * @param session: Output parameter for the session handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_IO, GAS_SENSOR_ERR_MEMORY,
+ *          GAS_SENSOR_ERR_NO_SPACE (over a memory budget) or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_session_attach(gas_sensor_session_mgr_t mgr,
+                              int fd,
+                              uint32_t sensor_id,
+                              gas_sensor_frame_handler_t handler,
+                              void *ctx,
+                              gas_sensor_session_t *session);
+
+/**
+ * Detach a sensor and free its session (the descriptor is not closed)
+ */
+void gas_sensor_session_detach(gas_sensor_session_t session);
+
+/**
+ * Wait for input and service every ready session once
+ *
+ * Each ready descriptor is drained until it would block, so one wakeup
+ * handles every byte already queued by the kernel. Frames of idle
+ * sessions arrive in batches once per idle interval and share the
+ * timestamp of the read that returned them.
+ *
+ * @param mgr: Manager handle
+ * @param timeout_ms: Maximum wait, -1 = forever, 0 = do not wait
+ * @return: Number of frames dispatched (>= 0), or GAS_SENSOR_ERR_IO
+ */
+int gas_sensor_session_mgr_poll(gas_sensor_session_mgr_t mgr, int timeout_ms);
+
+/**
+ * Feed bytes received by other means into a session
+ *
+ * @param session: Session handle
+ * @param data: Received bytes
+ * @param length: Number of bytes
+ * @param timestamp_us: Receive time (us since epoch)
+ * @return: Number of frames dispatched (>= 0), or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_session_feed(gas_sensor_session_t session,
+                            const uint8_t *data,
+                            size_t length,
+                            uint64_t timestamp_us);
+
+/**
+ * Set the frame format of a session
+ *
+ * Framing and decoding follow the descriptor from the next byte fed;
+ * bytes of a partial frame are dropped. The decoder is usually
+ * gas::format_decoder<F>::parse (gas_sensor_format.hpp); a C application
+ * can wrap gas_sensor_format_decode() instead. Frame events do not say
+ * which format a frame uses and handlers read them at the built-in
+ * offsets, so only formats with the built-in framing are accepted: sync
+ * bytes, frame size and ID count, ID, STS and waveform offsets and the
+ * checksum must match gas_sensor_format_phasein, leaving the slow data
+ * field map to differ. Fitted-option decoder selection only applies to
+ * the built-in format.
+ *
+ * @param session: Session handle
+ * @param format: Descriptor, which must outlive the session, or NULL to
+ *                return to the built-in format
+ * @param decoder: Decoder for the format (ignored when format is NULL)
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM for a descriptor
+ *          gas_sensor_format_validate() rejects or whose framing is not
+ *          the built-in one, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_session_set_format(gas_sensor_session_t session,
+                                  const gas_sensor_format_t *format,
+                                  gas_sensor_decoder_fn decoder);
+
+/**
+ * Get session state
+ */
+uint32_t gas_sensor_session_sensor_id(gas_sensor_session_t session);
+const gas_sensor_slow_data_t *gas_sensor_session_slow_data(gas_sensor_session_t session);
+int gas_sensor_session_stats(gas_sensor_session_t session,
+                             gas_sensor_session_stats_t *stats);
+
+/**
+ * Detach all sessions and free the manager
+ */
+void gas_sensor_session_mgr_destroy(gas_sensor_session_mgr_t mgr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_SESSION_H */
@@ -0,0 +1,245 @@
+/*
+ * Anesthetic Gas Sensor Simulator - Implementation
+ */
+
+#include "gas_sensor_sim.h"
+#include "gas_sensor_layout.h"
+#include <string.h>
+
+/* Fraction of a breath spent exhaling, and of that spent on the upstroke */
+#define SIM_EXP_FRACTION        0.6f
+#define SIM_UPSTROKE_FRACTION   0.15f
+
+/* Frames per simulated second */
+#define SIM_FRAMES_PER_SEC      (1000000 / GAS_SENSOR_SIM_FRAME_PERIOD_US)
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static void put_uint16_be(uint8_t *data, uint16_t value)
+{
+    data[0] = (uint8_t)(value >> 8);
+    data[1] = (uint8_t)(value & 0xFF);
+}
+
+/**
+ * Encode a waveform concentration (percentage * 100, 0xFFFF = no data)
+ */
+static uint16_t encode_wave(float percent)
+{
+    if (percent < 0.0f) {
+        return 0xFFFF;
+    }
+    return (uint16_t)(percent * 100.0f + 0.5f);
+}
+
+/**
+ * Encode a slow data concentration (percentage * 10, 0xFF = no data)
+ */
+static uint8_t encode_slow(float percent)
+{
+    if (percent < 0.0f) {
+        return GAS_SENSOR_NO_DATA;
+    }
+    float raw = percent * 10.0f + 0.5f;
+    return (raw >= 254.0f) ? 254 : (uint8_t)raw;
+}
+
+static uint8_t to_bcd(unsigned value)
+{
+    return (uint8_t)(((value / 10) % 10) << 4 | (value % 10));
+}
+
+/**
+ * Breath period in frames, 0 during apnea
+ */
+static uint64_t breath_period(const gas_sensor_sim_t *sim)
+{
+    if (sim->config.resp_rate == 0) {
+        return 0;
+    }
+
+    uint64_t period = (uint64_t)SIM_FRAMES_PER_SEC * 60 / sim->config.resp_rate;
+    return (period > 0) ? period : 1;
+}
+
+/**
+ * Position within the current breath, 0.0 (start of expiration) to 1.0
+ * Returns a negative value during apnea.
+ */
+static float breath_phase(const gas_sensor_sim_t *sim, uint64_t period)
+{
+    if (period == 0) {
+        return -1.0f;
+    }
+    return (float)(sim->frame_count % period) / (float)period;
+}
+
+/**
+ * Scale between inspired and end-tidal level along a capnogram shape
+ */
+static float capno_level(float phase)
+{
+    if (phase < 0.0f || phase >= SIM_EXP_FRACTION) {
+        return 0.0f;                                /* Inspiration / apnea */
+    }
+    if (phase < SIM_UPSTROKE_FRACTION) {
+        return phase / SIM_UPSTROKE_FRACTION;       /* Expiratory upstroke */
+    }
+    return 1.0f;                                    /* Alveolar plateau */
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+void gas_sensor_sim_default_config(gas_sensor_sim_config_t *config)
+{
+    if (config == NULL) {
+        return;
+    }
+
+    memset(config, 0, sizeof(*config));
+    config->resp_rate = 12;
+    config->etco2 = 5.0f;
+    config->fio2 = 50.0f;
+    config->n2o = 0.0f;
+    config->agent = GAS_AGENT_SEVOFLURANE;
+    config->et_agent = 2.0f;
+    config->mode = GAS_SENSOR_MODE_MEASUREMENT;
+    config->config_reg0 = 0xFF;                     /* All options fitted */
+    config->config_reg1 = 0x01;                     /* Agent auto-ID */
+    config->hw_revision = 3;
+    config->sw_revision = 1204;
+    config->protocol_revision = 2;
+    config->serial_number = 1;
+    config->atm_pressure = 1013;
+}
+
+void gas_sensor_sim_init(gas_sensor_sim_t *sim, const gas_sensor_sim_config_t *config)
+{
+    if (sim == NULL) {
+        return;
+    }
+
+    memset(sim, 0, sizeof(*sim));
+    if (config != NULL) {
+        sim->config = *config;
+    } else {
+        gas_sensor_sim_default_config(&sim->config);
+    }
+}
+
+void gas_sensor_sim_next_frame(gas_sensor_sim_t *sim, uint8_t *frame_data)
+{
+    if (sim == NULL || frame_data == NULL) {
+        return;
+    }
+
+    const gas_sensor_sim_config_t *cfg = &sim->config;
+    uint64_t period = breath_period(sim);
+    float level = capno_level(breath_phase(sim, period));
+
+    /* Breath detected on the first frame of each expiration */
+    bool breath_start = (period > 0 && sim->frame_count % period == 0);
+    if (breath_start) {
+        sim->last_breath_frame = sim->frame_count;
+        sim->breathing = true;
+    }
+
+    float et_o2 = cfg->fio2 - 4.0f;
+    float co2 = cfg->etco2 * level;
+    float o2 = cfg->fio2 + (et_o2 - cfg->fio2) * level;
+    float aa1 = (cfg->agent == GAS_AGENT_NONE) ? 0.0f :
+                cfg->et_agent * (1.15f - 0.15f * level);
+
+    memset(frame_data, 0, GAS_SENSOR_FRAME_SIZE);
+    frame_data[0] = GAS_SENSOR_FLAG1;
+    frame_data[1] = GAS_SENSOR_FLAG2;
+
+    /* IDs only cycle in measurement and demo mode */
+    bool cycling = (cfg->mode == GAS_SENSOR_MODE_MEASUREMENT ||
+                    cfg->mode == GAS_SENSOR_MODE_DEMO);
+    uint8_t frame_id = cycling ? (uint8_t)(sim->frame_count % GAS_SENSOR_FRAME_ID_MAX) : 0x04;
+    frame_data[GAS_SENSOR_OFFSET_ID] = frame_id;
+
+    uint8_t sts = (uint8_t)(cfg->status & 0xFE);
+    if (breath_start) {
+        sts |= 0x01;
+    }
+    if (cfg->resp_rate == 0) {
+        sts |= 0x02;                                /* APNEA */
+    }
+    if (cfg->adapter_reg != 0) {
+        sts |= 0x10;                                /* CHK_ADAPT */
+    }
+    if (cfg->error_reg != 0) {
+        sts |= 0x40;                                /* SENS_ERR */
+    }
+    frame_data[GAS_SENSOR_OFFSET_STS] = sts;
+
+    put_uint16_be(&frame_data[GAS_SENSOR_OFFSET_CO2], encode_wave(co2));
+    put_uint16_be(&frame_data[GAS_SENSOR_OFFSET_N2O], encode_wave(cfg->n2o));
+    put_uint16_be(&frame_data[GAS_SENSOR_OFFSET_AA1], encode_wave(aa1));
+    put_uint16_be(&frame_data[GAS_SENSOR_OFFSET_AA2], encode_wave(0.0f));
+    put_uint16_be(&frame_data[GAS_SENSOR_OFFSET_O2], encode_wave(o2));
+
+    uint8_t *slow = &frame_data[GAS_SENSOR_OFFSET_SLOW];
+    float insp_aa = (cfg->agent == GAS_AGENT_NONE) ? 0.0f : cfg->et_agent * 1.15f;
+    uint64_t since_breath = (sim->frame_count - sim->last_breath_frame) / SIM_FRAMES_PER_SEC;
+
+    switch (frame_id) {
+        case 0x00:
+            slow[GAS_SENSOR_SLOW_CO2] = encode_slow(0.0f);
+            slow[GAS_SENSOR_SLOW_N2O] = encode_slow(cfg->n2o);
+            slow[GAS_SENSOR_SLOW_AA1] = encode_slow(insp_aa);
+            slow[GAS_SENSOR_SLOW_AA2] = encode_slow(0.0f);
+            slow[GAS_SENSOR_SLOW_O2] = encode_slow(cfg->fio2);
+            break;
+        case 0x01:
+            slow[GAS_SENSOR_SLOW_CO2] = encode_slow(cfg->etco2);
+            slow[GAS_SENSOR_SLOW_N2O] = encode_slow(cfg->n2o);
+            slow[GAS_SENSOR_SLOW_AA1] = encode_slow(cfg->et_agent);
+            slow[GAS_SENSOR_SLOW_AA2] = encode_slow(0.0f);
+            slow[GAS_SENSOR_SLOW_O2] = encode_slow(et_o2);
+            break;
+        case 0x02:
+            slow[GAS_SENSOR_SLOW_CO2] = encode_slow(co2);
+            slow[GAS_SENSOR_SLOW_N2O] = encode_slow(cfg->n2o);
+            slow[GAS_SENSOR_SLOW_AA1] = encode_slow(aa1);
+            slow[GAS_SENSOR_SLOW_AA2] = encode_slow(0.0f);
+            slow[GAS_SENSOR_SLOW_O2] = encode_slow(o2);
+            break;
+        case 0x03:
+            slow[GAS_SENSOR_SLOW_RESP_RATE] = cfg->resp_rate;
+            slow[GAS_SENSOR_SLOW_SINCE_BREATH] = sim->breathing ?
+                      (uint8_t)(since_breath > 254 ? 254 : since_breath) : GAS_SENSOR_NO_DATA;
+            slow[GAS_SENSOR_SLOW_PRIMARY_AGENT] = (uint8_t)cfg->agent;
+            slow[GAS_SENSOR_SLOW_SECONDARY_AGENT] = (uint8_t)GAS_AGENT_NONE;
+            put_uint16_be(&slow[GAS_SENSOR_SLOW_ATM_PRESSURE], cfg->atm_pressure);
+            break;
+        case 0x04:
+            slow[GAS_SENSOR_SLOW_MODE] = (uint8_t)cfg->mode;
+            slow[GAS_SENSOR_SLOW_ERROR] = cfg->error_reg;
+            slow[GAS_SENSOR_SLOW_ADAPTER] = cfg->adapter_reg;
+            break;
+        case 0x05:
+            slow[GAS_SENSOR_SLOW_CONFIG0] = cfg->config_reg0;
+            slow[GAS_SENSOR_SLOW_HW_REV] = to_bcd(cfg->hw_revision);
+            slow[GAS_SENSOR_SLOW_SW_REV] = to_bcd(cfg->sw_revision / 100);
+            slow[GAS_SENSOR_SLOW_SW_REV + 1] = to_bcd(cfg->sw_revision % 100);
+            slow[GAS_SENSOR_SLOW_CONFIG1] = cfg->config_reg1;
+            slow[GAS_SENSOR_SLOW_PROTOCOL_REV] = to_bcd(cfg->protocol_revision);
+            break;
+        case 0x06:
+            put_uint16_be(&slow[GAS_SENSOR_SLOW_SERIAL], cfg->serial_number);
+            break;
+        default:
+            /* Reserved IDs carry no data */
+            break;
+    }
+
+    frame_data[GAS_SENSOR_OFFSET_CHECKSUM] = gas_sensor_compute_checksum(frame_data);
+    sim->frame_count++;
+}
@@ -0,0 +1,92 @@
+/*
+ * Anesthetic Gas Sensor Simulator
+ *
+ * Generates protocol-conformant 21-byte frames for a simulated patient:
+ * a capnogram-shaped waveform at a configurable respiratory rate, slow
+ * data cycling through IDs 0-9, and register/config/service frames laid
+ * out as in GAS_SENSOR_PROTOCOL.md. The simulator is a plain value type
+ * with no I/O and no clock of its own; each call produces the next frame
+ * of a 50 ms cadence, so it can drive benchmarks, ptys or virtual-time
+ * simulations alike.
+ */
+
+#ifndef GAS_SENSOR_SIM_H
+#define GAS_SENSOR_SIM_H
+
+#include "gas_sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_SIM_FRAME_PERIOD_US  50000
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+/* Simulated patient and sensor parameters */
+typedef struct {
+    uint8_t resp_rate;              /* Breaths per minute, 0 = apnea */
+    float etco2;                    /* End-tidal CO2 (%) */
+    float fio2;                     /* Inspired O2 (%) */
+    float n2o;                      /* Inspired N2O (%) */
+    gas_agent_id_t agent;           /* Primary agent */
+    float et_agent;                 /* End-tidal primary agent (%) */
+    gas_sensor_mode_t mode;         /* Reported sensor mode */
+    uint8_t status;                 /* Extra STS bits to report (bits 1-7) */
+    uint8_t error_reg;              /* Sensor error register */
+    uint8_t adapter_reg;            /* Adapter status register */
+    uint8_t config_reg0;            /* Fitted options (ConfigData byte 0) */
+    uint8_t config_reg1;            /* ConfigData byte 4 (bit 0 = ID_CFG) */
+    uint8_t hw_revision;            /* Hardware revision, 0-99 */
+    uint16_t sw_revision;           /* Software revision, 0-9999 */
+    uint8_t protocol_revision;      /* Comm protocol revision, 0-99 */
+    uint16_t serial_number;
+    uint16_t atm_pressure;          /* Ambient pressure in kPa * 10 */
+} gas_sensor_sim_config_t;
+
+/* Simulator state */
+typedef struct {
+    gas_sensor_sim_config_t config;
+    uint64_t frame_count;           /* Frames generated so far */
+    uint64_t last_breath_frame;     /* Frame count at the last breath start */
+    bool breathing;                 /* At least one breath since start */
+} gas_sensor_sim_t;
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Fill a configuration with a healthy adult under sevoflurane
+ */
+void gas_sensor_sim_default_config(gas_sensor_sim_config_t *config);
+
+/**
+ * Initialize a simulator
+ *
+ * @param sim: Simulator state
+ * @param config: Parameters (copied; NULL for defaults)
+ */
+void gas_sensor_sim_init(gas_sensor_sim_t *sim, const gas_sensor_sim_config_t *config);
+
+/**
+ * Generate the next frame (advances simulated time by 50 ms)
+ *
+ * Parameters in sim->config may be changed between calls.
+ *
+ * @param sim: Simulator state
+ * @param frame_data: Output 21-byte frame with valid checksum
+ */
+void gas_sensor_sim_next_frame(gas_sensor_sim_t *sim, uint8_t *frame_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_SIM_H */
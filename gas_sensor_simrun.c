@@ -0,0 +1,441 @@
+/*
+ * Anesthetic Gas Sensor Deterministic Simulation Runtime - Implementation
+ *
+ * Pending events live in a binary min-heap ordered by virtual time and
+ * then by scheduling sequence number, which makes the order of events at
+ * the same instant independent of heap layout.
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor_simrun.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+typedef enum {
+    EVENT_FRAME,
+    EVENT_TIMER
+} event_kind_t;
+
+typedef struct {
+    uint64_t at_us;
+    uint64_t seq;
+    uint32_t kind;                  /* event_kind_t */
+    uint32_t index;                 /* Into sensors or timers */
+} event_t;
+
+typedef struct {
+    gas_sensor_sim_t sim;
+    gas_sensor_simrun_timing_t timing;
+    gas_sensor_session_t session;   /* Fed directly, or NULL */
+    int fd;                         /* Written to when session is NULL */
+    uint64_t base_us;               /* Nominal time of frame 0 */
+    uint64_t frame_index;           /* Next frame */
+    uint64_t last_at_us;            /* Delivery time of the previous frame */
+} sensor_t;
+
+typedef struct {
+    gas_sensor_simrun_fn fn;
+    void *ctx;
+    uint64_t period_us;             /* 0 = one-shot */
+} sim_timer_t;
+
+struct gas_sensor_simrun {
+    gas_sensor_vclock_t vclock;
+    gas_sensor_clock_t clock;
+    uint64_t rng;
+    gas_sensor_session_mgr_t mgr;
+    sensor_t **sensors;
+    size_t sensor_count;
+    size_t sensor_capacity;
+    sim_timer_t *timers;
+    size_t timer_count;
+    size_t timer_capacity;
+    event_t *heap;
+    size_t heap_len;
+    size_t heap_capacity;
+    uint64_t next_seq;
+    bool written;                   /* A descriptor was written this instant */
+    gas_sensor_simrun_stats_t stats;
+};
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+/* xorshift64*: small, fast and identical on every platform */
+static uint64_t rng_next(struct gas_sensor_simrun *run)
+{
+    run->rng ^= run->rng >> 12;
+    run->rng ^= run->rng << 25;
+    run->rng ^= run->rng >> 27;
+    return run->rng * 2685821657736338717ull;
+}
+
+static bool event_before(const event_t *a, const event_t *b)
+{
+    return a->at_us < b->at_us || (a->at_us == b->at_us && a->seq < b->seq);
+}
+
+static int heap_push(struct gas_sensor_simrun *run, uint64_t at_us,
+                     event_kind_t kind, size_t index)
+{
+    if (run->heap_len == run->heap_capacity) {
+        size_t capacity = run->heap_capacity ? run->heap_capacity * 2 : 64;
+        event_t *heap = realloc(run->heap, capacity * sizeof(*heap));
+        if (heap == NULL) {
+            return GAS_SENSOR_ERR_MEMORY;
+        }
+        run->heap = heap;
+        run->heap_capacity = capacity;
+    }
+
+    event_t ev = { at_us, run->next_seq++, (uint32_t)kind, (uint32_t)index };
+    size_t i = run->heap_len++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!event_before(&ev, &run->heap[parent])) {
+            break;
+        }
+        run->heap[i] = run->heap[parent];
+        i = parent;
+    }
+    run->heap[i] = ev;
+    return GAS_SENSOR_OK;
+}
+
+static event_t heap_pop(struct gas_sensor_simrun *run)
+{
+    event_t top = run->heap[0];
+    event_t last = run->heap[--run->heap_len];
+
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= run->heap_len) {
+            break;
+        }
+        if (child + 1 < run->heap_len && event_before(&run->heap[child + 1], &run->heap[child])) {
+            child++;
+        }
+        if (!event_before(&run->heap[child], &last)) {
+            break;
+        }
+        run->heap[i] = run->heap[child];
+        i = child;
+    }
+    if (run->heap_len > 0) {
+        run->heap[i] = last;
+    }
+    return top;
+}
+
+/* Delivery time of a sensor's next frame */
+static uint64_t sensor_due(struct gas_sensor_simrun *run, sensor_t *s)
+{
+    uint64_t offset = s->frame_index * GAS_SENSOR_SIM_FRAME_PERIOD_US *
+                      (uint64_t)(1000000 + s->timing.drift_ppm) / 1000000;
+    uint64_t at = s->base_us + offset;
+    if (s->timing.jitter_us > 0) {
+        at += rng_next(run) % ((uint64_t)s->timing.jitter_us + 1);
+    }
+
+    /* Jitter never reorders a sensor's frames */
+    return (at > s->last_at_us) ? at : s->last_at_us;
+}
+
+static int add_sensor(struct gas_sensor_simrun *run,
+                      const gas_sensor_sim_config_t *config,
+                      const gas_sensor_simrun_timing_t *timing,
+                      gas_sensor_session_t session,
+                      int fd,
+                      gas_sensor_sim_t **sim)
+{
+    gas_sensor_simrun_timing_t t;
+    if (timing != NULL) {
+        t = *timing;
+    } else {
+        memset(&t, 0, sizeof(t));
+    }
+
+    if (t.drift_ppm > GAS_SENSOR_SIMRUN_MAX_DRIFT_PPM ||
+        t.drift_ppm < -GAS_SENSOR_SIMRUN_MAX_DRIFT_PPM ||
+        t.jitter_us >= GAS_SENSOR_SIM_FRAME_PERIOD_US) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    if (run->sensor_count == run->sensor_capacity) {
+        size_t capacity = run->sensor_capacity ? run->sensor_capacity * 2 : 16;
+        sensor_t **sensors = realloc(run->sensors, capacity * sizeof(*sensors));
+        if (sensors == NULL) {
+            return GAS_SENSOR_ERR_MEMORY;
+        }
+        run->sensors = sensors;
+        run->sensor_capacity = capacity;
+    }
+
+    sensor_t *s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    gas_sensor_sim_init(&s->sim, config);
+    s->timing = t;
+    s->session = session;
+    s->fd = fd;
+    s->base_us = run->vclock.now_us + rng_next(run) % GAS_SENSOR_SIM_FRAME_PERIOD_US;
+
+    int ret = heap_push(run, sensor_due(run, s), EVENT_FRAME, run->sensor_count);
+    if (ret != GAS_SENSOR_OK) {
+        free(s);
+        return ret;
+    }
+
+    run->sensors[run->sensor_count++] = s;
+    if (sim != NULL) {
+        *sim = &s->sim;
+    }
+    return GAS_SENSOR_OK;
+}
+
+static int add_timer(struct gas_sensor_simrun *run, uint64_t at_us, uint64_t period_us,
+                     gas_sensor_simrun_fn fn, void *ctx)
+{
+    if (run->timer_count == run->timer_capacity) {
+        size_t capacity = run->timer_capacity ? run->timer_capacity * 2 : 16;
+        sim_timer_t *timers = realloc(run->timers, capacity * sizeof(*timers));
+        if (timers == NULL) {
+            return GAS_SENSOR_ERR_MEMORY;
+        }
+        run->timers = timers;
+        run->timer_capacity = capacity;
+    }
+
+    int ret = heap_push(run, at_us, EVENT_TIMER, run->timer_count);
+    if (ret != GAS_SENSOR_OK) {
+        return ret;
+    }
+
+    sim_timer_t *t = &run->timers[run->timer_count++];
+    t->fn = fn;
+    t->ctx = ctx;
+    t->period_us = period_us;
+    return GAS_SENSOR_OK;
+}
+
+/* Emit one frame; write failures are counted, the sensor keeps going */
+static void sensor_emit(struct gas_sensor_simrun *run, sensor_t *s, uint64_t now_us)
+{
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+    gas_sensor_sim_next_frame(&s->sim, frame);
+    run->stats.frames++;
+
+    if (s->session != NULL) {
+        gas_sensor_session_feed(s->session, frame, sizeof(frame), now_us);
+        return;
+    }
+
+    run->written = true;
+    ssize_t n;
+    do {
+        n = write(s->fd, frame, sizeof(frame));
+    } while (n < 0 && errno == EINTR);
+    if (n != (ssize_t)sizeof(frame)) {
+        run->stats.write_errors++;
+    }
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+int gas_sensor_simrun_create(uint64_t start_us, uint64_t seed, gas_sensor_simrun_t *run)
+{
+    if (run == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    struct gas_sensor_simrun *r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    gas_sensor_vclock_init(&r->vclock, start_us);
+    r->clock = gas_sensor_vclock_clock(&r->vclock);
+
+    /* xorshift needs a non-zero state */
+    r->rng = seed ^ 0x9E3779B97F4A7C15ull;
+    if (r->rng == 0) {
+        r->rng = 1;
+    }
+
+    *run = r;
+    return GAS_SENSOR_OK;
+}
+
+const gas_sensor_clock_t *gas_sensor_simrun_clock(gas_sensor_simrun_t run)
+{
+    return (run != NULL) ? &run->clock : NULL;
+}
+
+uint64_t gas_sensor_simrun_now(gas_sensor_simrun_t run)
+{
+    return (run != NULL) ? run->vclock.now_us : 0;
+}
+
+int gas_sensor_simrun_set_mgr(gas_sensor_simrun_t run, gas_sensor_session_mgr_t mgr)
+{
+    if (run == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (mgr != NULL) {
+        int ret = gas_sensor_session_mgr_set_clock(mgr, &run->clock);
+        if (ret != GAS_SENSOR_OK) {
+            return ret;
+        }
+    }
+
+    run->mgr = mgr;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_simrun_add_sensor(gas_sensor_simrun_t run,
+                                 const gas_sensor_sim_config_t *config,
+                                 const gas_sensor_simrun_timing_t *timing,
+                                 gas_sensor_session_t session,
+                                 gas_sensor_sim_t **sim)
+{
+    if (run == NULL || session == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    return add_sensor(run, config, timing, session, -1, sim);
+}
+
+int gas_sensor_simrun_add_sensor_fd(gas_sensor_simrun_t run,
+                                    const gas_sensor_sim_config_t *config,
+                                    const gas_sensor_simrun_timing_t *timing,
+                                    int fd,
+                                    gas_sensor_sim_t **sim)
+{
+    if (run == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (fd < 0) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    return add_sensor(run, config, timing, NULL, fd, sim);
+}
+
+int gas_sensor_simrun_every(gas_sensor_simrun_t run,
+                            uint64_t period_us,
+                            gas_sensor_simrun_fn fn,
+                            void *ctx)
+{
+    if (run == NULL || fn == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (period_us == 0) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    return add_timer(run, run->vclock.now_us + period_us, period_us, fn, ctx);
+}
+
+int gas_sensor_simrun_at(gas_sensor_simrun_t run,
+                         uint64_t at_us,
+                         gas_sensor_simrun_fn fn,
+                         void *ctx)
+{
+    if (run == NULL || fn == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (at_us < run->vclock.now_us) {
+        at_us = run->vclock.now_us;
+    }
+    return add_timer(run, at_us, 0, fn, ctx);
+}
+
+int gas_sensor_simrun_run_until(gas_sensor_simrun_t run, uint64_t end_us)
+{
+    if (run == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    while (run->heap_len > 0 && run->heap[0].at_us <= end_us) {
+        event_t ev = heap_pop(run);
+        gas_sensor_vclock_set(&run->vclock, ev.at_us);
+        run->stats.events++;
+
+        int result = GAS_SENSOR_OK;
+        if (ev.kind == EVENT_FRAME) {
+            sensor_t *s = run->sensors[ev.index];
+            sensor_emit(run, s, ev.at_us);
+            s->last_at_us = ev.at_us;
+            s->frame_index++;
+            /* Cannot fail: the pop left room */
+            heap_push(run, sensor_due(run, s), EVENT_FRAME, ev.index);
+        } else {
+            /* The callback may add timers, moving the array */
+            sim_timer_t t = run->timers[ev.index];
+            run->stats.timer_calls++;
+            if (t.period_us != 0) {
+                heap_push(run, ev.at_us + t.period_us, EVENT_TIMER, ev.index);
+            }
+            result = t.fn(t.ctx, ev.at_us);
+        }
+
+        /* The manager sees each instant once all of its bytes are written;
+         * directly fed sessions need no poll. Its idle timer is checked at
+         * every poll, i.e. at least once per frame period. */
+        bool instant_done = (run->heap_len == 0 || run->heap[0].at_us > ev.at_us);
+        if (run->mgr != NULL && instant_done && run->written) {
+            run->written = false;
+            gas_sensor_session_mgr_poll(run->mgr, 0);
+            run->stats.polls++;
+        }
+
+        if (result != GAS_SENSOR_OK) {
+            return result;
+        }
+    }
+
+    gas_sensor_vclock_set(&run->vclock, end_us);
+    if (run->mgr != NULL) {
+        gas_sensor_session_mgr_poll(run->mgr, 0);
+        run->stats.polls++;
+    }
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_simrun_stats(gas_sensor_simrun_t run, gas_sensor_simrun_stats_t *stats)
+{
+    if (run == NULL || stats == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    *stats = run->stats;
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_simrun_destroy(gas_sensor_simrun_t run)
+{
+    if (run == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < run->sensor_count; i++) {
+        free(run->sensors[i]);
+    }
+    free(run->sensors);
+    free(run->timers);
+    free(run->heap);
+    free(run);
+}
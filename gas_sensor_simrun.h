@@ -0,0 +1,201 @@
+/*
+ * Anesthetic Gas Sensor Deterministic Simulation Runtime
+ *
+ * Runs multi-sensor scenarios on a virtual clock. The runtime is a
+ * discrete-event loop over simulated sensors, which emit a frame every
+ * 50 ms of their own (optionally drifting) clock, and over timers that
+ * stand in for the periodic work of an application: watchdogs, rollups,
+ * gas_sensor_o2feed_run(), scenario changes. Virtual time jumps straight
+ * from one event to the next, so a 24-hour scenario with dozens of
+ * sensors runs in seconds, and events at the same instant are handled in
+ * the order they were scheduled, so every run with the same seed produces
+ * the same frames, timestamps and callbacks.
+ *
+ * Sensors either feed a session directly (gas_sensor_session_feed() with
+ * the virtual timestamp) or write their frames to a descriptor, typically
+ * the write end of a pipe whose read end is attached to a session
+ * manager. When a manager is set, its clock is the runtime's and it is
+ * polled without blocking after every instant in which a frame was
+ * written, so its receive timestamps and idle timer follow virtual time
+ * as well.
+ *
+ * Everything runs on the calling thread. Handlers observe time through
+ * the event timestamps or gas_sensor_simrun_clock(); a component that
+ * reads the system clock itself (blocking waits with a timeout, for
+ * example) is not simulated.
+ */
+
+#ifndef GAS_SENSOR_SIMRUN_H
+#define GAS_SENSOR_SIMRUN_H
+
+#include "gas_sensor_clock.h"
+#include "gas_sensor_sim.h"
+#include "gas_sensor_session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Largest drift accepted by gas_sensor_simrun_add_sensor() */
+#define GAS_SENSOR_SIMRUN_MAX_DRIFT_PPM     100000
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_simrun *gas_sensor_simrun_t;
+
+/**
+ * Timer callback
+ *
+ * @param ctx: Timer context
+ * @param now_us: Virtual time of the call (us since epoch)
+ * @return: GAS_SENSOR_OK to continue, any other value stops
+ *          gas_sensor_simrun_run_until(), which returns it
+ */
+typedef int (*gas_sensor_simrun_fn)(void *ctx, uint64_t now_us);
+
+/* Frame timing of a simulated sensor; zeroed = ideal 50 ms cadence */
+typedef struct {
+    int32_t drift_ppm;              /* Sensor clock error: period is 50 ms * (1 + ppm / 1e6) */
+    uint32_t jitter_us;             /* Delivery delay drawn from the seed, 0 to jitter_us */
+} gas_sensor_simrun_timing_t;
+
+typedef struct {
+    uint64_t events;                /* Events processed */
+    uint64_t frames;                /* Frames emitted */
+    uint64_t timer_calls;           /* Timer callbacks made */
+    uint64_t write_errors;          /* Frames a descriptor did not accept */
+    uint64_t polls;                 /* Session manager polls */
+} gas_sensor_simrun_stats_t;
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Create a runtime
+ *
+ * @param start_us: Virtual time at start (us since epoch)
+ * @param seed: Seed for sensor phases and jitter
+ * @param run: Output parameter for the runtime handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_simrun_create(uint64_t start_us, uint64_t seed, gas_sensor_simrun_t *run);
+
+/**
+ * Get the runtime's virtual clock
+ *
+ * The clock stays valid until the runtime is destroyed; inject it into
+ * any component that reads time through a gas_sensor_clock_t.
+ */
+const gas_sensor_clock_t *gas_sensor_simrun_clock(gas_sensor_simrun_t run);
+
+/**
+ * Get the current virtual time (us since epoch)
+ */
+uint64_t gas_sensor_simrun_now(gas_sensor_simrun_t run);
+
+/**
+ * Drive a session manager from the runtime
+ *
+ * Sets the manager's clock to the runtime's; the manager is polled with
+ * a zero timeout after every instant in which a sensor wrote to its
+ * descriptor, and at the end of each run.
+ *
+ * @param run: Runtime handle
+ * @param mgr: Session manager, or NULL to stop polling (its clock is
+ *             left as is)
+ * @return: GAS_SENSOR_OK, or an error from gas_sensor_session_mgr_set_clock()
+ */
+int gas_sensor_simrun_set_mgr(gas_sensor_simrun_t run, gas_sensor_session_mgr_t mgr);
+
+/**
+ * Add a simulated sensor feeding a session
+ *
+ * The first frame comes within one frame period of the current time, at
+ * a phase drawn from the seed.
+ *
+ * @param run: Runtime handle
+ * @param config: Simulator parameters, or NULL for the defaults
+ * @param timing: Frame timing, or NULL for the ideal cadence
+ * @param session: Session fed with every frame
+ * @param sim: Output parameter for the simulator, whose config may be
+ *             changed by timer callbacks to script a scenario (may be NULL)
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM (timing out of
+ *          range), GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_simrun_add_sensor(gas_sensor_simrun_t run,
+                                 const gas_sensor_sim_config_t *config,
+                                 const gas_sensor_simrun_timing_t *timing,
+                                 gas_sensor_session_t session,
+                                 gas_sensor_sim_t **sim);
+
+/**
+ * Add a simulated sensor writing to a descriptor
+ *
+ * As gas_sensor_simrun_add_sensor(), but each frame is written to fd; a
+ * non-blocking pipe is best, so a reader that falls behind shows up in
+ * write_errors instead of stalling the run.
+ *
+ * @param fd: Descriptor (stays owned by the caller)
+ */
+int gas_sensor_simrun_add_sensor_fd(gas_sensor_simrun_t run,
+                                    const gas_sensor_sim_config_t *config,
+                                    const gas_sensor_simrun_timing_t *timing,
+                                    int fd,
+                                    gas_sensor_sim_t **sim);
+
+/**
+ * Call a function every period_us of virtual time
+ *
+ * The first call is period_us from now.
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM (zero period),
+ *          GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_simrun_every(gas_sensor_simrun_t run,
+                            uint64_t period_us,
+                            gas_sensor_simrun_fn fn,
+                            void *ctx);
+
+/**
+ * Call a function once at a virtual time (now if it has passed)
+ *
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_simrun_at(gas_sensor_simrun_t run,
+                         uint64_t at_us,
+                         gas_sensor_simrun_fn fn,
+                         void *ctx);
+
+/**
+ * Process every event up to and including a virtual time
+ *
+ * On return the clock reads end_us, unless a timer stopped the run.
+ *
+ * @param run: Runtime handle
+ * @param end_us: Virtual time to run to (us since epoch)
+ * @return: GAS_SENSOR_OK, a timer's stop value, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_simrun_run_until(gas_sensor_simrun_t run, uint64_t end_us);
+
+/**
+ * Get runtime counters
+ */
+int gas_sensor_simrun_stats(gas_sensor_simrun_t run, gas_sensor_simrun_stats_t *stats);
+
+/**
+ * Free a runtime (sessions, descriptors and the manager are not touched)
+ */
+void gas_sensor_simrun_destroy(gas_sensor_simrun_t run);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_SIMRUN_H */
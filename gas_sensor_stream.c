@@ -0,0 +1,191 @@
+/*
+ * Anesthetic Gas Sensor Byte Stream Synchronization - Implementation
+ */
+
+#include "gas_sensor_stream.h"
+#include <string.h>
+
+/* Forces the built-in and descriptor-driven copies of the feed loop apart */
+#if defined(__GNUC__)
+#define ALWAYS_INLINE   inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE   inline
+#endif
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+/* Framing of the stream; NULL format selects the built-in layout */
+typedef struct {
+    const gas_sensor_format_t *format;
+    uint8_t sync1;
+    uint8_t sync2;
+    size_t size;
+} framing_t;
+
+static ALWAYS_INLINE bool frame_ok(framing_t fr, const uint8_t *frame_data)
+{
+    return (fr.format == NULL) ? gas_sensor_verify_checksum(frame_data)
+                               : gas_sensor_format_check(fr.format, frame_data);
+}
+
+/**
+ * Find the next possible start of frame at or after `from`
+ *
+ * A candidate is the first sync byte followed by the second, or the first
+ * as the very last byte (the second may arrive with the next read).
+ * Returns length if none.
+ */
+static ALWAYS_INLINE size_t find_sync(framing_t fr, const uint8_t *data,
+                                      size_t from, size_t length)
+{
+    while (from < length) {
+        const uint8_t *p = memchr(&data[from], fr.sync1, length - from);
+        if (p == NULL) {
+            return length;
+        }
+
+        size_t j = (size_t)(p - data);
+        if (j + 1 == length || data[j + 1] == fr.sync2) {
+            return j;
+        }
+        from = j + 1;
+    }
+    return length;
+}
+
+/**
+ * Drop the rejected candidate at the front of the carry buffer and keep
+ * the next possible start of frame inside it, if any
+ */
+static ALWAYS_INLINE void resync_carry(framing_t fr, gas_sensor_stream_t *stream)
+{
+    size_t p = find_sync(fr, stream->carry, 1, stream->carry_len);
+
+    stream->stats.discarded_bytes += p;
+    stream->carry_len -= p;
+    if (stream->carry_len > 0) {
+        memmove(stream->carry, &stream->carry[p], stream->carry_len);
+    }
+}
+
+/**
+ * Feed loop, specialized per framing
+ */
+static ALWAYS_INLINE int feed_framed(framing_t fr,
+                                     gas_sensor_stream_t *stream,
+                                     const uint8_t *data,
+                                     size_t length,
+                                     gas_sensor_stream_handler_t handler,
+                                     void *ctx)
+{
+    size_t i = 0;
+
+    /* Complete a frame split across reads */
+    while (stream->carry_len > 0) {
+        size_t take = fr.size - stream->carry_len;
+        if (take > length - i) {
+            take = length - i;
+        }
+        memcpy(&stream->carry[stream->carry_len], &data[i], take);
+        stream->carry_len += take;
+        i += take;
+
+        if (stream->carry_len >= 2 && stream->carry[1] != fr.sync2) {
+            resync_carry(fr, stream);
+            continue;
+        }
+        if (stream->carry_len < fr.size) {
+            return GAS_SENSOR_OK;
+        }
+
+        if (frame_ok(fr, stream->carry)) {
+            stream->carry_len = 0;
+            stream->stats.frames++;
+            int result = handler(ctx, stream->carry);
+            if (result != GAS_SENSOR_OK) {
+                return result;
+            }
+        } else {
+            stream->stats.checksum_errors++;
+            resync_carry(fr, stream);
+        }
+    }
+
+    /* Take complete frames straight from the caller's buffer */
+    while (i < length) {
+        size_t j = find_sync(fr, data, i, length);
+        stream->stats.discarded_bytes += j - i;
+        if (j == length) {
+            break;
+        }
+
+        if (length - j < fr.size) {
+            memcpy(stream->carry, &data[j], length - j);
+            stream->carry_len = length - j;
+            break;
+        }
+
+        if (frame_ok(fr, &data[j])) {
+            i = j + fr.size;
+            stream->stats.frames++;
+            int result = handler(ctx, &data[j]);
+            if (result != GAS_SENSOR_OK) {
+                return result;
+            }
+        } else {
+            /* Resume right after the rejected sync byte */
+            stream->stats.checksum_errors++;
+            stream->stats.discarded_bytes++;
+            i = j + 1;
+        }
+    }
+
+    return GAS_SENSOR_OK;
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+void gas_sensor_stream_init(gas_sensor_stream_t *stream)
+{
+    if (stream == NULL) {
+        return;
+    }
+
+    memset(stream, 0, sizeof(*stream));
+}
+
+int gas_sensor_stream_feed(gas_sensor_stream_t *stream,
+                           const uint8_t *data,
+                           size_t length,
+                           gas_sensor_stream_handler_t handler,
+                           void *ctx)
+{
+    if (stream == NULL || handler == NULL || (data == NULL && length > 0)) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    framing_t fr = { NULL, GAS_SENSOR_FLAG1, GAS_SENSOR_FLAG2, GAS_SENSOR_FRAME_SIZE };
+    return feed_framed(fr, stream, data, length, handler, ctx);
+}
+
+int gas_sensor_stream_feed_format(gas_sensor_stream_t *stream,
+                                  const gas_sensor_format_t *format,
+                                  const uint8_t *data,
+                                  size_t length,
+                                  gas_sensor_stream_handler_t handler,
+                                  void *ctx)
+{
+    if (format == NULL) {
+        return gas_sensor_stream_feed(stream, data, length, handler, ctx);
+    }
+    if (stream == NULL || handler == NULL || (data == NULL && length > 0)) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    framing_t fr = { format, format->sync[0], format->sync[1], format->size };
+    return feed_framed(fr, stream, data, length, handler, ctx);
+}
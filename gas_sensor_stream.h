@@ -0,0 +1,107 @@
+/*
+ * Anesthetic Gas Sensor Byte Stream Synchronization
+ *
+ * Turns arbitrarily chunked serial bytes into aligned, checksum-verified
+ * 21-byte frames. Complete frames are taken directly from the caller's
+ * buffer; only a frame split across two reads is copied, into a small
+ * carry buffer. After a sync or checksum failure, scanning resumes one
+ * byte after the rejected FLAG1 so a real frame hidden inside garbage is
+ * never skipped.
+ *
+ * gas_sensor_stream_feed_format() frames by a gas_sensor_format_t
+ * descriptor instead of the built-in layout, for sensor variants with
+ * other sync bytes, sizes or checksums.
+ */
+
+#ifndef GAS_SENSOR_STREAM_H
+#define GAS_SENSOR_STREAM_H
+
+#include "gas_sensor.h"
+#include "gas_sensor_format.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+/* Stream synchronization statistics */
+typedef struct {
+    uint64_t frames;                /* Valid frames delivered */
+    uint64_t checksum_errors;       /* Candidates with sync bytes but bad checksum */
+    uint64_t discarded_bytes;       /* Bytes skipped while searching for sync */
+} gas_sensor_stream_stats_t;
+
+/* Stream synchronizer state; allocate anywhere and gas_sensor_stream_init() */
+typedef struct {
+    uint8_t carry[GAS_SENSOR_FORMAT_MAX_SIZE];  /* Partial frame from last feed */
+    size_t carry_len;
+    gas_sensor_stream_stats_t stats;
+} gas_sensor_stream_t;
+
+/**
+ * Aligned frame handler
+ *
+ * @param ctx: User context
+ * @param frame_data: Pointer to a frame (21 bytes, or the format's size) with
+ *                    valid sync and checksum
+ * @return: GAS_SENSOR_OK to continue, any other value stops the feed
+ */
+typedef int (*gas_sensor_stream_handler_t)(void *ctx, const uint8_t *frame_data);
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Reset a stream synchronizer
+ */
+void gas_sensor_stream_init(gas_sensor_stream_t *stream);
+
+/**
+ * Feed received bytes and deliver every complete frame
+ *
+ * Frame pointers passed to the handler are only valid during the call.
+ * If the handler stops the feed, the remaining bytes are dropped.
+ *
+ * @param stream: Stream state
+ * @param data: Received bytes
+ * @param length: Number of bytes
+ * @param handler: Called once per valid frame
+ * @param ctx: Handler context
+ * @return: GAS_SENSOR_OK, the handler's return value if it stopped the
+ *          feed, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_stream_feed(gas_sensor_stream_t *stream,
+                           const uint8_t *data,
+                           size_t length,
+                           gas_sensor_stream_handler_t handler,
+                           void *ctx);
+
+/**
+ * Feed received bytes framed by a format descriptor
+ *
+ * As gas_sensor_stream_feed(), with the sync bytes, frame size and
+ * checksum taken from the descriptor. A stream must be fed with one
+ * format only; reinitialize it before switching.
+ *
+ * @param stream: Stream state
+ * @param format: Descriptor accepted by gas_sensor_format_validate(), or
+ *                NULL for the built-in layout
+ * @return: As gas_sensor_stream_feed()
+ */
+int gas_sensor_stream_feed_format(gas_sensor_stream_t *stream,
+                                  const gas_sensor_format_t *format,
+                                  const uint8_t *data,
+                                  size_t length,
+                                  gas_sensor_stream_handler_t handler,
+                                  void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_STREAM_H */
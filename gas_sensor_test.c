@@ -0,0 +1,1439 @@
+/*
+ * Anesthetic Gas Sensor Protocol Conformance Tests
+ *
+ * Every frame here is built by hand from the byte layout in
+ * doc/GAS_SENSOR_PROTOCOL.md rather than by the simulator, so a library
+ * and simulator that agree with each other but not with the sensor
+ * cannot pass. Waveform words are chosen so that byte 13 (the O2 LO
+ * byte) never looks like the slow data field that follows it.
+ *
+ * Build:
+ *   gcc -O2 -o gas_sensor_test gas_sensor_test.c gas_sensor.c \
+ *       gas_sensor_o2feed.c gas_sensor_session.c gas_sensor_stream.c \
+ *       gas_sensor_format.c gas_sensor_clock.c gas_sensor_mem.c \
+ *       gas_sensor_hl7.c gas_sensor_uplink.c gas_sensor_ws.c \
+ *       gas_sensor_capture.c gas_sensor_changelog.c gas_sensor_case.c \
+ *       gas_sensor_executor.c -lpthread -lm
+ *
+ * Usage:
+ *   gas_sensor_test        exits non-zero if any check fails
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor.h"
+#include "gas_sensor_o2feed.h"
+#include "gas_sensor_session.h"
+#include "gas_sensor_format.h"
+#include "gas_sensor_changelog.h"
+#include "gas_sensor_executor.h"
+#include "gas_sensor_hl7.h"
+#include "gas_sensor_uplink.h"
+#include "gas_sensor_ws.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                    \
+                    __FILE__, __LINE__, #cond);                             \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_NEAR(value, expected) CHECK((value) > (expected) - 0.001f && \
+                                          (value) < (expected) + 0.001f)
+
+/* ============================================================================
+ * Frame Construction
+ * ============================================================================ */
+
+/* Waveform in hundredths of %: CO2 5.00, N2O 60.00, AA1 2.00, AA2 0, O2 50.00 */
+static const uint16_t test_waveform[5] = { 0x01F4, 0x1770, 0x00C8, 0x0000, 0x1388 };
+
+/**
+ * Lay out a frame per the protocol document
+ *
+ * [0-1] 0xAA 0x55, [2] ID, [3] STS, [4-13] five big-endian waveform
+ * words, [14-19] slow data, [20] two's complement of the sum of 2-19.
+ */
+static void build_frame_words(uint8_t frame[GAS_SENSOR_FRAME_SIZE], uint8_t id, uint8_t sts,
+                              const uint16_t words[5], const uint8_t slow[6])
+{
+    uint8_t sum = 0;
+    int i;
+
+    frame[0] = 0xAA;
+    frame[1] = 0x55;
+    frame[2] = id;
+    frame[3] = sts;
+    for (i = 0; i < 5; i++) {
+        frame[4 + 2 * i] = (uint8_t)(words[i] >> 8);
+        frame[5 + 2 * i] = (uint8_t)(words[i] & 0xFF);
+    }
+    memcpy(&frame[14], slow, 6);
+
+    for (i = 2; i < 20; i++) {
+        sum = (uint8_t)(sum + frame[i]);
+    }
+    frame[20] = (uint8_t)(0x100 - sum);
+}
+
+/* A frame with the test waveform and no STS bits */
+static void build_frame(uint8_t frame[GAS_SENSOR_FRAME_SIZE], uint8_t id,
+                        const uint8_t slow[6])
+{
+    build_frame_words(frame, id, 0x00, test_waveform, slow);
+}
+
+/* ============================================================================
+ * Parser
+ * ============================================================================ */
+
+static void test_parse_sensor_regs(void)
+{
+    /* Sleep mode, uncalibrated, no adapter, zero calibration required */
+    static const uint8_t slow[6] = { 0x01, 0x00, 0x08, 0x02, 0x40, 0x00 };
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+    gas_sensor_slow_data_t slow_data;
+    gas_sensor_waveform_t waveform;
+
+    memset(&slow_data, 0, sizeof(slow_data));
+    build_frame(frame, 0x04, slow);
+    CHECK(frame[13] == 0x88);
+    CHECK(gas_sensor_parse_frame(frame, &slow_data, &waveform, NULL) == GAS_SENSOR_OK);
+
+    CHECK(slow_data.last_frame_id == 0x04);
+    CHECK(slow_data.sensor_regs.mode == GAS_SENSOR_MODE_SLEEP);
+    CHECK(!slow_data.sensor_regs.error.sw_error);
+    CHECK(slow_data.sensor_regs.error.uncalibrated);
+    CHECK(!slow_data.sensor_regs.adapter.replace_adapter);
+    CHECK(slow_data.sensor_regs.adapter.no_adapter);
+    CHECK(slow_data.sensor_regs.data_valid.zero_calibration_required);
+    CHECK(!slow_data.sensor_regs.data_valid.co2_out_of_range);
+    CHECK_NEAR(waveform.o2, 50.0f);
+}
+
+static void test_parse_config_data(void)
+{
+    /* CO2 only, hardware 12, software 1.23, ID_CFG set, protocol 2 */
+    static const uint8_t slow[6] = { 0x02, 0x12, 0x01, 0x23, 0x01, 0x02 };
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+    gas_sensor_slow_data_t slow_data;
+
+    memset(&slow_data, 0, sizeof(slow_data));
+    build_frame(frame, 0x05, slow);
+    CHECK(gas_sensor_parse_frame(frame, &slow_data, NULL, NULL) == GAS_SENSOR_OK);
+
+    CHECK(slow_data.last_frame_id == 0x05);
+    CHECK(!slow_data.config_data.o2_fitted);
+    CHECK(slow_data.config_data.co2_fitted);
+    CHECK(!slow_data.config_data.n2o_fitted);
+    CHECK(!slow_data.config_data.desflurane_fitted);
+    CHECK(slow_data.config_data.hw_revision == 12);
+    CHECK(slow_data.config_data.sw_revision == 123);
+    CHECK(slow_data.config_data.id_config);
+    CHECK(slow_data.config_data.comm_protocol_rev == 2);
+}
+
+static void test_select_decoder(void)
+{
+    /* Every option fitted; byte 13 (0x88) would read as "desflurane only" */
+    static const uint8_t config_slow[6] = { 0xFF, 0x12, 0x01, 0x23, 0x00, 0x02 };
+    /* FiCO2 0, FiN2O 60, FiAA1 2.3, FiAA2 0, FiO2 50 */
+    static const uint8_t insp_slow[6] = { 0x00, 0x3C, 0x17, 0x00, 0x32, 0x00 };
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+    gas_sensor_slow_data_t slow_data;
+    gas_sensor_waveform_t waveform;
+    gas_sensor_decoder_fn decode;
+
+    memset(&slow_data, 0, sizeof(slow_data));
+    build_frame(frame, 0x05, config_slow);
+    CHECK(gas_sensor_parse_frame(frame, &slow_data, NULL, NULL) == GAS_SENSOR_OK);
+    CHECK(slow_data.config_data.o2_fitted);
+    CHECK(slow_data.config_data.n2o_fitted);
+    CHECK(slow_data.config_data.halothane_fitted);
+
+    decode = gas_sensor_select_decoder(&slow_data.config_data);
+    CHECK(decode == gas_sensor_parse_frame);
+
+    build_frame(frame, 0x00, insp_slow);
+    CHECK(decode(frame, &slow_data, &waveform, NULL) == GAS_SENSOR_OK);
+    CHECK_NEAR(waveform.n2o, 60.0f);
+    CHECK_NEAR(waveform.aa1, 2.0f);
+    CHECK_NEAR(waveform.o2, 50.0f);
+    CHECK(slow_data.insp_vals.n2o != GAS_SENSOR_CONC_INVALID);
+    CHECK_NEAR(slow_data.insp_vals.aa1, 2.3f);
+    CHECK(slow_data.insp_vals.o2 != GAS_SENSOR_CONC_INVALID);
+}
+
+static void test_parse_gen_vals(void)
+{
+    /* RR 12, 3 s since the last breath, sevoflurane, no second agent, 101.3 kPa */
+    static const uint8_t slow[6] = { 0x0C, 0x03, 0x04, 0x00, 0x03, 0xF5 };
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+    gas_sensor_slow_data_t slow_data;
+
+    gas_sensor_init_slow_data(&slow_data);
+    build_frame(frame, 0x03, slow);
+    CHECK(gas_sensor_parse_frame(frame, &slow_data, NULL, NULL) == GAS_SENSOR_OK);
+
+    CHECK(slow_data.gen_vals.resp_rate == 12);
+    CHECK(slow_data.gen_vals.time_since_breath == 3);
+    CHECK(slow_data.gen_vals.primary_agent == GAS_AGENT_SEVOFLURANE);
+    CHECK_NEAR(slow_data.gen_vals.atm_pressure, 101.3f);
+
+    gas_sensor_init_slow_data(&slow_data);
+    CHECK(gas_sensor_format_decode(&gas_sensor_format_phasein, frame, &slow_data,
+                                   NULL, NULL) == GAS_SENSOR_OK);
+    CHECK_NEAR(slow_data.gen_vals.atm_pressure, 101.3f);
+}
+
+/* ============================================================================
+ * HL7 Export
+ * ============================================================================ */
+
+static void test_hl7_pressure(void)
+{
+    static const uint8_t slow[6] = { 0x0C, 0x03, 0x04, 0x00, 0x03, 0xF5 };
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+    gas_sensor_slow_data_t slow_data;
+    gas_sensor_hl7_writer_t writer;
+    gas_sensor_hl7_bed_t bed;
+    char message[2048];
+    size_t length = 0;
+
+    gas_sensor_init_slow_data(&slow_data);
+    build_frame(frame, 0x03, slow);
+    CHECK(gas_sensor_parse_frame(frame, &slow_data, NULL, NULL) == GAS_SENSOR_OK);
+
+    gas_sensor_hl7_writer_init(&writer, "GW", "OR", "EHR", "HOSP");
+    memset(&bed, 0, sizeof(bed));
+    bed.patient_id = "P1";
+    bed.location = "OR3^^1";
+    bed.sensor_id = 1;
+    bed.slow_data = &slow_data;
+    CHECK(gas_sensor_hl7_write_oru(&writer, &bed, message, sizeof(message) - 1,
+                                   &length) == GAS_SENSOR_OK);
+    message[length] = '\0';
+
+    /* OBX-5 of the ambient pressure observation */
+    const char *obx = strstr(message, "|ATMP^");
+    CHECK(obx != NULL);
+    if (obx != NULL) {
+        const char *value = strstr(obx, "^L||");
+        CHECK(value != NULL && strncmp(value + 4, "101.3|kPa|", 10) == 0);
+    }
+}
+
+/* ============================================================================
+ * O2 Compensation Feeder
+ * ============================================================================ */
+
+static int fixed_o2_source(void *ctx, uint32_t sensor_id, float *o2_percent)
+{
+    (void)ctx;
+    (void)sensor_id;
+    *o2_percent = 40.0f;
+    return GAS_SENSOR_OK;
+}
+
+/* Parse a hand-built frame and hand it to the feeder as a session would */
+static void feed_frame(gas_sensor_o2feed_t feeder, uint32_t sensor_id,
+                       gas_sensor_slow_data_t *slow_data,
+                       uint8_t id, const uint8_t slow[6])
+{
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+    gas_sensor_waveform_t waveform;
+    gas_sensor_status_t status;
+    gas_sensor_frame_event_t event;
+
+    build_frame(frame, id, slow);
+    CHECK(gas_sensor_parse_frame(frame, slow_data, &waveform, &status) == GAS_SENSOR_OK);
+
+    event.sensor_id = sensor_id;
+    event.timestamp_us = 0;
+    event.frame = frame;
+    event.slow_data = slow_data;
+    event.waveform = &waveform;
+    event.status = &status;
+    CHECK(gas_sensor_o2feed_frame_handler(feeder, &event) == GAS_SENSOR_OK);
+}
+
+/* Number of complete commands waiting in a pipe */
+static int drain_commands(int fd)
+{
+    uint8_t buffer[64];
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    return n > 0 ? (int)(n / GAS_SENSOR_COMMAND_SIZE) : 0;
+}
+
+static void test_o2feed(void)
+{
+    /* CO2 only, and every option fitted (byte 13 alone would say no O2) */
+    static const uint8_t config_no_o2[6] = { 0x02, 0x12, 0x01, 0x23, 0x00, 0x02 };
+    static const uint8_t config_all[6] = { 0xFF, 0x12, 0x01, 0x23, 0x00, 0x02 };
+    /* Measurement mode, then self-test after a restart */
+    static const uint8_t regs_measuring[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    static const uint8_t regs_self_test[6] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    gas_sensor_slow_data_t slow_a, slow_b;
+    gas_sensor_o2feed_config_t config;
+    gas_sensor_o2feed_stats_t stats;
+    gas_sensor_o2feed_t feeder;
+    uint64_t now_us = 1000000;
+    int pipe_a[2], pipe_b[2];
+
+    CHECK(pipe2(pipe_a, O_NONBLOCK) == 0);
+    CHECK(pipe2(pipe_b, O_NONBLOCK) == 0);
+    memset(&slow_a, 0, sizeof(slow_a));
+    memset(&slow_b, 0, sizeof(slow_b));
+
+    gas_sensor_o2feed_config_init(&config);
+    config.refresh_ms = 0;
+    CHECK(gas_sensor_o2feed_create(&config, fixed_o2_source, NULL, &feeder) == GAS_SENSOR_OK);
+    CHECK(gas_sensor_o2feed_add(feeder, 1, pipe_a[1]) == GAS_SENSOR_OK);
+    CHECK(gas_sensor_o2feed_add(feeder, 2, pipe_b[1]) == GAS_SENSOR_OK);
+
+    feed_frame(feeder, 1, &slow_a, 0x05, config_no_o2);
+    feed_frame(feeder, 2, &slow_b, 0x05, config_all);
+    CHECK(gas_sensor_o2feed_stats(feeder, &stats) == GAS_SENSOR_OK);
+    CHECK(stats.bound == 2);
+    CHECK(stats.fed == 1);
+
+    CHECK(gas_sensor_o2feed_run(feeder, now_us) == 1);
+    CHECK(drain_commands(pipe_a[0]) == 1);
+    CHECK(drain_commands(pipe_b[0]) == 0);
+
+    /* An unchanged value is not resent while the sensor keeps measuring */
+    feed_frame(feeder, 1, &slow_a, 0x04, regs_measuring);
+    now_us += (uint64_t)config.batch_ms * 1000;
+    CHECK(gas_sensor_o2feed_run(feeder, now_us) == 0);
+    CHECK(drain_commands(pipe_a[0]) == 0);
+
+    /* A restarted sensor gets it again */
+    feed_frame(feeder, 1, &slow_a, 0x04, regs_self_test);
+    now_us += (uint64_t)config.batch_ms * 1000;
+    CHECK(gas_sensor_o2feed_run(feeder, now_us) == 1);
+    CHECK(drain_commands(pipe_a[0]) == 1);
+
+    gas_sensor_o2feed_destroy(feeder);
+    close(pipe_a[0]);
+    close(pipe_a[1]);
+    close(pipe_b[0]);
+    close(pipe_b[1]);
+}
+
+/* ============================================================================
+ * Session Formats
+ * ============================================================================ */
+
+/* A variant with the fitted options in byte 19 and the protocol revision in 14 */
+static const gas_sensor_field_t variant_fields[] = {
+    GAS_SENSOR_FIELD(5, 14, GAS_SENSOR_FIELD_BCD8, 0xFF, config_data.comm_protocol_rev),
+    GAS_SENSOR_FIELD(5, 19, GAS_SENSOR_FIELD_BIT, 0x01, config_data.o2_fitted),
+    GAS_SENSOR_FIELD(5, 19, GAS_SENSOR_FIELD_BIT, 0x02, config_data.co2_fitted),
+};
+
+static const gas_sensor_format_t variant_format = GAS_SENSOR_PHASEIN_FORMAT(
+    "variant", variant_fields, sizeof(variant_fields) / sizeof(variant_fields[0]));
+
+static int variant_decode(const uint8_t *frame_data,
+                          gas_sensor_slow_data_t *slow_data,
+                          gas_sensor_waveform_t *waveform,
+                          gas_sensor_status_t *status)
+{
+    return gas_sensor_format_decode(&variant_format, frame_data, slow_data, waveform, status);
+}
+
+static void test_session_format(void)
+{
+    /* Protocol 1 in byte 14 would read as "O2 fitted" in the built-in map */
+    static const uint8_t config_slow[6] = { 0x01, 0x12, 0x01, 0x23, 0x00, 0x02 };
+    gas_sensor_format_t other_sync = variant_format;
+    gas_sensor_format_t other_checksum = variant_format;
+    gas_sensor_o2feed_config_t config;
+    gas_sensor_o2feed_stats_t stats;
+    gas_sensor_o2feed_t feeder;
+    gas_sensor_session_mgr_t mgr;
+    gas_sensor_session_t session;
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+    int pipe_fd[2];
+
+    CHECK(pipe2(pipe_fd, O_NONBLOCK) == 0);
+    gas_sensor_o2feed_config_init(&config);
+    CHECK(gas_sensor_o2feed_create(&config, fixed_o2_source, NULL, &feeder) == GAS_SENSOR_OK);
+    CHECK(gas_sensor_o2feed_add(feeder, 1, pipe_fd[1]) == GAS_SENSOR_OK);
+    CHECK(gas_sensor_session_mgr_create(&mgr) == GAS_SENSOR_OK);
+    CHECK(gas_sensor_session_attach(mgr, -1, 1, gas_sensor_o2feed_frame_handler,
+                                    feeder, &session) == GAS_SENSOR_OK);
+
+    /* Events carry no format, so the framing must be the built-in one */
+    other_sync.sync[1] = 0x56;
+    other_checksum.checksum = GAS_SENSOR_CHECKSUM_XOR8;
+    CHECK(gas_sensor_session_set_format(session, &other_sync, variant_decode) ==
+          GAS_SENSOR_ERR_INVALID_PARAM);
+    CHECK(gas_sensor_session_set_format(session, &other_checksum, variant_decode) ==
+          GAS_SENSOR_ERR_INVALID_PARAM);
+    CHECK(gas_sensor_session_set_format(session, &variant_format, variant_decode) ==
+          GAS_SENSOR_OK);
+
+    build_frame(frame, 0x05, config_slow);
+    CHECK(gas_sensor_session_feed(session, frame, sizeof(frame), 0) == 1);
+    CHECK(gas_sensor_session_slow_data(session)->config_data.comm_protocol_rev == 1);
+
+    /* The feeder saw a configuration frame without O2 */
+    CHECK(gas_sensor_o2feed_stats(feeder, &stats) == GAS_SENSOR_OK);
+    CHECK(stats.bound == 1);
+    CHECK(stats.fed == 1);
+
+    gas_sensor_session_detach(session);
+    gas_sensor_session_mgr_destroy(mgr);
+    gas_sensor_o2feed_destroy(feeder);
+    close(pipe_fd[0]);
+    close(pipe_fd[1]);
+}
+
+/* ============================================================================
+ * Change-Log Captures
+ * ============================================================================ */
+
+#define CHANGELOG_T0            1800000000000000ull
+#define CHANGELOG_FRAMES        4000
+#define CHANGELOG_KEYFRAME_MS   500
+#define CHANGELOG_INDEX_BLOCK   (256 * 16)  /* First index allocation, in bytes */
+
+typedef struct {
+    uint8_t frames[CHANGELOG_FRAMES][GAS_SENSOR_FRAME_SIZE];
+    uint64_t timestamp_us[CHANGELOG_FRAMES];
+    gas_sensor_slow_data_t slow_data[CHANGELOG_FRAMES];    /* State after each frame */
+} changelog_source_t;
+
+/*
+ * Frames cycle through IDs 0-9 about every 52 ms. IDs 0-4 change their
+ * slow data every 300 frames and IDs 5-9 never do, so the writer both
+ * stores and skips payloads; STS and the waveform change on every frame.
+ */
+static void changelog_build_source(changelog_source_t *src)
+{
+    gas_sensor_slow_data_t slow_data;
+    gas_sensor_init_slow_data(&slow_data);
+
+    for (int n = 0; n < CHANGELOG_FRAMES; n++) {
+        uint8_t id = (uint8_t)(n % 10);
+        uint8_t epoch = (id < 5) ? (uint8_t)(n / 300) : 0;
+        uint16_t words[5];
+        uint8_t slow[6];
+
+        for (int i = 0; i < 5; i++) {
+            words[i] = (uint16_t)(test_waveform[i] + (n * (i + 1)) % 500);
+        }
+        for (int i = 0; i < 6; i++) {
+            slow[i] = (uint8_t)(id * 16 + i + epoch);
+        }
+        build_frame_words(src->frames[n], id, (uint8_t)(n % 7 == 0 ? 0x01 : 0x00),
+                          words, slow);
+        src->timestamp_us[n] = CHANGELOG_T0 + (uint64_t)n * 52000 + (uint64_t)(n * 7919) % 2000;
+        gas_sensor_parse_frame(src->frames[n], &slow_data, NULL, NULL);
+        src->slow_data[n] = slow_data;
+    }
+}
+
+/* Keyframe records in a change-log capture, or -1 if it does not read */
+static int changelog_keyframes(const char *path)
+{
+    gas_sensor_capture_reader_t reader;
+    gas_sensor_capture_record_t record;
+    int keyframes = 0;
+    int result;
+
+    if (gas_sensor_capture_reader_open(path, &reader) != GAS_SENSOR_OK) {
+        return -1;
+    }
+    while ((result = gas_sensor_capture_read(reader, &record)) == GAS_SENSOR_OK) {
+        if (record.type == GAS_SENSOR_REC_KEYFRAME) {
+            keyframes++;
+        }
+    }
+    gas_sensor_capture_reader_close(reader);
+    return (result == GAS_SENSOR_ERR_EOF) ? keyframes : -1;
+}
+
+/* Reading, seeking and state reconstruction must match parsing the source */
+static void changelog_check_reader(const changelog_source_t *src, const char *path)
+{
+    gas_sensor_changelog_reader_t reader;
+    gas_sensor_frame_event_t event;
+    gas_sensor_slow_data_t initial, slow_data;
+    int n;
+
+    CHECK(gas_sensor_changelog_reader_open(path, &reader) == GAS_SENSOR_OK);
+    if (failures != 0) {
+        return;
+    }
+    CHECK(gas_sensor_changelog_sensor_id(reader) == 1);
+
+    /* Every frame in order, byte for byte, with the state after it */
+    for (n = 0; n < CHANGELOG_FRAMES; n++) {
+        if (gas_sensor_changelog_next(reader, &event) != GAS_SENSOR_OK ||
+            event.timestamp_us != src->timestamp_us[n] ||
+            memcmp(event.frame, src->frames[n], GAS_SENSOR_FRAME_SIZE) != 0 ||
+            memcmp(event.slow_data, &src->slow_data[n], sizeof(slow_data)) != 0) {
+            break;
+        }
+    }
+    CHECK(n == CHANGELOG_FRAMES);
+    CHECK(gas_sensor_changelog_next(reader, &event) == GAS_SENSOR_ERR_EOF);
+
+    /* Before the first frame nothing has been received */
+    gas_sensor_init_slow_data(&initial);
+    CHECK(gas_sensor_changelog_state_at(reader, CHANGELOG_T0 - 1, &slow_data) == GAS_SENSOR_OK);
+    CHECK(memcmp(&slow_data, &initial, sizeof(slow_data)) == 0);
+
+    /* Backwards, so every seek restores from a keyframe rather than reading on */
+    for (n = CHANGELOG_FRAMES - 1; n >= 0; n -= 37) {
+        uint64_t t = src->timestamp_us[n];
+
+        CHECK(gas_sensor_changelog_state_at(reader, t, &slow_data) == GAS_SENSOR_OK);
+        CHECK(memcmp(&slow_data, &src->slow_data[n], sizeof(slow_data)) == 0);
+        if (n + 1 < CHANGELOG_FRAMES) {
+            CHECK(gas_sensor_changelog_next(reader, &event) == GAS_SENSOR_OK);
+            CHECK(event.timestamp_us == src->timestamp_us[n + 1]);
+        } else {
+            CHECK(gas_sensor_changelog_next(reader, &event) == GAS_SENSOR_ERR_EOF);
+        }
+
+        /* Between two frames, the state is still the one after frame n */
+        CHECK(gas_sensor_changelog_state_at(reader, t + 1, &slow_data) == GAS_SENSOR_OK);
+        CHECK(memcmp(&slow_data, &src->slow_data[n], sizeof(slow_data)) == 0);
+
+        CHECK(gas_sensor_changelog_seek(reader, t) == GAS_SENSOR_OK);
+        CHECK(gas_sensor_changelog_next(reader, &event) == GAS_SENSOR_OK);
+        CHECK(event.timestamp_us == t);
+        CHECK(memcmp(event.frame, src->frames[n], GAS_SENSOR_FRAME_SIZE) == 0);
+        CHECK(memcmp(event.slow_data, &src->slow_data[n], sizeof(slow_data)) == 0);
+    }
+
+    gas_sensor_changelog_reader_close(reader);
+}
+
+/* Write the source through a writer whose index is charged to a ledger */
+static void changelog_write_budgeted(const changelog_source_t *src, const char *path,
+                                     size_t index_budget)
+{
+    gas_sensor_mem_config_t config;
+    gas_sensor_mem_usage_t usage;
+    gas_sensor_mem_stats_t stats;
+    gas_sensor_changelog_writer_t writer;
+    gas_sensor_mem_t mem;
+    int n;
+
+    gas_sensor_mem_config_init(&config);
+    config.subsystem[GAS_SENSOR_MEM_INDEX] = index_budget;
+    CHECK(gas_sensor_mem_create(&config, &mem) == GAS_SENSOR_OK);
+    CHECK(gas_sensor_changelog_writer_open(path, 1, CHANGELOG_T0, CHANGELOG_KEYFRAME_MS,
+                                           &writer) == GAS_SENSOR_OK);
+    CHECK(gas_sensor_changelog_writer_set_mem(writer, mem) == GAS_SENSOR_OK);
+
+    for (n = 0; n < CHANGELOG_FRAMES; n++) {
+        if (gas_sensor_changelog_write_frame(writer, src->timestamp_us[n],
+                                             src->frames[n]) != GAS_SENSOR_OK) {
+            break;
+        }
+    }
+    CHECK(n == CHANGELOG_FRAMES);
+
+    /* Growth past the budget was refused rather than charged */
+    CHECK(gas_sensor_mem_stats(mem, &stats) == GAS_SENSOR_OK);
+    CHECK(stats.refusals > 0);
+    CHECK(gas_sensor_mem_usage(mem, 1, &usage) == GAS_SENSOR_OK);
+    CHECK(usage.subsystem[GAS_SENSOR_MEM_INDEX] <= index_budget);
+
+    CHECK(gas_sensor_changelog_writer_close(writer) == GAS_SENSOR_OK);
+    gas_sensor_mem_destroy(mem);
+}
+
+static void test_changelog_roundtrip(void)
+{
+    static changelog_source_t src;
+    static const uint8_t noise[5] = { 0xAA, 0x55, 0x03, 0x00, 0xAA };
+    char dir[] = "/tmp/gas_sensor_test.XXXXXX";
+    char capture[64], converted[64], capped[64], unindexed[64];
+    gas_sensor_capture_writer_t writer;
+    int keyframes, capped_keyframes, unindexed_keyframes;
+
+    CHECK(mkdtemp(dir) != NULL);
+    snprintf(capture, sizeof(capture), "%s/source.gscp", dir);
+    snprintf(converted, sizeof(converted), "%s/converted.gscp", dir);
+    snprintf(capped, sizeof(capped), "%s/capped.gscp", dir);
+    snprintf(unindexed, sizeof(unindexed), "%s/unindexed.gscp", dir);
+
+    changelog_build_source(&src);
+
+    /* An ordinary capture; its raw chunk is dropped on conversion */
+    CHECK(gas_sensor_capture_writer_open(capture, 1, CHANGELOG_T0, &writer) == GAS_SENSOR_OK);
+    for (int n = 0; n < CHANGELOG_FRAMES; n++) {
+        CHECK(gas_sensor_capture_write_frame(writer, src.timestamp_us[n],
+                                             src.frames[n]) == GAS_SENSOR_OK);
+        if (n == CHANGELOG_FRAMES / 2) {
+            CHECK(gas_sensor_capture_write_raw(writer, src.timestamp_us[n], noise,
+                                               sizeof(noise)) == GAS_SENSOR_OK);
+        }
+    }
+    CHECK(gas_sensor_capture_writer_close(writer) == GAS_SENSOR_OK);
+
+    CHECK(gas_sensor_changelog_convert(capture, converted, CHANGELOG_KEYFRAME_MS) ==
+          GAS_SENSOR_OK);
+    changelog_check_reader(&src, converted);
+
+    /*
+     * Room for the first index allocation only: when it fills, every other
+     * entry is dropped and keyframes come half as often. With no room at
+     * all the index stays empty, the interval doubles at every keyframe
+     * and the reader decodes from the start of the file.
+     */
+    changelog_write_budgeted(&src, capped, CHANGELOG_INDEX_BLOCK);
+    changelog_check_reader(&src, capped);
+    changelog_write_budgeted(&src, unindexed, 1);
+    changelog_check_reader(&src, unindexed);
+
+    keyframes = changelog_keyframes(converted);
+    capped_keyframes = changelog_keyframes(capped);
+    unindexed_keyframes = changelog_keyframes(unindexed);
+    CHECK(keyframes >= 400);
+    CHECK(capped_keyframes > 256 && capped_keyframes < keyframes - 50);
+    CHECK(unindexed_keyframes > 0 && unindexed_keyframes < 16);
+
+    unlink(capture);
+    unlink(converted);
+    unlink(capped);
+    unlink(unindexed);
+    rmdir(dir);
+}
+
+/* ============================================================================
+ * Executor
+ * ============================================================================ */
+
+#define EXECUTOR_THREADS        4
+#define EXECUTOR_STRANDS        8
+#define EXECUTOR_POSTS          20000
+#define EXECUTOR_HANDOFFS       2000
+
+typedef struct {
+    atomic_bool running;                /* A task of this strand is running */
+    int last;                           /* Sequence number of the last task run */
+    int out_of_order;
+    int overlapped;
+} executor_order_t;
+
+typedef struct {
+    executor_order_t *order;
+    int seq;
+} executor_task_t;
+
+static void executor_order_task(void *arg)
+{
+    executor_task_t *task = arg;
+    executor_order_t *order = task->order;
+
+    if (atomic_exchange(&order->running, true)) {
+        order->overlapped++;
+    }
+    if (task->seq <= order->last) {
+        order->out_of_order++;
+    }
+    order->last = task->seq;
+    atomic_store(&order->running, false);
+}
+
+static void executor_count_task(void *arg)
+{
+    atomic_fetch_add((atomic_int *)arg, 1);
+}
+
+/* Hold the strand's worker until released */
+typedef struct {
+    atomic_bool started;
+    atomic_bool release;
+} executor_gate_t;
+
+static void executor_gate_task(void *arg)
+{
+    executor_gate_t *gate = arg;
+
+    atomic_store(&gate->started, true);
+    while (!atomic_load(&gate->release)) {
+        usleep(100);
+    }
+}
+
+static void test_executor(void)
+{
+    static executor_order_t order[EXECUTOR_STRANDS];
+    static executor_task_t tasks[EXECUTOR_POSTS];
+    gas_sensor_strand_t strands[EXECUTOR_STRANDS];
+    gas_sensor_executor_stats_t stats;
+    gas_sensor_mem_config_t config;
+    gas_sensor_mem_usage_t usage;
+    gas_sensor_executor_t executor;
+    gas_sensor_strand_t strand;
+    executor_gate_t gate;
+    gas_sensor_mem_t mem;
+    atomic_int count;
+    int n, posted;
+
+    /* A lost wakeup would hang; fail instead */
+    alarm(60);
+
+    gas_sensor_mem_config_init(&config);
+    CHECK(gas_sensor_mem_create(&config, &mem) == GAS_SENSOR_OK);
+    CHECK(gas_sensor_executor_create(EXECUTOR_THREADS, &executor) == GAS_SENSOR_OK);
+    CHECK(gas_sensor_executor_set_mem(executor, mem) == GAS_SENSOR_OK);
+
+    /* Each strand runs its tasks in posting order, one at a time */
+    for (n = 0; n < EXECUTOR_STRANDS; n++) {
+        atomic_init(&order[n].running, false);
+        order[n].last = -1;
+        CHECK(gas_sensor_strand_create(executor, NULL, NULL, &strands[n]) == GAS_SENSOR_OK);
+    }
+    for (n = 0; n < EXECUTOR_POSTS; n++) {
+        /* Bursts per strand, so batches run out and strands are requeued */
+        int s = (n / 100) % EXECUTOR_STRANDS;
+        tasks[n].order = &order[s];
+        tasks[n].seq = n;
+        CHECK(gas_sensor_strand_post(strands[s], executor_order_task, &tasks[n]) ==
+              GAS_SENSOR_OK);
+    }
+    gas_sensor_executor_drain(executor);
+    for (n = 0; n < EXECUTOR_STRANDS; n++) {
+        CHECK(order[n].out_of_order == 0);
+        CHECK(order[n].overlapped == 0);
+        CHECK(order[n].last == EXECUTOR_POSTS - 100 * (EXECUTOR_STRANDS - n) + 99);
+        gas_sensor_strand_destroy(strands[n]);
+    }
+    CHECK(gas_sensor_executor_stats(executor, &stats) == GAS_SENSOR_OK);
+    CHECK(stats.tasks == EXECUTOR_POSTS);
+
+    /*
+     * Post to an idle pool and wait at once, over and over: a worker must
+     * wake for every post, and destroy must return only once the worker
+     * let go of the strand, whichever side gets there first.
+     */
+    atomic_init(&count, 0);
+    for (n = 0; n < EXECUTOR_HANDOFFS; n++) {
+        CHECK(gas_sensor_strand_create(executor, NULL, NULL, &strand) == GAS_SENSOR_OK);
+        CHECK(gas_sensor_strand_post(strand, executor_count_task, &count) == GAS_SENSOR_OK);
+        if (n % 2 == 0) {
+            gas_sensor_executor_drain(executor);
+            CHECK(atomic_load(&count) == n + 1);
+        }
+        gas_sensor_strand_destroy(strand);
+        CHECK(atomic_load(&count) == n + 1);
+    }
+    CHECK(gas_sensor_executor_stats(executor, &stats) == GAS_SENSOR_OK);
+    CHECK(stats.sleeps > 0);
+
+    /* A strand that cannot keep up stops taking tasks at the cap */
+    atomic_init(&gate.started, false);
+    atomic_init(&gate.release, false);
+    CHECK(gas_sensor_strand_create(executor, NULL, NULL, &strand) == GAS_SENSOR_OK);
+    CHECK(gas_sensor_strand_post(strand, executor_gate_task, &gate) == GAS_SENSOR_OK);
+    while (!atomic_load(&gate.started)) {
+        usleep(100);
+    }
+    atomic_store(&count, 0);
+    posted = 0;
+    while (posted <= GAS_SENSOR_STRAND_MAX_TASKS &&
+           gas_sensor_strand_post(strand, executor_count_task, &count) == GAS_SENSOR_OK) {
+        posted++;
+    }
+    CHECK(posted == GAS_SENSOR_STRAND_MAX_TASKS);
+    atomic_store(&gate.release, true);
+    gas_sensor_strand_destroy(strand);
+    CHECK(atomic_load(&count) == GAS_SENSOR_STRAND_MAX_TASKS);
+
+    /* Every strand and ring growth was credited back */
+    CHECK(gas_sensor_mem_usage(mem, GAS_SENSOR_MEM_SHARED, &usage) == GAS_SENSOR_OK);
+    CHECK(usage.subsystem[GAS_SENSOR_MEM_QUEUE] == 0);
+    CHECK(usage.peak > 0);
+
+    gas_sensor_executor_destroy(executor);
+    gas_sensor_mem_destroy(mem);
+    alarm(0);
+}
+
+/* ============================================================================
+ * Uplink
+ * ============================================================================ */
+
+#define UPLINK_T0           1800000000000000ull
+#define UPLINK_FRAME_US     50000
+#define UPLINK_OUTAGE       1200    /* Frame the link slows down at */
+#define UPLINK_RECOVERY     5200    /* Frame the link recovers at */
+#define UPLINK_FRAMES       8000
+#define UPLINK_MAX_MSGS     4096
+
+typedef struct {
+    const uint8_t (*frames)[GAS_SENSOR_FRAME_SIZE];
+    size_t fed;                             /* Frames handed to the uplink so far */
+    size_t count;
+    uint8_t cls[UPLINK_MAX_MSGS];
+    uint64_t timestamp_us[UPLINK_MAX_MSGS];
+    uint64_t arrival_us[UPLINK_MAX_MSGS];
+    gas_sensor_slow_data_t slow_data;       /* Every status and slow message applied */
+    int raw_windows;                        /* Waveforms checked at full rate */
+    int decimated_windows;                  /* Waveforms checked when decimated */
+} uplink_rx_t;
+
+/* Frame k: STS apnea for 10 s in every 20, inspired and expired values
+ * changing every cycle, a waveform with an invalid AA1 stretch */
+static void build_uplink_frame(uint8_t frame[GAS_SENSOR_FRAME_SIZE], size_t k)
+{
+    uint8_t id = (uint8_t)(k % GAS_SENSOR_FRAME_ID_MAX);
+    uint8_t cycle = (uint8_t)(k / GAS_SENSOR_FRAME_ID_MAX);
+    uint16_t words[5];
+    uint8_t slow[6] = { id, (uint8_t)(id + 1), 0x00, 0x00, 0x00, 0x00 };
+
+    words[0] = (uint16_t)(400 + (k * 37) % 600);
+    words[1] = (uint16_t)(5000 + (k % 20) * 10);
+    words[2] = (k % 50 < 3) ? 0xFFFF : (uint16_t)(100 + k % 7);
+    words[3] = 0;
+    words[4] = (uint16_t)(2100 + (k / 20) % 50);
+    if (id == 0x00 || id == 0x01) {
+        slow[0] = cycle;
+        slow[1] = (uint8_t)(cycle * 3);
+    } else if (id == 0x04) {
+        slow[0] = 0x00;             /* Measurement mode, no errors */
+        slow[1] = 0x00;
+        slow[2] = 0x00;
+        slow[3] = 0x00;
+    }
+
+    build_frame_words(frame, id, ((k / 200) % 2 == 1) ? GAS_SENSOR_STS_APNEA : 0x00,
+                      words, slow);
+}
+
+static size_t uplink_frame_index(uint64_t timestamp_us)
+{
+    return (size_t)((timestamp_us - UPLINK_T0) / UPLINK_FRAME_US);
+}
+
+/* Each sample must be the rounded mean of the valid words it covers */
+static void check_uplink_waveform(uplink_rx_t *rx, const gas_sensor_uplink_msg_t *msg)
+{
+    uint16_t samples[20][GAS_SENSOR_CH_COUNT];
+    size_t first = uplink_frame_index(msg->timestamp_us);
+    int count = gas_sensor_uplink_samples(msg, samples, 20);
+    int i, k;
+
+    CHECK(first % 20 == 0);
+    CHECK(msg->decimation > 0 && count == (20 + msg->decimation - 1) / msg->decimation);
+    for (i = 0; i < count && msg->decimation > 0; i++) {
+        for (k = 0; k < GAS_SENSOR_CH_COUNT; k++) {
+            uint32_t sum = 0;
+            uint32_t valid = 0;
+            size_t f;
+            for (f = first + (size_t)i * msg->decimation;
+                 f < first + (size_t)(i + 1) * msg->decimation && f < first + 20; f++) {
+                const uint8_t *word = &rx->frames[f][4 + 2 * k];
+                uint16_t value = (uint16_t)((word[0] << 8) | word[1]);
+                if (value != 0xFFFF) {
+                    sum += value;
+                    valid++;
+                }
+            }
+            CHECK(samples[i][k] == (valid > 0 ? (sum + valid / 2) / valid : 0xFFFF));
+        }
+    }
+    if (msg->decimation == 1) {
+        rx->raw_windows++;
+    } else {
+        rx->decimated_windows++;
+    }
+}
+
+/* Applying the message must equal parsing the frames its windows came from */
+static void check_uplink_windows(uplink_rx_t *rx, const gas_sensor_uplink_msg_t *msg)
+{
+    gas_sensor_slow_data_t applied;
+    gas_sensor_slow_data_t parsed;
+    size_t last = uplink_frame_index(msg->timestamp_us);
+    const uint8_t *window = msg->windows;
+    int id;
+
+    memset(&applied, 0, sizeof(applied));
+    memset(&parsed, 0, sizeof(parsed));
+    gas_sensor_init_slow_data(&applied);
+    gas_sensor_init_slow_data(&parsed);
+
+    for (id = 0; id < GAS_SENSOR_FRAME_ID_MAX; id++) {
+        size_t f;
+        if (!(msg->id_mask & (1u << id))) {
+            continue;
+        }
+        /* The newest frame of this ID at or before the message */
+        CHECK(last >= (size_t)id);
+        f = last - (last + GAS_SENSOR_FRAME_ID_MAX - (size_t)id) % GAS_SENSOR_FRAME_ID_MAX;
+        CHECK(memcmp(window, &rx->frames[f][14], 6) == 0);
+        CHECK(gas_sensor_parse_frame(rx->frames[f], &parsed, NULL, NULL) == GAS_SENSOR_OK);
+        window += 6;
+    }
+    CHECK(gas_sensor_uplink_apply(msg, &applied) == GAS_SENSOR_OK);
+    CHECK(memcmp(&applied, &parsed, sizeof(applied)) == 0);
+    CHECK(gas_sensor_uplink_apply(msg, &rx->slow_data) == GAS_SENSOR_OK);
+}
+
+static int uplink_receive(void *ctx, const uint8_t *data, size_t length, uint64_t now_us)
+{
+    uplink_rx_t *rx = ctx;
+    gas_sensor_uplink_msg_t msg;
+
+    CHECK(gas_sensor_uplink_parse(data, length, &msg) == GAS_SENSOR_OK);
+    CHECK(msg.sensor_id == 7);
+    CHECK(uplink_frame_index(msg.timestamp_us) < rx->fed);
+    if (rx->count < UPLINK_MAX_MSGS) {
+        rx->cls[rx->count] = (uint8_t)(msg.type - GAS_SENSOR_UPLINK_MSG_STATUS);
+        rx->timestamp_us[rx->count] = msg.timestamp_us;
+        rx->arrival_us[rx->count] = now_us;
+        rx->count++;
+    }
+
+    if (msg.type == GAS_SENSOR_UPLINK_MSG_WAVEFORM) {
+        check_uplink_waveform(rx, &msg);
+    } else {
+        check_uplink_windows(rx, &msg);
+    }
+    return GAS_SENSOR_OK;
+}
+
+/**
+ * One sensor over a 1200 bytes/s uplink whose link drops to 4 bytes/s for
+ * 200 s and then recovers, all in simulated time
+ */
+static void test_uplink_shaper(void)
+{
+    static uint8_t frames[UPLINK_FRAMES][GAS_SENSOR_FRAME_SIZE];
+    static uplink_rx_t rx;
+    gas_sensor_uplink_config_t config;
+    gas_sensor_uplink_stats_t stats;
+    gas_sensor_uplink_t uplink;
+    gas_sensor_shaper_t shaper;
+    gas_sensor_slow_data_t reference;
+    size_t wave_dropped_at = 0;
+    size_t slow_dropped_at = 0;
+    uint8_t outage_level = 0;
+    uint64_t last_outage_slow = 0;
+    bool last_outage_slow_received = false;
+    size_t k, i, j;
+
+    memset(&rx, 0, sizeof(rx));
+    memset(&reference, 0, sizeof(reference));
+    gas_sensor_init_slow_data(&rx.slow_data);
+    gas_sensor_init_slow_data(&reference);
+    for (k = 0; k < UPLINK_FRAMES; k++) {
+        build_uplink_frame(frames[k], k);
+    }
+    rx.frames = (const uint8_t (*)[GAS_SENSOR_FRAME_SIZE])frames;
+
+    gas_sensor_uplink_config_init(&config);
+    config.spill_bytes = 4096;
+    CHECK(gas_sensor_shaper_init(&shaper, 1200, 300, uplink_receive, &rx, UPLINK_T0) ==
+          GAS_SENSOR_OK);
+    CHECK(gas_sensor_uplink_create(&config, gas_sensor_shaper_send, &shaper, &uplink) ==
+          GAS_SENSOR_OK);
+
+    for (k = 0; k < UPLINK_FRAMES; k++) {
+        uint64_t now = UPLINK_T0 + (uint64_t)k * UPLINK_FRAME_US;
+        gas_sensor_frame_event_t event;
+
+        if (k == UPLINK_OUTAGE) {
+            gas_sensor_token_bucket_init(&shaper.bucket, 4, 4, now);
+        } else if (k == UPLINK_RECOVERY) {
+            gas_sensor_token_bucket_init(&shaper.bucket, 1200, 300, now);
+        }
+
+        memset(&event, 0, sizeof(event));
+        event.sensor_id = 7;
+        event.timestamp_us = now;
+        event.frame = frames[k];
+        rx.fed = k + 1;
+        gas_sensor_uplink_frame_handler(uplink, &event);
+        CHECK(gas_sensor_uplink_tick(uplink, now + UPLINK_FRAME_US / 2) == GAS_SENSOR_OK);
+        CHECK(gas_sensor_parse_frame(frames[k], &reference, NULL, NULL) == GAS_SENSOR_OK);
+
+        CHECK(gas_sensor_uplink_stats(uplink, &stats) == GAS_SENSOR_OK);
+        if (k == UPLINK_OUTAGE - 1) {
+            /* Raw or delta at full rate while the link keeps up */
+            CHECK(stats.level <= 1);
+            CHECK(stats.dropped[GAS_SENSOR_UPLINK_CLASS_WAVEFORM] == 0);
+        }
+        if (k >= UPLINK_OUTAGE && k < UPLINK_RECOVERY && stats.level > outage_level) {
+            outage_level = stats.level;
+        }
+        if (wave_dropped_at == 0 && stats.dropped[GAS_SENSOR_UPLINK_CLASS_WAVEFORM] > 0) {
+            wave_dropped_at = k;
+        }
+        if (slow_dropped_at == 0 && stats.dropped[GAS_SENSOR_UPLINK_CLASS_SLOW] > 0) {
+            slow_dropped_at = k;
+        }
+        if (k < UPLINK_RECOVERY && k % GAS_SENSOR_FRAME_ID_MAX == GAS_SENSOR_FRAME_ID_MAX - 1) {
+            last_outage_slow = now;
+        }
+    }
+
+    /* Drain the backlog */
+    for (k = 0; k < 200; k++) {
+        gas_sensor_uplink_tick(uplink, UPLINK_T0 + (uint64_t)(UPLINK_FRAMES + k) * UPLINK_FRAME_US);
+    }
+    CHECK(gas_sensor_uplink_stats(uplink, &stats) == GAS_SENSOR_OK);
+
+    /* The level fell to suspended waveforms and came back */
+    CHECK(outage_level == GAS_SENSOR_UPLINK_LEVEL_OFF);
+    CHECK(stats.frames_suspended > 0);
+    CHECK(stats.level <= 1);
+    CHECK(stats.backlog_bytes == 0);
+    CHECK(rx.raw_windows > 0 && rx.decimated_windows > 0);
+
+    /* Waveforms are evicted before slow data, status never, oldest first */
+    CHECK(wave_dropped_at > 0 && slow_dropped_at > wave_dropped_at);
+    CHECK(stats.dropped[GAS_SENSOR_UPLINK_CLASS_STATUS] == 0);
+    CHECK(stats.sent[GAS_SENSOR_UPLINK_CLASS_STATUS] == stats.queued[GAS_SENSOR_UPLINK_CLASS_STATUS]);
+    CHECK(rx.count < UPLINK_MAX_MSGS);
+    for (i = 0; i < rx.count; i++) {
+        if (rx.cls[i] == GAS_SENSOR_UPLINK_CLASS_SLOW && rx.timestamp_us[i] == last_outage_slow) {
+            last_outage_slow_received = true;
+        }
+    }
+    CHECK(last_outage_slow_received);
+
+    /* Strict priority: nothing overtakes a higher class already queued */
+    for (i = 0; i < rx.count; i++) {
+        for (j = i + 1; j < rx.count; j++) {
+            if (rx.cls[j] < rx.cls[i]) {
+                CHECK(rx.timestamp_us[j] > rx.arrival_us[i]);
+            }
+        }
+    }
+
+    /* After recovery the far end holds the same slow data as the sensor;
+     * only the last frame ID differs, as slow messages carry changed IDs */
+    rx.slow_data.last_frame_id = reference.last_frame_id;
+    CHECK(memcmp(&rx.slow_data, &reference, sizeof(reference)) == 0);
+
+    gas_sensor_uplink_destroy(uplink);
+}
+
+/* ============================================================================
+ * WebSocket Server
+ * ============================================================================ */
+
+#define WS_SENSOR           7
+#define WS_T0               1800000000000000ull
+#define WS_MAX_MSGS         64
+
+typedef struct {
+    int fd;
+    uint8_t buf[8192];
+    size_t len;
+} ws_peer_t;
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t len;
+    uint8_t data[125];
+} ws_msg_t;
+
+/* Read what the peer has, polling the server so it makes progress */
+static bool ws_fill(gas_sensor_ws_t server, ws_peer_t *peer)
+{
+    ssize_t n;
+
+    gas_sensor_ws_poll(server, 1);
+    n = recv(peer->fd, &peer->buf[peer->len], sizeof(peer->buf) - peer->len, MSG_DONTWAIT);
+    if (n > 0) {
+        peer->len += (size_t)n;
+    }
+    return n != 0;                          /* false at end of file */
+}
+
+/**
+ * Connect and upgrade with the RFC 6455 sample key
+ * Returns true if the server answered 101 with the sample accept value.
+ */
+static bool ws_connect(gas_sensor_ws_t server, ws_peer_t *peer, int receive_buffer)
+{
+    static const char request[] =
+        "GET /live HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: keep-alive, Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n\r\n";
+    struct sockaddr_in addr;
+    char *end = NULL;
+    int tries;
+
+    memset(peer, 0, sizeof(*peer));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(gas_sensor_ws_port(server));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    peer->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (peer->fd < 0) {
+        return false;
+    }
+    if (receive_buffer > 0) {
+        setsockopt(peer->fd, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+    }
+    if (connect(peer->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        write(peer->fd, request, sizeof(request) - 1) != (ssize_t)(sizeof(request) - 1)) {
+        return false;
+    }
+
+    for (tries = 0; tries < 200 && end == NULL; tries++) {
+        ws_fill(server, peer);
+        peer->buf[peer->len < sizeof(peer->buf) ? peer->len : sizeof(peer->buf) - 1] = '\0';
+        end = strstr((char *)peer->buf, "\r\n\r\n");
+    }
+    if (end == NULL) {
+        return false;
+    }
+
+    bool upgraded = strncmp((char *)peer->buf, "HTTP/1.1 101 ", 13) == 0 &&
+                    strstr((char *)peer->buf,
+                           "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != NULL;
+    size_t used = (size_t)(end + 4 - (char *)peer->buf);
+    memmove(peer->buf, &peer->buf[used], peer->len - used);
+    peer->len -= used;
+    return upgraded;
+}
+
+/* Send one unfragmented client frame */
+static void ws_send(ws_peer_t *peer, uint8_t opcode, const void *payload, size_t len,
+                    bool masked)
+{
+    static const uint8_t mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+    uint8_t frame[256];
+    size_t header = 2;
+    size_t i;
+
+    frame[0] = (uint8_t)(0x80 | opcode);
+    if (len < 126) {
+        frame[1] = (uint8_t)len;
+    } else {
+        frame[1] = 126;
+        frame[2] = (uint8_t)(len >> 8);
+        frame[3] = (uint8_t)len;
+        header = 4;
+    }
+    if (masked) {
+        frame[1] |= 0x80;
+        memcpy(&frame[header], mask, 4);
+        header += 4;
+    }
+    for (i = 0; i < len; i++) {
+        frame[header + i] = (uint8_t)(((const uint8_t *)payload)[i] ^ (masked ? mask[i & 3] : 0));
+    }
+    CHECK(write(peer->fd, frame, header + len) == (ssize_t)(header + len));
+}
+
+/**
+ * Take the next server frame, waiting up to about 50 ms, or only taking
+ * what has already arrived
+ * Returns false if none arrived.
+ */
+static bool ws_next(gas_sensor_ws_t server, ws_peer_t *peer, ws_msg_t *msg, bool wait)
+{
+    int tries;
+
+    for (tries = 0; tries < (wait ? 50 : 2); tries++) {
+        if (peer->len >= 2 && peer->len >= 2u + (peer->buf[1] & 0x7F)) {
+            msg->opcode = peer->buf[0] & 0x0F;
+            msg->len = peer->buf[1] & 0x7F;
+            CHECK((peer->buf[0] & 0x80) != 0 && (peer->buf[1] & 0x80) == 0 && msg->len < 126);
+            memcpy(msg->data, &peer->buf[2], msg->len);
+            memmove(peer->buf, &peer->buf[2 + msg->len], peer->len - 2 - msg->len);
+            peer->len -= 2u + msg->len;
+            return true;
+        }
+        if (!ws_fill(server, peer)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+static bool ws_recv(gas_sensor_ws_t server, ws_peer_t *peer, ws_msg_t *msg)
+{
+    return ws_next(server, peer, msg, true);
+}
+
+/* Send a command and check the text reply */
+static bool ws_command(gas_sensor_ws_t server, ws_peer_t *peer, const char *command,
+                       const char *reply)
+{
+    ws_msg_t msg;
+
+    ws_send(peer, 0x1, command, strlen(command), true);
+    return ws_recv(server, peer, &msg) && msg.opcode == 0x1 &&
+           msg.len == strlen(reply) && memcmp(msg.data, reply, msg.len) == 0;
+}
+
+/* Read every pending message into msgs, returning how many there were */
+static size_t ws_drain(gas_sensor_ws_t server, ws_peer_t *peer, ws_msg_t *msgs, size_t max,
+                       bool wait)
+{
+    ws_msg_t msg;
+    size_t count = 0;
+
+    while (ws_next(server, peer, &msg, wait)) {
+        if (count < max) {
+            msgs[count] = msg;
+        }
+        count++;
+    }
+    return count;
+}
+
+/* Little-endian field of a server message */
+static uint64_t ws_field(const ws_msg_t *msg, size_t offset, size_t size)
+{
+    uint64_t value = 0;
+    size_t i;
+
+    for (i = size; i > 0; i--) {
+        value = (value << 8) | msg->data[offset + i - 1];
+    }
+    return value;
+}
+
+static uint64_t ws_timestamp(const ws_msg_t *msg)
+{
+    return ws_field(msg, 5, 8);
+}
+
+/* As the server encodes a mean concentration */
+static uint16_t ws_conc(float value)
+{
+    float scaled = value * 100.0f + 0.5f;
+    return (value < 0.0f) ? 0xFFFF : (scaled >= 65534.0f) ? 65534 : (uint16_t)scaled;
+}
+
+/* Parse frame k and hand it to the server as a session would */
+static void ws_feed(gas_sensor_ws_t server, gas_sensor_slow_data_t *slow_data, size_t k,
+                    uint8_t sts, gas_sensor_waveform_t *waveform)
+{
+    static const uint8_t slow[6] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    uint16_t words[5];
+    uint8_t frame[GAS_SENSOR_FRAME_SIZE];
+    gas_sensor_status_t status;
+    gas_sensor_frame_event_t event;
+
+    words[0] = (k % 8 == 5) ? 0xFFFF : (uint16_t)(400 + 4 * (k % 100));
+    words[1] = (uint16_t)(1000 + 7 * (k % 13));
+    words[2] = 0xFFFF;
+    words[3] = (uint16_t)(k % 3);
+    words[4] = (uint16_t)(2100 + k % 50);
+    build_frame_words(frame, (uint8_t)(k % GAS_SENSOR_FRAME_ID_MAX), sts, words, slow);
+    CHECK(gas_sensor_parse_frame(frame, slow_data, waveform, &status) == GAS_SENSOR_OK);
+
+    event.sensor_id = WS_SENSOR;
+    event.timestamp_us = WS_T0 + (uint64_t)k * 50000;
+    event.frame = frame;
+    event.slow_data = slow_data;
+    event.waveform = waveform;
+    event.status = &status;
+    CHECK(gas_sensor_ws_frame_handler(server, &event) == GAS_SENSOR_OK);
+    gas_sensor_ws_poll(server, 0);
+}
+
+static void test_ws_loopback(void)
+{
+    static ws_peer_t a, b, slow, bad;
+    static ws_msg_t msgs_a[WS_MAX_MSGS], msgs_b[WS_MAX_MSGS];
+    gas_sensor_ws_config_t config;
+    gas_sensor_ws_t server;
+    gas_sensor_ws_stats_t before, after;
+    gas_sensor_slow_data_t slow_data;
+    gas_sensor_waveform_t waveforms[20];
+    ws_msg_t msg;
+    size_t count_a, count_b, i, k;
+    size_t windows = 0;
+    bool apnea_status = false;
+    static const uint8_t ping[126] = { 0 };
+
+    memset(&slow_data, 0, sizeof(slow_data));
+    gas_sensor_init_slow_data(&slow_data);
+    gas_sensor_ws_config_init(&config);
+    config.send_buffer = 4096;
+    CHECK(gas_sensor_ws_create(&config, &server) == GAS_SENSOR_OK);
+    CHECK(gas_sensor_ws_port(server) != 0);
+
+    CHECK(ws_connect(server, &a, 0));
+    CHECK(ws_connect(server, &b, 0));
+    CHECK(ws_command(server, &a, "sub 7 5", "ok"));
+    CHECK(ws_command(server, &b, "sub 7 5", "ok"));
+    CHECK(ws_command(server, &a, "unsub 9", "error not subscribed"));
+    CHECK(ws_command(server, &a, "sub 7 99", "error bad command"));
+
+    /* One second at 5 Hz, apnea on the second frame only */
+    CHECK(gas_sensor_ws_stats(server, &before) == GAS_SENSOR_OK);
+    for (k = 0; k < 20; k++) {
+        ws_feed(server, &slow_data, k, (k == 1) ? GAS_SENSOR_STS_APNEA : 0x00, &waveforms[k]);
+    }
+    CHECK(gas_sensor_ws_stats(server, &after) == GAS_SENSOR_OK);
+    count_a = ws_drain(server, &a, msgs_a, WS_MAX_MSGS, true);
+    count_b = ws_drain(server, &b, msgs_b, WS_MAX_MSGS, true);
+
+    /* Each message was encoded once and written to both clients */
+    CHECK(count_a > 0 && count_a < WS_MAX_MSGS && count_a == count_b);
+    CHECK(after.encoded - before.encoded == count_a);
+    CHECK(after.sent - before.sent == 2 * count_a);
+    for (i = 0; i < count_a && i < count_b; i++) {
+        CHECK(msgs_a[i].len == msgs_b[i].len &&
+              memcmp(msgs_a[i].data, msgs_b[i].data, msgs_a[i].len) == 0);
+    }
+
+    for (i = 0; i < count_a && i < WS_MAX_MSGS; i++) {
+        const ws_msg_t *m = &msgs_a[i];
+        CHECK(m->opcode == 0x2);
+        CHECK(ws_field(m, 1, 4) == WS_SENSOR);
+        if (m->data[0] == GAS_SENSOR_WS_MSG_STATUS) {
+            CHECK(m->len == GAS_SENSOR_WS_STATUS_SIZE);
+            if (m->data[13] & GAS_SENSOR_STS_APNEA) {
+                apnea_status = true;
+            }
+            continue;
+        }
+
+        /* The mean of four frames, with the window's alarm bits */
+        const gas_sensor_waveform_t *w = &waveforms[4 * windows];
+        float sum[GAS_SENSOR_CH_COUNT] = { 0 };
+        unsigned valid[GAS_SENSOR_CH_COUNT] = { 0 };
+        int ch;
+        CHECK(m->data[0] == GAS_SENSOR_WS_MSG_WAVEFORM && m->len == GAS_SENSOR_WS_WAVEFORM_SIZE);
+        CHECK(ws_timestamp(m) == WS_T0 + (uint64_t)(4 * windows + 3) * 50000);
+        CHECK(m->data[14] == 4);
+        CHECK(((m->data[13] & GAS_SENSOR_STS_APNEA) != 0) == (windows == 0));
+        for (k = 0; k < 4; k++) {
+            const float values[GAS_SENSOR_CH_COUNT] = { w[k].co2, w[k].n2o, w[k].aa1,
+                                                        w[k].aa2, w[k].o2 };
+            for (ch = 0; ch < GAS_SENSOR_CH_COUNT; ch++) {
+                if (values[ch] >= 0.0f) {
+                    sum[ch] += values[ch];
+                    valid[ch]++;
+                }
+            }
+        }
+        for (ch = 0; ch < GAS_SENSOR_CH_COUNT; ch++) {
+            uint16_t expected = valid[ch] ? ws_conc(sum[ch] / (float)valid[ch]) : 0xFFFF;
+            CHECK(ws_field(m, 15 + 2 * (size_t)ch, 2) == expected);
+        }
+        windows++;
+    }
+    CHECK(windows == 5);
+    CHECK(apnea_status);
+
+    /* A client that never reads keeps only the newest message */
+    CHECK(ws_connect(server, &slow, 2048));
+    CHECK(ws_command(server, &slow, "sub 7 20", "ok"));
+    CHECK(gas_sensor_ws_stats(server, &before) == GAS_SENSOR_OK);
+    windows = 0;
+    for (k = 20; k < 3020; k++) {
+        ws_feed(server, &slow_data, k, 0x00, &waveforms[0]);
+        if (k % 10 == 9) {
+            while (ws_next(server, &a, &msg, false)) {
+                if (msg.data[0] == GAS_SENSOR_WS_MSG_WAVEFORM) {
+                    windows++;
+                }
+            }
+            ws_drain(server, &b, msgs_b, WS_MAX_MSGS, false);
+        }
+    }
+    CHECK(gas_sensor_ws_stats(server, &after) == GAS_SENSOR_OK);
+    CHECK(windows == 750);
+    CHECK(after.dropped > before.dropped);
+    {
+        /* The reopened TCP window may wait for a zero-window probe */
+        uint64_t newest = WS_T0 + 3019ull * 50000;
+        uint64_t last = 0;
+        uint64_t last_waveform = 0;
+        size_t received = 0;
+        int idle = 0;
+        while (last_waveform < newest && idle < 100) {
+            if (!ws_recv(server, &slow, &msg)) {
+                idle++;
+                continue;
+            }
+            CHECK(ws_timestamp(&msg) >= last);
+            last = ws_timestamp(&msg);
+            if (msg.data[0] == GAS_SENSOR_WS_MSG_WAVEFORM) {
+                last_waveform = last;
+                received++;
+            }
+        }
+        CHECK(received > 0 && received < 3000);
+        CHECK(last_waveform == newest);
+    }
+
+    /* Unsubscribed clients get nothing more */
+    CHECK(ws_command(server, &a, "unsub 7", "ok"));
+    for (k = 3020; k < 3028; k++) {
+        ws_feed(server, &slow_data, k, 0x00, &waveforms[0]);
+    }
+    CHECK(!ws_recv(server, &a, &msg));
+    CHECK(ws_drain(server, &b, msgs_b, WS_MAX_MSGS, true) >= 2);
+
+    /* An unmasked frame and an oversized ping are protocol errors */
+    CHECK(ws_connect(server, &bad, 0));
+    ws_send(&bad, 0x1, "sub 7 5", 7, false);
+    CHECK(ws_recv(server, &bad, &msg) && msg.opcode == 0x8 && msg.len == 2 &&
+          msg.data[0] == 0x03 && msg.data[1] == 0xEA);
+    CHECK(!ws_recv(server, &bad, &msg));
+    close(bad.fd);
+
+    CHECK(ws_connect(server, &bad, 0));
+    ws_send(&bad, 0x9, ping, sizeof(ping), true);
+    CHECK(ws_recv(server, &bad, &msg) && msg.opcode == 0x8 && msg.len == 2 &&
+          msg.data[0] == 0x03 && msg.data[1] == 0xEA);
+    CHECK(!ws_recv(server, &bad, &msg));
+    close(bad.fd);
+
+    close(a.fd);
+    close(b.fd);
+    close(slow.fd);
+    gas_sensor_ws_destroy(server);
+}
+
+int main(void)
+{
+    test_parse_sensor_regs();
+    test_parse_config_data();
+    test_select_decoder();
+    test_parse_gen_vals();
+    test_hl7_pressure();
+    test_o2feed();
+    test_session_format();
+    test_changelog_roundtrip();
+    test_executor();
+    test_uplink_shaper();
+    test_ws_loopback();
+
+    if (failures != 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
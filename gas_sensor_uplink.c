@@ -0,0 +1,982 @@
+/*
+ * Anesthetic Gas Sensor Prioritized Uplink - Implementation
+ *
+ * Messages are built as soon as their content is complete and queued per
+ * class; the pump serves the queues in priority order whenever the pacer
+ * bucket has tokens. Waveform levels are applied per sensor at the start
+ * of a window, so one message never mixes two levels.
+ */
+
+#include "gas_sensor_uplink.h"
+#include "gas_sensor_layout.h"
+#include "gas_sensor_internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_IDS               GAS_SENSOR_FRAME_ID_MAX
+#define FRAME_ID_SENSOR_REGS    0x04
+#define FRAME_PERIOD_US         50000
+#define FRAMES_PER_SECOND       (1000000 / FRAME_PERIOD_US)
+#define WAVEFORM_OFFSET         GAS_SENSOR_OFFSET_CO2
+#define SLOW_OFFSET             GAS_SENSOR_OFFSET_SLOW
+#define SLOW_SIZE               GAS_SENSOR_SLOW_SIZE
+#define SAMPLE_SIZE             (2 * GAS_SENSOR_CH_COUNT)
+#define SAMPLE_DELTA_MAX        (3 * GAS_SENSOR_CH_COUNT)
+#define MAX_SAMPLES             (GAS_SENSOR_UPLINK_MAX_WINDOW_MS * 1000 / FRAME_PERIOD_US)
+#define WAVE_HEADER_SIZE        (GAS_SENSOR_UPLINK_HEADER_SIZE + 3)
+#define WAVE_MAX_SIZE           (WAVE_HEADER_SIZE + SAMPLE_SIZE + MAX_SAMPLES * SAMPLE_DELTA_MAX)
+#define SLOW_MAX_SIZE           (GAS_SENSOR_UPLINK_HEADER_SIZE + 2 + FRAME_IDS * SLOW_SIZE)
+#define INVALID_SAMPLE          0xFFFF
+#define DELTA_SIZE_INITIAL      (5 * 16)            /* Bytes per delta sample * 16 */
+#define SENSOR_TABLE_INITIAL    8
+#define TOKEN_SCALE             1000000
+
+/* Waveform levels below GAS_SENSOR_UPLINK_LEVEL_OFF */
+static const struct {
+    uint8_t decimation;
+    uint8_t encoding;
+} levels[GAS_SENSOR_UPLINK_LEVEL_OFF] = {
+    { 1, GAS_SENSOR_UPLINK_ENC_RAW },
+    { 1, GAS_SENSOR_UPLINK_ENC_DELTA },
+    { 2, GAS_SENSOR_UPLINK_ENC_DELTA },
+    { 4, GAS_SENSOR_UPLINK_ENC_DELTA },
+    { 10, GAS_SENSOR_UPLINK_ENC_DELTA },
+    { 20, GAS_SENSOR_UPLINK_ENC_DELTA },
+};
+
+/* One queued message */
+typedef struct msg {
+    struct msg *next;
+    size_t length;
+    uint8_t data[];
+} msg_t;
+
+typedef struct {
+    msg_t *head;
+    msg_t *tail;
+} queue_t;
+
+typedef struct {
+    uint32_t sensor_id;
+    bool used;
+
+    /* Status */
+    bool reported;                          /* A status message was queued */
+    bool regs_valid;
+    uint8_t status;                         /* Masked STS bits last reported */
+
+    /* Slow data */
+    uint8_t window[FRAME_IDS][SLOW_SIZE];   /* Last frame bytes 14-19 per ID */
+    uint8_t sent[FRAME_IDS][SLOW_SIZE];     /* Bytes 14-19 last sent per ID */
+    uint16_t seen;                          /* IDs with a window */
+    uint16_t sent_mask;                     /* IDs with sent bytes */
+    bool keyed;                             /* A complete message was queued */
+    uint64_t keyframe_us;
+
+    /* Waveform window */
+    uint8_t level;
+    uint32_t frames;
+    uint64_t first_us;
+    uint8_t last_status;
+    uint8_t alarm_bits;                     /* Alarm STS bits seen in the window */
+    uint32_t sum[GAS_SENSOR_CH_COUNT];
+    uint32_t valid[GAS_SENSOR_CH_COUNT];
+    uint32_t bucket;                        /* Frames in the sample being built */
+    uint32_t count;
+    uint16_t samples[MAX_SAMPLES][GAS_SENSOR_CH_COUNT];
+} sensor_t;
+
+struct gas_sensor_uplink {
+    gas_sensor_uplink_config_t config;
+    gas_sensor_uplink_send_fn send;
+    void *ctx;
+
+    gas_sensor_token_bucket_t pacer;
+    uint32_t paced_rate;                    /* Bandwidth less headroom */
+    uint32_t window_frames;
+    queue_t queues[GAS_SENSOR_UPLINK_CLASSES];
+    size_t backlog;
+
+    sensor_t *sensors;
+    size_t sensor_capacity;
+    size_t sensor_count;
+    size_t mem_charged;                     /* Sensor table bytes charged to config.mem */
+
+    /* Adaptation */
+    bool started;
+    uint8_t level;
+    uint64_t interval_us;                   /* Start of the adaptation interval */
+    uint64_t priority_bytes;                /* Status and slow bytes queued in it */
+    uint32_t priority_rate;
+    bool rate_known;
+    uint64_t interval_sent;                 /* Bytes the link took in it */
+    bool congested;                         /* The link refused a send in it */
+    uint32_t link_rate;                     /* Measured while congested */
+    uint32_t delta_size;                    /* Bytes per delta sample * 16 */
+
+    uint64_t queued[GAS_SENSOR_UPLINK_CLASSES];
+    uint64_t sent[GAS_SENSOR_UPLINK_CLASSES];
+    uint64_t dropped[GAS_SENSOR_UPLINK_CLASSES];
+    uint64_t bytes_sent;
+    uint64_t refused;
+    uint64_t frames_suspended;
+};
+
+/* ============================================================================
+ * Helper Functions
+ * ============================================================================ */
+
+static size_t put_zigzag(uint8_t *data, int32_t value)
+{
+    uint32_t v = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    size_t n = 0;
+    while (v >= 0x80) {
+        data[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    data[n++] = (uint8_t)v;
+    return n;
+}
+
+/* Returns the bytes consumed, 0 if malformed */
+static size_t get_zigzag(const uint8_t *data, size_t available, int32_t *value)
+{
+    uint32_t v = 0;
+    for (size_t n = 0; n < available && n < 5; n++) {
+        v |= (uint32_t)(data[n] & 0x7F) << (7 * n);
+        if ((data[n] & 0x80) == 0) {
+            *value = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static int popcount16(uint16_t mask)
+{
+    int n = 0;
+    for (; mask != 0; mask &= (uint16_t)(mask - 1)) {
+        n++;
+    }
+    return n;
+}
+
+static void put_header(uint8_t *data, uint8_t type, size_t length, uint32_t sensor_id,
+                       uint64_t timestamp_us, uint8_t status)
+{
+    data[0] = type;
+    put_uint16_le(&data[1], (uint16_t)length);
+    put_uint32_le(&data[3], sensor_id);
+    put_uint64_le(&data[7], timestamp_us);
+    data[15] = status;
+}
+
+/* ============================================================================
+ * Token Bucket
+ * ============================================================================ */
+
+static void bucket_refill(gas_sensor_token_bucket_t *bucket, uint64_t now_us)
+{
+    if (now_us <= bucket->last_us) {
+        return;
+    }
+
+    uint64_t elapsed = now_us - bucket->last_us;
+    bucket->last_us = now_us;
+    if (bucket->rate == 0 || bucket->level >= bucket->depth) {
+        return;
+    }
+
+    /* Compare before multiplying so a long gap cannot overflow */
+    uint64_t missing = (uint64_t)(bucket->depth - bucket->level);
+    if (elapsed >= missing / bucket->rate + 1) {
+        bucket->level = bucket->depth;
+    } else {
+        bucket->level += (int64_t)(elapsed * bucket->rate);
+        if (bucket->level > bucket->depth) {
+            bucket->level = bucket->depth;
+        }
+    }
+}
+
+static void bucket_refund(gas_sensor_token_bucket_t *bucket, size_t bytes)
+{
+    bucket->level += (int64_t)bytes * TOKEN_SCALE;
+    if (bucket->level > bucket->depth) {
+        bucket->level = bucket->depth;
+    }
+}
+
+/* ============================================================================
+ * Queues
+ * ============================================================================ */
+
+static void queue_drop_head(struct gas_sensor_uplink *u, int cls)
+{
+    queue_t *q = &u->queues[cls];
+    msg_t *m = q->head;
+    q->head = m->next;
+    if (q->head == NULL) {
+        q->tail = NULL;
+    }
+    u->backlog -= m->length;
+    gas_sensor_mem_release(u->config.mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE,
+                           sizeof(*m) + m->length);
+    free(m);
+}
+
+/* Charge a message to the ledger; status messages are never refused */
+static bool queue_charge(struct gas_sensor_uplink *u, int cls, size_t bytes)
+{
+    if (cls == GAS_SENSOR_UPLINK_CLASS_STATUS) {
+        gas_sensor_mem_force(u->config.mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE, bytes);
+        return true;
+    }
+    return gas_sensor_mem_charge(u->config.mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE,
+                                 bytes) == GAS_SENSOR_OK;
+}
+
+/**
+ * Queue a message, making room in the spill buffer or the memory budget
+ * if needed
+ * Returns GAS_SENSOR_ERR_NO_SPACE if this or an older message was dropped.
+ */
+static int uplink_enqueue(struct gas_sensor_uplink *u, int cls,
+                          const uint8_t *data, size_t length)
+{
+    int result = GAS_SENSOR_OK;
+    size_t bytes = sizeof(msg_t) + length;
+    while (u->backlog + length > u->config.spill_bytes || !queue_charge(u, cls, bytes)) {
+        int victim = -1;
+        for (int c = GAS_SENSOR_UPLINK_CLASSES - 1; c >= cls; c--) {
+            if (u->queues[c].head != NULL) {
+                victim = c;
+                break;
+            }
+        }
+        if (victim < 0) {
+            u->dropped[cls]++;
+            return GAS_SENSOR_ERR_NO_SPACE;
+        }
+        queue_drop_head(u, victim);
+        u->dropped[victim]++;
+        result = GAS_SENSOR_ERR_NO_SPACE;
+    }
+
+    msg_t *m = malloc(bytes);
+    if (m == NULL) {
+        gas_sensor_mem_release(u->config.mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE, bytes);
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    m->next = NULL;
+    m->length = length;
+    memcpy(m->data, data, length);
+
+    queue_t *q = &u->queues[cls];
+    if (q->tail != NULL) {
+        q->tail->next = m;
+    } else {
+        q->head = m;
+    }
+    q->tail = m;
+    u->backlog += length;
+    u->queued[cls]++;
+    if (cls != GAS_SENSOR_UPLINK_CLASS_WAVEFORM) {
+        u->priority_bytes += length;
+    }
+    return result;
+}
+
+/* Send in priority order while the pacer and the link allow */
+static int uplink_pump(struct gas_sensor_uplink *u, uint64_t now_us)
+{
+    for (;;) {
+        int cls = 0;
+        while (cls < GAS_SENSOR_UPLINK_CLASSES && u->queues[cls].head == NULL) {
+            cls++;
+        }
+        if (cls == GAS_SENSOR_UPLINK_CLASSES) {
+            return GAS_SENSOR_OK;
+        }
+
+        msg_t *m = u->queues[cls].head;
+        if (!gas_sensor_token_bucket_take(&u->pacer, m->length, now_us)) {
+            return GAS_SENSOR_OK;
+        }
+        int result = u->send(u->ctx, m->data, m->length, now_us);
+        if (result != GAS_SENSOR_OK) {
+            bucket_refund(&u->pacer, m->length);
+            if (result == GAS_SENSOR_ERR_NO_SPACE) {
+                u->refused++;
+                u->congested = true;
+                return GAS_SENSOR_OK;
+            }
+            return result;
+        }
+
+        u->sent[cls]++;
+        u->bytes_sent += m->length;
+        u->interval_sent += m->length;
+        queue_drop_head(u, cls);
+    }
+}
+
+/* ============================================================================
+ * Sensor Table
+ * ============================================================================ */
+
+GAS_SENSOR_ID_TABLE(sensor, sensor_t)
+
+/**
+ * Find or create a sensor's state; NULL if the table could not grow
+ */
+static sensor_t *sensor_lookup(struct gas_sensor_uplink *u, uint32_t sensor_id)
+{
+    size_t i = sensor_slot(u->sensors, u->sensor_capacity - 1, sensor_id);
+    if (u->sensors[i].used) {
+        return &u->sensors[i];
+    }
+
+    /* Keep the load factor at or below one half */
+    if ((u->sensor_count + 1) * 2 > u->sensor_capacity) {
+        size_t capacity = u->sensor_capacity * 2;
+        sensor_t *table = calloc(capacity, sizeof(*table));
+        if (table == NULL) {
+            return NULL;
+        }
+        for (size_t k = 0; k < u->sensor_capacity; k++) {
+            if (u->sensors[k].used) {
+                table[sensor_slot(table, capacity - 1, u->sensors[k].sensor_id)] = u->sensors[k];
+            }
+        }
+        free(u->sensors);
+        gas_sensor_mem_force(u->config.mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE,
+                             (capacity - u->sensor_capacity) * sizeof(*table));
+        u->mem_charged += (capacity - u->sensor_capacity) * sizeof(*table);
+        u->sensors = table;
+        u->sensor_capacity = capacity;
+        i = sensor_slot(table, capacity - 1, sensor_id);
+    }
+
+    sensor_t *s = &u->sensors[i];
+    memset(s, 0, sizeof(*s));
+    s->used = true;
+    s->sensor_id = sensor_id;
+    u->sensor_count++;
+    return s;
+}
+
+/* ============================================================================
+ * Message Builders
+ * ============================================================================ */
+
+static int queue_status(struct gas_sensor_uplink *u, sensor_t *s, uint64_t timestamp_us,
+                        uint8_t status, uint8_t changed, bool regs_changed)
+{
+    uint8_t msg[GAS_SENSOR_UPLINK_STATUS_SIZE];
+    put_header(msg, GAS_SENSOR_UPLINK_MSG_STATUS, sizeof(msg), s->sensor_id,
+               timestamp_us, status);
+    msg[16] = changed;
+    msg[17] = (uint8_t)((regs_changed ? GAS_SENSOR_UPLINK_F_REGS_CHANGED : 0) |
+                        (s->regs_valid ? GAS_SENSOR_UPLINK_F_REGS_VALID : 0));
+    memcpy(&msg[18], s->window[FRAME_ID_SENSOR_REGS], SLOW_SIZE);
+    return uplink_enqueue(u, GAS_SENSOR_UPLINK_CLASS_STATUS, msg, sizeof(msg));
+}
+
+/* At the end of a slow data cycle: queue the IDs that changed */
+static int queue_slow(struct gas_sensor_uplink *u, sensor_t *s, uint64_t timestamp_us,
+                      uint8_t status)
+{
+    bool keyframe = !s->keyed ||
+                    timestamp_us >= s->keyframe_us + (uint64_t)u->config.slow_keyframe_ms * 1000;
+    uint8_t msg[SLOW_MAX_SIZE];
+    size_t length = GAS_SENSOR_UPLINK_HEADER_SIZE + 2;
+    uint16_t mask = 0;
+
+    for (int id = 0; id < FRAME_IDS; id++) {
+        uint16_t bit = (uint16_t)(1u << id);
+        if (!(s->seen & bit)) {
+            continue;
+        }
+        if (keyframe || !(s->sent_mask & bit) ||
+            memcmp(s->sent[id], s->window[id], SLOW_SIZE) != 0) {
+            memcpy(&msg[length], s->window[id], SLOW_SIZE);
+            memcpy(s->sent[id], s->window[id], SLOW_SIZE);
+            length += SLOW_SIZE;
+            mask |= bit;
+        }
+    }
+    if (mask == 0) {
+        return GAS_SENSOR_OK;
+    }
+
+    s->sent_mask |= mask;
+    if (keyframe) {
+        s->keyed = true;
+        s->keyframe_us = timestamp_us;
+    }
+    put_header(msg, GAS_SENSOR_UPLINK_MSG_SLOW, length, s->sensor_id, timestamp_us, status);
+    put_uint16_le(&msg[16], mask);
+    return uplink_enqueue(u, GAS_SENSOR_UPLINK_CLASS_SLOW, msg, length);
+}
+
+/* Close the sample being averaged */
+static void wave_sample(sensor_t *s)
+{
+    uint16_t *sample = s->samples[s->count++];
+    for (int k = 0; k < GAS_SENSOR_CH_COUNT; k++) {
+        sample[k] = (s->valid[k] > 0)
+                    ? (uint16_t)((s->sum[k] + s->valid[k] / 2) / s->valid[k])
+                    : INVALID_SAMPLE;
+        s->sum[k] = 0;
+        s->valid[k] = 0;
+    }
+    s->bucket = 0;
+}
+
+static int queue_waveform(struct gas_sensor_uplink *u, sensor_t *s)
+{
+    uint8_t msg[WAVE_MAX_SIZE];
+    uint8_t encoding = levels[s->level].encoding;
+    size_t length = WAVE_HEADER_SIZE;
+
+    for (uint32_t i = 0; i < s->count; i++) {
+        for (int k = 0; k < GAS_SENSOR_CH_COUNT; k++) {
+            if (i == 0 || encoding == GAS_SENSOR_UPLINK_ENC_RAW) {
+                put_uint16_le(&msg[length], s->samples[i][k]);
+                length += 2;
+            } else {
+                length += put_zigzag(&msg[length],
+                                     (int32_t)s->samples[i][k] - (int32_t)s->samples[i - 1][k]);
+            }
+        }
+    }
+
+    if (encoding == GAS_SENSOR_UPLINK_ENC_DELTA && s->count > 1) {
+        uint32_t size = (uint32_t)((length - WAVE_HEADER_SIZE - SAMPLE_SIZE) * 16 /
+                                   (s->count - 1));
+        u->delta_size = (u->delta_size * 3 + size + 2) / 4;
+    }
+
+    put_header(msg, GAS_SENSOR_UPLINK_MSG_WAVEFORM, length, s->sensor_id, s->first_us,
+               (uint8_t)(s->last_status | s->alarm_bits));
+    msg[16] = levels[s->level].decimation;
+    msg[17] = encoding;
+    msg[18] = (uint8_t)s->count;
+    return uplink_enqueue(u, GAS_SENSOR_UPLINK_CLASS_WAVEFORM, msg, length);
+}
+
+static int sensor_waveform(struct gas_sensor_uplink *u, sensor_t *s, const uint8_t *frame,
+                           uint64_t timestamp_us)
+{
+    if (s->frames == 0) {
+        s->level = u->level;
+        s->first_us = timestamp_us;
+        s->alarm_bits = 0;
+        s->count = 0;
+        s->bucket = 0;
+        memset(s->sum, 0, sizeof(s->sum));
+        memset(s->valid, 0, sizeof(s->valid));
+    }
+    s->last_status = gas_sensor_frame_status(frame);
+    s->alarm_bits |= (uint8_t)(s->last_status & u->config.status_mask);
+    s->frames++;
+
+    if (s->level == GAS_SENSOR_UPLINK_LEVEL_OFF) {
+        u->frames_suspended++;
+        if (s->frames == u->window_frames) {
+            s->frames = 0;
+        }
+        return GAS_SENSOR_OK;
+    }
+
+    for (int k = 0; k < GAS_SENSOR_CH_COUNT; k++) {
+        const uint8_t *word = &frame[WAVEFORM_OFFSET + 2 * k];
+        uint16_t value = (uint16_t)((word[0] << 8) | word[1]);
+        if (value != INVALID_SAMPLE) {
+            s->sum[k] += value;
+            s->valid[k]++;
+        }
+    }
+    if (++s->bucket == levels[s->level].decimation) {
+        wave_sample(s);
+    }
+
+    if (s->frames < u->window_frames) {
+        return GAS_SENSOR_OK;
+    }
+    if (s->bucket > 0) {
+        wave_sample(s);
+    }
+    s->frames = 0;
+    return queue_waveform(u, s);
+}
+
+/* ============================================================================
+ * Adaptation
+ * ============================================================================ */
+
+/* Estimated rate of one sensor's waveforms at a level, bytes/s * 16 */
+static uint64_t level_rate(const struct gas_sensor_uplink *u, uint8_t level)
+{
+    uint32_t sample_size = (levels[level].encoding == GAS_SENSOR_UPLINK_ENC_RAW)
+                           ? SAMPLE_SIZE * 16 : u->delta_size;
+    return (uint64_t)WAVE_HEADER_SIZE * 16 * 1000 / u->config.window_ms +
+           (uint64_t)FRAMES_PER_SECOND * sample_size / levels[level].decimation;
+}
+
+static void uplink_adapt(struct gas_sensor_uplink *u, uint64_t now_us)
+{
+    if (now_us < u->interval_us + (uint64_t)u->config.window_ms * 1000) {
+        return;
+    }
+    uint64_t elapsed = now_us - u->interval_us;
+
+    uint32_t rate = (uint32_t)(u->priority_bytes * 1000000 / elapsed);
+    u->priority_rate = u->rate_known ? (u->priority_rate * 3 + rate + 2) / 4 : rate;
+    u->rate_known = true;
+    u->priority_bytes = 0;
+
+    /* A link that refused sends is slower than configured: use what it took */
+    uint32_t capacity = u->paced_rate;
+    if (u->congested) {
+        uint32_t taken = (uint32_t)(u->interval_sent * 1000000 / elapsed);
+        u->link_rate = (u->link_rate > 0) ? (u->link_rate * 3 + taken + 2) / 4 : taken;
+        if (u->link_rate < capacity) {
+            capacity = u->link_rate;
+        }
+    } else {
+        u->link_rate = 0;
+    }
+    u->congested = false;
+    u->interval_sent = 0;
+    u->interval_us = now_us;
+
+    /* Finest level whose rate fits what status and slow data leave */
+    uint64_t budget = (capacity > u->priority_rate) ? capacity - u->priority_rate : 0;
+    uint64_t per_sensor = budget * 16 / (u->sensor_count ? u->sensor_count : 1);
+    uint8_t fit = u->config.min_level;
+    while (fit < GAS_SENSOR_UPLINK_LEVEL_OFF && level_rate(u, fit) > per_sensor) {
+        fit++;
+    }
+
+    uint64_t limit = (uint64_t)capacity * u->config.max_backlog_ms / 1000;
+    if (u->backlog > limit) {
+        uint8_t coarser = (u->level < GAS_SENSOR_UPLINK_LEVEL_OFF) ? u->level + 1 : u->level;
+        u->level = (fit > coarser) ? fit : coarser;
+    } else if (fit > u->level) {
+        u->level = fit;
+    } else if (fit < u->level && u->backlog * 2 <= limit) {
+        u->level--;
+    }
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+void gas_sensor_uplink_config_init(gas_sensor_uplink_config_t *config)
+{
+    if (config == NULL) {
+        return;
+    }
+
+    config->bandwidth = 1200;
+    config->headroom_percent = 10;
+    config->window_ms = 1000;
+    config->max_backlog_ms = 2000;
+    config->slow_keyframe_ms = 10000;
+    config->spill_bytes = 256 * 1024;
+    config->status_mask = GAS_SENSOR_STS_ALARM_MASK;
+    config->min_level = 0;
+    config->mem = NULL;
+}
+
+int gas_sensor_uplink_create(const gas_sensor_uplink_config_t *config,
+                             gas_sensor_uplink_send_fn send,
+                             void *ctx,
+                             gas_sensor_uplink_t *uplink)
+{
+    if (send == NULL || uplink == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    gas_sensor_uplink_config_t defaults;
+    if (config == NULL) {
+        gas_sensor_uplink_config_init(&defaults);
+        config = &defaults;
+    }
+    if (config->bandwidth == 0 || config->headroom_percent >= 100 ||
+        config->window_ms < FRAME_PERIOD_US / 1000 ||
+        config->window_ms > GAS_SENSOR_UPLINK_MAX_WINDOW_MS ||
+        config->spill_bytes < WAVE_MAX_SIZE ||
+        config->min_level > GAS_SENSOR_UPLINK_LEVEL_OFF) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    struct gas_sensor_uplink *u = calloc(1, sizeof(*u));
+    if (u == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    u->sensors = calloc(SENSOR_TABLE_INITIAL, sizeof(*u->sensors));
+    if (u->sensors == NULL) {
+        free(u);
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    u->config = *config;
+    u->send = send;
+    u->ctx = ctx;
+    u->sensor_capacity = SENSOR_TABLE_INITIAL;
+    u->mem_charged = sizeof(*u) + SENSOR_TABLE_INITIAL * sizeof(*u->sensors);
+    gas_sensor_mem_force(config->mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE, u->mem_charged);
+    u->paced_rate = (uint32_t)((uint64_t)config->bandwidth * (100 - config->headroom_percent) / 100);
+    if (u->paced_rate == 0) {
+        u->paced_rate = 1;
+    }
+    u->window_frames = config->window_ms * 1000 / FRAME_PERIOD_US;
+    u->level = config->min_level;
+    u->delta_size = DELTA_SIZE_INITIAL;
+
+    *uplink = u;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_uplink_frame_handler(void *ctx, const gas_sensor_frame_event_t *event)
+{
+    struct gas_sensor_uplink *u = ctx;
+    if (u == NULL || event == NULL || event->frame == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    const uint8_t *frame = event->frame;
+    uint64_t now = event->timestamp_us;
+    uint8_t id = gas_sensor_frame_id(frame);
+    if (id >= FRAME_IDS) {
+        return GAS_SENSOR_ERR_INVALID_FRAME;
+    }
+
+    if (!u->started) {
+        u->started = true;
+        u->interval_us = now;
+        gas_sensor_token_bucket_init(&u->pacer, u->paced_rate, u->paced_rate / 4 + 1, now);
+    }
+
+    sensor_t *s = sensor_lookup(u, event->sensor_id);
+    if (s == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    /* Status: alarm bits and the mode, error and adapter registers */
+    uint8_t status = gas_sensor_frame_status(frame);
+    bool regs_changed = false;
+    if (id == FRAME_ID_SENSOR_REGS) {
+        const uint8_t *regs = s->window[FRAME_ID_SENSOR_REGS];
+        const uint8_t *w = &frame[SLOW_OFFSET];
+        regs_changed = !s->regs_valid ||
+                       ((regs[GAS_SENSOR_SLOW_MODE] ^ w[GAS_SENSOR_SLOW_MODE]) &
+                        GAS_SENSOR_MODE_MASK) != 0 ||
+                       regs[GAS_SENSOR_SLOW_ERROR] != w[GAS_SENSOR_SLOW_ERROR] ||
+                       regs[GAS_SENSOR_SLOW_ADAPTER] != w[GAS_SENSOR_SLOW_ADAPTER];
+        s->regs_valid = true;
+    }
+    memcpy(s->window[id], &frame[SLOW_OFFSET], SLOW_SIZE);
+    s->seen |= (uint16_t)(1u << id);
+
+    int result = GAS_SENSOR_OK;
+    int r;
+    uint8_t masked = status & u->config.status_mask;
+    uint8_t changed = s->reported ? (uint8_t)(masked ^ s->status) : masked;
+    if (!s->reported || changed != 0 || regs_changed) {
+        r = queue_status(u, s, now, status, changed, regs_changed);
+        if (r != GAS_SENSOR_OK && result == GAS_SENSOR_OK) {
+            result = r;
+        }
+        s->reported = true;
+        s->status = masked;
+    }
+
+    if (id == FRAME_IDS - 1) {
+        r = queue_slow(u, s, now, status);
+        if (r != GAS_SENSOR_OK && result == GAS_SENSOR_OK) {
+            result = r;
+        }
+    }
+
+    r = sensor_waveform(u, s, frame, now);
+    if (r != GAS_SENSOR_OK && result == GAS_SENSOR_OK) {
+        result = r;
+    }
+
+    uplink_adapt(u, now);
+    r = uplink_pump(u, now);
+    return (r != GAS_SENSOR_OK) ? r : result;
+}
+
+int gas_sensor_uplink_tick(gas_sensor_uplink_t uplink, uint64_t now_us)
+{
+    if (uplink == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (!uplink->started) {
+        return GAS_SENSOR_OK;
+    }
+    uplink_adapt(uplink, now_us);
+    return uplink_pump(uplink, now_us);
+}
+
+int gas_sensor_uplink_stats(gas_sensor_uplink_t uplink, gas_sensor_uplink_stats_t *stats)
+{
+    if (uplink == NULL || stats == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    for (int c = 0; c < GAS_SENSOR_UPLINK_CLASSES; c++) {
+        stats->queued[c] = uplink->queued[c];
+        stats->sent[c] = uplink->sent[c];
+        stats->dropped[c] = uplink->dropped[c];
+    }
+    stats->bytes_sent = uplink->bytes_sent;
+    stats->refused = uplink->refused;
+    stats->frames_suspended = uplink->frames_suspended;
+    stats->backlog_bytes = uplink->backlog;
+    stats->sensors = uplink->sensor_count;
+    stats->priority_rate = uplink->priority_rate;
+    stats->level = uplink->level;
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_uplink_destroy(gas_sensor_uplink_t uplink)
+{
+    if (uplink == NULL) {
+        return;
+    }
+
+    for (int c = 0; c < GAS_SENSOR_UPLINK_CLASSES; c++) {
+        while (uplink->queues[c].head != NULL) {
+            queue_drop_head(uplink, c);
+        }
+    }
+    gas_sensor_mem_release(uplink->config.mem, GAS_SENSOR_MEM_SHARED, GAS_SENSOR_MEM_QUEUE,
+                           uplink->mem_charged);
+    free(uplink->sensors);
+    free(uplink);
+}
+
+/* ============================================================================
+ * Traffic Shaping
+ * ============================================================================ */
+
+void gas_sensor_token_bucket_init(gas_sensor_token_bucket_t *bucket,
+                                  uint32_t rate,
+                                  uint32_t depth,
+                                  uint64_t now_us)
+{
+    if (bucket == NULL) {
+        return;
+    }
+
+    bucket->rate = rate;
+    bucket->depth = (int64_t)depth * TOKEN_SCALE;
+    bucket->level = bucket->depth;
+    bucket->last_us = now_us;
+}
+
+bool gas_sensor_token_bucket_take(gas_sensor_token_bucket_t *bucket,
+                                  size_t bytes,
+                                  uint64_t now_us)
+{
+    if (bucket == NULL) {
+        return false;
+    }
+
+    bucket_refill(bucket, now_us);
+    if (bucket->level <= 0) {
+        return false;
+    }
+    bucket->level -= (int64_t)bytes * TOKEN_SCALE;
+    return true;
+}
+
+int gas_sensor_shaper_init(gas_sensor_shaper_t *shaper,
+                           uint32_t rate,
+                           uint32_t depth,
+                           gas_sensor_uplink_send_fn deliver,
+                           void *ctx,
+                           uint64_t now_us)
+{
+    if (shaper == NULL || deliver == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (rate == 0) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    memset(shaper, 0, sizeof(*shaper));
+    gas_sensor_token_bucket_init(&shaper->bucket, rate, depth, now_us);
+    shaper->deliver = deliver;
+    shaper->ctx = ctx;
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_shaper_send(void *ctx, const uint8_t *msg, size_t length, uint64_t now_us)
+{
+    gas_sensor_shaper_t *shaper = ctx;
+    if (shaper == NULL || msg == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    if (!gas_sensor_token_bucket_take(&shaper->bucket, length, now_us)) {
+        shaper->refused++;
+        return GAS_SENSOR_ERR_NO_SPACE;
+    }
+
+    int result = shaper->deliver(shaper->ctx, msg, length, now_us);
+    if (result != GAS_SENSOR_OK) {
+        bucket_refund(&shaper->bucket, length);
+        return result;
+    }
+    shaper->messages++;
+    shaper->bytes += length;
+    return GAS_SENSOR_OK;
+}
+
+/* ============================================================================
+ * Receiving Side
+ * ============================================================================ */
+
+int gas_sensor_uplink_parse(const uint8_t *data, size_t length, gas_sensor_uplink_msg_t *msg)
+{
+    if (data == NULL || msg == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (length < GAS_SENSOR_UPLINK_HEADER_SIZE) {
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    size_t size = get_uint16_le(&data[1]);
+    if (size < GAS_SENSOR_UPLINK_HEADER_SIZE || size > length) {
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+
+    memset(msg, 0, sizeof(*msg));
+    msg->type = data[0];
+    msg->sensor_id = get_uint32_le(&data[3]);
+    msg->timestamp_us = get_uint64_le(&data[7]);
+    msg->status = data[15];
+
+    switch (msg->type) {
+        case GAS_SENSOR_UPLINK_MSG_STATUS:
+            if (size != GAS_SENSOR_UPLINK_STATUS_SIZE) {
+                return GAS_SENSOR_ERR_FORMAT;
+            }
+            msg->status_changed = data[16];
+            msg->flags = data[17];
+            if (msg->flags & GAS_SENSOR_UPLINK_F_REGS_VALID) {
+                msg->id_mask = 1u << FRAME_ID_SENSOR_REGS;
+                msg->windows = &data[18];
+            }
+            return GAS_SENSOR_OK;
+
+        case GAS_SENSOR_UPLINK_MSG_SLOW:
+            if (size < GAS_SENSOR_UPLINK_HEADER_SIZE + 2) {
+                return GAS_SENSOR_ERR_FORMAT;
+            }
+            msg->id_mask = get_uint16_le(&data[16]);
+            if ((msg->id_mask >> FRAME_IDS) != 0 ||
+                size != GAS_SENSOR_UPLINK_HEADER_SIZE + 2 +
+                        (size_t)popcount16(msg->id_mask) * SLOW_SIZE) {
+                return GAS_SENSOR_ERR_FORMAT;
+            }
+            msg->windows = &data[18];
+            return GAS_SENSOR_OK;
+
+        case GAS_SENSOR_UPLINK_MSG_WAVEFORM:
+            if (size < WAVE_HEADER_SIZE) {
+                return GAS_SENSOR_ERR_FORMAT;
+            }
+            msg->decimation = data[16];
+            msg->encoding = data[17];
+            msg->count = data[18];
+            msg->samples = &data[WAVE_HEADER_SIZE];
+            msg->samples_length = size - WAVE_HEADER_SIZE;
+            if (msg->decimation == 0 || msg->encoding > GAS_SENSOR_UPLINK_ENC_DELTA ||
+                (msg->encoding == GAS_SENSOR_UPLINK_ENC_RAW &&
+                 msg->samples_length != (size_t)msg->count * SAMPLE_SIZE)) {
+                return GAS_SENSOR_ERR_FORMAT;
+            }
+            return GAS_SENSOR_OK;
+
+        default:
+            return GAS_SENSOR_ERR_FORMAT;
+    }
+}
+
+int gas_sensor_uplink_samples(const gas_sensor_uplink_msg_t *msg,
+                              uint16_t (*samples)[GAS_SENSOR_CH_COUNT],
+                              size_t max)
+{
+    if (msg == NULL || samples == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (msg->type != GAS_SENSOR_UPLINK_MSG_WAVEFORM || msg->samples == NULL) {
+        return GAS_SENSOR_ERR_FORMAT;
+    }
+    if (msg->count > max) {
+        return GAS_SENSOR_ERR_NO_SPACE;
+    }
+
+    const uint8_t *p = msg->samples;
+    size_t available = msg->samples_length;
+    for (size_t i = 0; i < msg->count; i++) {
+        for (int k = 0; k < GAS_SENSOR_CH_COUNT; k++) {
+            if (i == 0 || msg->encoding == GAS_SENSOR_UPLINK_ENC_RAW) {
+                if (available < 2) {
+                    return GAS_SENSOR_ERR_FORMAT;
+                }
+                samples[i][k] = get_uint16_le(p);
+                p += 2;
+                available -= 2;
+            } else {
+                int32_t delta;
+                size_t n = get_zigzag(p, available, &delta);
+                int32_t value = (int32_t)samples[i - 1][k] + delta;
+                if (n == 0 || value < 0 || value > 0xFFFF) {
+                    return GAS_SENSOR_ERR_FORMAT;
+                }
+                samples[i][k] = (uint16_t)value;
+                p += n;
+                available -= n;
+            }
+        }
+    }
+    return (available == 0) ? (int)msg->count : GAS_SENSOR_ERR_FORMAT;
+}
+
+int gas_sensor_uplink_apply(const gas_sensor_uplink_msg_t *msg,
+                            gas_sensor_slow_data_t *slow_data)
+{
+    if (msg == NULL || slow_data == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+    if (msg->type != GAS_SENSOR_UPLINK_MSG_STATUS && msg->type != GAS_SENSOR_UPLINK_MSG_SLOW) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    /* Rebuild each frame around its window and parse it */
+    const uint8_t *window = msg->windows;
+    for (int id = 0; id < FRAME_IDS; id++) {
+        if (!(msg->id_mask & (1u << id))) {
+            continue;
+        }
+        uint8_t frame[GAS_SENSOR_FRAME_SIZE] = { GAS_SENSOR_FLAG1, GAS_SENSOR_FLAG2 };
+        frame[GAS_SENSOR_OFFSET_ID] = (uint8_t)id;
+        frame[GAS_SENSOR_OFFSET_STS] = msg->status;
+        memcpy(&frame[SLOW_OFFSET], window, SLOW_SIZE);
+        frame[GAS_SENSOR_OFFSET_CHECKSUM] = gas_sensor_compute_checksum(frame);
+        gas_sensor_parse_frame(frame, slow_data, NULL, NULL);
+        window += SLOW_SIZE;
+    }
+    return GAS_SENSOR_OK;
+}
@@ -0,0 +1,373 @@
+/*
+ * Anesthetic Gas Sensor Prioritized Uplink
+ *
+ * Sends frame events from the edge over a link of known, limited
+ * bandwidth without saturating it. Events are turned into three classes
+ * of messages, each with its own queue, and queues are served in strict
+ * priority order:
+ *
+ *   Status    An alarm STS bit changed, or the mode, error or adapter
+ *             register of an ID 0x04 frame changed (as the delivery alarm
+ *             lane). Carries the sensor registers, so one message is the
+ *             sensor's full alarm state.
+ *   Slow      One per completed slow data cycle (frame ID 9), holding the
+ *             frame IDs whose slow data changed since the last message,
+ *             and every ID once per keyframe interval.
+ *   Waveform  One per window of frames (1 s by default), at the current
+ *             waveform level.
+ *
+ * Waveforms take what the higher classes leave of the bandwidth. Each
+ * adaptation interval (one window) the uplink measures the status and
+ * slow data rate and picks the finest waveform level whose estimated rate
+ * fits the rest, for every sensor seen. The levels are:
+ *
+ *   0  20 Hz, raw samples
+ *   1  20 Hz, delta-encoded samples (about half the size)
+ *   2  10 Hz, delta      3  5 Hz, delta      4  2 Hz, delta
+ *   5  1 Hz, delta
+ *   6  waveforms suspended
+ *
+ * Decimation averages the frames of each sample, as the WebSocket
+ * viewers do, and every alarm bit seen in the window is OR-ed into the
+ * message's STS byte. A backlog of more than max_backlog_ms of bandwidth
+ * forces a coarser level; the uplink refines by one level per interval.
+ *
+ * Messages waiting for the link are held in a bounded spill buffer. When
+ * it is full the oldest waveform message is dropped first, then the
+ * oldest slow data message, and a status message only makes room by
+ * dropping an older status message. The uplink paces its own sends with
+ * a token bucket at the configured bandwidth; a link that refuses a
+ * message (GAS_SENSOR_ERR_NO_SPACE) keeps it queued for the next tick.
+ *
+ * With a memory ledger in the configuration, queued messages and the
+ * sensor table are charged to it as shared GAS_SENSOR_MEM_QUEUE memory. A
+ * refused charge evicts like a full spill buffer; status messages and the
+ * sensor table are always charged, as delivery's alarm lane.
+ *
+ * gas_sensor_shaper_t is a link stand-in for local testing: a token
+ * bucket of its own in front of any receiver, so a slow or congested link
+ * can be reproduced with simulated time.
+ *
+ * Messages (multi-byte fields little-endian), each self-delimiting:
+ *   Header (16 bytes)
+ *     [0]     Message type (GAS_SENSOR_UPLINK_MSG_*)
+ *     [1-2]   Message length, header included
+ *     [3-6]   Sensor ID
+ *     [7-14]  Timestamp (us since epoch): status frame, last frame of the
+ *             slow data cycle, or first frame of the waveform window
+ *     [15]    STS byte
+ *   Status (24 bytes)
+ *     [16]    Alarm STS bits changed
+ *     [17]    Flags (GAS_SENSOR_UPLINK_F_*)
+ *     [18-23] Bytes 14-19 of the last ID 0x04 frame
+ *   Slow
+ *     [16-17] Frame IDs included (bit per ID)
+ *     [18-]   Bytes 14-19 of the last frame of each included ID, by ID
+ *   Waveform
+ *     [16]    Frames per sample (decimation factor)
+ *     [17]    Sample encoding (GAS_SENSOR_UPLINK_ENC_*)
+ *     [18]    Sample count
+ *     [19-]   Samples of CO2, N2O, AA1, AA2, O2 in hundredths of %
+ *             (0xFFFF invalid): raw, 10 bytes each; or delta, the first
+ *             sample raw and then each channel's change from the previous
+ *             sample as a zigzag varint
+ *
+ * Single-threaded: the frame handler and gas_sensor_uplink_tick() must
+ * be called from the same thread.
+ */
+
+#ifndef GAS_SENSOR_UPLINK_H
+#define GAS_SENSOR_UPLINK_H
+
+#include "gas_sensor.h"
+#include "gas_sensor_mem.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+/* Priority classes, highest first */
+#define GAS_SENSOR_UPLINK_CLASS_STATUS      0
+#define GAS_SENSOR_UPLINK_CLASS_SLOW        1
+#define GAS_SENSOR_UPLINK_CLASS_WAVEFORM    2
+#define GAS_SENSOR_UPLINK_CLASSES           3
+
+/* Message types */
+#define GAS_SENSOR_UPLINK_MSG_STATUS        0x01
+#define GAS_SENSOR_UPLINK_MSG_SLOW          0x02
+#define GAS_SENSOR_UPLINK_MSG_WAVEFORM      0x03
+
+#define GAS_SENSOR_UPLINK_HEADER_SIZE       16
+#define GAS_SENSOR_UPLINK_STATUS_SIZE       24
+
+/* Status message flags */
+#define GAS_SENSOR_UPLINK_F_REGS_CHANGED    0x01    /* Mode, error or adapter register changed */
+#define GAS_SENSOR_UPLINK_F_REGS_VALID      0x02    /* An ID 0x04 frame has been seen */
+
+/* Waveform sample encodings */
+#define GAS_SENSOR_UPLINK_ENC_RAW           0
+#define GAS_SENSOR_UPLINK_ENC_DELTA         1
+
+/* Waveform levels */
+#define GAS_SENSOR_UPLINK_LEVEL_OFF         6
+#define GAS_SENSOR_UPLINK_MAX_WINDOW_MS     10000
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_uplink *gas_sensor_uplink_t;
+
+/**
+ * Link send function
+ *
+ * @param ctx: Link context
+ * @param msg: One complete message (valid during the call only)
+ * @param length: Message length
+ * @param now_us: Current time (us since epoch)
+ * @return: GAS_SENSOR_OK when the link took the message,
+ *          GAS_SENSOR_ERR_NO_SPACE to retry it later, or another error,
+ *          which is returned to the caller with the message still queued
+ */
+typedef int (*gas_sensor_uplink_send_fn)(void *ctx, const uint8_t *msg, size_t length,
+                                         uint64_t now_us);
+
+typedef struct {
+    uint32_t bandwidth;             /* Link bandwidth (bytes/s) */
+    uint32_t headroom_percent;      /* Bandwidth kept unused for bursts */
+    uint32_t window_ms;             /* Waveform window and adaptation interval */
+    uint32_t max_backlog_ms;        /* Backlog, in bandwidth time, that forces a coarser level */
+    uint32_t slow_keyframe_ms;      /* Interval between complete slow data messages */
+    size_t spill_bytes;             /* Spill buffer capacity */
+    uint8_t status_mask;            /* STS bits that are alarm-relevant */
+    uint8_t min_level;              /* Finest waveform level allowed */
+    gas_sensor_mem_t mem;           /* Ledger charged for the queues, or NULL */
+} gas_sensor_uplink_config_t;
+
+typedef struct {
+    uint64_t queued[GAS_SENSOR_UPLINK_CLASSES];     /* Messages queued, per class */
+    uint64_t sent[GAS_SENSOR_UPLINK_CLASSES];       /* Messages taken by the link */
+    uint64_t dropped[GAS_SENSOR_UPLINK_CLASSES];    /* Messages lost to a full spill buffer */
+    uint64_t bytes_sent;
+    uint64_t refused;               /* Sends refused by the link */
+    uint64_t frames_suspended;      /* Frames not sent while waveforms were off */
+    size_t backlog_bytes;           /* Bytes in the spill buffer */
+    size_t sensors;
+    uint32_t priority_rate;         /* Measured status and slow data rate (bytes/s) */
+    uint8_t level;                  /* Current waveform level */
+} gas_sensor_uplink_stats_t;
+
+/* Token bucket; allocate anywhere and gas_sensor_token_bucket_init() */
+typedef struct {
+    uint64_t rate;                  /* Bytes per second */
+    int64_t level;                  /* Bytes * 1e6; negative while in debt */
+    int64_t depth;                  /* Bucket depth, bytes * 1e6 */
+    uint64_t last_us;
+} gas_sensor_token_bucket_t;
+
+/* Shaped link stand-in; allocate anywhere and gas_sensor_shaper_init() */
+typedef struct {
+    gas_sensor_token_bucket_t bucket;
+    gas_sensor_uplink_send_fn deliver;      /* Far end of the link */
+    void *ctx;
+    uint64_t messages;              /* Messages passed */
+    uint64_t bytes;                 /* Bytes passed */
+    uint64_t refused;               /* Messages refused while the bucket was empty */
+} gas_sensor_shaper_t;
+
+/* One received message; pointers refer into the message buffer */
+typedef struct {
+    uint8_t type;                   /* GAS_SENSOR_UPLINK_MSG_* */
+    uint32_t sensor_id;
+    uint64_t timestamp_us;
+    uint8_t status;                 /* STS byte */
+
+    /* Status */
+    uint8_t status_changed;
+    uint8_t flags;                  /* GAS_SENSOR_UPLINK_F_* */
+
+    /* Status and slow: frame bytes 14-19 per frame ID, by ID */
+    uint16_t id_mask;
+    const uint8_t *windows;
+
+    /* Waveform */
+    uint8_t decimation;
+    uint8_t encoding;
+    uint8_t count;
+    const uint8_t *samples;
+    size_t samples_length;
+} gas_sensor_uplink_msg_t;
+
+/* ============================================================================
+ * Edge Side
+ * ============================================================================ */
+
+/**
+ * Initialize a configuration: 1200 bytes/s (9600 baud), 10% headroom,
+ * 1 s windows, 2 s maximum backlog, 10 s slow data keyframes, 256 KiB
+ * spill buffer, GAS_SENSOR_STS_ALARM_MASK, all levels allowed
+ */
+void gas_sensor_uplink_config_init(gas_sensor_uplink_config_t *config);
+
+/**
+ * Create an uplink
+ *
+ * @param config: Configuration, or NULL for the defaults
+ * @param send: Link send function
+ * @param ctx: Link context
+ * @param uplink: Output parameter for the uplink handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM,
+ *          GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_uplink_create(const gas_sensor_uplink_config_t *config,
+                             gas_sensor_uplink_send_fn send,
+                             void *ctx,
+                             gas_sensor_uplink_t *uplink);
+
+/**
+ * Queue one frame event and send what the bandwidth allows
+ *
+ * Matches gas_sensor_frame_handler_t, so an uplink can be passed directly
+ * to gas_sensor_session_attach() as handler context. The event timestamp
+ * is used as the current time.
+ *
+ * @param ctx: Uplink handle
+ * @param event: Frame event (frame is used)
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_NO_SPACE if a message was
+ *          dropped, GAS_SENSOR_ERR_MEMORY, the link's error, or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_uplink_frame_handler(void *ctx, const gas_sensor_frame_event_t *event);
+
+/**
+ * Send queued messages as far as the bandwidth and the link allow
+ *
+ * Call periodically so the backlog drains while no frames arrive.
+ *
+ * @param uplink: Uplink handle
+ * @param now_us: Current time (us since epoch)
+ * @return: GAS_SENSOR_OK, the link's error, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_uplink_tick(gas_sensor_uplink_t uplink, uint64_t now_us);
+
+/**
+ * Get uplink counters
+ */
+int gas_sensor_uplink_stats(gas_sensor_uplink_t uplink, gas_sensor_uplink_stats_t *stats);
+
+/**
+ * Free an uplink; queued messages are discarded
+ */
+void gas_sensor_uplink_destroy(gas_sensor_uplink_t uplink);
+
+/* ============================================================================
+ * Traffic Shaping
+ * ============================================================================ */
+
+/**
+ * Initialize a token bucket
+ *
+ * A send is allowed whenever the bucket is not empty and may overdraw
+ * it, so messages larger than the bucket still pass; the debt delays the
+ * next one.
+ *
+ * @param bucket: Bucket to initialize (full)
+ * @param rate: Refill rate (bytes/s)
+ * @param depth: Bucket depth (bytes)
+ * @param now_us: Current time (us since epoch)
+ */
+void gas_sensor_token_bucket_init(gas_sensor_token_bucket_t *bucket,
+                                  uint32_t rate,
+                                  uint32_t depth,
+                                  uint64_t now_us);
+
+/**
+ * Take tokens for a send
+ *
+ * @param bucket: Token bucket
+ * @param bytes: Size of the send
+ * @param now_us: Current time (us since epoch)
+ * @return: true if the send may go ahead (tokens taken)
+ */
+bool gas_sensor_token_bucket_take(gas_sensor_token_bucket_t *bucket,
+                                  size_t bytes,
+                                  uint64_t now_us);
+
+/**
+ * Initialize a shaped link
+ *
+ * @param shaper: Link to initialize
+ * @param rate: Link rate (bytes/s)
+ * @param depth: Burst the link absorbs (bytes)
+ * @param deliver: Receives every message the link passes
+ * @param ctx: Receiver context
+ * @param now_us: Current time (us since epoch)
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_shaper_init(gas_sensor_shaper_t *shaper,
+                           uint32_t rate,
+                           uint32_t depth,
+                           gas_sensor_uplink_send_fn deliver,
+                           void *ctx,
+                           uint64_t now_us);
+
+/**
+ * Send through a shaped link
+ *
+ * Matches gas_sensor_uplink_send_fn with the shaper as context.
+ *
+ * @return: The receiver's result, or GAS_SENSOR_ERR_NO_SPACE while the
+ *          bucket is empty
+ */
+int gas_sensor_shaper_send(void *ctx, const uint8_t *msg, size_t length, uint64_t now_us);
+
+/* ============================================================================
+ * Receiving Side
+ * ============================================================================ */
+
+/**
+ * Validate a message and decode its header and body layout
+ *
+ * @param data: Received bytes starting at a message
+ * @param length: Bytes available (at least the message length)
+ * @param msg: Output message
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_FORMAT or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_uplink_parse(const uint8_t *data, size_t length, gas_sensor_uplink_msg_t *msg);
+
+/**
+ * Decode waveform samples
+ *
+ * @param msg: Parsed waveform message
+ * @param samples: Output samples, hundredths of % (0xFFFF invalid)
+ * @param max: Capacity of samples
+ * @return: Number of samples, or GAS_SENSOR_ERR_FORMAT,
+ *          GAS_SENSOR_ERR_NO_SPACE (more than max) or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_uplink_samples(const gas_sensor_uplink_msg_t *msg,
+                              uint16_t (*samples)[GAS_SENSOR_CH_COUNT],
+                              size_t max);
+
+/**
+ * Update slow data from a status or slow data message
+ *
+ * @param msg: Parsed message
+ * @param slow_data: Slow data updated with every frame ID in the message
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM for a waveform
+ *          message, or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_uplink_apply(const gas_sensor_uplink_msg_t *msg,
+                            gas_sensor_slow_data_t *slow_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_UPLINK_H */
@@ -0,0 +1,1237 @@
+/*
+ * Anesthetic Gas Sensor WebSocket Streaming - Implementation
+ *
+ * Subscribers are grouped per sensor and per decimation factor. A group
+ * accumulates the window and encodes one message, which every subscriber
+ * in the group holds by reference in its pending slot until its socket
+ * takes it. A client writes its in-flight message, its control bytes
+ * (handshake response, pong, close) and then every pending slot with one
+ * sendmsg(); whatever the socket did not take stays where it was.
+ *
+ * Clients are never freed from inside a write: a failed client is marked
+ * and reaped at the end of gas_sensor_ws_poll(), so the frame handler can
+ * walk subscriber lists while writing.
+ */
+
+#define _GNU_SOURCE
+
+#include "gas_sensor_ws.h"
+#include "gas_sensor_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define MAX_EVENTS              64
+#define IN_SIZE                 2048    /* Handshake request, or buffered client frames */
+#define CTRL_SIZE               512     /* Handshake response and control frames */
+#define MSG_SIZE                (2 + GAS_SENSOR_WS_STATUS_SIZE)
+#define SENSOR_TABLE_INITIAL    64
+#define WS_GUID                 "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+#define OP_TEXT                 0x1
+#define OP_BINARY               0x2
+#define OP_CLOSE                0x8
+#define OP_PING                 0x9
+#define OP_PONG                 0xA
+
+#define CLOSE_PROTOCOL          1002
+#define CLOSE_UNSUPPORTED       1003
+#define CLOSE_TOO_BIG           1009
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+/* One encoded message, WebSocket header included, shared by reference */
+typedef struct payload {
+    struct payload *next_free;
+    unsigned refs;
+    uint8_t size;
+    uint8_t data[MSG_SIZE];
+} payload_t;
+
+struct client;
+struct group;
+
+typedef struct sub {
+    struct client *client;
+    struct group *group;                    /* NULL = slot unused */
+    struct sub *prev;                       /* Group's subscriber list */
+    struct sub *next;
+    payload_t *wave;                        /* Newest unsent messages */
+    payload_t *status;
+} sub_t;
+
+/* Subscribers of one sensor at one decimation factor */
+typedef struct group {
+    struct group *next;                     /* Sensor's groups */
+    uint32_t sensor_id;
+    unsigned factor;                        /* Frames per waveform message, 0 = none */
+    unsigned count;                         /* Frames in the current window */
+    float sum[GAS_SENSOR_CH_COUNT];
+    unsigned valid[GAS_SENSOR_CH_COUNT];
+    uint8_t alarm;                          /* Alarm bits seen in the window */
+    sub_t *subs;
+} group_t;
+
+typedef struct {
+    uint32_t sensor_id;
+    bool used;
+    group_t *groups;
+    uint32_t since_status;                  /* Frames since the last status message */
+    uint8_t alarm;                          /* Alarm bits of the last frame */
+} sensor_t;
+
+typedef enum {
+    CLIENT_HANDSHAKE,
+    CLIENT_OPEN,
+    CLIENT_CLOSING,                         /* Close frame queued; no more data */
+    CLIENT_DEAD                             /* Reaped at the end of the poll */
+} client_state_t;
+
+typedef struct client {
+    struct gas_sensor_ws *server;
+    struct client *prev;
+    struct client *next;
+    int fd;
+    client_state_t state;
+    bool writing;                           /* Waiting for EPOLLOUT */
+    unsigned next_sub;                      /* Round-robin start of the pending scan */
+    payload_t *out;                         /* Message partly written */
+    size_t out_pos;
+    size_t ctrl_pos;
+    size_t ctrl_len;
+    size_t in_len;
+    sub_t subs[GAS_SENSOR_WS_MAX_SUBSCRIPTIONS];
+    uint8_t ctrl[CTRL_SIZE];
+    uint8_t in[IN_SIZE];
+} client_t;
+
+struct gas_sensor_ws {
+    gas_sensor_ws_config_t config;
+    int epoll_fd;
+    int listen_fd;
+    uint16_t port;
+    client_t *clients;
+    sensor_t *sensors;
+    size_t sensor_capacity;
+    size_t sensor_count;
+    payload_t *free_payloads;
+    struct epoll_event events[MAX_EVENTS];
+    gas_sensor_ws_stats_t stats;
+};
+
+/* ============================================================================
+ * Helper Functions - SHA-1 and Base64 (handshake only)
+ * ============================================================================ */
+
+static uint32_t rol32(uint32_t x, unsigned n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static void sha1_block(uint32_t h[5], const uint8_t *block)
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t t = rol32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rol32(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+static void sha1(const uint8_t *data, size_t len, uint8_t digest[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    uint8_t block[64];
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        sha1_block(h, &data[i]);
+    }
+
+    size_t rest = len - i;
+    memset(block, 0, sizeof(block));
+    memcpy(block, &data[i], rest);
+    block[rest] = 0x80;
+    if (rest >= 56) {
+        sha1_block(h, block);
+        memset(block, 0, sizeof(block));
+    }
+    uint64_t bits = (uint64_t)len * 8;
+    for (int k = 0; k < 8; k++) {
+        block[63 - k] = (uint8_t)(bits >> (k * 8));
+    }
+    sha1_block(h, block);
+
+    for (int k = 0; k < 5; k++) {
+        digest[k * 4] = (uint8_t)(h[k] >> 24);
+        digest[k * 4 + 1] = (uint8_t)(h[k] >> 16);
+        digest[k * 4 + 2] = (uint8_t)(h[k] >> 8);
+        digest[k * 4 + 3] = (uint8_t)h[k];
+    }
+}
+
+/* Encode len bytes; out needs 4 * ((len + 2) / 3) + 1 bytes */
+static void base64(const uint8_t *data, size_t len, char *out)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < len) {
+            v |= (uint32_t)data[i + 1] << 8;
+        }
+        if (i + 2 < len) {
+            v |= data[i + 2];
+        }
+        out[o++] = alphabet[(v >> 18) & 0x3F];
+        out[o++] = alphabet[(v >> 12) & 0x3F];
+        out[o++] = (i + 1 < len) ? alphabet[(v >> 6) & 0x3F] : '=';
+        out[o++] = (i + 2 < len) ? alphabet[v & 0x3F] : '=';
+    }
+    out[o] = '\0';
+}
+
+/* ============================================================================
+ * Helper Functions - Messages
+ * ============================================================================ */
+
+/* Concentration as u16 hundredths of a percent, 0xFFFF = invalid */
+static void put_conc(uint8_t *data, float value)
+{
+    uint16_t raw = 0xFFFF;
+    if (value >= 0.0f) {
+        float scaled = value * 100.0f + 0.5f;
+        raw = (scaled >= 65534.0f) ? 65534 : (uint16_t)scaled;
+    }
+    data[0] = (uint8_t)raw;
+    data[1] = (uint8_t)(raw >> 8);
+}
+
+static uint8_t status_byte(const gas_sensor_status_t *status)
+{
+    return (uint8_t)((status->breath_detected ? GAS_SENSOR_STS_BREATH : 0) |
+                     (status->apnea ? GAS_SENSOR_STS_APNEA : 0) |
+                     (status->o2_low ? GAS_SENSOR_STS_O2_LOW : 0) |
+                     (status->o2_replace ? GAS_SENSOR_STS_O2_REPLACE : 0) |
+                     (status->check_adapter ? GAS_SENSOR_STS_CHECK_ADAPTER : 0) |
+                     (status->accuracy_out_of_range ? GAS_SENSOR_STS_ACCURACY : 0) |
+                     (status->sensor_error ? GAS_SENSOR_STS_SENSOR_ERROR : 0) |
+                     (status->o2_calibration_required ? GAS_SENSOR_STS_O2_CALIBRATION : 0));
+}
+
+static payload_t *payload_new(struct gas_sensor_ws *ws, size_t size)
+{
+    payload_t *p = ws->free_payloads;
+    if (p != NULL) {
+        ws->free_payloads = p->next_free;
+    } else if ((p = malloc(sizeof(*p))) == NULL) {
+        return NULL;
+    }
+
+    /* Server frames are unmasked, so the header is the same for everyone */
+    p->refs = 1;
+    p->size = (uint8_t)(2 + size);
+    p->data[0] = 0x80 | OP_BINARY;
+    p->data[1] = (uint8_t)size;
+    ws->stats.encoded++;
+    return p;
+}
+
+static void payload_release(struct gas_sensor_ws *ws, payload_t *p)
+{
+    if (p != NULL && --p->refs == 0) {
+        p->next_free = ws->free_payloads;
+        ws->free_payloads = p;
+    }
+}
+
+/* Message bytes [0-13], common to both types */
+static void put_header(uint8_t *msg, uint8_t type, uint32_t sensor_id,
+                       uint64_t timestamp_us, uint8_t status)
+{
+    msg[0] = type;
+    put_uint32_le(&msg[1], sensor_id);
+    put_uint64_le(&msg[5], timestamp_us);
+    msg[13] = status;
+}
+
+/* ============================================================================
+ * Helper Functions - Sensor Table
+ * ============================================================================ */
+
+GAS_SENSOR_ID_TABLE(sensor, sensor_t)
+
+static sensor_t *sensor_find(struct gas_sensor_ws *ws, uint32_t sensor_id)
+{
+    size_t i = sensor_slot(ws->sensors, ws->sensor_capacity - 1, sensor_id);
+    return ws->sensors[i].used ? &ws->sensors[i] : NULL;
+}
+
+/**
+ * Find or create a sensor's entry; NULL if the table could not grow
+ */
+static sensor_t *sensor_lookup(struct gas_sensor_ws *ws, uint32_t sensor_id)
+{
+    size_t i = sensor_slot(ws->sensors, ws->sensor_capacity - 1, sensor_id);
+    if (ws->sensors[i].used) {
+        return &ws->sensors[i];
+    }
+
+    /* Keep the load factor at or below one half */
+    if ((ws->sensor_count + 1) * 2 > ws->sensor_capacity) {
+        size_t capacity = ws->sensor_capacity * 2;
+        sensor_t *table = calloc(capacity, sizeof(*table));
+        if (table == NULL) {
+            return NULL;
+        }
+        for (size_t k = 0; k < ws->sensor_capacity; k++) {
+            if (ws->sensors[k].used) {
+                table[sensor_slot(table, capacity - 1, ws->sensors[k].sensor_id)] = ws->sensors[k];
+            }
+        }
+        free(ws->sensors);
+        ws->sensors = table;
+        ws->sensor_capacity = capacity;
+        i = sensor_slot(table, capacity - 1, sensor_id);
+    }
+
+    memset(&ws->sensors[i], 0, sizeof(ws->sensors[i]));
+    ws->sensors[i].used = true;
+    ws->sensors[i].sensor_id = sensor_id;
+    ws->sensor_count++;
+    return &ws->sensors[i];
+}
+
+/* Remove a sensor's entry, shifting later entries of the probe run back */
+static void sensor_delete(struct gas_sensor_ws *ws, sensor_t *s)
+{
+    sensor_remove(ws->sensors, ws->sensor_capacity - 1, (size_t)(s - ws->sensors));
+    ws->sensor_count--;
+}
+
+/* ============================================================================
+ * Helper Functions - Subscriptions
+ * ============================================================================ */
+
+static void sub_remove(struct gas_sensor_ws *ws, sub_t *sub)
+{
+    group_t *g = sub->group;
+    if (g == NULL) {
+        return;
+    }
+
+    if (sub->prev != NULL) {
+        sub->prev->next = sub->next;
+    } else {
+        g->subs = sub->next;
+    }
+    if (sub->next != NULL) {
+        sub->next->prev = sub->prev;
+    }
+    payload_release(ws, sub->wave);
+    payload_release(ws, sub->status);
+    memset(sub, 0, sizeof(*sub));
+    ws->stats.subscriptions--;
+
+    if (g->subs != NULL) {
+        return;
+    }
+
+    sensor_t *s = sensor_find(ws, g->sensor_id);
+    group_t **link = &s->groups;
+    while (*link != g) {
+        link = &(*link)->next;
+    }
+    *link = g->next;
+    free(g);
+    if (s->groups == NULL) {
+        sensor_delete(ws, s);
+    }
+}
+
+static sub_t *sub_find(client_t *c, uint32_t sensor_id)
+{
+    for (size_t i = 0; i < GAS_SENSOR_WS_MAX_SUBSCRIPTIONS; i++) {
+        if (c->subs[i].group != NULL && c->subs[i].group->sensor_id == sensor_id) {
+            return &c->subs[i];
+        }
+    }
+    return NULL;
+}
+
+static int sub_add(struct gas_sensor_ws *ws, client_t *c, uint32_t sensor_id, unsigned factor)
+{
+    sub_t *sub = sub_find(c, sensor_id);
+    if (sub != NULL) {
+        sub_remove(ws, sub);
+    } else {
+        for (size_t i = 0; i < GAS_SENSOR_WS_MAX_SUBSCRIPTIONS && sub == NULL; i++) {
+            if (c->subs[i].group == NULL) {
+                sub = &c->subs[i];
+            }
+        }
+        if (sub == NULL) {
+            return GAS_SENSOR_ERR_NO_SPACE;
+        }
+    }
+
+    sensor_t *s = sensor_lookup(ws, sensor_id);
+    if (s == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+
+    group_t *g = s->groups;
+    while (g != NULL && g->factor != factor) {
+        g = g->next;
+    }
+    if (g == NULL) {
+        g = calloc(1, sizeof(*g));
+        if (g == NULL) {
+            if (s->groups == NULL) {
+                sensor_delete(ws, s);
+            }
+            return GAS_SENSOR_ERR_MEMORY;
+        }
+        g->sensor_id = sensor_id;
+        g->factor = factor;
+        g->next = s->groups;
+        s->groups = g;
+    }
+
+    sub->client = c;
+    sub->group = g;
+    sub->prev = NULL;
+    sub->next = g->subs;
+    if (g->subs != NULL) {
+        g->subs->prev = sub;
+    }
+    g->subs = sub;
+    ws->stats.subscriptions++;
+    return GAS_SENSOR_OK;
+}
+
+/* Replace a pending slot with a newer message */
+static void sub_deliver(struct gas_sensor_ws *ws, payload_t **slot, payload_t *p)
+{
+    if (*slot != NULL) {
+        payload_release(ws, *slot);
+        ws->stats.dropped++;
+    }
+    p->refs++;
+    *slot = p;
+}
+
+/* ============================================================================
+ * Helper Functions - Client Output
+ * ============================================================================ */
+
+static void client_watch(client_t *c, bool writing)
+{
+    if (c->writing == writing) {
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | (writing ? EPOLLOUT : 0);
+    ev.data.ptr = c;
+    if (epoll_ctl(c->server->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev) == 0) {
+        c->writing = writing;
+    }
+}
+
+/* Queue connection-private bytes; false if the control buffer is full */
+static bool client_ctrl(client_t *c, const void *data, size_t len)
+{
+    if (c->ctrl_pos == c->ctrl_len) {
+        c->ctrl_pos = c->ctrl_len = 0;
+    }
+    if (c->ctrl_len + len > sizeof(c->ctrl)) {
+        return false;
+    }
+    memcpy(&c->ctrl[c->ctrl_len], data, len);
+    c->ctrl_len += len;
+    return true;
+}
+
+static void client_frame(client_t *c, uint8_t opcode, const void *payload, size_t len)
+{
+    uint8_t frame[2 + 125];
+    if (len > 125) {
+        len = 125;
+    }
+    frame[0] = 0x80 | opcode;
+    frame[1] = (uint8_t)len;
+    memcpy(&frame[2], payload, len);
+    if (!client_ctrl(c, frame, 2 + len)) {
+        c->state = CLIENT_DEAD;
+    }
+}
+
+static void client_unsubscribe_all(client_t *c)
+{
+    for (size_t i = 0; i < GAS_SENSOR_WS_MAX_SUBSCRIPTIONS; i++) {
+        sub_remove(c->server, &c->subs[i]);
+    }
+}
+
+/* Queue a close frame; the connection ends once it is written */
+static void client_close(client_t *c, uint16_t code)
+{
+    if (c->state == CLIENT_CLOSING || c->state == CLIENT_DEAD) {
+        return;
+    }
+
+    uint8_t payload[2] = { (uint8_t)(code >> 8), (uint8_t)code };
+    client_unsubscribe_all(c);
+    client_frame(c, OP_CLOSE, payload, sizeof(payload));
+    if (c->state != CLIENT_DEAD) {
+        c->state = CLIENT_CLOSING;
+    }
+}
+
+/**
+ * Write the in-flight message, control bytes and pending messages
+ *
+ * Everything goes out with one sendmsg(); what the socket does not take
+ * stays queued and EPOLLOUT is requested.
+ */
+static void client_flush(client_t *c)
+{
+    enum { IOV_MAX_COUNT = 2 + 2 * GAS_SENSOR_WS_MAX_SUBSCRIPTIONS };
+    struct gas_sensor_ws *ws = c->server;
+    struct iovec iov[IOV_MAX_COUNT];
+    payload_t **slots[IOV_MAX_COUNT];       /* Pending slot of each vector, NULL = out or ctrl */
+    size_t ctrl_index = IOV_MAX_COUNT;
+    size_t n = 0;
+
+    if (c->state == CLIENT_DEAD) {
+        return;
+    }
+
+    if (c->out != NULL) {
+        iov[n].iov_base = &c->out->data[c->out_pos];
+        iov[n].iov_len = c->out->size - c->out_pos;
+        slots[n++] = NULL;
+    }
+    if (c->ctrl_pos < c->ctrl_len) {
+        iov[n].iov_base = &c->ctrl[c->ctrl_pos];
+        iov[n].iov_len = c->ctrl_len - c->ctrl_pos;
+        ctrl_index = n;
+        slots[n++] = NULL;
+    }
+    for (size_t k = 0; k < GAS_SENSOR_WS_MAX_SUBSCRIPTIONS; k++) {
+        sub_t *sub = &c->subs[(c->next_sub + k) % GAS_SENSOR_WS_MAX_SUBSCRIPTIONS];
+        payload_t **pending[2] = { &sub->status, &sub->wave };
+        for (int m = 0; m < 2; m++) {
+            if (*pending[m] != NULL) {
+                iov[n].iov_base = (*pending[m])->data;
+                iov[n].iov_len = (*pending[m])->size;
+                slots[n++] = pending[m];
+            }
+        }
+    }
+    c->next_sub = (c->next_sub + 1) % GAS_SENSOR_WS_MAX_SUBSCRIPTIONS;
+
+    if (n == 0) {
+        client_watch(c, false);
+        if (c->state == CLIENT_CLOSING) {
+            c->state = CLIENT_DEAD;
+        }
+        return;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n;
+    ssize_t written;
+    do {
+        written = sendmsg(c->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    } while (written < 0 && errno == EINTR);
+
+    if (written < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            client_watch(c, true);
+        } else {
+            c->state = CLIENT_DEAD;
+        }
+        return;
+    }
+
+    size_t left = (size_t)written;
+    bool blocked = false;
+    for (size_t i = 0; i < n && !blocked; i++) {
+        size_t len = iov[i].iov_len;
+        size_t taken = (left < len) ? left : len;
+        left -= taken;
+        blocked = (taken < len);
+
+        if (slots[i] != NULL) {
+            if (taken == 0) {
+                continue;                   /* Stays pending */
+            }
+            payload_t *p = *slots[i];
+            *slots[i] = NULL;
+            if (blocked) {
+                c->out = p;
+                c->out_pos = taken;
+            } else {
+                payload_release(ws, p);
+                ws->stats.sent++;
+            }
+        } else if (i == ctrl_index) {
+            c->ctrl_pos += taken;
+        } else {
+            c->out_pos += taken;
+            if (!blocked) {
+                payload_release(ws, c->out);
+                c->out = NULL;
+                ws->stats.sent++;
+            }
+        }
+    }
+
+    if (blocked) {
+        client_watch(c, true);
+    } else {
+        client_watch(c, false);
+        if (c->state == CLIENT_CLOSING) {
+            c->state = CLIENT_DEAD;
+        }
+    }
+}
+
+/* ============================================================================
+ * Helper Functions - Client Input
+ * ============================================================================ */
+
+static const char *header_value(const char *request, const char *name)
+{
+    size_t len = strlen(name);
+    for (const char *line = strstr(request, "\r\n"); line != NULL; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (strncasecmp(line, name, len) == 0 && line[len] == ':') {
+            const char *value = &line[len + 1];
+            while (*value == ' ' || *value == '\t') {
+                value++;
+            }
+            return value;
+        }
+    }
+    return NULL;
+}
+
+static bool value_contains(const char *value, const char *token)
+{
+    if (value == NULL) {
+        return false;
+    }
+    const char *end = strstr(value, "\r\n");
+    size_t len = strlen(token);
+    for (const char *p = value; p + len <= end; p++) {
+        if (strncasecmp(p, token, len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Answer the opening handshake once the request is complete
+ * Returns the request length, 0 if incomplete, -1 if rejected.
+ */
+static long client_handshake(client_t *c)
+{
+    struct gas_sensor_ws *ws = c->server;
+    c->in[c->in_len < IN_SIZE ? c->in_len : IN_SIZE - 1] = '\0';
+    char *request = (char *)c->in;
+    char *end = strstr(request, "\r\n\r\n");
+    if (end == NULL) {
+        return (c->in_len >= IN_SIZE - 1) ? -1 : 0;
+    }
+    end[2] = '\0';                          /* Keep the last header's CRLF */
+
+    const char *key = header_value(request, "Sec-WebSocket-Key");
+    const char *version = header_value(request, "Sec-WebSocket-Version");
+    size_t key_len = (key != NULL) ? strcspn(key, " \t\r") : 0;
+
+    if (strncmp(request, "GET ", 4) != 0 ||
+        !value_contains(header_value(request, "Upgrade"), "websocket") ||
+        !value_contains(header_value(request, "Connection"), "upgrade") ||
+        version == NULL || strncmp(version, "13", 2) != 0 ||
+        key_len == 0 || key_len > 64) {
+        static const char bad[] =
+            "HTTP/1.1 400 Bad Request\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+        client_ctrl(c, bad, sizeof(bad) - 1);
+        c->state = CLIENT_CLOSING;
+        ws->stats.rejected++;
+        return -1;
+    }
+
+    char concat[64 + sizeof(WS_GUID)];
+    memcpy(concat, key, key_len);
+    memcpy(&concat[key_len], WS_GUID, sizeof(WS_GUID) - 1);
+    uint8_t digest[20];
+    sha1((const uint8_t *)concat, key_len + sizeof(WS_GUID) - 1, digest);
+    char accept[29];
+    base64(digest, sizeof(digest), accept);
+
+    char response[160];
+    int len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 101 Switching Protocols\r\n"
+                       "Upgrade: websocket\r\n"
+                       "Connection: Upgrade\r\n"
+                       "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+    client_ctrl(c, response, (size_t)len);
+    c->state = CLIENT_OPEN;
+    return (long)(end + 4 - request);
+}
+
+static void client_reply(client_t *c, const char *text)
+{
+    client_frame(c, OP_TEXT, text, strlen(text));
+}
+
+/* Execute one text message */
+static void client_command(client_t *c, char *text)
+{
+    struct gas_sensor_ws *ws = c->server;
+    char verb[8];
+    unsigned long sensor_id;
+    unsigned rate;
+    char extra;
+
+    int fields = sscanf(text, "%7s %lu %u %c", verb, &sensor_id, &rate, &extra);
+    if (fields == 3 && strcmp(verb, "sub") == 0 && sensor_id <= UINT32_MAX &&
+        rate <= GAS_SENSOR_WS_MAX_RATE_HZ) {
+        unsigned factor = (rate == 0) ? 0 : (GAS_SENSOR_WS_MAX_RATE_HZ + rate / 2) / rate;
+        int result = sub_add(ws, c, (uint32_t)sensor_id, factor);
+        client_reply(c, (result == GAS_SENSOR_OK) ? "ok" :
+                        (result == GAS_SENSOR_ERR_NO_SPACE) ? "error too many subscriptions"
+                                                            : "error out of memory");
+    } else if (fields == 2 && strcmp(verb, "unsub") == 0) {
+        sub_t *sub = sub_find(c, (uint32_t)sensor_id);
+        if (sub != NULL) {
+            sub_remove(ws, sub);
+        }
+        client_reply(c, (sub != NULL) ? "ok" : "error not subscribed");
+    } else {
+        client_reply(c, "error bad command");
+    }
+}
+
+/**
+ * Handle one complete client frame
+ * Returns its length, 0 if incomplete.
+ */
+static size_t client_message(client_t *c, uint8_t *data, size_t avail)
+{
+    if (avail < 2) {
+        return 0;
+    }
+
+    uint8_t opcode = data[0] & 0x0F;
+    size_t len = data[1] & 0x7F;
+    size_t header = 2;
+    if ((data[0] & 0x70) != 0 || !(data[1] & 0x80)) {
+        client_close(c, CLOSE_PROTOCOL);        /* Reserved bits, or an unmasked client frame */
+        return avail;
+    }
+    if ((opcode & 0x8) && (len > 125 || !(data[0] & 0x80))) {
+        client_close(c, CLOSE_PROTOCOL);        /* Control frames are short and never fragmented */
+        return avail;
+    }
+    if (len == 127) {
+        client_close(c, CLOSE_TOO_BIG);
+        return avail;
+    }
+    if (len == 126) {
+        if (avail < 4) {
+            return 0;
+        }
+        len = ((size_t)data[2] << 8) | data[3];
+        header = 4;
+    }
+    header += 4;
+    if (header + len > IN_SIZE - 1) {
+        client_close(c, CLOSE_TOO_BIG);
+        return avail;
+    }
+    if (avail < header + len) {
+        return 0;
+    }
+
+    uint8_t *payload = &data[header];
+    const uint8_t *mask = &data[header - 4];
+    for (size_t i = 0; i < len; i++) {
+        payload[i] ^= mask[i & 3];
+    }
+
+    if (!(data[0] & 0x80) || opcode == 0) {
+        client_close(c, CLOSE_UNSUPPORTED);     /* Fragmented messages */
+        return avail;
+    }
+
+    switch (opcode) {
+        case OP_TEXT: {
+            uint8_t saved = payload[len];       /* Next frame's first byte, or spare */
+            payload[len] = '\0';
+            client_command(c, (char *)payload);
+            payload[len] = saved;
+            break;
+        }
+        case OP_PING:
+            client_frame(c, OP_PONG, payload, len);
+            break;
+        case OP_PONG:
+            break;
+        case OP_CLOSE: {
+            uint16_t code = (len >= 2) ? (uint16_t)((payload[0] << 8) | payload[1]) : 1000;
+            client_close(c, code);
+            break;
+        }
+        default:
+            client_close(c, CLOSE_UNSUPPORTED);
+            break;
+    }
+    return header + len;
+}
+
+static void client_read(client_t *c)
+{
+    for (;;) {
+        ssize_t n = read(c->fd, &c->in[c->in_len], IN_SIZE - 1 - c->in_len);
+        if (n > 0) {
+            c->in_len += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            c->state = CLIENT_DEAD;             /* End of file or error */
+            return;
+        }
+
+        size_t pos = 0;
+        if (c->state == CLIENT_HANDSHAKE) {
+            long used = client_handshake(c);
+            if (used == 0) {
+                continue;                       /* Request incomplete */
+            }
+            pos = (used > 0) ? (size_t)used : c->in_len;
+        }
+        while (c->state == CLIENT_OPEN && pos < c->in_len) {
+            size_t used = client_message(c, &c->in[pos], c->in_len - pos);
+            if (used == 0) {
+                break;
+            }
+            pos += used;
+        }
+        if (c->state != CLIENT_OPEN && c->state != CLIENT_HANDSHAKE) {
+            pos = c->in_len;                    /* Closing: input is ignored */
+        }
+        memmove(c->in, &c->in[pos], c->in_len - pos);
+        c->in_len -= pos;
+        if (c->in_len == IN_SIZE - 1) {
+            client_close(c, CLOSE_TOO_BIG);
+            c->in_len = 0;
+        }
+    }
+    client_flush(c);
+}
+
+static void client_free(struct gas_sensor_ws *ws, client_t *c)
+{
+    client_unsubscribe_all(c);
+    payload_release(ws, c->out);
+    close(c->fd);
+
+    if (c->prev != NULL) {
+        c->prev->next = c->next;
+    } else {
+        ws->clients = c->next;
+    }
+    if (c->next != NULL) {
+        c->next->prev = c->prev;
+    }
+    ws->stats.clients--;
+    free(c);
+}
+
+static void server_accept(struct gas_sensor_ws *ws)
+{
+    for (;;) {
+        int fd = accept4(ws->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return;
+        }
+        if (ws->stats.clients >= ws->config.max_clients) {
+            close(fd);
+            ws->stats.rejected++;
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (ws->config.send_buffer > 0) {
+            setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &ws->config.send_buffer,
+                       sizeof(ws->config.send_buffer));
+        }
+
+        client_t *c = calloc(1, sizeof(*c));
+        if (c == NULL) {
+            close(fd);
+            ws->stats.rejected++;
+            continue;
+        }
+        c->server = ws;
+        c->fd = fd;
+        c->state = CLIENT_HANDSHAKE;
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        if (epoll_ctl(ws->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            free(c);
+            ws->stats.rejected++;
+            continue;
+        }
+
+        c->next = ws->clients;
+        if (ws->clients != NULL) {
+            ws->clients->prev = c;
+        }
+        ws->clients = c;
+        ws->stats.clients++;
+        ws->stats.accepted++;
+    }
+}
+
+/* ============================================================================
+ * Helper Functions - Producer
+ * ============================================================================ */
+
+static void group_add_frame(struct gas_sensor_ws *ws, group_t *g,
+                            const gas_sensor_frame_event_t *event, uint8_t status)
+{
+    const gas_sensor_waveform_t *w = event->waveform;
+    float values[GAS_SENSOR_CH_COUNT] = { w->co2, w->n2o, w->aa1, w->aa2, w->o2 };
+    for (int k = 0; k < GAS_SENSOR_CH_COUNT; k++) {
+        if (values[k] >= 0.0f) {
+            g->sum[k] += values[k];
+            g->valid[k]++;
+        }
+    }
+    g->alarm |= status & GAS_SENSOR_STS_ALARM_MASK;
+    if (++g->count < g->factor) {
+        return;
+    }
+
+    payload_t *p = payload_new(ws, GAS_SENSOR_WS_WAVEFORM_SIZE);
+    if (p != NULL) {
+        uint8_t *msg = &p->data[2];
+        put_header(msg, GAS_SENSOR_WS_MSG_WAVEFORM, event->sensor_id, event->timestamp_us,
+                   (uint8_t)(status | g->alarm));
+        msg[14] = (uint8_t)g->factor;
+        for (int k = 0; k < GAS_SENSOR_CH_COUNT; k++) {
+            put_conc(&msg[15 + 2 * k],
+                     g->valid[k] ? g->sum[k] / (float)g->valid[k] : GAS_SENSOR_CONC_INVALID);
+        }
+        for (sub_t *sub = g->subs; sub != NULL; sub = sub->next) {
+            sub_deliver(ws, &sub->wave, p);
+        }
+        payload_release(ws, p);
+    }
+
+    g->count = 0;
+    g->alarm = 0;
+    memset(g->sum, 0, sizeof(g->sum));
+    memset(g->valid, 0, sizeof(g->valid));
+}
+
+static payload_t *encode_status(struct gas_sensor_ws *ws,
+                                const gas_sensor_frame_event_t *event, uint8_t status)
+{
+    const gas_sensor_slow_data_t *sd = event->slow_data;
+    payload_t *p = payload_new(ws, GAS_SENSOR_WS_STATUS_SIZE);
+    if (p == NULL) {
+        return NULL;
+    }
+
+    uint8_t *msg = &p->data[2];
+    put_header(msg, GAS_SENSOR_WS_MSG_STATUS, event->sensor_id, event->timestamp_us, status);
+    msg[14] = (uint8_t)sd->sensor_regs.mode;
+    msg[15] = sd->gen_vals.resp_rate;
+    msg[16] = (uint8_t)sd->gen_vals.primary_agent;
+    msg[17] = (uint8_t)sd->gen_vals.secondary_agent;
+
+    const float et[GAS_SENSOR_CH_COUNT] = { sd->exp_vals.co2, sd->exp_vals.n2o, sd->exp_vals.aa1,
+                                            sd->exp_vals.aa2, sd->exp_vals.o2 };
+    const float fi[GAS_SENSOR_CH_COUNT] = { sd->insp_vals.co2, sd->insp_vals.n2o, sd->insp_vals.aa1,
+                                            sd->insp_vals.aa2, sd->insp_vals.o2 };
+    for (int k = 0; k < GAS_SENSOR_CH_COUNT; k++) {
+        put_conc(&msg[18 + 2 * k], et[k]);
+        put_conc(&msg[28 + 2 * k], fi[k]);
+    }
+    return p;
+}
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+void gas_sensor_ws_config_init(gas_sensor_ws_config_t *config)
+{
+    if (config == NULL) {
+        return;
+    }
+
+    config->address = "127.0.0.1";
+    config->port = 0;
+    config->max_clients = 256;
+    config->status_frames = 10;
+    config->send_buffer = 16384;
+}
+
+int gas_sensor_ws_create(const gas_sensor_ws_config_t *config, gas_sensor_ws_t *server)
+{
+    if (server == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    gas_sensor_ws_config_t cfg;
+    if (config != NULL) {
+        cfg = *config;
+    } else {
+        gas_sensor_ws_config_init(&cfg);
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(cfg.port);
+    if (cfg.address == NULL || inet_pton(AF_INET, cfg.address, &addr.sin_addr) != 1 ||
+        cfg.max_clients == 0 || cfg.status_frames == 0) {
+        return GAS_SENSOR_ERR_INVALID_PARAM;
+    }
+
+    struct gas_sensor_ws *ws = calloc(1, sizeof(*ws));
+    if (ws == NULL) {
+        return GAS_SENSOR_ERR_MEMORY;
+    }
+    ws->config = cfg;
+    ws->listen_fd = -1;
+    ws->sensor_capacity = SENSOR_TABLE_INITIAL;
+    ws->sensors = calloc(ws->sensor_capacity, sizeof(*ws->sensors));
+    ws->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (ws->sensors == NULL || ws->epoll_fd < 0) {
+        int result = (ws->sensors == NULL) ? GAS_SENSOR_ERR_MEMORY : GAS_SENSOR_ERR_IO;
+        gas_sensor_ws_destroy(ws);
+        return result;
+    }
+
+    int one = 1;
+    socklen_t addr_len = sizeof(addr);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+
+    ws->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (ws->listen_fd < 0 ||
+        setsockopt(ws->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        bind(ws->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(ws->listen_fd, SOMAXCONN) != 0 ||
+        getsockname(ws->listen_fd, (struct sockaddr *)&addr, &addr_len) != 0 ||
+        epoll_ctl(ws->epoll_fd, EPOLL_CTL_ADD, ws->listen_fd, &ev) != 0) {
+        gas_sensor_ws_destroy(ws);
+        return GAS_SENSOR_ERR_IO;
+    }
+    ws->port = ntohs(addr.sin_port);
+
+    *server = ws;
+    return GAS_SENSOR_OK;
+}
+
+uint16_t gas_sensor_ws_port(gas_sensor_ws_t server)
+{
+    return (server != NULL) ? server->port : 0;
+}
+
+int gas_sensor_ws_fd(gas_sensor_ws_t server)
+{
+    return (server != NULL) ? server->epoll_fd : -1;
+}
+
+int gas_sensor_ws_frame_handler(void *ctx, const gas_sensor_frame_event_t *event)
+{
+    struct gas_sensor_ws *ws = ctx;
+    if (ws == NULL || event == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    sensor_t *s = sensor_find(ws, event->sensor_id);
+    if (s == NULL || event->status == NULL) {
+        return GAS_SENSOR_OK;
+    }
+
+    uint8_t status = status_byte(event->status);
+    uint8_t alarm = status & GAS_SENSOR_STS_ALARM_MASK;
+
+    if (event->waveform != NULL) {
+        for (group_t *g = s->groups; g != NULL; g = g->next) {
+            if (g->factor != 0) {
+                group_add_frame(ws, g, event, status);
+            }
+        }
+    }
+
+    if (event->slow_data != NULL &&
+        (++s->since_status >= ws->config.status_frames || alarm != s->alarm)) {
+        payload_t *p = encode_status(ws, event, status);
+        if (p != NULL) {
+            for (group_t *g = s->groups; g != NULL; g = g->next) {
+                for (sub_t *sub = g->subs; sub != NULL; sub = sub->next) {
+                    sub_deliver(ws, &sub->status, p);
+                }
+            }
+            payload_release(ws, p);
+            s->since_status = 0;
+        }
+    }
+    s->alarm = alarm;
+
+    /* Clients waiting for EPOLLOUT are written from the poll */
+    for (group_t *g = s->groups; g != NULL; g = g->next) {
+        for (sub_t *sub = g->subs; sub != NULL; sub = sub->next) {
+            if (!sub->client->writing && (sub->wave != NULL || sub->status != NULL)) {
+                client_flush(sub->client);
+            }
+        }
+    }
+    return GAS_SENSOR_OK;
+}
+
+int gas_sensor_ws_poll(gas_sensor_ws_t server, int timeout_ms)
+{
+    if (server == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    int ready = epoll_wait(server->epoll_fd, server->events, MAX_EVENTS, timeout_ms);
+    if (ready < 0) {
+        return (errno == EINTR) ? 0 : GAS_SENSOR_ERR_IO;
+    }
+
+    for (int i = 0; i < ready; i++) {
+        client_t *c = server->events[i].data.ptr;
+        uint32_t events = server->events[i].events;
+        if (c == NULL) {
+            server_accept(server);
+            continue;
+        }
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            c->state = CLIENT_DEAD;
+            continue;
+        }
+        if (events & EPOLLIN) {
+            client_read(c);
+        }
+        if (events & EPOLLOUT) {
+            client_flush(c);
+        }
+    }
+
+    client_t *c = server->clients;
+    while (c != NULL) {
+        client_t *next = c->next;
+        if (c->state == CLIENT_DEAD) {
+            client_free(server, c);
+        }
+        c = next;
+    }
+    return ready;
+}
+
+int gas_sensor_ws_stats(gas_sensor_ws_t server, gas_sensor_ws_stats_t *stats)
+{
+    if (server == NULL || stats == NULL) {
+        return GAS_SENSOR_ERR_NULL_PARAM;
+    }
+
+    *stats = server->stats;
+    return GAS_SENSOR_OK;
+}
+
+void gas_sensor_ws_destroy(gas_sensor_ws_t server)
+{
+    if (server == NULL) {
+        return;
+    }
+
+    while (server->clients != NULL) {
+        client_free(server, server->clients);
+    }
+    while (server->free_payloads != NULL) {
+        payload_t *p = server->free_payloads;
+        server->free_payloads = p->next_free;
+        free(p);
+    }
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+    }
+    if (server->epoll_fd >= 0) {
+        close(server->epoll_fd);
+    }
+    free(server->sensors);
+    free(server);
+}
@@ -0,0 +1,165 @@
+/*
+ * Anesthetic Gas Sensor WebSocket Streaming
+ *
+ * An embedded WebSocket server (RFC 6455) for remote viewers. A client
+ * connects, then subscribes to sensors with text messages:
+ *
+ *   sub <sensor_id> <rate_hz>   Stream a sensor at 1-20 Hz (0: status only);
+ *                               subscribing again changes the rate
+ *   unsub <sensor_id>           Stop streaming a sensor
+ *
+ * and receives binary messages, one per WebSocket frame, little-endian:
+ *
+ *   Waveform (GAS_SENSOR_WS_MSG_WAVEFORM), 25 bytes
+ *     [0]     Message type
+ *     [1-4]   Sensor ID
+ *     [5-12]  Timestamp of the last frame in the window (us since epoch)
+ *     [13]    STS byte of the last frame, with every alarm bit seen in
+ *             the window
+ *     [14]    Frames per message (decimation factor)
+ *     [15-24] CO2, N2O, AA1, AA2, O2: mean over the window (u16,
+ *             hundredths of %, 0xFFFF = invalid)
+ *   Status (GAS_SENSOR_WS_MSG_STATUS), 38 bytes, every status interval
+ *   and whenever an alarm STS bit changes
+ *     [0-13]  As above
+ *     [14]    Sensor mode
+ *     [15]    Respiratory rate (bpm, 0xFF = invalid)
+ *     [16-17] Primary and secondary agent IDs
+ *     [18-27] Expired CO2, N2O, AA1, AA2, O2 (u16 as above)
+ *     [28-37] Inspired CO2, N2O, AA1, AA2, O2 (u16 as above)
+ *
+ * Decimation averages the waveform over the window rather than picking
+ * one frame in N, so low-rate viewers do not see aliasing; alarm bits are
+ * OR-ed over the window so a short alarm is never decimated away.
+ *
+ * Each message is encoded once, WebSocket header included, and shared by
+ * reference between every client subscribed to the same sensor at the
+ * same rate. Backpressure is drop-to-latest: a client whose socket does
+ * not accept a message keeps only the newest waveform and the newest
+ * status per subscription, so a slow viewer loses intermediate samples,
+ * never falls behind, and never slows the producer or other viewers.
+ *
+ * Single-threaded: the frame handler and gas_sensor_ws_poll() must be
+ * called from the same thread, typically the one polling the session
+ * manager. Messages are written from the frame handler when a socket has
+ * room, and otherwise when poll sees it writable again.
+ *
+ * Linux only (epoll).
+ */
+
+#ifndef GAS_SENSOR_WS_H
+#define GAS_SENSOR_WS_H
+
+#include "gas_sensor.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ============================================================================
+ * Constants
+ * ============================================================================ */
+
+#define GAS_SENSOR_WS_MSG_WAVEFORM          0x01
+#define GAS_SENSOR_WS_MSG_STATUS            0x02
+
+#define GAS_SENSOR_WS_WAVEFORM_SIZE         25
+#define GAS_SENSOR_WS_STATUS_SIZE           38
+
+#define GAS_SENSOR_WS_MAX_RATE_HZ           20      /* Sensor frame rate */
+#define GAS_SENSOR_WS_MAX_SUBSCRIPTIONS     16      /* Per client */
+
+/* ============================================================================
+ * Data Structures
+ * ============================================================================ */
+
+typedef struct gas_sensor_ws *gas_sensor_ws_t;
+
+typedef struct {
+    const char *address;            /* IPv4 address to listen on */
+    uint16_t port;                  /* 0 = any free port */
+    size_t max_clients;
+    uint32_t status_frames;         /* Frames between status messages */
+    int send_buffer;                /* Socket send buffer (bytes); bounds the
+                                       latency before drop-to-latest, 0 = system */
+} gas_sensor_ws_config_t;
+
+typedef struct {
+    size_t clients;                 /* Open connections */
+    size_t subscriptions;
+    uint64_t accepted;              /* Connections accepted */
+    uint64_t rejected;              /* Failed handshakes and connections over max_clients */
+    uint64_t encoded;               /* Messages encoded (once per sensor and rate) */
+    uint64_t sent;                  /* Messages written to clients */
+    uint64_t dropped;               /* Messages replaced by a newer one before sending */
+} gas_sensor_ws_stats_t;
+
+/* ============================================================================
+ * Public API Functions
+ * ============================================================================ */
+
+/**
+ * Initialize a configuration: 127.0.0.1, any port, 256 clients, status
+ * every 10 frames (one slow data cycle), 16 KiB send buffers
+ */
+void gas_sensor_ws_config_init(gas_sensor_ws_config_t *config);
+
+/**
+ * Create a server and start listening
+ *
+ * @param config: Configuration, or NULL for the defaults
+ * @param server: Output parameter for the server handle
+ * @return: GAS_SENSOR_OK, GAS_SENSOR_ERR_INVALID_PARAM, GAS_SENSOR_ERR_IO,
+ *          GAS_SENSOR_ERR_MEMORY or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_ws_create(const gas_sensor_ws_config_t *config, gas_sensor_ws_t *server);
+
+/**
+ * Get the port the server listens on
+ */
+uint16_t gas_sensor_ws_port(gas_sensor_ws_t server);
+
+/**
+ * Get a descriptor that polls readable when gas_sensor_ws_poll() has work
+ */
+int gas_sensor_ws_fd(gas_sensor_ws_t server);
+
+/**
+ * Feed one frame event
+ *
+ * Matches gas_sensor_frame_handler_t, so a server can be passed directly
+ * to gas_sensor_session_attach() as handler context. Frames of sensors
+ * nobody subscribed to cost one table lookup.
+ *
+ * @param ctx: Server handle
+ * @param event: Frame event (waveform and slow data are used)
+ * @return: GAS_SENSOR_OK or GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_ws_frame_handler(void *ctx, const gas_sensor_frame_event_t *event);
+
+/**
+ * Accept connections, read client messages and write pending messages
+ *
+ * @param server: Server handle
+ * @param timeout_ms: -1 waits forever, 0 polls
+ * @return: Number of descriptors serviced, GAS_SENSOR_ERR_IO or
+ *          GAS_SENSOR_ERR_NULL_PARAM
+ */
+int gas_sensor_ws_poll(gas_sensor_ws_t server, int timeout_ms);
+
+/**
+ * Get server counters
+ */
+int gas_sensor_ws_stats(gas_sensor_ws_t server, gas_sensor_ws_stats_t *stats);
+
+/**
+ * Close every connection and free a server
+ */
+void gas_sensor_ws_destroy(gas_sensor_ws_t server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GAS_SENSOR_WS_H */